@@ -4,10 +4,24 @@
 
 #include "dex.hpp"
 #include "manifest.hpp"
+#include "resources.hpp"
+#include "res_strings.hpp"
+#include "binary_strings.hpp"
+#include "component_linker.hpp"
+#include "native_libs.hpp"
+#include "payload_scanner.hpp"
+#include "entropy.hpp"
+#include "bundle.hpp"
+#include "zip_recovery.hpp"
+#include "apk_writer.hpp"
 #include "cert.hpp"
+#include "apk_signature.hpp"
 #include "patterns.hpp"
+#include "output.hpp"
+#include "smali_export.hpp"
 
 #include "digestpp/digestpp.hpp"
+#include "slicer/chronometer.h"
 
 namespace andromeda
 {
@@ -16,16 +30,30 @@ namespace andromeda
 	public:
 		bool is_valid = false;
 		std::shared_ptr<manifest> app_manifest;
+		std::shared_ptr<resource_table> resources;
+		std::shared_ptr<res_strings> xml_strings;
+		std::shared_ptr<native_libs> natives;
+		std::shared_ptr<binary_strings> bin_strings;
+		std::shared_ptr<payload_scanner> payloads;
 		std::shared_ptr<andromeda::certificate> cert;
+		std::shared_ptr<app_bundle> bundle; // the nested archives, always read for XAPK / APKS files
 		std::vector<parsed_dex> parsed_dexes{};
+		std::string apk_path{};
+		utils::zip_source source{}; // the APK itself, or the base APK of a bundle
 		std::string unzip_path{};
 		std::vector<std::string> file_pathes{};
 
 		explicit apk(const std::string& full_path)
 		{
 			is_valid = true;
+			apk_path = full_path;
 			// Unzip APK file
 
+			if (app_bundle::is_bundle_name(full_path))
+			{
+				is_valid = load_bundle(utils::zip_source(full_path));
+				return;
+			}
 			if (utils::ends_with(full_path, ".apk"))
 			{
 				const auto unzip_result = utils::unzip_file(full_path, false);
@@ -36,7 +64,7 @@ namespace andromeda
 				{
 					color_printf(color::FG_RED, "Failed to unpack the file: %s\n",
 					             full_path.c_str());
-					is_valid = false;
+					is_valid = load_recovered(full_path);
 					return;
 				}
 			}
@@ -47,10 +75,10 @@ namespace andromeda
 				return;
 			}
 
+			source = utils::zip_source(full_path);
+
 			// certificate
-			const auto certificate_dir = unzip_path + '/' + "META-INF";
-			cert = std::shared_ptr<certificate>{new certificate(certificate_dir)};
-			
+			cert = std::shared_ptr<certificate>{new certificate(source)};
 
 			// manifest
 			const auto manifest_path = unzip_path + '/' + "AndroidManifest.xml";
@@ -66,6 +94,23 @@ namespace andromeda
 				return;
 			}
 
+			xml_strings = std::make_shared<res_strings>(source);
+			natives = std::make_shared<native_libs>(source);
+			bin_strings = std::make_shared<binary_strings>(source);
+			payloads = std::make_shared<payload_scanner>(source);
+
+			// resources (optional)
+			const auto resources_path = unzip_path + '/' + "resources.arsc";
+			if (fs::exists(resources_path))
+			{
+				resources = std::make_shared<resource_table>(resources_path);
+				if (!resources->is_valid())
+				{
+					color_printf(color::FG_LIGHT_RED, "Failed to parse resources.arsc\n");
+					resources.reset();
+				}
+			}
+
 			// dex
 			for (auto& p : fs::directory_iterator(unzip_path))
 			{
@@ -89,114 +134,577 @@ namespace andromeda
 		apk(const apk&) = default;
 		apk& operator=(const apk&) = default;
 
-		std::vector<std::string> get_libs(const fs::path& file_path, bool extract = false, const std::string& target_lib_path = "", const bool get_hash = false)
+		// XAPK / APKS: the base and split APKs are read from memory and seen as one app,
+		// the dex files and native libraries of every split are merged with the base ones
+		bool load_bundle(const utils::zip_source& archive)
 		{
-			if (get_hash == true)
+			bundle = std::make_shared<app_bundle>(archive);
+			if (!bundle->load_app())
 			{
-				extract = true;
+				color_printf(color::FG_RED, "No base APK in the bundle: %s\n", archive.name().c_str());
+				return false;
 			}
+			const auto& parts = bundle->get_parts();
+			const auto& base = parts.front();
+			source = bundle->get_nodes()[base.node].source;
 
-			std::vector<std::string> libs{};
+			cert = std::make_shared<certificate>(source);
+			if (base.manifest_content == nullptr)
+			{
+				printf("Failed to locate AndroidManifest.xml file\nPath: %s\n", source.name().c_str());
+				return false;
+			}
+			app_manifest = std::make_shared<manifest>(base.manifest_content, base.manifest_size);
 
-			mz_zip_archive zip_archive;
-			memset(&zip_archive, 0, sizeof(zip_archive));
+			xml_strings = std::make_shared<res_strings>(source);
+			natives = std::make_shared<native_libs>(bundle->part_sources());
+			bin_strings = std::make_shared<binary_strings>(source);
+			payloads = std::make_shared<payload_scanner>(source);
+
+			if (base.resources_content != nullptr)
+			{
+				resources = std::make_shared<resource_table>(base.resources_content, base.resources_size);
+				if (!resources->is_valid())
+				{
+					color_printf(color::FG_LIGHT_RED, "Failed to parse resources.arsc\n");
+					resources.reset();
+				}
+			}
+
+			for (const auto& part : parts)
+			{
+				parsed_dexes.insert(parsed_dexes.end(), part.dexes.begin(), part.dexes.end());
+				file_pathes.insert(file_pathes.end(), part.files.begin(), part.files.end());
+			}
+			if (parsed_dexes.empty())
+			{
+				printf("Failed to parse DEX files\n");
+				return false;
+			}
+			color::color_printf(color::FG_DARK_GRAY, "Bundle: %s with %zu split(s), %zu dex file(s) (%.2f ms)\n",
+			                    fs::path(source.name()).filename().string().c_str(), parts.size() - 1,
+			                    parsed_dexes.size(), bundle->get_elapsed_ms());
+			return true;
+		}
+
+		// the central directory can't be read (tampered): the archive is rebuilt in memory from its
+		// local headers and loaded like the base APK of a bundle
+		bool load_recovered(const std::string& full_path)
+		{
+			zip_recovery recovery(full_path);
+			const auto recovered = recovery.scan() ? recovery.rebuild() : utils::zip_source{};
+			if (!recovered.in_memory())
+			{
+				return false;
+			}
+			color::color_printf(color::FG_YELLOW, "Recovered %zu entries from the local headers (%.2f ms)\n",
+			                    recovery.get_entries().size(), recovery.get_elapsed_ms());
+			return load_bundle(recovered);
+		}
 
-			const auto status = mz_zip_reader_init_file(&zip_archive, file_path.string().c_str(), 0);
-			if (!status)
-				return libs;
+		// the entries as the local headers describe them, with what doesn't match their data
+		void dump_recovery() const
+		{
+			zip_recovery recovery(apk_path);
+			recovery.scan();
+			output::writer out;
+			size_t notes = 0;
+			for (const auto& entry : recovery.get_entries())
+			{
+				out.color_printf(entry.notes.empty() ? color::FG_DEFAULT : color::FG_YELLOW, "0x%08llx  %10llu  %s  %s\n",
+				                 static_cast<unsigned long long>(entry.header_offset), static_cast<unsigned long long>(entry.size),
+				                 entry.deflated ? "deflated" : "stored  ", entry.name.c_str());
+				for (const auto& note : entry.notes)
+				{
+					out.color_printf(color::FG_LIGHT_RED, "\t%s\n", note.c_str());
+				}
+				notes += entry.notes.size();
+			}
 
-			const auto file_count = mz_zip_reader_get_num_files(&zip_archive);
-			if (file_count == 0)
+			// entries the central directory doesn't list (or the other way around)
+			mz_zip_archive zip_archive;
+			if (source.open(zip_archive))
 			{
+				const auto listed = mz_zip_reader_get_num_files(&zip_archive);
 				mz_zip_reader_end(&zip_archive);
-				return libs;
+				if (!source.in_memory() && listed != recovery.get_entries().size())
+				{
+					out.color_printf(color::FG_LIGHT_RED, "the central directory lists %u entries\n", listed);
+				}
 			}
-			// printf("number_of_files: %zu\n", file_count);
+			out.color_printf(color::FG_DARK_GRAY, "%zu entries, %zu notes, %zu signatures (%.2f ms, %zu threads)\n",
+			                 recovery.get_entries().size(), notes, recovery.candidate_count(),
+			                 recovery.get_elapsed_ms(), worker_pool().size());
+		}
 
-			const auto dest_dir = fs::current_path().string() + '/' + "libs";
+		// writes the APK to "out_path", the dex files of the APK written again from their IR when
+		// "rewrite_dex" is set (patched when possible); the entries which don't change are copied
+		// without recompression
+		void repack(const std::string& out_path, const bool rewrite_dex)
+		{
+			apk_writer writer(source);
+			double dex_ms = 0;
+			size_t patched_count = 0, dex_count = 0;
+			if (rewrite_dex)
+			{
+				slicer::Chronometer chrono(dex_ms);
+				for (auto& dex : parsed_dexes)
+				{
+					// the dex files of splits and the payloads aren't entries of this archive
+					const auto name = dex.get_dex_name();
+					if (name.find('/') != std::string::npos || name.find('@') != std::string::npos)
+					{
+						continue;
+					}
+					size_t size = 0;
+					std::string fallback{};
+					auto image = dex.create_patched_image(size, fallback);
+					if (!fallback.empty())
+					{
+						color::color_printf(color::FG_DARK_GRAY, "%s: full writer used, %s\n", name.c_str(), fallback.c_str());
+					}
+					patched_count += fallback.empty() ? 1 : 0;
+					dex_count++;
+					writer.replace(name, std::move(image), size);
+				}
+			}
+			if (!writer.write(out_path))
+			{
+				color::color_printf(color::FG_LIGHT_RED, "%s\n", writer.get_error().c_str());
+				return;
+			}
+			const auto mb_per_s = writer.get_elapsed_ms() > 0 ? writer.written_size() / 1048.576 / writer.get_elapsed_ms() : 0;
+			color::color_printf(color::FG_GREEN, "%s: %llu bytes, %zu entries copied, %zu deflated\n", out_path.c_str(),
+			                    static_cast<unsigned long long>(writer.written_size()), writer.copied_count(), writer.deflated_count());
+			color::color_printf(color::FG_DARK_GRAY, "dex images: %.2f ms (%zu of %zu patched), zip: %.2f ms (%.0f MB/s, %zu threads), not signed\n",
+			                    dex_ms, patched_count, dex_count, writer.get_elapsed_ms(), mb_per_s, worker_pool().size());
+		}
 
-			const auto current_path = fs::current_path().string();
-			for (auto i = 0; i < file_count; i++)
+		// writes every dex file again from its IR into "out_dir", patched from the original image when possible,
+		// else with the full writer straight into its mapped output file
+		void write_dexes(const std::string& out_dir)
+		{
+			std::error_code error_code;
+			fs::create_directories(out_dir, error_code);
+			for (auto& dex : parsed_dexes)
 			{
-				mz_zip_archive_file_stat file_stat;
-				if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat))
+				auto name = dex.get_dex_name();
+				std::replace(name.begin(), name.end(), '/', '_');
+				std::replace(name.begin(), name.end(), '@', '_');
+				const auto out_path = (fs::path(out_dir) / name).string();
+
+				size_t size = 0;
+				std::string fallback, error;
+				double write_ms = 0;
+				bool is_written;
+				{
+					slicer::Chronometer chrono(write_ms);
+					is_written = dex.write_image(out_path, size, fallback, error);
+				}
+				if (!is_written)
 				{
-					printf("failed to get file stat. index: %d\n", i);
+					color::color_printf(color::FG_LIGHT_RED, "%s\n", error.c_str());
 					continue;
 				}
-				if (mz_zip_reader_is_file_a_directory(&zip_archive, i))
+				color::color_printf(color::FG_GREEN, "%s: %zu bytes", out_path.c_str(), size);
+				if (fallback.empty())
+				{
+					color::color_printf(color::FG_DARK_GRAY, " (patched, %.2f ms)\n", write_ms);
+				}
+				else
+				{
+					color::color_printf(color::FG_DARK_GRAY, " (full writer, %s, %.2f ms)\n", fallback.c_str(), write_ms);
+				}
+			}
+		}
+
+		// adds entry/exit hooks (Landromeda/Trace;.onEntry/onExit) to the methods matching "filter_line":
+		// a package prefix, an @annotation and/or a "name(signature)" pattern with '*' and '?'
+		void trace_methods(const std::string& filter_line)
+		{
+			slicer::MethodFilter filter;
+			std::istringstream tokens(filter_line);
+			std::string token;
+			while (tokens >> token)
+			{
+				if (token[0] == '@')
+				{
+					filter.annotation = parsed_dex::name_to_descriptor(token.substr(1));
+				}
+				else if (token.find_first_of("(*?") != std::string::npos)
+				{
+					filter.signature = token;
+				}
+				else
+				{
+					// "com.example" -> "Lcom/example"
+					filter.class_prefix = parsed_dex::name_to_descriptor(token);
+					filter.class_prefix.pop_back();
+				}
+			}
+
+			size_t selected = 0, instrumented = 0;
+			double trace_ms = 0;
+			{
+				slicer::Chronometer chrono(trace_ms);
+				for (auto& dex : parsed_dexes)
+				{
+					size_t dex_selected = 0;
+					instrumented += dex.trace_methods(filter, "Landromeda/Trace;", dex_selected);
+					selected += dex_selected;
+				}
+			}
+			if (selected == 0)
+			{
+				color::color_printf(color::FG_RED, "No method matches\n");
+				return;
+			}
+			color::color_printf(color::FG_GREEN, "%zu of %zu methods instrumented\n", instrumented, selected);
+			color::color_printf(color::FG_DARK_GRAY, "%.2f ms, %zu threads (write_dex/repack dex to save them)\n",
+			                    trace_ms, worker_pool().size());
+		}
+
+		// the archive graph (nested zips and APKs), read on first use for a single APK
+		void dump_archives()
+		{
+			if (bundle == nullptr)
+			{
+				bundle = std::make_shared<app_bundle>(source);
+			}
+			output::writer out;
+			const auto& nodes = bundle->get_nodes();
+			std::vector<size_t> pending{0}; // depth first, in archive order
+			size_t skipped = 0;
+			while (!pending.empty())
+			{
+				const auto index = pending.back();
+				pending.pop_back();
+				const auto& node = nodes[index];
+				const std::string indent(node.depth, '\t');
+				const auto name = node.parent < 0 ? fs::path(node.source.name()).filename().string() : node.entry;
+				out.color_printf(node.is_apk ? color::FG_GREEN : color::FG_DEFAULT, "%s%s", indent.c_str(), name.c_str());
+				if (node.is_skipped)
 				{
+					out.color_printf(color::FG_DARK_GRAY, " (%llu bytes)", static_cast<unsigned long long>(node.size));
+					out.color_printf(color::FG_YELLOW, " skipped, over the %llu MB budget of the nested archives\n",
+					                 static_cast<unsigned long long>(app_bundle::max_nested_total >> 20));
+					skipped++;
 					continue;
 				}
+				out.color_printf(color::FG_DARK_GRAY, " (%llu bytes, %zu files)", static_cast<unsigned long long>(node.size), node.file_count);
+				const auto part = bundle->find_part(index);
+				if (part != nullptr)
+				{
+					out.color_printf(color::FG_LIGHT_CYAN, part->split.empty() ? " base" : " split %s", part->split.c_str());
+				}
+				else if (node.is_apk && index != 0)
+				{
+					out.color_printf(color::FG_YELLOW, " nested APK");
+				}
+				out.printf("\n");
+				pending.insert(pending.end(), node.children.rbegin(), node.children.rend());
+			}
+			out.color_printf(color::FG_DARK_GRAY, "%zu archives, %zu skipped (%.2f ms, %zu threads)\n", nodes.size(), skipped,
+			                 bundle->get_elapsed_ms(), worker_pool().size());
+		}
+
+		// the lib/ entries of the APK (and of its splits), extracted to ./libs when asked
+		std::vector<std::string> get_libs(bool extract = false, const std::string& target_lib_path = "", const bool get_hash = false)
+		{
+			if (get_hash == true)
+			{
+				extract = true;
+			}
+
+			std::vector<std::string> libs{};
+			const auto dest_dir = fs::current_path().string() + '/' + "libs";
 
-				const std::string file_name{file_stat.m_filename};
-				const auto dest_file = dest_dir + '/' + file_name;
+			const auto archives = bundle != nullptr && !bundle->get_parts().empty() ? bundle->part_sources() : std::vector<utils::zip_source>{source};
+			for (const auto& archive : archives)
+			{
+				mz_zip_archive zip_archive;
+				if (!archive.open(zip_archive))
+				{
+					continue;
+				}
 
-				if (utils::starts_with(file_name, "lib/"))
+				const auto file_count = mz_zip_reader_get_num_files(&zip_archive);
+				for (auto i = 0; i < file_count; i++)
 				{
-					const auto [_, lib_path] = utils::split(file_name, '/');
-					if (!extract)
+					mz_zip_archive_file_stat file_stat;
+					if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat))
+					{
+						printf("failed to get file stat. index: %d\n", i);
+						continue;
+					}
+					if (mz_zip_reader_is_file_a_directory(&zip_archive, i))
 					{
-						if (!lib_path.empty())
-						{
-							libs.emplace_back(lib_path);
-						}
 						continue;
 					}
-					else if (extract && !target_lib_path.empty())
+
+					const std::string file_name{file_stat.m_filename};
+					const auto dest_file = dest_dir + '/' + file_name;
+
+					if (utils::starts_with(file_name, "lib/"))
 					{
-						if (target_lib_path != lib_path)
+						const auto [_, lib_path] = utils::split(file_name, '/');
+						if (!extract)
 						{
+							if (!lib_path.empty())
+							{
+								libs.emplace_back(lib_path);
+							}
 							continue;
 						}
-					}
+						else if (extract && !target_lib_path.empty())
+						{
+							if (target_lib_path != lib_path)
+							{
+								continue;
+							}
+						}
 
-					const fs::path under_dir_path{dest_file};
-					const std::string under_dir_full = under_dir_path.parent_path();
-					if (!fs::exists(under_dir_full))
-					{
-						fs::create_directories(under_dir_full);
-					}
+						const fs::path under_dir_path{dest_file};
+						const std::string under_dir_full = under_dir_path.parent_path();
+						if (!fs::exists(under_dir_full))
+						{
+							fs::create_directories(under_dir_full);
+						}
 
-					const auto is_okay = mz_zip_reader_extract_to_file(&zip_archive, i, dest_file.c_str(), 0);
-					if (!is_okay)
-					{
-						color::color_printf(color::FG_LIGHT_RED, "[APK.hpp] Failed to unpack file: %s\n", file_name.c_str());
-					}
-					else
-					{
-						if (get_hash == true)
+						const auto is_okay = mz_zip_reader_extract_to_file(&zip_archive, i, dest_file.c_str(), 0);
+						if (!is_okay)
 						{
-							const auto file_content = utils::read_file_content(dest_file);
-							const auto file_sha1_ascii = digestpp::sha1().absorb(file_content).hexdigest();
-							color::color_printf(color::FG_GREEN, "%s: ", file_name.c_str());
-							color::color_printf(color::FG_DARK_GRAY, "%s\n", file_sha1_ascii.c_str());
+							color::color_printf(color::FG_LIGHT_RED, "[APK.hpp] Failed to unpack file: %s\n", file_name.c_str());
 						}
 						else
 						{
-							color::color_printf(color::FG_GREEN, "unpacked lib: %s\n", dest_file.c_str());
+							if (get_hash == true)
+							{
+								const auto file_content = utils::read_file_content(dest_file);
+								const auto file_sha1_ascii = digestpp::sha1().absorb(file_content).hexdigest();
+								color::color_printf(color::FG_GREEN, "%s: ", file_name.c_str());
+								color::color_printf(color::FG_DARK_GRAY, "%s\n", file_sha1_ascii.c_str());
+							}
+							else
+							{
+								color::color_printf(color::FG_GREEN, "unpacked lib: %s\n", dest_file.c_str());
+							}
 						}
 					}
+
 				}
 
+				mz_zip_reader_end(&zip_archive);
 			}
 
-			mz_zip_reader_end(&zip_archive);
-
 			return libs;
 		}
 
+		// native methods of the dex files and the Java_ exports of lib/*.so implementing them
+		void dump_jni_bindings()
+		{
+			const auto& libraries = natives->get_libraries();
+			if (libraries.empty())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "No native libraries\n");
+			}
+			std::vector<const native_library*> on_load{};
+			for (const auto& library : libraries)
+			{
+				color::color_printf(color::FG_GREEN, "%s", library.path.c_str());
+				if (library.elf == nullptr || !library.elf->is_valid())
+				{
+					color::color_printf(color::FG_LIGHT_RED, " (not a valid ELF file)\n");
+					continue;
+				}
+				color::color_printf(color::FG_DARK_GRAY, " (%s, %zu dynamic symbols", library.elf->machine_name(), library.elf->get_symbols().size());
+				if (library.elf->find_export("JNI_OnLoad") != nullptr)
+				{
+					color::color_printf(color::FG_DARK_GRAY, ", JNI_OnLoad");
+					on_load.emplace_back(&library);
+				}
+				color::color_printf(color::FG_DARK_GRAY, ")\n");
+			}
+
+			// why a native method has no export
+			const auto missing_reason = libraries.empty() ? "the library isn't in the APK"
+			                            : on_load.empty() ? "no library exports it, and no JNI_OnLoad to register it"
+			                            : "registered from JNI_OnLoad?";
+
+			std::vector<std::pair<const native_library*, std::string>> unmatched_exports{};
+			const auto bindings = natives->link(parsed_dexes, unmatched_exports);
+			color::color_printf(color::FG_YELLOW, "\nNative methods (%zu):\n", bindings.size());
+			for (const auto& binding : bindings)
+			{
+				color::color_printf(binding.exports.empty() ? color::FG_LIGHT_RED : color::FG_DEFAULT, "\t%s->%s%s\n",
+				                    binding.class_descriptor.c_str(), binding.method_name.c_str(), binding.signature.c_str());
+				for (const auto& [library, symbol] : binding.exports)
+				{
+					color::color_printf(color::FG_DARK_GRAY, "\t\t%s!%s\n", library->path.c_str(), symbol.c_str());
+				}
+				if (binding.exports.empty())
+				{
+					color::color_printf(color::FG_DARK_GRAY, "\t\tno export, %s\n", missing_reason);
+				}
+			}
+
+			if (!unmatched_exports.empty())
+			{
+				color::color_printf(color::FG_YELLOW, "\nJava_ exports without a native method (%zu):\n", unmatched_exports.size());
+				for (const auto& [library, symbol] : unmatched_exports)
+				{
+					color::color_printf(color::FG_DARK_GRAY, "\t%s!%s\n", library->path.c_str(), symbol.c_str());
+				}
+			}
+		}
+
+		// needed libraries, imports and exports of "lib_path" (ex. arm64-v8a/libfoo.so)
+		void dump_lib_symbols(const std::string& lib_path)
+		{
+			const auto library = natives->find(lib_path);
+			if (library == nullptr || library->elf == nullptr || !library->elf->is_valid())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Invalid library: %s\n", lib_path.c_str());
+				return;
+			}
+			const auto& elf = *library->elf;
+			color::color_printf(color::FG_GREEN, "%s", library->path.c_str());
+			color::color_printf(color::FG_DARK_GRAY, " (ELF%d %s) SHA-256: %s\n", elf.is_64() ? 64 : 32, elf.machine_name(), library->sha256.c_str());
+			if (!elf.get_soname().empty())
+			{
+				color::color_printf(color::FG_DARK_GRAY, "soname: %s\n", elf.get_soname().c_str());
+			}
+			for (const auto& needed : elf.get_needed())
+			{
+				color::color_printf(color::FG_DARK_GRAY, "needed: %s\n", needed.c_str());
+			}
+
+			output::writer out;
+			out.line(color::FG_YELLOW, "", "Exports:");
+			for (const auto& symbol : elf.get_symbols())
+			{
+				if (symbol.defined && symbol.binding != STB_LOCAL)
+				{
+					out.line(symbol.type == STT_FUNC ? color::FG_DEFAULT : color::FG_DARK_GRAY, "\t", symbol.name);
+				}
+			}
+			out.line(color::FG_YELLOW, "", "Imports:");
+			for (const auto& symbol : elf.get_symbols())
+			{
+				if (!symbol.defined)
+				{
+					out.line(color::FG_DARK_GRAY, "\t", symbol.name);
+				}
+			}
+		}
+
+		// dex, zip, ELF and class headers inside the archive entries, "with_xor" also tries every single byte XOR key
+		void dump_payloads(const bool with_xor)
+		{
+			const auto& found = payloads->scan(with_xor);
+			for (const auto& hit : found)
+			{
+				color::color_printf(color::FG_GREEN, "%s", payloads->get_file(hit.entry).c_str());
+				color::color_printf(color::FG_DARK_GRAY, " @ 0x%llx: ", static_cast<unsigned long long>(hit.offset));
+				color::color_printf(color::FG_LIGHT_RED, "%s", payload_scanner::type_name(hit.type));
+				if (hit.key != 0)
+				{
+					color::color_printf(color::FG_YELLOW, " (XOR 0x%02x)", hit.key);
+				}
+				if (hit.type == payload_type::dex)
+				{
+					color::color_printf(color::FG_DARK_GRAY, " %llu bytes", static_cast<unsigned long long>(hit.size));
+				}
+				else if (hit.type == payload_type::zip && hit.count > 1)
+				{
+					color::color_printf(color::FG_DARK_GRAY, " %u local headers", hit.count);
+				}
+				printf("\n");
+			}
+			color::color_printf(color::FG_DARK_GRAY, "%zu payloads in %.2f ms\n", found.size(), payloads->get_elapsed_ms());
+		}
+
+		// adds the dex payloads to the dex files, every other command sees them after that
+		void load_payloads(const bool with_xor)
+		{
+			payloads->scan(with_xor);
+			std::vector<std::string> rejected{};
+			auto dexes = payloads->load_dexes(rejected);
+			for (auto& dex : dexes)
+			{
+				const auto name = dex.get_dex_name();
+				const auto loaded = std::any_of(parsed_dexes.begin(), parsed_dexes.end(), [&name](const parsed_dex& current)
+				{
+					return current.get_dex_name() == name;
+				});
+				if (loaded)
+				{
+					continue;
+				}
+				color::color_printf(color::FG_GREEN, "loaded: %s", name.c_str());
+				color::color_printf(color::FG_DARK_GRAY, " (%zu classes)\n", dex.class_count());
+				parsed_dexes.emplace_back(std::move(dex));
+			}
+			for (const auto& name : rejected)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "not a valid dex file: %s\n", name.c_str());
+			}
+		}
+
+		// entropy of every entry (highest first), with the min/max of the sliding windows, then the packer hints
+		void dump_entropy() const
+		{
+			entropy_scanner scanner(source);
+			const auto& entries = scanner.scan();
+
+			std::vector<const entry_entropy*> sorted{};
+			for (const auto& entry : entries)
+			{
+				sorted.emplace_back(&entry);
+			}
+			std::stable_sort(sorted.begin(), sorted.end(), [](const entry_entropy* left, const entry_entropy* right)
+			{
+				return left->entropy > right->entropy;
+			});
+
+			for (const auto entry : sorted)
+			{
+				const auto code = entry->entropy >= 7.5 ? color::FG_LIGHT_RED : entry->entropy >= 6.5 ? color::FG_YELLOW : color::FG_GREEN;
+				color::color_printf(code, "%.3f", entry->entropy);
+				color::color_printf(color::FG_DARK_GRAY, " %10llu  ", static_cast<unsigned long long>(entry->size));
+				printf("%s", entry->name.c_str());
+				if (!entry->windows.empty())
+				{
+					const auto [low, high] = std::minmax_element(entry->windows.begin(), entry->windows.end());
+					color::color_printf(color::FG_DARK_GRAY, "  (windows %.2f-%.2f)", *low, *high);
+				}
+				printf("\n");
+			}
+
+			const auto findings = entropy_scanner::findings(entries);
+			if (!findings.empty())
+			{
+				color::color_printf(color::FG_YELLOW, "\nFindings:\n");
+				for (const auto& finding : findings)
+				{
+					color::color_printf(color::FG_LIGHT_RED, "\t%s\n", finding.c_str());
+				}
+			}
+			color::color_printf(color::FG_DARK_GRAY, "%zu entries in %.2f ms (%zu threads)\n", entries.size(), scanner.get_elapsed_ms(), worker_pool().size());
+		}
+
 		void dump_classes()
 		{
+			output::writer out;
 			for (auto& dex : parsed_dexes)
 			{
-				const auto dex_classes = dex.get_classes();
+				const auto& dex_classes = dex.get_classes();
 				if (!dex_classes.empty())
 				{
-					color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", dex.get_dex_name().c_str());
+					out.line(color::FG_DARK_GRAY, "DEX file: ", dex.get_dex_name());
 					for (const auto& i_class : dex_classes)
 					{
-						color::color_printf(color::FG_GREEN, "\t%s\n", i_class.c_str());
+						out.line(color::FG_GREEN, "\t", i_class);
 					}
 				}
 			}
@@ -205,17 +713,18 @@ namespace andromeda
 
 		void find_dump_class(const std::string& class_part)
 		{
+			output::writer out;
 			for (auto& dex : parsed_dexes)
 			{
-				const auto dex_classes = dex.get_classes();
+				const auto& dex_classes = dex.get_classes();
 				if (!dex_classes.empty())
 				{
 					for (const auto& i_class : dex_classes)
 					{
 						if (utils::find_case_insensitive(i_class, class_part) != std::string::npos)
 						{
-							color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", dex.get_dex_name().c_str());
-							color::color_printf(color::FG_GREEN, "\t%s\n", i_class.c_str());
+							out.line(color::FG_DARK_GRAY, "DEX file: ", dex.get_dex_name());
+							out.line(color::FG_GREEN, "\t", i_class);
 						}
 					}
 				}
@@ -224,16 +733,17 @@ namespace andromeda
 
 		void dump_methods()
 		{
+			output::writer out;
 			for (auto& parsed_dex : parsed_dexes)
 			{
-				const auto dex_methods = parsed_dex.get_methods();
+				const auto& dex_methods = parsed_dex.get_methods();
 				if (!dex_methods.empty())
 				{
-					color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", parsed_dex.get_dex_name().c_str());
+					out.line(color::FG_DARK_GRAY, "DEX file: ", parsed_dex.get_dex_name());
 					for (const auto& [class_path, method_name] : dex_methods)
 					{
-						color::color_printf(color::FG_DARK_GRAY, "%s.", class_path.c_str());
-						color::color_printf(color::FG_GREEN, "%s\n", method_name.c_str());
+						out.line(color::FG_DARK_GRAY, "", class_path, ".");
+						out.line(color::FG_GREEN, "", method_name);
 					}
 				}
 			}
@@ -241,18 +751,19 @@ namespace andromeda
 
 		void fin_dump_method(const std::string& target_method_name)
 		{
+			output::writer out;
 			for (auto& parsed_dex : parsed_dexes)
 			{
-				const auto dex_methods = parsed_dex.get_methods();
+				const auto& dex_methods = parsed_dex.get_methods();
 				if (!dex_methods.empty())
 				{
 					for (const auto& [class_path, method_name] : dex_methods)
 					{
 						if (utils::find_case_insensitive(method_name, target_method_name) != std::string::npos)
 						{
-							color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", parsed_dex.get_dex_name().c_str());
-							color::color_printf(color::FG_DARK_GRAY, "%s.", class_path.c_str());
-							color::color_printf(color::FG_GREEN, "%s\n", method_name.c_str());
+							out.line(color::FG_DARK_GRAY, "DEX file: ", parsed_dex.get_dex_name());
+							out.line(color::FG_DARK_GRAY, "", class_path, ".");
+							out.line(color::FG_GREEN, "", method_name);
 						}
 					}
 				}
@@ -303,65 +814,195 @@ namespace andromeda
 			}
 		}
 
-		void dump_permissions() const 
+		void dump_method_cfg(const std::string& method_path)
 		{
-			if (!app_manifest->permissions.empty())
+			auto found = false;
+			for (auto& parsed_dex : parsed_dexes)
 			{
-				color::color_printf(color::FG_DARK_GRAY, "Permissions:\n");
-				for (const auto& perm : app_manifest->permissions)
-				{
-					color::color_printf(color::FG_GREEN, "\t%s\n", perm.c_str());
-				}
+				const auto current_found = parsed_dex.dump_cfg(method_path);
+				found = found ? found : current_found;
 			}
-		}
 
-		
-		void dump_activities() const 
-		{
-			if (!app_manifest->activities.empty())
+			if (!found)
 			{
-				color::color_printf(color::FG_DARK_GRAY, "Activities:\n");
-				for (const auto& [name, intents]  : app_manifest->activities)
-				{
-					auto full_class_name = name;
-					if (!full_class_name.empty() && full_class_name[0] == '.')
-					{
-						if (!app_manifest->manifest_package.empty())
-						{
-							full_class_name = app_manifest->manifest_package + full_class_name;
-						}
-					}
-
-					color_printf(color::FG_GREEN, "\t%s\n", full_class_name.c_str());
-				}
+				color::color_printf(color::FG_LIGHT_RED, "Failed to locale method: %s\n",
+				                    method_path.c_str());
 			}
 		}
 
-		void dump_services() const
+		void dump_all_methods(const std::string& out_path)
 		{
-			if (!app_manifest->services.empty())
+			const auto out_file = fopen(out_path.c_str(), "wb");
+			if (out_file == nullptr)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Failed to create file: %s\n", out_path.c_str());
+				return;
+			}
+
+			size_t total_size = 0;
+			double elapsed_ms = 0;
 			{
-				color::color_printf(color::FG_DARK_GRAY, "Services:\n");
-				for (const auto& [name, intents]  : app_manifest->services)
+				slicer::Chronometer chrono(elapsed_ms);
+				for (auto& parsed_dex : parsed_dexes)
 				{
-					color_printf(color::FG_GREEN, "\t%s\n", name.c_str());
+					total_size += parsed_dex.dump_all_methods(out_file);
 				}
 			}
+			fclose(out_file);
+
+			const auto size_mb = total_size / (1024.0 * 1024.0);
+			color::color_printf(color::FG_GREEN, "%s: %.2f MB in %.2f ms (%.1f MB/s)\n", out_path.c_str(),
+			                    size_mb, elapsed_ms, elapsed_ms > 0 ? size_mb * 1000.0 / elapsed_ms : 0.0);
 		}
 
-		void dump_receivers() const
+		void export_smali(const std::string& out_dir)
+		{
+			andromeda::export_smali(parsed_dexes, fs::absolute(out_dir).string());
+		}
+
+		void dump_permissions() const 
 		{
-			if (!app_manifest->receivers.empty())
+			if (!app_manifest->permissions.empty())
 			{
-				color::color_printf(color::FG_DARK_GRAY, "Receivers:\n");
-				for (const auto& [name, intents]  : app_manifest->receivers)
+				color::color_printf(color::FG_DARK_GRAY, "Permissions:\n");
+				for (const auto& perm : app_manifest->permissions)
 				{
-					color_printf(color::FG_GREEN, "\t%s\n", name.c_str());
+					color::color_printf(color::FG_GREEN, "\t%s\n", perm.c_str());
 				}
 			}
 		}
 
-		void is_debuggable() const
+		
+		void dump_activities() const
+		{
+			const auto& components = app_manifest->get_components();
+			const auto has_activities = std::any_of(components.begin(), components.end(), [](const component& current)
+			{
+				return current.type == component_type::activity || current.type == component_type::activity_alias;
+			});
+			if (has_activities)
+			{
+				color::color_printf(color::FG_DARK_GRAY, "Activities:\n");
+				app_manifest->dump_components(component_type::activity, false);
+				app_manifest->dump_components(component_type::activity_alias, false);
+			}
+		}
+
+		void dump_services() const
+		{
+			color::color_printf(color::FG_DARK_GRAY, "Services:\n");
+			app_manifest->dump_components(component_type::service, false);
+		}
+
+		void dump_receivers() const
+		{
+			color::color_printf(color::FG_DARK_GRAY, "Receivers:\n");
+			app_manifest->dump_components(component_type::receiver, false);
+		}
+
+		void dump_providers() const
+		{
+			color::color_printf(color::FG_DARK_GRAY, "Providers:\n");
+			app_manifest->dump_components(component_type::provider, false);
+		}
+
+		// components with an intent-filter for "action", "BOOT_COMPLETED" is short for "android.intent.action.BOOT_COMPLETED"
+		void dump_action_handlers(const std::string& action) const
+		{
+			auto handlers = &app_manifest->find_by_action(action);
+			if (handlers->empty() && action.find('.') == std::string::npos)
+			{
+				handlers = &app_manifest->find_by_action("android.intent.action." + action);
+			}
+			if (handlers->empty())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "No component handles %s\n", action.c_str());
+				return;
+			}
+
+			const auto& components = app_manifest->get_components();
+			for (const auto index : *handlers)
+			{
+				color::color_printf(color::FG_DARK_GRAY, "%s:", manifest::type_name(components[index].type));
+				app_manifest->dump_component(components[index], false);
+			}
+		}
+
+		// components accepting links with "scheme", or with any scheme when it is empty
+		void dump_deep_links(const std::string& scheme) const
+		{
+			const auto schemes = scheme.empty() ? app_manifest->get_schemes() : std::vector<std::string>{scheme};
+			if (schemes.empty())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "No intent-filter accepts links\n");
+				return;
+			}
+
+			const auto& components = app_manifest->get_components();
+			for (const auto& current_scheme : schemes)
+			{
+				const auto& handlers = app_manifest->find_by_scheme(current_scheme);
+				if (handlers.empty())
+				{
+					color::color_printf(color::FG_LIGHT_RED, "No component accepts %s links\n", current_scheme.c_str());
+					continue;
+				}
+				color::color_printf(color::FG_DARK_GRAY, "%s:\n", current_scheme.c_str());
+				for (const auto index : handlers)
+				{
+					app_manifest->dump_component(components[index]);
+				}
+			}
+		}
+
+		// every component with its class, the lifecycle methods it overrides, and the ones missing from the dex files
+		void dump_linked_components()
+		{
+			std::vector<linked_component> linked{};
+			double elapsed_ms = 0;
+			{
+				slicer::Chronometer chrono(elapsed_ms);
+				component_linker linker(parsed_dexes);
+				linked = linker.link(*app_manifest);
+			}
+
+			size_t missing = 0;
+			output::writer out;
+			for (const auto& current : linked)
+			{
+				out.color_printf(color::FG_DARK_GRAY, "%s: ", current.kind);
+				if (!current.location.found())
+				{
+					out.color_printf(color::FG_LIGHT_RED, "%s [missing from the dex files]\n",
+					                 current.class_name.empty() ? "(no android:name)" : current.class_name.c_str());
+					missing++;
+					continue;
+				}
+
+				out.color_printf(color::FG_GREEN, "%s", current.class_name.c_str());
+				out.color_printf(color::FG_DARK_GRAY, " (%s #%u)", parsed_dexes[current.location.dex].get_dex_name().c_str(),
+				                 current.location.class_index);
+				if (!current.base_class.empty())
+				{
+					out.color_printf(color::FG_DARK_GRAY, " extends %s", dex::DescriptorToDecl(current.base_class.c_str()).c_str());
+				}
+				out.write("\n");
+
+				const auto own_descriptor = parsed_dex::name_to_descriptor(current.class_name);
+				for (const auto& [method, declaring_class] : current.lifecycle_methods)
+				{
+					out.color_printf(color::FG_DEFAULT, "\t%s", method.c_str());
+					if (declaring_class != own_descriptor)
+					{
+						out.color_printf(color::FG_DARK_GRAY, " (%s)", dex::DescriptorToDecl(declaring_class.c_str()).c_str());
+					}
+					out.write("\n");
+				}
+			}
+			out.color_printf(color::FG_DARK_GRAY, "%zu classes, %zu missing, %.2f ms\n", linked.size(), missing, elapsed_ms);
+		}
+
+		void is_debuggable() const
 		{
 			const auto is_debug = app_manifest->is_debuggable();
 			if (is_debug)
@@ -377,40 +1018,111 @@ namespace andromeda
 		void dump_manifest_file() const
 		{
 			color::color_printf(color::FG_LIGHT_GREEN, "----------- BEGIN -----------\n");
-			printf("%s\n", app_manifest->manifest_content.c_str());
+			printf("%s\n", app_manifest->get_content().c_str());
 			color::color_printf(color::FG_LIGHT_GREEN, "----------- EOF -----------\n");
 		}
 
 		// certificate
 		void dump_certificate() const
 		{
+			if (!cert->is_certificate())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "No v1 certificate\n");
+				return;
+			}
+			for (const auto& info : cert->get_chain())
+			{
+				color::color_printf(color::FG_GREEN, "%s\n", info.subject.c_str());
+				color::color_printf(color::FG_DARK_GRAY, "\tissuer: %s\n\tserial: %s\n", info.issuer.c_str(), info.serial.c_str());
+				color::color_printf(color::FG_DARK_GRAY, "\tSHA-1: %s\n\tSHA-256: %s\n", info.sha1_hex().c_str(), info.sha256_hex().c_str());
+			}
 			color::color_printf(color::FG_LIGHT_GREEN, "----------- BEGIN -----------\n");
-			printf("%s\n", cert->get_certificate().get());
+			printf("%s\n", cert->get_certificate().c_str());
 			color::color_printf(color::FG_LIGHT_GREEN, "----------- EOF -----------\n");
 		}
 
+		// v2/v3 signers and the verification of their content digests
+		void dump_signature_block() const
+		{
+			const apk_signature signature(source);
+			if (!signature.has_signing_block())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "No v2/v3 signature: %s\n", signature.get_error().c_str());
+				return;
+			}
+			if (!signature.get_error().empty())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "APK Signing Block: %s\n", signature.get_error().c_str());
+			}
+
+			for (const auto& signer : signature.get_signers())
+			{
+				color::color_printf(color::FG_DARK_GRAY, "Signer (v%s", signer.scheme == 31 ? "3.1" : std::to_string(signer.scheme).c_str());
+				if (signer.scheme != 2)
+				{
+					color::color_printf(color::FG_DARK_GRAY, ", SDK %u-%u", signer.min_sdk, signer.max_sdk);
+				}
+				color::color_printf(color::FG_DARK_GRAY, "):\n");
+				for (const auto& der : signer.certificates)
+				{
+					color::color_printf(color::FG_GREEN, "\t%s\n", apk_signature::certificate_subject(der).c_str());
+					color::color_printf(color::FG_DARK_GRAY, "\t\tSHA-256: %s\n", apk_signature::sha256_hex(der).c_str());
+				}
+				for (const auto algorithm : signer.signature_algorithms)
+				{
+					color::color_printf(color::FG_DARK_GRAY, "\tsignature: %s\n", apk_signature::algorithm_name(algorithm));
+				}
+			}
+
+			color::color_printf(color::FG_DARK_GRAY, "Content digests:\n");
+			for (const auto& result : signature.verify())
+			{
+				color::color_printf(color::FG_DEFAULT, "\t%s: ", apk_signature::algorithm_name(result.algorithm));
+				if (!result.supported)
+				{
+					color::color_printf(color::FG_YELLOW, "not checked\n");
+					continue;
+				}
+				if (result.verified)
+				{
+					color::color_printf(color::FG_LIGHT_GREEN, "verified");
+				}
+				else
+				{
+					color::color_printf(color::FG_LIGHT_RED, "MISMATCH");
+				}
+				color::color_printf(color::FG_DARK_GRAY, " (%zu chunks", result.chunks);
+				if (result.elapsed_ms > 0)
+				{
+					color::color_printf(color::FG_DARK_GRAY, ", %.2f ms, %zu threads", result.elapsed_ms, worker_pool().size());
+				}
+				color::color_printf(color::FG_DARK_GRAY, ")\n");
+			}
+		}
+
 		void dump_creation_date() const 
 		{
-			printf("%s\n", cert->get_creation_date().get());
+			printf("%s\n", cert->get_creation_date().c_str());
 		}
 
 		void dump_revoke_date() const 
 		{
-			printf("%s\n", cert->get_revoke_date().get());
+			printf("%s\n", cert->get_revoke_date().c_str());
 		}
 
 		// strings
 		void dump_strings()
 		{
-			for (auto parsed_dex : parsed_dexes)
+			output::writer out;
+			for (auto& parsed_dex : parsed_dexes)
 			{
-				const auto dex_strings = parsed_dex.get_strings();
+				const auto& dex_strings = parsed_dex.get_strings();
 				if (!dex_strings.empty())
 				{
-					color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", parsed_dex.get_dex_name().c_str());
+					out.line(color::FG_DARK_GRAY, "DEX file: ", parsed_dex.get_dex_name());
 					for (const auto& str : dex_strings)
 					{
-						color::color_printf(color::FG_GREEN, "\t%s\n", str.c_str());
+						out.line(color::FG_GREEN, "\t", str);
 					}
 				}
 			}
@@ -421,43 +1133,48 @@ namespace andromeda
 			std::vector<std::string> urls{};
 			std::vector<std::string> emails{};
 
-			for (auto parsed_dex : parsed_dexes)
+			const auto classify = [&](const std::vector<std::string>& strings)
 			{
-				const auto dex_strings = parsed_dex.get_strings();
-				if (!dex_strings.empty())
+				for (const auto& str : strings)
 				{
-					for (const auto& str : dex_strings)
+					if (is_url(str))
 					{
-						if (is_url(str))
-						{
-							urls.emplace_back(str);
-						}
-						
-						if(is_email(str))
-						{
-							emails.emplace_back(str);
-						}
+						urls.emplace_back(str);
+					}
+
+					if (is_email(str))
+					{
+						emails.emplace_back(str);
 					}
 				}
+			};
+
+			for (auto& parsed_dex : parsed_dexes)
+			{
+				classify(parsed_dex.get_strings());
 			}
+			// native libraries and assets
+			classify(bin_strings->get_strings());
+
+			output::writer out;
 
 			// URLs:
 			if (!urls.empty())
 			{
-				color::color_printf(color::FG_DARK_GRAY, "URLs:\n");
+				out.color_printf(color::FG_DARK_GRAY, "URLs:\n");
 				for (const auto& url : urls)
 				{
-					color::color_printf(color::FG_GREEN, "\t%s\n", url.c_str());
+					out.line(color::FG_GREEN, "\t", url);
 				}
 			}
 
 			// emails
 			if (!emails.empty())
 			{
-				color::color_printf(color::FG_DARK_GRAY, "e-Mails:\n");
+				out.color_printf(color::FG_DARK_GRAY, "e-Mails:\n");
 				for (const auto& email : emails)
 				{
-					color::color_printf(color::FG_GREEN, "\t%s\n", email.c_str());
+					out.line(color::FG_GREEN, "\t", email);
 				}
 			}
 
@@ -465,24 +1182,148 @@ namespace andromeda
 
 		void search_string(std::string& target_string)
 		{
-			for (auto parsed_dex : parsed_dexes)
+			output::writer out;
+			for (auto& parsed_dex : parsed_dexes)
 			{
-				auto dex_strings = parsed_dex.get_strings();
+				const auto& dex_strings = parsed_dex.get_strings();
 				if (!dex_strings.empty())
 				{
-					for (auto& str : dex_strings)
+					for (const auto& str : dex_strings)
 					{
 						if (!str.empty() &&
 							utils::find_case_insensitive(str, target_string) != std::string::npos )
 						{
-							color::color_printf(color::FG_DARK_GRAY, "%s: ", parsed_dex.get_dex_name().c_str());
-							color::color_printf(color::FG_GREEN, "%s\n", str.c_str());
+							out.line(color::FG_DARK_GRAY, "", parsed_dex.get_dex_name(), ": ");
+							out.line(color::FG_GREEN, "", str);
+						}
+					}
+				}
+			}
+
+			const auto& xml_values = xml_strings->get_strings();
+			for (size_t i = 0; i < xml_values.size(); i++)
+			{
+				if (utils::find_case_insensitive(xml_values[i], target_string) != std::string::npos)
+				{
+					const auto& sources = xml_strings->get_sources(i);
+					out.line(color::FG_DARK_GRAY, "", xml_strings->get_file(sources[0]), ": ");
+					if (sources.size() > 1)
+					{
+						out.color_printf(color::FG_DARK_GRAY, "(+%zu files) ", sources.size() - 1);
+					}
+					out.line(color::FG_GREEN, "", xml_values[i]);
+				}
+			}
+
+			const auto& binary_values = bin_strings->get_strings();
+			for (size_t i = 0; i < binary_values.size(); i++)
+			{
+				if (utils::find_case_insensitive(binary_values[i], target_string) != std::string::npos)
+				{
+					const auto& sources = bin_strings->get_sources(i);
+					out.line(color::FG_DARK_GRAY, "", bin_strings->get_file(sources[0]), ": ");
+					if (sources.size() > 1)
+					{
+						out.color_printf(color::FG_DARK_GRAY, "(+%zu files) ", sources.size() - 1);
+					}
+					out.line(color::FG_GREEN, "", binary_values[i]);
+				}
+			}
+
+			if (resources != nullptr)
+			{
+				const auto count = resources->string_count();
+				for (size_t i = 0; i < count; i++)
+				{
+					const std::string str = resources->get_string(i);
+					if (!str.empty() &&
+						utils::find_case_insensitive(str, target_string) != std::string::npos)
+					{
+						const auto owner = resources->string_owner(i);
+						if (owner != 0)
+						{
+							out.line(color::FG_DARK_GRAY, "resources.arsc (", resources->get_name(owner), "): ");
+						}
+						else
+						{
+							out.line(color::FG_DARK_GRAY, "", "resources.arsc", ": ");
 						}
+						out.line(color::FG_GREEN, "", str);
 					}
 				}
 			}
 		}
 
+		// values from the binary XML files under res/, with the files they come from
+		void dump_res_strings()
+		{
+			double elapsed_ms = 0;
+			{
+				slicer::Chronometer chrono(elapsed_ms);
+				xml_strings->get_strings();
+			}
+
+			output::writer out;
+			const auto& strings = xml_strings->get_strings();
+			for (size_t i = 0; i < strings.size(); i++)
+			{
+				out.line(color::FG_GREEN, "", strings[i]);
+				for (const auto file_index : xml_strings->get_sources(i))
+				{
+					out.line(color::FG_DARK_GRAY, "\t\t", xml_strings->get_file(file_index));
+				}
+			}
+			out.color_printf(color::FG_DARK_GRAY, "%zu strings from %zu files in %.2f ms\n",
+			                 strings.size(), xml_strings->file_count(), elapsed_ms);
+		}
+
+		// printable strings of the native libraries and assets, at least "min_length" characters long;
+		// another length than the default is a scan of its own, the string searches keep the default one
+		void dump_binary_strings(const size_t min_length)
+		{
+			const auto scanned = min_length == bin_strings->get_min_length()
+			                     ? bin_strings
+			                     : std::make_shared<binary_strings>(source, min_length);
+			output::writer out;
+			const auto& strings = scanned->get_strings();
+			for (size_t i = 0; i < strings.size(); i++)
+			{
+				out.line(color::FG_GREEN, "", strings[i]);
+				for (const auto file_index : scanned->get_sources(i))
+				{
+					out.line(color::FG_DARK_GRAY, "\t\t", scanned->get_file(file_index));
+				}
+			}
+			out.color_printf(color::FG_DARK_GRAY, "%zu strings from %zu files in %.2f ms\n",
+			                 strings.size(), scanned->file_count(), scanned->get_elapsed_ms());
+		}
+
+		// "query" is a resource id (as printed in the manifest, ex. @7F0A0001) or a name (ex. @string/app_name)
+		void dump_resource(const std::string& query) const
+		{
+			if (resources == nullptr)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "No resources.arsc\n");
+				return;
+			}
+
+			uint32_t id = 0;
+			if (!resources->find(query, id) && !resource_table::parse_id(query, id))
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Invalid resource: %s\n", query.c_str());
+				return;
+			}
+
+			const auto name = resources->get_name(id);
+			if (name.empty())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Failed to locate resource: 0x%08x\n", id);
+				return;
+			}
+			color::color_printf(color::FG_DARK_GRAY, "0x%08x @%s: ", id, name.c_str());
+			color::color_printf(color::FG_GREEN, "%s\n", resources->resolve(id).c_str());
+		}
+
 		void dump_language()
 		{
 			std::string lang = "Java";
@@ -507,6 +1348,303 @@ namespace andromeda
 			color::color_printf(print_color, "%s\n", lang.c_str());
 		}
 
+		// compares per-line color_printf with the buffered writer, both write the method list to /dev/null
+		void benchmark_dump()
+		{
+			size_t lines = 0;
+			for (auto& parsed_dex : parsed_dexes)
+			{
+				lines += parsed_dex.get_methods().size();
+			}
+
+			const auto null_fd = open("/dev/null", O_WRONLY);
+			const auto stdout_fd = dup(STDOUT_FILENO);
+			if (null_fd < 0 || stdout_fd < 0)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Failed to open /dev/null\n");
+				return;
+			}
+			fflush(stdout);
+			dup2(null_fd, STDOUT_FILENO);
+
+			double legacy_ms = 0;
+			{
+				slicer::Chronometer chrono(legacy_ms);
+				for (auto& parsed_dex : parsed_dexes)
+				{
+					for (const auto& [class_path, method_name] : parsed_dex.get_methods())
+					{
+						printf("\033[%dm%s.\033[%dm", color::FG_DARK_GRAY, class_path.c_str(), color::FG_DEFAULT);
+						printf("\033[%dm%s\n\033[%dm", color::FG_GREEN, method_name.c_str(), color::FG_DEFAULT);
+					}
+				}
+			}
+
+			double buffered_ms = 0;
+			{
+				slicer::Chronometer chrono(buffered_ms);
+				output::writer out(stdout, true);
+				for (auto& parsed_dex : parsed_dexes)
+				{
+					for (const auto& [class_path, method_name] : parsed_dex.get_methods())
+					{
+						out.line(color::FG_DARK_GRAY, "", class_path, ".");
+						out.line(color::FG_GREEN, "", method_name);
+					}
+				}
+			}
+
+			fflush(stdout);
+			dup2(stdout_fd, STDOUT_FILENO);
+			close(stdout_fd);
+			close(null_fd);
+
+			color::color_printf(color::FG_DARK_GRAY, "Methods: %zu\n", lines);
+			color::color_printf(color::FG_GREEN, "\tcolor_printf: %.2f ms (%.0f lines/s)\n",
+			                    legacy_ms, legacy_ms > 0 ? lines * 1000.0 / legacy_ms : 0.0);
+			color::color_printf(color::FG_GREEN, "\tbuffered:     %.2f ms (%.0f lines/s)\n",
+			                    buffered_ms, buffered_ms > 0 ? lines * 1000.0 / buffered_ms : 0.0);
+			if (buffered_ms > 0)
+			{
+				color::color_printf(color::FG_LIGHT_GREEN, "\tspeedup: %.1fx\n", legacy_ms / buffered_ms);
+			}
+		}
+
+		// decodes the manifest repeatedly with both parsers and checks they agree
+		void benchmark_manifest() const
+		{
+			const auto manifest_path = unzip_path + '/' + "AndroidManifest.xml";
+			size_t size = 0;
+			const auto content = utils::read_file(manifest_path, size);
+			if (content == nullptr)
+			{
+				return;
+			}
+
+			static constexpr size_t iterations = 1000;
+			const manifest reference(content, size, manifest::parse_mode::dom);
+
+			auto mismatches = 0;
+			double dom_ms = 0;
+			{
+				slicer::Chronometer chrono(dom_ms);
+				for (size_t i = 0; i < iterations; i++)
+				{
+					const manifest current(content, size, manifest::parse_mode::dom);
+					mismatches += !current.same_fields(reference);
+				}
+			}
+
+			double streaming_ms = 0;
+			{
+				slicer::Chronometer chrono(streaming_ms);
+				for (size_t i = 0; i < iterations; i++)
+				{
+					const manifest current(content, size, manifest::parse_mode::streaming);
+					mismatches += !current.same_fields(reference);
+				}
+			}
+
+			color::color_printf(color::FG_DARK_GRAY, "AndroidManifest.xml: %zu bytes, %zu iterations\n", size, iterations);
+			color::color_printf(color::FG_GREEN, "\tpugixml DOM: %.1f us per manifest\n", dom_ms * 1000.0 / iterations);
+			color::color_printf(color::FG_GREEN, "\tstreaming:   %.1f us per manifest\n", streaming_ms * 1000.0 / iterations);
+			if (mismatches != 0)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "\t%d results differ from the DOM path\n", mismatches);
+			}
+			else
+			{
+				color::color_printf(color::FG_LIGHT_GREEN, "\tresults match\n");
+			}
+		}
+
+		// raises the code IR of every method: a new CodeIr per method,
+		// one reused CodeIr workspace, and one workspace per pool thread
+		void benchmark_code_ir()
+		{
+			std::vector<std::pair<std::shared_ptr<ir::DexFile>, ir::EncodedMethod*>> methods{};
+			for (auto& parsed_dex : parsed_dexes)
+			{
+				auto dex_ir = parsed_dex.get_full_ir();
+				for (const auto& ir_method : dex_ir->encoded_methods)
+				{
+					if (ir_method->code != nullptr)
+					{
+						methods.emplace_back(dex_ir, ir_method.get());
+					}
+				}
+			}
+			if (methods.empty())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "No methods with code\n");
+				return;
+			}
+
+			size_t fresh_instructions = 0;
+			double fresh_ms = 0;
+			{
+				slicer::Chronometer chrono(fresh_ms);
+				for (const auto& [dex_ir, ir_method] : methods)
+				{
+					lir::CodeIr code_ir(ir_method, dex_ir);
+					for (auto instr : code_ir.instructions)
+					{
+						fresh_instructions += instr != nullptr;
+					}
+				}
+			}
+
+			size_t reused_instructions = 0;
+			size_t arena_capacity = 0;
+			double reused_ms = 0;
+			{
+				slicer::Chronometer chrono(reused_ms);
+				std::unique_ptr<lir::CodeIr> code_ir = nullptr;
+				for (const auto& [dex_ir, ir_method] : methods)
+				{
+					if (code_ir == nullptr || code_ir->dex_ir != dex_ir)
+					{
+						code_ir.reset(new lir::CodeIr(ir_method, dex_ir));
+					}
+					else
+					{
+						code_ir->Reset(ir_method);
+					}
+					for (auto instr : code_ir->instructions)
+					{
+						reused_instructions += instr != nullptr;
+					}
+				}
+				arena_capacity = code_ir->ArenaCapacity();
+			}
+
+			auto& pool = worker_pool();
+			std::vector<std::unique_ptr<lir::CodeIr>> workspaces(pool.size());
+			std::vector<size_t> worker_instructions(pool.size(), 0);
+			double parallel_ms = 0;
+			{
+				slicer::Chronometer chrono(parallel_ms);
+				pool.parallel_for(methods.size(), 64, [&](const size_t index, const size_t worker_index)
+				{
+					const auto& [dex_ir, ir_method] = methods[index];
+					auto& code_ir = workspaces[worker_index];
+					if (code_ir == nullptr || code_ir->dex_ir != dex_ir)
+					{
+						code_ir.reset(new lir::CodeIr(ir_method, dex_ir));
+					}
+					else
+					{
+						code_ir->Reset(ir_method);
+					}
+					for (auto instr : code_ir->instructions)
+					{
+						worker_instructions[worker_index] += instr != nullptr;
+					}
+				});
+			}
+			size_t parallel_instructions = 0;
+			for (const auto count : worker_instructions)
+			{
+				parallel_instructions += count;
+			}
+
+			SLICER_CHECK(fresh_instructions == reused_instructions);
+			SLICER_CHECK(fresh_instructions == parallel_instructions);
+
+			const auto count = methods.size();
+			color::color_printf(color::FG_DARK_GRAY, "Methods: %zu, IR instructions: %zu\n", count, fresh_instructions);
+			color::color_printf(color::FG_GREEN, "\tCodeIr per method: %.2f ms (%.0f methods/s)\n",
+			                    fresh_ms, fresh_ms > 0 ? count * 1000.0 / fresh_ms : 0.0);
+			color::color_printf(color::FG_GREEN, "\treused workspace:  %.2f ms (%.0f methods/s), arena %.1f KB\n",
+			                    reused_ms, reused_ms > 0 ? count * 1000.0 / reused_ms : 0.0, arena_capacity / 1024.0);
+			color::color_printf(color::FG_GREEN, "\t%zu workspaces:     %.2f ms (%.0f methods/s)\n",
+			                    pool.size(), parallel_ms, parallel_ms > 0 ? count * 1000.0 / parallel_ms : 0.0);
+			if (reused_ms > 0 && parallel_ms > 0)
+			{
+				color::color_printf(color::FG_LIGHT_GREEN, "\tspeedup: %.1fx reused, %.1fx parallel\n",
+				                    fresh_ms / reused_ms, fresh_ms / parallel_ms);
+			}
+		}
+
+		// assembles the methods matching "method_path" again from their code IR, then writes
+		// their dex files with the incremental writer and with the full writer
+		void benchmark_patch(const std::string& method_path)
+		{
+			bool found = false;
+			for (auto& parsed_dex : parsed_dexes)
+			{
+				const auto methods = parsed_dex.find_methods(method_path);
+				if (methods.empty())
+				{
+					continue;
+				}
+				found = true;
+				for (const auto ir_method : methods)
+				{
+					if (ir_method->code != nullptr)
+					{
+						lir::CodeIr code_ir(ir_method, parsed_dex.get_ir());
+						code_ir.Assemble();
+					}
+				}
+
+				size_t patched_size = 0;
+				std::string fallback{};
+				double patched_ms = 0;
+				std::shared_ptr<const uint8_t> patched = nullptr;
+				{
+					slicer::Chronometer chrono(patched_ms);
+					patched = parsed_dex.create_patched_image(patched_size, fallback);
+				}
+				size_t full_size = 0;
+				double full_ms = 0;
+				std::shared_ptr<const uint8_t> full = nullptr;
+				{
+					slicer::Chronometer chrono(full_ms);
+					full = parsed_dex.create_image(full_size);
+				}
+
+				// the patched image read again must give back the same IR: written by the full writer,
+				// it's the same image as the one from the IR it was patched from
+				bool is_same = true;
+				if (fallback.empty())
+				{
+					std::shared_ptr<char> reread_content(new char[patched_size], std::default_delete<char[]>());
+					memcpy(reread_content.get(), patched.get(), patched_size);
+					andromeda::parsed_dex reread(parsed_dex.get_dex_name(), reread_content, patched_size);
+					// the full writer orders the classes as they were created, the same order for both
+					for (const auto& ir_class : parsed_dex.get_ir()->classes)
+					{
+						reread.get_class_ir(ir_class->orig_index);
+					}
+					size_t reread_size = 0;
+					const auto reread_full = reread.create_image(reread_size);
+					is_same = reread_size == full_size && memcmp(reread_full.get(), full.get(), full_size) == 0;
+				}
+
+				color::color_printf(color::FG_DARK_GRAY, "%s: %zu methods assembled again\n",
+				                    parsed_dex.get_dex_name().c_str(), methods.size());
+				if (!fallback.empty())
+				{
+					color::color_printf(color::FG_YELLOW, "\tfull writer used: %s\n", fallback.c_str());
+				}
+				color::color_printf(color::FG_GREEN, "\tpatched image: %zu bytes, %.2f ms\n", patched_size, patched_ms);
+				color::color_printf(color::FG_GREEN, "\tfull writer:   %zu bytes, %.2f ms\n", full_size, full_ms);
+				if (!is_same)
+				{
+					color::color_printf(color::FG_LIGHT_RED, "\tthe patched image doesn't read back as the full writer's image\n");
+				}
+				if (patched_ms > 0)
+				{
+					color::color_printf(color::FG_LIGHT_GREEN, "\tspeedup: %.1fx\n", full_ms / patched_ms);
+				}
+			}
+			if (!found)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Method not found: %s\n", method_path.c_str());
+			}
+		}
+
 		// class apk
 	};
 } // namespace andromeda
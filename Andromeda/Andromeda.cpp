@@ -8,7 +8,57 @@
 
 void usage()
 {
-	printf("Usage:\n\tAndromeda apk_file_path\n");
+	printf("Usage:\n\tAndromeda apk_file_path (or .xapk / .apks / .apkm bundle)\n");
+	printf("\tAndromeda --signers apk_file_or_dir... (group the APKs by certificate)\n");
+}
+
+// batch mode: the v1 certificates of every APK are decoded in parallel and indexed by fingerprint
+int cluster_signers(const int argc, char* argv[])
+{
+	std::vector<std::string> apk_pathes{};
+	for (auto i = 2; i < argc; i++)
+	{
+		const auto path = fs::absolute(argv[i]);
+		if (fs::is_directory(path))
+		{
+			const auto first = apk_pathes.size();
+			for (auto& p : fs::recursive_directory_iterator(path))
+			{
+				if (p.path().extension() == ".apk")
+				{
+					apk_pathes.emplace_back(p.path().string());
+				}
+			}
+			std::sort(apk_pathes.begin() + first, apk_pathes.end());
+		}
+		else if (fs::exists(path))
+		{
+			apk_pathes.emplace_back(path.string());
+		}
+		else
+		{
+			printf("Invalid file path: %s\n", path.string().c_str());
+		}
+	}
+
+	double elapsed = 0;
+	andromeda::signer_index index{};
+	{
+		slicer::Chronometer chrono(elapsed);
+		std::vector<std::unique_ptr<andromeda::certificate>> certificates(apk_pathes.size());
+		andromeda::worker_pool().parallel_for(apk_pathes.size(), 1, [&](const size_t i, size_t)
+		{
+			certificates[i].reset(new andromeda::certificate(apk_pathes[i]));
+		});
+		for (size_t i = 0; i < apk_pathes.size(); i++)
+		{
+			index.add(apk_pathes[i], *certificates[i]);
+		}
+	}
+
+	index.dump();
+	color::color_printf(color::FG_DARK_GRAY, "%zu APKs, %zu signers (%.2f ms)\n", apk_pathes.size(), index.signer_count(), elapsed);
+	return 0;
 }
 
 void print_todo()
@@ -25,6 +75,8 @@ void help_commands()
 	printf(" - print list of entry points [LIMITED]\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "entry_points_extended [epe]");
 	printf(" - print all possible entry points\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "components");
+	printf(" - match the components with their classes and lifecycle methods, flag the missing ones\n");
 
 	// permissions
 	printf("\n");
@@ -39,6 +91,12 @@ void help_commands()
 	// Receivers
 	color::color_printf(color::FG_LIGHT_GREEN, "receivers");
 	printf(" - Names of handlers declared in the APK file for receiving broadcasts\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "providers");
+	printf(" - Names of content providers contained in the APK file\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "handlers action");
+	printf(" - components with an intent-filter for 'action', ex. BOOT_COMPLETED\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "deep_links [scheme]");
+	printf(" - components accepting links with 'scheme' (all schemes by default)\n");
 
 	printf("\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "classes");
@@ -53,16 +111,26 @@ void help_commands()
 	printf(" - print all methods from APK file\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "disassemble [dis] method_path");
 	printf(" - disassemble a method\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "cfg method_path");
+	printf(" - print basic blocks, dominators and loops of a method\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "find_method [find_func] _str_");
 	printf(" - find a method which contains _str_ string\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "dump_all file_path");
+	printf(" - disassemble all methods into 'file_path'\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "export_smali dir_path");
+	printf(" - disassemble every class into its own file under 'dir_path'\n");
 
 	printf("\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "manifest");
 	printf(" - print content of AndroidManifest.xml file\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "resource [res] id_or_name");
+	printf(" - resolve a resource from resources.arsc, ex. @7F0A0001 or @string/app_name\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "is_debuggable");
 	printf(" - Checks android::debuggable field of AndroidManifest.xml file\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "certificate");
 	printf(" - print content of root certificate\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "signature [sig]");
+	printf(" - APK Signature Scheme v2/v3 signers, verifies the content digests\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "creation_date");
 	printf(" - print creation date of the application based on a certificate\n");
 	
@@ -76,6 +144,26 @@ void help_commands()
 	printf(" - write 'lib_path' file to disk\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "libs_hash [libh]");
 	printf(" - SHA-1 hashes of lib files\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "entropy");
+	printf(" - entropy of every APK entry and packer/encryption hints\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "archives");
+	printf(" - nested archives and APKs, with the base and split APKs of a bundle\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "local_headers");
+	printf(" - entries read from the local file headers, and what doesn't match their data\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "repack out_apk [dex]");
+	printf(" - write the APK again (aligned, unsigned), 'dex' rewrites the dex files from their IR\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "write_dex out_dir");
+	printf(" - write the dex files again from their IR, straight into mapped output files\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "trace_methods [package] [@annotation] [name(signature)]");
+	printf(" - add entry/exit hooks to the matching methods ('*' and '?' in the signature), in parallel\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "payloads [xor]");
+	printf(" - dex/zip/ELF/class headers hidden in the APK entries, 'xor' also tries single byte XOR keys\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "load_payloads [xor]");
+	printf(" - load the dex payloads next to the dex files of the APK\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "lib_symbols lib_path");
+	printf(" - needed libraries, exports and imports of 'lib_path' (ex. arm64-v8a/libfoo.so)\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "jni");
+	printf(" - match the native methods with the Java_ exports of the native libraries\n");
 	
 	// strings
 	printf("\n");
@@ -83,6 +171,10 @@ void help_commands()
 	printf(" - print the strings of APK (thanks to Strings Constant Pool)\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "string [str] search_string");
 	printf(" - find \"search_string\" in the strings of APK\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "res_strings");
+	printf(" - print the attribute and text values of the XML files under res/ and where they come from\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "bin_strings [min_length]");
+	printf(" - printable ASCII/UTF-16LE strings of the native libraries and assets (default length: 6)\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "interesting_strings [???]"); // TODO(lasha): short form
 	printf(" - Interesting/Suspicious strings from the APK file\n");
 
@@ -90,6 +182,14 @@ void help_commands()
 	printf("\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "language [lang]");
 	printf(" - print a language used to write the application\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "bench_dump");
+	printf(" - compare unbuffered and buffered throughput of the methods listing\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "bench_manifest");
+	printf(" - compare the streaming and the DOM manifest parsers\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "bench_ir");
+	printf(" - time raising the code IR of every method, fresh vs reused workspaces\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "bench_patch class.path.method");
+	printf(" - assemble a method again and time the incremental and the full dex writers\n");
 
 	printf("\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "cls [clr]");
@@ -111,6 +211,11 @@ int main(const int argc, char* argv[])
 	// disable buffering
 	setbuf(stdout, nullptr);
 
+	if (strcmp(argv[1], "--signers") == 0)
+	{
+		return cluster_signers(argc, argv);
+	}
+
 	const auto full_path = fs::absolute(argv[1]);
 	if (!exists(full_path))
 	{
@@ -132,10 +237,13 @@ int main(const int argc, char* argv[])
 			completions.emplace_back("entry_points");
 			completions.emplace_back("epe");
 			completions.emplace_back("entry_points_extended");
+			completions.emplace_back("entropy");
+			completions.emplace_back("export_smali ");
 		}
 		else if (editBuffer[0] == 'a')
 		{
 			completions.emplace_back("activities");
+			completions.emplace_back("archives");
 		}
 		else if (editBuffer[0] == 'd')
 		{
@@ -144,6 +252,9 @@ int main(const int argc, char* argv[])
 
 			completions.emplace_back("dump_lib ");
 			completions.emplace_back("dump_libs");
+			completions.emplace_back("dump_all ");
+
+			completions.emplace_back("deep_links");
 		}
 		else if (editBuffer[0] == 'c')
 		{
@@ -153,6 +264,8 @@ int main(const int argc, char* argv[])
 
 			completions.emplace_back("certificate");
 			completions.emplace_back("creation_date");
+			completions.emplace_back("cfg ");
+			completions.emplace_back("components");
 
 			if (strlen(editBuffer) > 1 && editBuffer[1] == 'l')
 			{
@@ -176,7 +289,12 @@ int main(const int argc, char* argv[])
 		else if (editBuffer[0] == 'r')
 		{
 			completions.emplace_back("revoke_date");
+			completions.emplace_back("repack ");
 			completions.emplace_back("receivers");
+
+			completions.emplace_back("res ");
+			completions.emplace_back("resource ");
+			completions.emplace_back("res_strings");
 		}
 		else if (editBuffer[0] == 's')
 		{
@@ -187,6 +305,9 @@ int main(const int argc, char* argv[])
 			completions.emplace_back("string ");
 
 			completions.emplace_back("services");
+
+			completions.emplace_back("sig");
+			completions.emplace_back("signature");
 		}
 		else if (editBuffer[0] == 'i')
 		{
@@ -198,6 +319,9 @@ int main(const int argc, char* argv[])
 			completions.emplace_back("libs");
 			completions.emplace_back("libs_hash");
 			completions.emplace_back("libh");
+			completions.emplace_back("lib_symbols ");
+			completions.emplace_back("load_payloads");
+			completions.emplace_back("local_headers");
 			
 			completions.emplace_back("language");
 			completions.emplace_back("lang");
@@ -205,13 +329,36 @@ int main(const int argc, char* argv[])
 		}
 		else if (editBuffer[0] == 'p')
 		{
+			completions.emplace_back("payloads");
+			completions.emplace_back("providers");
 			completions.emplace_back("permissions");
 			completions.emplace_back("perms");
 		}
 
+		else if (editBuffer[0] == 'b')
+		{
+			completions.emplace_back("bench_dump");
+			completions.emplace_back("bench_ir");
+			completions.emplace_back("bench_manifest");
+			completions.emplace_back("bench_patch ");
+			completions.emplace_back("bin_strings");
+		}
+		else if (editBuffer[0] == 't')
+		{
+			completions.emplace_back("trace_methods ");
+		}
 		else if (editBuffer[0] == 'h')
 		{
 			completions.emplace_back("help");
+			completions.emplace_back("handlers ");
+		}
+		else if (editBuffer[0] == 'j')
+		{
+			completions.emplace_back("jni");
+		}
+		else if (editBuffer[0] == 'w')
+		{
+			completions.emplace_back("write_dex ");
 		}
 	});
 
@@ -253,10 +400,35 @@ int main(const int argc, char* argv[])
 		{
 			apk.dump_receivers();
 		}
+		else if (line == "providers")
+		{
+			apk.dump_providers();
+		}
+		else if (utils::starts_with(line, "handlers "))
+		{
+			auto [_, action] = utils::split(line, ' ');
+			if (!action.empty())
+			{
+				apk.dump_action_handlers(action);
+			}
+		}
+		else if (line == "deep_links" || utils::starts_with(line, "deep_links "))
+		{
+			auto [_, scheme] = utils::split(line, ' ');
+			apk.dump_deep_links(scheme);
+		}
 		else if (line == "manifest")
 		{
 			apk.dump_manifest_file();
 		}
+		else if (utils::starts_with(line, "res ") || utils::starts_with(line, "resource "))
+		{
+			auto [_, query] = utils::split(line, ' ');
+			if (!query.empty())
+			{
+				apk.dump_resource(query);
+			}
+		}
 		else if (line == "permissions" || line == "perms")
 		{
 			apk.dump_permissions();
@@ -275,6 +447,11 @@ int main(const int argc, char* argv[])
 			apk.app_manifest->dump_entry_points(true);
 		}
 
+		else if (line == "components")
+		{
+			apk.dump_linked_components();
+		}
+
 		else if (utils::starts_with(line, "class ") || utils::starts_with(line, "class_info "))
 		{
 			auto [_, class_path] = utils::split(line, ' ');
@@ -325,12 +502,44 @@ int main(const int argc, char* argv[])
 				color::color_printf(color::FG_LIGHT_RED, "Invalid method path\n");
 			}
 		}
+		else if (utils::starts_with(line, "cfg "))
+		{
+			auto [_, method_path] = utils::split(line, ' ');
+			if (!method_path.empty())
+			{
+				apk.dump_method_cfg(method_path);
+			}
+			else
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Invalid method path\n");
+			}
+		}
+		else if (utils::starts_with(line, "dump_all "))
+		{
+			auto [_, out_path] = utils::split(line, ' ');
+			if (!out_path.empty())
+			{
+				apk.dump_all_methods(out_path);
+			}
+		}
+		else if (utils::starts_with(line, "export_smali "))
+		{
+			auto [_, out_dir] = utils::split(line, ' ');
+			if (!out_dir.empty())
+			{
+				apk.export_smali(out_dir);
+			}
+		}
 
 
 		else if (line == "certificate")
 		{
 			apk.dump_certificate();
 		}
+		else if (line == "signature" || line == "sig")
+		{
+			apk.dump_signature_block();
+		}
 		else if (line == "creation_date")
 		{
 			apk.dump_creation_date();
@@ -343,7 +552,7 @@ int main(const int argc, char* argv[])
 		// libs
 		else if (line == "libs")
 		{
-			const auto libs = apk.get_libs(full_path);
+			const auto libs = apk.get_libs();
 			if (!libs.empty())
 			{
 				color::color_printf(color::FG_DARK_GRAY, "Libs:\n");
@@ -355,19 +564,74 @@ int main(const int argc, char* argv[])
 		}
 		else if (line == "dump_libs")
 		{
-			apk.get_libs(full_path, true);
+			apk.get_libs(true);
 		}
 		else if (utils::starts_with(line, "dump_lib "))
 		{
 			auto [_, lib_path] = utils::split(line, ' ');
 			if (!lib_path.empty())
 			{
-				apk.get_libs(full_path, true, lib_path);
+				apk.get_libs(true, lib_path);
 			}
 		}
 		else if (line == "libs_hash" || line == "libh")
 		{
-			apk.get_libs(full_path, true, "", true);
+			apk.get_libs(true, "", true);
+		}
+		else if (utils::starts_with(line, "lib_symbols "))
+		{
+			auto [_, lib_path] = utils::split(line, ' ');
+			apk.dump_lib_symbols(lib_path);
+		}
+		else if (line == "entropy")
+		{
+			apk.dump_entropy();
+		}
+		else if (line == "archives")
+		{
+			apk.dump_archives();
+		}
+		else if (line == "local_headers")
+		{
+			apk.dump_recovery();
+		}
+		else if (utils::starts_with(line, "repack "))
+		{
+			auto [_, arguments] = utils::split(line, ' ');
+			const auto rewrite_dex = utils::ends_with(arguments, " dex");
+			if (rewrite_dex)
+			{
+				arguments.resize(arguments.size() - 4);
+			}
+			if (!arguments.empty())
+			{
+				apk.repack(arguments, rewrite_dex);
+			}
+		}
+		else if (utils::starts_with(line, "trace_methods "))
+		{
+			const auto [_, filter] = utils::split(line, ' ');
+			apk.trace_methods(filter);
+		}
+		else if (utils::starts_with(line, "write_dex "))
+		{
+			const auto [_, out_dir] = utils::split(line, ' ');
+			if (!out_dir.empty())
+			{
+				apk.write_dexes(out_dir);
+			}
+		}
+		else if (line == "payloads" || line == "payloads xor")
+		{
+			apk.dump_payloads(line == "payloads xor");
+		}
+		else if (line == "load_payloads" || line == "load_payloads xor")
+		{
+			apk.load_payloads(line == "load_payloads xor");
+		}
+		else if (line == "jni")
+		{
+			apk.dump_jni_bindings();
 		}
 		
 
@@ -376,6 +640,23 @@ int main(const int argc, char* argv[])
 		{
 			apk.dump_strings();
 		}
+		else if (line == "res_strings")
+		{
+			apk.dump_res_strings();
+		}
+		else if (line == "bin_strings" || utils::starts_with(line, "bin_strings "))
+		{
+			auto [_, min_length] = utils::split(line, ' ');
+			const auto length = min_length.empty() ? andromeda::binary_strings::default_min_length : strtoul(min_length.c_str(), nullptr, 10);
+			if (length == 0)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Invalid length: %s\n", min_length.c_str());
+			}
+			else
+			{
+				apk.dump_binary_strings(length);
+			}
+		}
 		else if (line == "interesting_strings")
 		{
 			apk.dump_interesting_strings();
@@ -394,6 +675,23 @@ int main(const int argc, char* argv[])
 		{
 			apk.dump_language();
 		}
+		else if (line == "bench_dump")
+		{
+			apk.benchmark_dump();
+		}
+		else if (line == "bench_manifest")
+		{
+			apk.benchmark_manifest();
+		}
+		else if (line == "bench_ir")
+		{
+			apk.benchmark_code_ir();
+		}
+		else if (utils::starts_with(line, "bench_patch "))
+		{
+			auto [_, method_path] = utils::split(line, ' ');
+			apk.benchmark_patch(method_path);
+		}
 
 		// clear screen
 		else if (line == "clr" || line == "cls" || line == "clear")
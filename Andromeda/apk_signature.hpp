@@ -0,0 +1,499 @@
+#pragma once
+
+#include <cstring>
+
+#include "utils.hpp"
+#include "thread_pool.hpp"
+
+#include "slicer/chronometer.h"
+
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+namespace andromeda
+{
+	// APK Signature Scheme v2/v3 (https://source.android.com/docs/security/features/apksigning/v2).
+	// The signing block sits right before the zip central directory, it is found through the EOCD
+	// of the mapped file. The content digests are recomputed the way the platform does it:
+	// the file minus the signing block is cut into 1 MB chunks, every chunk is hashed on the
+	// worker pool and the top level digest is taken over the chunk digests.
+	// Signatures over the signed data are not checked, only the content digests.
+	class apk_signature
+	{
+	public:
+		static constexpr uint32_t v2_block_id = 0x7109871a;
+		static constexpr uint32_t v3_block_id = 0xf05368c0;
+		static constexpr uint32_t v31_block_id = 0x1b93ad61;
+
+		struct content_digest
+		{
+			uint32_t algorithm = 0;
+			std::vector<uint8_t> value{};
+		};
+
+		struct signer
+		{
+			int scheme = 2; // 2, 3 or 31 (v3.1)
+			uint32_t min_sdk = 0; // v3
+			uint32_t max_sdk = 0;
+			std::vector<content_digest> digests{};
+			std::vector<std::vector<uint8_t>> certificates{}; // DER
+			std::vector<uint32_t> signature_algorithms{};
+		};
+
+		struct verification
+		{
+			uint32_t algorithm = 0;
+			bool supported = false;
+			bool verified = false;
+			size_t chunks = 0;
+			double elapsed_ms = 0;
+		};
+
+	private:
+		static constexpr size_t chunk_size = 1024 * 1024;
+		static constexpr uint32_t eocd_magic = 0x06054b50;
+		static constexpr size_t eocd_size = 22;
+
+		// bounds checked little-endian reader over a length-prefixed structure
+		struct byte_reader
+		{
+			const uint8_t* data = nullptr;
+			size_t size = 0;
+
+			bool read_u32(uint32_t& value)
+			{
+				if (size < 4)
+				{
+					return false;
+				}
+				memcpy(&value, data, 4);
+				data += 4;
+				size -= 4;
+				return true;
+			}
+
+			bool read_u64(uint64_t& value)
+			{
+				if (size < 8)
+				{
+					return false;
+				}
+				memcpy(&value, data, 8);
+				data += 8;
+				size -= 8;
+				return true;
+			}
+
+			// uint32 length followed by that many bytes
+			bool read_prefixed(byte_reader& value)
+			{
+				uint32_t length = 0;
+				if (!read_u32(length) || length > size)
+				{
+					return false;
+				}
+				value.data = data;
+				value.size = length;
+				data += length;
+				size -= length;
+				return true;
+			}
+
+			bool empty() const
+			{
+				return size == 0;
+			}
+		};
+
+		size_t size_ = 0; // set by the mapping, before data_ is initialized
+		std::shared_ptr<const uint8_t> data_{};
+		std::string error_{};
+		size_t block_offset_ = 0;
+		size_t central_directory_offset_ = 0;
+		size_t eocd_offset_ = 0;
+		std::vector<signer> signers_{};
+
+		static uint32_t read_u32(const uint8_t* p)
+		{
+			uint32_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		bool find_eocd()
+		{
+			const auto data = data_.get();
+			const auto size = size_;
+			if (size < eocd_size)
+			{
+				return false;
+			}
+			// the EOCD is followed by a comment of at most 64 KB
+			const auto lowest = size > eocd_size + 0xffff ? size - eocd_size - 0xffff : 0;
+			for (auto offset = size - eocd_size + 1; offset-- > lowest;)
+			{
+				if (read_u32(data + offset) == eocd_magic &&
+				    offset + eocd_size + (data[offset + 20] | data[offset + 21] << 8) == size)
+				{
+					eocd_offset_ = offset;
+					central_directory_offset_ = read_u32(data + offset + 16);
+					return central_directory_offset_ <= eocd_offset_;
+				}
+			}
+			return false;
+		}
+
+		// signed data: digests, certificates, [min/max sdk,] additional attributes
+		static bool parse_signed_data(byte_reader signed_data, signer& current)
+		{
+			byte_reader digests{};
+			if (!signed_data.read_prefixed(digests))
+			{
+				return false;
+			}
+			while (!digests.empty())
+			{
+				byte_reader digest{};
+				byte_reader value{};
+				content_digest entry{};
+				if (!digests.read_prefixed(digest) || !digest.read_u32(entry.algorithm) || !digest.read_prefixed(value))
+				{
+					return false;
+				}
+				entry.value.assign(value.data, value.data + value.size);
+				current.digests.emplace_back(std::move(entry));
+			}
+
+			byte_reader certificates{};
+			if (!signed_data.read_prefixed(certificates))
+			{
+				return false;
+			}
+			while (!certificates.empty())
+			{
+				byte_reader certificate{};
+				if (!certificates.read_prefixed(certificate))
+				{
+					return false;
+				}
+				current.certificates.emplace_back(certificate.data, certificate.data + certificate.size);
+			}
+			return true;
+		}
+
+		static bool parse_signer(byte_reader signer_data, const int scheme, signer& current)
+		{
+			current.scheme = scheme;
+			byte_reader signed_data{};
+			byte_reader signatures{};
+			if (!signer_data.read_prefixed(signed_data) || !parse_signed_data(signed_data, current))
+			{
+				return false;
+			}
+			if (scheme != 2 && (!signer_data.read_u32(current.min_sdk) || !signer_data.read_u32(current.max_sdk)))
+			{
+				return false;
+			}
+			if (!signer_data.read_prefixed(signatures))
+			{
+				return false;
+			}
+			while (!signatures.empty())
+			{
+				byte_reader signature{};
+				uint32_t algorithm = 0;
+				if (!signatures.read_prefixed(signature) || !signature.read_u32(algorithm))
+				{
+					return false;
+				}
+				current.signature_algorithms.emplace_back(algorithm);
+			}
+			return true;
+		}
+
+		bool parse_scheme_block(byte_reader block, const int scheme)
+		{
+			byte_reader signers{};
+			if (!block.read_prefixed(signers))
+			{
+				return false;
+			}
+			while (!signers.empty())
+			{
+				byte_reader signer_data{};
+				signer current{};
+				if (!signers.read_prefixed(signer_data) || !parse_signer(signer_data, scheme, current))
+				{
+					return false;
+				}
+				signers_.emplace_back(std::move(current));
+			}
+			return true;
+		}
+
+		void parse()
+		{
+			if (!find_eocd())
+			{
+				error_ = "no zip end of central directory";
+				return;
+			}
+
+			// ... | signing block: size, (size, id, value)*, size, "APK Sig Block 42" | central directory
+			const auto data = data_.get();
+			if (central_directory_offset_ < 32 ||
+			    memcmp(data + central_directory_offset_ - 16, "APK Sig Block 42", 16) != 0)
+			{
+				error_ = "no APK Signing Block";
+				return;
+			}
+			uint64_t block_size = 0;
+			memcpy(&block_size, data + central_directory_offset_ - 24, sizeof(block_size));
+			if (block_size < 24 || block_size > central_directory_offset_ - 8)
+			{
+				error_ = "invalid APK Signing Block size";
+				return;
+			}
+			block_offset_ = central_directory_offset_ - block_size - 8;
+
+			byte_reader pairs{data + block_offset_ + 8, static_cast<size_t>(block_size) - 24};
+			while (!pairs.empty())
+			{
+				uint64_t pair_size = 0;
+				uint32_t id = 0;
+				if (!pairs.read_u64(pair_size) || pair_size < 4 || pair_size > pairs.size || !pairs.read_u32(id))
+				{
+					error_ = "invalid APK Signing Block entry";
+					return;
+				}
+				const byte_reader value{pairs.data, static_cast<size_t>(pair_size) - 4};
+				pairs.data += value.size;
+				pairs.size -= value.size;
+
+				const auto scheme = id == v2_block_id ? 2 : id == v3_block_id ? 3 : id == v31_block_id ? 31 : 0;
+				if (scheme != 0 && !parse_scheme_block(value, scheme))
+				{
+					error_ = "invalid signer block";
+					return;
+				}
+			}
+		}
+
+		static const EVP_MD* digest_for(const uint32_t algorithm)
+		{
+			switch (algorithm)
+			{
+			case 0x0101: // RSASSA-PSS with SHA2-256
+			case 0x0103: // RSASSA-PKCS1-v1_5 with SHA2-256
+			case 0x0201: // ECDSA with SHA2-256
+			case 0x0301: // DSA with SHA2-256
+				return EVP_sha256();
+			case 0x0102: // RSASSA-PSS with SHA2-512
+			case 0x0104: // RSASSA-PKCS1-v1_5 with SHA2-512
+			case 0x0202: // ECDSA with SHA2-512
+				return EVP_sha512();
+			default: // ex. 0x0421, the verity tree digest
+				return nullptr;
+			}
+		}
+
+		// the chunked digest over the contents, the central directory and the EOCD
+		// (pointing to the signing block instead of the central directory)
+		void compute_content_digest(const EVP_MD* md, std::vector<uint8_t>& top_digest, size_t& chunk_count) const
+		{
+			const auto data = data_.get();
+			std::vector<uint8_t> eocd(data + eocd_offset_, data + size_);
+			const auto patched_offset = static_cast<uint32_t>(block_offset_);
+			memcpy(eocd.data() + 16, &patched_offset, sizeof(patched_offset));
+
+			const std::pair<const uint8_t*, size_t> sections[] = {
+				{data, block_offset_},
+				{data + central_directory_offset_, eocd_offset_ - central_directory_offset_},
+				{eocd.data(), eocd.size()},
+			};
+			std::vector<std::pair<const uint8_t*, uint32_t>> chunks{};
+			for (const auto& [section, size] : sections)
+			{
+				for (size_t offset = 0; offset < size; offset += chunk_size)
+				{
+					chunks.emplace_back(section + offset, static_cast<uint32_t>(std::min(chunk_size, size - offset)));
+				}
+			}
+			chunk_count = chunks.size();
+
+			const auto digest_size = static_cast<size_t>(EVP_MD_size(md));
+			std::vector<uint8_t> chunk_digests(chunks.size() * digest_size);
+			auto& pool = worker_pool();
+			std::vector<EVP_MD_CTX*> contexts(pool.size(), nullptr);
+			pool.parallel_for(chunks.size(), 1, [&](const size_t index, const size_t worker_index)
+			{
+				auto& context = contexts[worker_index];
+				if (context == nullptr)
+				{
+					context = EVP_MD_CTX_new();
+				}
+				const uint8_t prefix = 0xa5;
+				const auto [chunk, size] = chunks[index];
+				EVP_DigestInit_ex(context, md, nullptr);
+				EVP_DigestUpdate(context, &prefix, 1);
+				EVP_DigestUpdate(context, &size, sizeof(size));
+				EVP_DigestUpdate(context, chunk, size);
+				EVP_DigestFinal_ex(context, chunk_digests.data() + index * digest_size, nullptr);
+			});
+			for (const auto context : contexts)
+			{
+				EVP_MD_CTX_free(context);
+			}
+
+			const auto context = EVP_MD_CTX_new();
+			const uint8_t prefix = 0x5a;
+			const auto count = static_cast<uint32_t>(chunks.size());
+			top_digest.resize(digest_size);
+			EVP_DigestInit_ex(context, md, nullptr);
+			EVP_DigestUpdate(context, &prefix, 1);
+			EVP_DigestUpdate(context, &count, sizeof(count));
+			EVP_DigestUpdate(context, chunk_digests.data(), chunk_digests.size());
+			EVP_DigestFinal_ex(context, top_digest.data(), nullptr);
+			EVP_MD_CTX_free(context);
+		}
+
+	public:
+		explicit apk_signature(const utils::zip_source& source) : data_(source.map(size_))
+		{
+			if (data_ == nullptr)
+			{
+				error_ = "failed to map the file";
+				return;
+			}
+			parse();
+		}
+
+		// No copy/move semantics
+		apk_signature(const apk_signature&) = delete;
+		apk_signature& operator=(const apk_signature&) = delete;
+
+		bool has_signing_block() const
+		{
+			return block_offset_ != 0;
+		}
+
+		const std::string& get_error() const
+		{
+			return error_;
+		}
+
+		const std::vector<signer>& get_signers() const
+		{
+			return signers_;
+		}
+
+		// checks every content digest of every signer, each digest algorithm is computed once
+		std::vector<verification> verify() const
+		{
+			struct computed_digest
+			{
+				const EVP_MD* md;
+				std::vector<uint8_t> value;
+				size_t chunks;
+			};
+
+			std::vector<verification> results{};
+			std::vector<computed_digest> computed{};
+			for (const auto& current : signers_)
+			{
+				for (const auto& digest : current.digests)
+				{
+					verification result{};
+					result.algorithm = digest.algorithm;
+					const auto md = digest_for(digest.algorithm);
+					if (md == nullptr || !has_signing_block())
+					{
+						results.emplace_back(result);
+						continue;
+					}
+					result.supported = true;
+
+					auto found = std::find_if(computed.begin(), computed.end(), [md](const computed_digest& entry)
+					{
+						return entry.md == md;
+					});
+					if (found == computed.end())
+					{
+						computed_digest entry{md, {}, 0};
+						{
+							slicer::Chronometer chrono(result.elapsed_ms);
+							compute_content_digest(md, entry.value, entry.chunks);
+						}
+						computed.emplace_back(std::move(entry));
+						found = computed.end() - 1;
+					}
+					result.chunks = found->chunks;
+					result.verified = found->value == digest.value;
+					results.emplace_back(result);
+				}
+			}
+			return results;
+		}
+
+		static const char* algorithm_name(const uint32_t algorithm)
+		{
+			switch (algorithm)
+			{
+			case 0x0101:
+				return "RSASSA-PSS SHA2-256";
+			case 0x0102:
+				return "RSASSA-PSS SHA2-512";
+			case 0x0103:
+				return "RSASSA-PKCS1-v1_5 SHA2-256";
+			case 0x0104:
+				return "RSASSA-PKCS1-v1_5 SHA2-512";
+			case 0x0201:
+				return "ECDSA SHA2-256";
+			case 0x0202:
+				return "ECDSA SHA2-512";
+			case 0x0301:
+				return "DSA SHA2-256";
+			case 0x0421:
+				return "verity SHA2-256";
+			default:
+				return "unknown";
+			}
+		}
+
+		// subject of a DER certificate, empty if it can't be decoded
+		static std::string certificate_subject(const std::vector<uint8_t>& der)
+		{
+			auto p = der.data();
+			const auto x509 = d2i_X509(nullptr, &p, static_cast<long>(der.size()));
+			if (x509 == nullptr)
+			{
+				return "";
+			}
+			char subject[512]{};
+			X509_NAME_oneline(X509_get_subject_name(x509), subject, sizeof(subject));
+			X509_free(x509);
+			return subject;
+		}
+
+		static std::string hex(const std::vector<uint8_t>& bytes)
+		{
+			static const char digits[] = "0123456789abcdef";
+			std::string result{};
+			result.reserve(bytes.size() * 2);
+			for (const auto byte : bytes)
+			{
+				result += digits[byte >> 4];
+				result += digits[byte & 0x0f];
+			}
+			return result;
+		}
+
+		static std::string sha256_hex(const std::vector<uint8_t>& bytes)
+		{
+			std::vector<uint8_t> digest(EVP_MD_size(EVP_sha256()));
+			EVP_Digest(bytes.data(), bytes.size(), digest.data(), nullptr, EVP_sha256(), nullptr);
+			return hex(digest);
+		}
+	};
+} // namespace andromeda
@@ -0,0 +1,491 @@
+#pragma once
+
+#include <map>
+#include <set>
+
+#include "utils.hpp"
+#include "thread_pool.hpp"
+
+#include "slicer/chronometer.h"
+
+namespace andromeda
+{
+	// CRC-32 of two concatenated buffers from their CRCs (zlib's crc32_combine, GF(2) matrices)
+	inline uint32_t crc32_combine(uint32_t first, const uint32_t second, uint64_t second_size)
+	{
+		const auto times = [](const uint32_t* matrix, uint32_t vector)
+		{
+			uint32_t sum = 0;
+			for (auto row = matrix; vector != 0; vector >>= 1, row++)
+			{
+				if (vector & 1)
+				{
+					sum ^= *row;
+				}
+			}
+			return sum;
+		};
+		const auto square = [&times](uint32_t* square, const uint32_t* matrix)
+		{
+			for (size_t n = 0; n < 32; n++)
+			{
+				square[n] = times(matrix, matrix[n]);
+			}
+		};
+		if (second_size == 0)
+		{
+			return first;
+		}
+
+		uint32_t even[32]{}; // even power of two zeros operator
+		uint32_t odd[32]{}; // odd power of two zeros operator
+		odd[0] = 0xedb88320; // the CRC-32 polynomial
+		for (uint32_t n = 1, row = 1; n < 32; n++, row <<= 1)
+		{
+			odd[n] = row;
+		}
+		square(even, odd); // 2 zero bits
+		square(odd, even); // 4 zero bits
+
+		// first << second_size zero bytes, one bit of the size at a time
+		do
+		{
+			square(even, odd);
+			if (second_size & 1)
+			{
+				first = times(even, first);
+			}
+			second_size >>= 1;
+			if (second_size == 0)
+			{
+				break;
+			}
+			square(odd, even);
+			if (second_size & 1)
+			{
+				first = times(odd, first);
+			}
+			second_size >>= 1;
+		}
+		while (second_size != 0);
+		return first ^ second;
+	}
+
+	// Writes a new APK from an existing one: the unchanged entries are copied as they are compressed
+	// (no inflate / deflate), the replaced ones are deflated pigz-style, in chunks compressed in parallel
+	// on the worker pool and joined with sync flushes. Stored entries get the zipalign alignment
+	// (4 bytes, a page for the native libraries) through the 0xd935 extra field. No zip64, no signature:
+	// the output has to be signed again.
+	class apk_writer
+	{
+	public:
+		static constexpr size_t chunk_size = 256 * 1024;
+		static constexpr size_t page_alignment = 4096;
+		static constexpr uint16_t alignment_extra_id = 0xd935;
+
+	private:
+		struct replacement
+		{
+			std::shared_ptr<const uint8_t> content{};
+			size_t size = 0;
+		};
+
+		// an entry of the output, in the order of the source
+		struct entry
+		{
+			std::string name{};
+			uint16_t flags = 0;
+			uint16_t method = 0;
+			uint16_t time = 0;
+			uint16_t date = 0;
+			uint32_t crc = 0;
+			uint64_t compressed_size = 0;
+			uint64_t size = 0;
+			uint32_t external_attributes = 0;
+			const uint8_t* raw = nullptr; // compressed data of an unchanged entry
+			const replacement* replaced = nullptr;
+			std::vector<std::vector<uint8_t>> chunks{}; // deflated pieces of a replaced entry
+			uint64_t header_offset = 0;
+		};
+
+		utils::zip_source source_;
+		std::map<std::string, replacement> replacements_{};
+		std::set<std::string> removed_{};
+		std::string error_{};
+		double elapsed_ms_ = 0;
+		size_t copied_ = 0;
+		size_t deflated_ = 0;
+		uint64_t written_ = 0;
+
+		static uint16_t read_u16(const uint8_t* p)
+		{
+			return static_cast<uint16_t>(p[0] | p[1] << 8);
+		}
+
+		static void put_u16(std::vector<uint8_t>& out, const uint16_t value)
+		{
+			out.push_back(static_cast<uint8_t>(value));
+			out.push_back(static_cast<uint8_t>(value >> 8));
+		}
+
+		static void put_u32(std::vector<uint8_t>& out, const uint32_t value)
+		{
+			put_u16(out, static_cast<uint16_t>(value));
+			put_u16(out, static_cast<uint16_t>(value >> 16));
+		}
+
+		static size_t alignment(const entry& current)
+		{
+			if (current.method != 0)
+			{
+				return 1;
+			}
+			return utils::ends_with(current.name, ".so") ? page_alignment : 4;
+		}
+
+		static mz_bool collect_chunk(const void* buffer, const int size, void* user)
+		{
+			auto& out = *static_cast<std::vector<uint8_t>*>(user);
+			out.insert(out.end(), static_cast<const uint8_t*>(buffer), static_cast<const uint8_t*>(buffer) + size);
+			return MZ_TRUE;
+		}
+
+		bool fail(const std::string& error)
+		{
+			error_ = error;
+			return false;
+		}
+
+		// the deflated chunks and the CRC of every replaced entry, all chunks in one parallel loop
+		void deflate(std::vector<entry>& entries) const
+		{
+			std::vector<std::pair<entry*, size_t>> chunks{}; // entry, chunk index
+			for (auto& current : entries)
+			{
+				if (current.replaced == nullptr)
+				{
+					continue;
+				}
+				const auto count = std::max<size_t>(1, (current.size + chunk_size - 1) / chunk_size);
+				if (current.method == 8)
+				{
+					current.chunks.resize(count);
+				}
+				for (size_t i = 0; i < count; i++)
+				{
+					chunks.emplace_back(&current, i);
+				}
+			}
+
+			auto& pool = worker_pool();
+			std::vector<std::unique_ptr<tdefl_compressor>> compressors(pool.size());
+			std::vector<uint32_t> crcs(chunks.size());
+			const auto flags = tdefl_create_comp_flags_from_zip_params(MZ_DEFAULT_LEVEL, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY);
+			pool.parallel_for(chunks.size(), 1, [&](const size_t index, const size_t worker_index)
+			{
+				auto& [current, chunk] = chunks[index];
+				const auto begin = chunk * chunk_size;
+				const auto size = std::min<uint64_t>(chunk_size, current->size - std::min<uint64_t>(current->size, begin));
+				const auto data = current->replaced->content.get() + begin;
+				crcs[index] = static_cast<uint32_t>(mz_crc32(MZ_CRC32_INIT, data, size));
+				if (current->method != 8)
+				{
+					return;
+				}
+
+				auto& compressor = compressors[worker_index];
+				if (compressor == nullptr)
+				{
+					compressor.reset(new tdefl_compressor);
+				}
+				auto& out = current->chunks[chunk];
+				out.reserve(size / 2);
+				tdefl_init(compressor.get(), collect_chunk, &out, static_cast<int>(flags));
+				// every chunk but the last ends on a byte boundary without the final block bit
+				const auto is_last = chunk + 1 == current->chunks.size();
+				tdefl_compress_buffer(compressor.get(), data, size, is_last ? TDEFL_FINISH : TDEFL_SYNC_FLUSH);
+			});
+
+			for (size_t i = 0; i < chunks.size(); i++)
+			{
+				auto& [current, chunk] = chunks[i];
+				const auto begin = chunk * chunk_size;
+				const auto size = std::min<uint64_t>(chunk_size, current->size - std::min<uint64_t>(current->size, begin));
+				current->crc = chunk == 0 ? crcs[i] : crc32_combine(current->crc, crcs[i], size);
+			}
+			for (auto& current : entries)
+			{
+				if (current.replaced == nullptr)
+				{
+					continue;
+				}
+				current.compressed_size = current.size;
+				if (current.method == 8)
+				{
+					current.compressed_size = 0;
+					for (const auto& chunk : current.chunks)
+					{
+						current.compressed_size += chunk.size();
+					}
+				}
+			}
+		}
+
+		std::vector<uint8_t> local_header(const entry& current, const uint64_t offset) const
+		{
+			std::vector<uint8_t> header{};
+			put_u32(header, 0x04034b50);
+			put_u16(header, 20);
+			put_u16(header, current.flags);
+			put_u16(header, current.method);
+			put_u16(header, current.time);
+			put_u16(header, current.date);
+			put_u32(header, current.crc);
+			put_u32(header, static_cast<uint32_t>(current.compressed_size));
+			put_u32(header, static_cast<uint32_t>(current.size));
+			put_u16(header, static_cast<uint16_t>(current.name.size()));
+
+			const auto align = alignment(current);
+			size_t extra_size = 0;
+			if (align > 1)
+			{
+				// id, size, alignment and the padding which puts the data on the boundary
+				const auto data_offset = offset + 30 + current.name.size() + 6;
+				extra_size = 6 + (align - data_offset % align) % align;
+			}
+			put_u16(header, static_cast<uint16_t>(extra_size));
+			header.insert(header.end(), current.name.begin(), current.name.end());
+			if (extra_size != 0)
+			{
+				put_u16(header, alignment_extra_id);
+				put_u16(header, static_cast<uint16_t>(extra_size - 4));
+				put_u16(header, static_cast<uint16_t>(align));
+				header.resize(header.size() + extra_size - 6, 0);
+			}
+			return header;
+		}
+
+		static void central_header(std::vector<uint8_t>& out, const entry& current)
+		{
+			put_u32(out, 0x02014b50);
+			put_u16(out, 0x0314); // made by: unix, 2.0
+			put_u16(out, 20);
+			put_u16(out, current.flags);
+			put_u16(out, current.method);
+			put_u16(out, current.time);
+			put_u16(out, current.date);
+			put_u32(out, current.crc);
+			put_u32(out, static_cast<uint32_t>(current.compressed_size));
+			put_u32(out, static_cast<uint32_t>(current.size));
+			put_u16(out, static_cast<uint16_t>(current.name.size()));
+			put_u16(out, 0); // extra
+			put_u16(out, 0); // comment
+			put_u16(out, 0); // disk
+			put_u16(out, 0); // internal attributes
+			put_u32(out, current.external_attributes);
+			put_u32(out, static_cast<uint32_t>(current.header_offset));
+			out.insert(out.end(), current.name.begin(), current.name.end());
+		}
+
+		// the entries of the source with their raw data, then the new ones
+		bool list_entries(const uint8_t* data, const size_t size, std::vector<entry>& entries) const
+		{
+			mz_zip_archive zip_archive;
+			if (!source_.open(zip_archive))
+			{
+				return false;
+			}
+			const auto file_count = mz_zip_reader_get_num_files(&zip_archive);
+			for (mz_uint i = 0; i < file_count; i++)
+			{
+				mz_zip_archive_file_stat file_stat;
+				if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat) || removed_.count(file_stat.m_filename) != 0)
+				{
+					continue;
+				}
+				const auto header = file_stat.m_local_header_ofs;
+				if (header + 30 > size || read_u16(data + header) != 0x4b50)
+				{
+					continue;
+				}
+				const auto data_offset = header + 30 + read_u16(data + header + 26) + read_u16(data + header + 28);
+				if (data_offset + file_stat.m_comp_size > size)
+				{
+					continue;
+				}
+
+				entry current{};
+				current.name = file_stat.m_filename;
+				current.flags = file_stat.m_bit_flag & ~8; // the sizes are in the header
+				current.method = static_cast<uint16_t>(file_stat.m_method);
+				current.time = read_u16(data + header + 10);
+				current.date = read_u16(data + header + 12);
+				current.crc = file_stat.m_crc32;
+				current.compressed_size = file_stat.m_comp_size;
+				current.size = file_stat.m_uncomp_size;
+				current.external_attributes = file_stat.m_external_attr;
+				current.raw = data + data_offset;
+
+				const auto found = replacements_.find(current.name);
+				if (found != replacements_.end())
+				{
+					current.replaced = &found->second;
+					current.size = found->second.size;
+					current.flags &= ~1;
+					current.method = current.method == 0 ? 0 : 8;
+				}
+				entries.emplace_back(std::move(current));
+			}
+			mz_zip_reader_end(&zip_archive);
+
+			for (const auto& [name, content] : replacements_)
+			{
+				const auto exists = std::any_of(entries.begin(), entries.end(), [&name](const entry& current)
+				{
+					return current.name == name;
+				});
+				if (!exists)
+				{
+					entry current{};
+					current.name = name;
+					current.method = 8;
+					current.date = 0x21; // 1980-01-01
+					current.external_attributes = 0644u << 16;
+					current.replaced = &content;
+					current.size = content.size;
+					entries.emplace_back(std::move(current));
+				}
+			}
+			return true;
+		}
+
+	public:
+		explicit apk_writer(const utils::zip_source& source) : source_(source)
+		{
+		}
+
+		// new content for an entry, added at the end if the archive doesn't have it
+		void replace(const std::string& name, std::shared_ptr<const uint8_t> content, const size_t size)
+		{
+			replacements_[name] = replacement{std::move(content), size};
+		}
+
+		void remove(const std::string& name)
+		{
+			removed_.insert(name);
+		}
+
+		// false (see get_error) if the archive can't be read or the output written
+		bool write(const std::string& out_path)
+		{
+			slicer::Chronometer chrono(elapsed_ms_);
+			copied_ = deflated_ = 0;
+			written_ = 0;
+
+			size_t size = 0;
+			const auto mapping = source_.map(size);
+			std::vector<entry> entries{};
+			if (mapping == nullptr || !list_entries(mapping.get(), size, entries))
+			{
+				return fail("failed to read " + source_.name());
+			}
+			if (entries.size() >= 0xffff)
+			{
+				return fail("too many entries, zip64 isn't supported");
+			}
+			deflate(entries);
+
+			const auto out_file = fopen(out_path.c_str(), "wb");
+			if (out_file == nullptr)
+			{
+				return fail("failed to create " + out_path);
+			}
+			std::vector<char> buffer(4 * 1024 * 1024);
+			setvbuf(out_file, buffer.data(), _IOFBF, buffer.size());
+
+			auto is_written = true;
+			const auto write_bytes = [&](const void* bytes, const size_t count)
+			{
+				is_written = is_written && fwrite(bytes, 1, count, out_file) == count;
+				written_ += count;
+			};
+			std::vector<uint8_t> central_directory{};
+			for (auto& current : entries)
+			{
+				if (written_ + current.compressed_size + 0xffff >= 0xffffffff)
+				{
+					is_written = false;
+					error_ = "the output is over 4 GB, zip64 isn't supported";
+					break;
+				}
+				current.header_offset = written_;
+				const auto header = local_header(current, written_);
+				write_bytes(header.data(), header.size());
+				if (current.replaced == nullptr)
+				{
+					write_bytes(current.raw, current.compressed_size);
+					copied_++;
+				}
+				else if (current.method == 8)
+				{
+					for (const auto& chunk : current.chunks)
+					{
+						write_bytes(chunk.data(), chunk.size());
+					}
+					deflated_++;
+				}
+				else
+				{
+					write_bytes(current.replaced->content.get(), current.size);
+				}
+				central_header(central_directory, current);
+			}
+
+			const auto directory_offset = written_;
+			write_bytes(central_directory.data(), central_directory.size());
+			std::vector<uint8_t> end_record{};
+			put_u32(end_record, 0x06054b50);
+			put_u16(end_record, 0);
+			put_u16(end_record, 0);
+			put_u16(end_record, static_cast<uint16_t>(entries.size()));
+			put_u16(end_record, static_cast<uint16_t>(entries.size()));
+			put_u32(end_record, static_cast<uint32_t>(central_directory.size()));
+			put_u32(end_record, static_cast<uint32_t>(directory_offset));
+			put_u16(end_record, 0);
+			write_bytes(end_record.data(), end_record.size());
+
+			is_written = fclose(out_file) == 0 && is_written;
+			if (!is_written)
+			{
+				return fail(error_.empty() ? "failed to write " + out_path : error_);
+			}
+			return true;
+		}
+
+		const std::string& get_error() const
+		{
+			return error_;
+		}
+
+		// entries copied as they were compressed / replaced and deflated, by the last write
+		size_t copied_count() const
+		{
+			return copied_;
+		}
+
+		size_t deflated_count() const
+		{
+			return deflated_;
+		}
+
+		uint64_t written_size() const
+		{
+			return written_;
+		}
+
+		double get_elapsed_ms() const
+		{
+			return elapsed_ms_;
+		}
+	};
+} // namespace andromeda
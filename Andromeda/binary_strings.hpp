@@ -0,0 +1,319 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "utils.hpp"
+#include "thread_pool.hpp"
+
+#include "slicer/chronometer.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace andromeda
+{
+	// `strings`-like extractor for raw bytes: printable ASCII runs and UTF-16LE runs of printable ASCII units.
+	// The input can come in pieces (an inflater callback), the runs are carried over between them.
+	// The bytes are classified 16 at a time: blocks without any printable byte are skipped and
+	// blocks which are printable from end to end extend the current ASCII run, only the mixed ones go byte by byte.
+	class string_scanner
+	{
+		static constexpr size_t block_size = 16;
+		static constexpr size_t max_length = 4096; // longer runs are cut
+
+		size_t min_length_;
+		std::unordered_set<std::string>& found_;
+		std::string ascii_run_{};
+		std::string wide_run_[2]{}; // by parity of the unit offset
+		uint64_t offset_ = 0;
+		uint8_t previous_ = 0;
+
+		static bool is_printable(const uint8_t c)
+		{
+			return (c >= 0x20 && c < 0x7f) || c == '\t';
+		}
+
+		enum class block_kind { none, all, mixed };
+
+		static block_kind classify(const uint8_t* block)
+		{
+#if defined(__SSE2__)
+			const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+			// signed compares: 0x80-0xff are negative, so they fail the lower bound
+			const auto printable = _mm_or_si128(
+				_mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(0x1f)), _mm_cmplt_epi8(bytes, _mm_set1_epi8(0x7f))),
+				_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t')));
+			const auto mask = _mm_movemask_epi8(printable);
+			return mask == 0 ? block_kind::none : mask == 0xffff ? block_kind::all : block_kind::mixed;
+#elif defined(__ARM_NEON)
+			const auto bytes = vld1q_u8(block);
+			const auto printable = vorrq_u8(
+				vandq_u8(vcgtq_u8(bytes, vdupq_n_u8(0x1f)), vcltq_u8(bytes, vdupq_n_u8(0x7f))),
+				vceqq_u8(bytes, vdupq_n_u8('\t')));
+			return vmaxvq_u8(printable) == 0 ? block_kind::none : vminvq_u8(printable) != 0 ? block_kind::all : block_kind::mixed;
+#else
+			size_t count = 0;
+			for (size_t i = 0; i < block_size; i++)
+			{
+				count += is_printable(block[i]);
+			}
+			return count == 0 ? block_kind::none : count == block_size ? block_kind::all : block_kind::mixed;
+#endif
+		}
+
+		void flush(std::string& run)
+		{
+			if (run.size() >= min_length_)
+			{
+				found_.insert(run);
+			}
+			run.clear();
+		}
+
+		void append(std::string& run, const char c)
+		{
+			if (run.size() == max_length)
+			{
+				flush(run);
+			}
+			run += c;
+		}
+
+		void scan_byte(const uint8_t c)
+		{
+			if (is_printable(c))
+			{
+				append(ascii_run_, static_cast<char>(c));
+			}
+			else
+			{
+				flush(ascii_run_);
+			}
+
+			// the UTF-16 unit which started at the previous byte
+			if (offset_ != 0)
+			{
+				auto& wide_run = wide_run_[(offset_ - 1) & 1];
+				if (c == 0 && is_printable(previous_))
+				{
+					append(wide_run, static_cast<char>(previous_));
+				}
+				else
+				{
+					flush(wide_run);
+				}
+			}
+			previous_ = c;
+			offset_++;
+		}
+
+	public:
+		string_scanner(const size_t min_length, std::unordered_set<std::string>& found)
+			: min_length_(std::max<size_t>(min_length, 1)), found_(found)
+		{
+		}
+
+		void scan(const uint8_t* data, const size_t size)
+		{
+			size_t i = 0;
+			while (size - i >= block_size)
+			{
+				const auto idle = ascii_run_.empty() && wide_run_[0].empty() && wide_run_[1].empty() &&
+				                  !is_printable(previous_);
+				const auto kind = classify(data + i);
+				if (kind == block_kind::none && idle)
+				{
+					// nothing starts here, every unit needs a printable byte
+				}
+				else if (kind == block_kind::all && !ascii_run_.empty() && ascii_run_.size() + block_size <= max_length)
+				{
+					// no zero byte, so no UTF-16 unit ends in this block
+					flush(wide_run_[0]);
+					flush(wide_run_[1]);
+					ascii_run_.append(reinterpret_cast<const char*>(data + i), block_size);
+				}
+				else
+				{
+					for (size_t j = 0; j < block_size; j++)
+					{
+						scan_byte(data[i + j]);
+					}
+					i += block_size;
+					continue;
+				}
+				previous_ = data[i + block_size - 1];
+				offset_ += block_size;
+				i += block_size;
+			}
+			for (; i < size; i++)
+			{
+				scan_byte(data[i]);
+			}
+		}
+
+		// end of the input
+		void finish()
+		{
+			flush(ascii_run_);
+			flush(wide_run_[0]);
+			flush(wide_run_[1]);
+		}
+	};
+
+	// Printable strings of the native libraries (lib/) and the assets (assets/), inflated straight
+	// from the archive into the scanner, one entry per task on the worker pool. Like the res/ strings,
+	// the values are merged into one deduplicated pool which remembers the files they came from.
+	class binary_strings
+	{
+	public:
+		static constexpr size_t default_min_length = 6;
+
+	private:
+		utils::zip_source source_;
+		size_t min_length_;
+		bool collected_ = false;
+		double elapsed_ms_ = 0;
+
+		std::vector<std::string> files_{};
+		std::vector<std::string> strings_pool{};
+		std::vector<std::vector<uint32_t>> sources_{}; // indexes into files_, per string
+
+		static bool is_scanned(const std::string& file_name)
+		{
+			return utils::starts_with(file_name, "assets/") ||
+			       (utils::starts_with(file_name, "lib/") && utils::ends_with(file_name, ".so"));
+		}
+
+		static size_t scan_chunk(void* opaque, mz_uint64, const void* buffer, const size_t size)
+		{
+			static_cast<string_scanner*>(opaque)->scan(static_cast<const uint8_t*>(buffer), size);
+			return size;
+		}
+
+		void collect()
+		{
+			collected_ = true;
+			files_.clear();
+			strings_pool.clear();
+			sources_.clear();
+			slicer::Chronometer chrono(elapsed_ms_);
+
+			mz_zip_archive zip_archive;
+			if (!source_.open(zip_archive))
+			{
+				return;
+			}
+			std::vector<mz_uint> entries{};
+			const auto file_count = mz_zip_reader_get_num_files(&zip_archive);
+			for (mz_uint i = 0; i < file_count; i++)
+			{
+				mz_zip_archive_file_stat file_stat;
+				if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat) ||
+				    mz_zip_reader_is_file_a_directory(&zip_archive, i) || !is_scanned(file_stat.m_filename))
+				{
+					continue;
+				}
+				entries.emplace_back(i);
+				files_.emplace_back(file_stat.m_filename);
+			}
+			mz_zip_reader_end(&zip_archive);
+
+			auto& pool = worker_pool();
+			std::vector<std::unique_ptr<mz_zip_archive>> readers(pool.size());
+			std::vector<std::unordered_set<std::string>> values(entries.size());
+			pool.parallel_for(entries.size(), 1, [&](const size_t index, const size_t worker_index)
+			{
+				auto& reader = readers[worker_index];
+				if (reader == nullptr)
+				{
+					reader.reset(new mz_zip_archive);
+					if (!source_.open(*reader))
+					{
+						return;
+					}
+				}
+				if (reader->m_zip_mode != MZ_ZIP_MODE_READING)
+				{
+					return;
+				}
+
+				string_scanner scanner(min_length_, values[index]);
+				mz_zip_reader_extract_to_callback(reader.get(), entries[index], scan_chunk, &scanner, 0);
+				scanner.finish();
+			});
+			for (auto& reader : readers)
+			{
+				if (reader != nullptr && reader->m_zip_mode == MZ_ZIP_MODE_READING)
+				{
+					mz_zip_reader_end(reader.get());
+				}
+			}
+
+			std::unordered_map<std::string, uint32_t> string_ids{};
+			for (size_t file = 0; file < values.size(); file++)
+			{
+				// sets have no order, keep the output stable
+				std::vector<std::string> file_values(values[file].begin(), values[file].end());
+				std::sort(file_values.begin(), file_values.end());
+				for (auto& value : file_values)
+				{
+					const auto [found, inserted] = string_ids.emplace(value, static_cast<uint32_t>(strings_pool.size()));
+					if (inserted)
+					{
+						strings_pool.emplace_back(std::move(value));
+						sources_.emplace_back();
+					}
+					sources_[found->second].emplace_back(static_cast<uint32_t>(file));
+				}
+			}
+		}
+
+	public:
+		explicit binary_strings(const utils::zip_source& source, const size_t min_length = default_min_length)
+			: source_(source), min_length_(min_length)
+		{
+		}
+
+		size_t get_min_length() const
+		{
+			return min_length_;
+		}
+
+		// same interface as the dex strings
+		const std::vector<std::string>& get_strings()
+		{
+			if (!collected_)
+			{
+				collect();
+			}
+			return strings_pool;
+		}
+
+		// the files (indexes for get_file) the string "index" appears in
+		const std::vector<uint32_t>& get_sources(const size_t index)
+		{
+			get_strings();
+			return sources_[index];
+		}
+
+		const std::string& get_file(const uint32_t file_index) const
+		{
+			return files_[file_index];
+		}
+
+		size_t file_count()
+		{
+			get_strings();
+			return files_.size();
+		}
+
+		double get_elapsed_ms() const
+		{
+			return elapsed_ms_;
+		}
+	};
+} // namespace andromeda
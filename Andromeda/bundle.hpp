@@ -0,0 +1,417 @@
+#pragma once
+
+#include "utils.hpp"
+#include "thread_pool.hpp"
+#include "dex.hpp"
+
+#include "slicer/chronometer.h"
+
+namespace andromeda
+{
+	// an archive of the graph: the opened file or a zip nested in one of the archives
+	struct archive_node
+	{
+		utils::zip_source source{}; // named "outer.xapk!/base.apk!/assets/inner.apk"
+		std::string entry{}; // name in the parent archive, empty for the opened file
+		int parent = -1;
+		size_t depth = 0;
+		uint64_t size = 0;
+		size_t file_count = 0;
+		bool is_apk = false; // has an AndroidManifest.xml
+		bool has_dex = false;
+		bool is_skipped = false; // over the memory budget of the nested archives: no image, not walked
+		std::vector<size_t> children{};
+	};
+
+	// an APK of the app, the base or a split, with what was read from it
+	struct app_part
+	{
+		size_t node = 0;
+		std::string split{}; // empty for the base
+		std::shared_ptr<char> manifest_content{};
+		size_t manifest_size = 0;
+		std::shared_ptr<const uint8_t> resources_content{};
+		size_t resources_size = 0;
+		std::vector<parsed_dex> dexes{};
+		std::vector<std::string> files{};
+	};
+
+	// The archives inside an archive: XAPK / APKS / APKM bundles, APKs hidden in the assets of an APK ...
+	// The nested zips are inflated to memory and opened from there (nothing is written to the disk),
+	// one level of the graph at a time with one archive per task on the worker pool. Their images stay
+	// in memory with the graph, up to max_nested_total bytes given in archive order: the ones after it
+	// are recorded without their image.
+	// The APKs at the top of a bundle are one app, the base APK and its splits, also read in parallel.
+	class app_bundle
+	{
+	public:
+		static constexpr size_t max_depth = 4;
+		static constexpr uint64_t max_nested_size = uint64_t{1} << 30;
+		static constexpr uint64_t max_nested_total = uint64_t{2} << 30;
+
+	private:
+		// a nested archive found in a zip, inflated if it fits in the memory budget
+		struct nested_entry
+		{
+			mz_uint index = 0;
+			std::string file_name{};
+			uint64_t size = 0;
+			bool is_skipped = false;
+		};
+
+		std::vector<archive_node> nodes_{};
+		std::vector<app_part> parts_{}; // the base APK first
+		double elapsed_ms_ = 0;
+
+		static bool is_nested_archive(const std::string& file_name)
+		{
+			return utils::ends_with(file_name, ".apk") || utils::ends_with(file_name, ".apks") ||
+			       utils::ends_with(file_name, ".xapk") || utils::ends_with(file_name, ".apkm") ||
+			       utils::ends_with(file_name, ".zip") || utils::ends_with(file_name, ".jar");
+		}
+
+		static bool is_dex(const std::string& file_name)
+		{
+			return utils::starts_with(file_name, "classes") && utils::ends_with(file_name, ".dex") &&
+			       file_name.find('/') == std::string::npos;
+		}
+
+		// classes.dex, classes2.dex ... classes10.dex
+		static bool dex_order(const parsed_dex& left, const parsed_dex& right)
+		{
+			const auto left_name = left.get_dex_name();
+			const auto right_name = right.get_dex_name();
+			return left_name.size() != right_name.size() ? left_name.size() < right_name.size() : left_name < right_name;
+		}
+
+		template <typename T>
+		static std::shared_ptr<T> extract(mz_zip_archive& zip_archive, const mz_uint index, size_t& size)
+		{
+			const auto content = mz_zip_reader_extract_to_heap(&zip_archive, index, &size, 0);
+			if (content == nullptr)
+			{
+				return nullptr;
+			}
+			return std::shared_ptr<T>(static_cast<T*>(content), [](T* p)
+			{
+				mz_free(const_cast<void*>(static_cast<const void*>(p)));
+			});
+		}
+
+		void walk(const utils::zip_source& source)
+		{
+			nodes_.emplace_back();
+			nodes_[0].source = source;
+			if (source.in_memory())
+			{
+				size_t size = 0;
+				source.map(size);
+				nodes_[0].size = size;
+			}
+			else
+			{
+				std::error_code error{};
+				nodes_[0].size = fs::file_size(source.name(), error);
+			}
+
+			auto& pool = worker_pool();
+			uint64_t nested_total = 0;
+			std::vector<size_t> level{0};
+			while (!level.empty())
+			{
+				// the nested archives of each archive of the level
+				std::vector<std::vector<nested_entry>> entries(level.size());
+				pool.parallel_for(level.size(), 1, [&](const size_t index, size_t)
+				{
+					auto& node = nodes_[level[index]];
+					mz_zip_archive zip_archive;
+					if (!node.source.open(zip_archive))
+					{
+						return;
+					}
+					const auto file_count = mz_zip_reader_get_num_files(&zip_archive);
+					for (mz_uint i = 0; i < file_count; i++)
+					{
+						mz_zip_archive_file_stat file_stat;
+						if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat) || mz_zip_reader_is_file_a_directory(&zip_archive, i))
+						{
+							continue;
+						}
+						node.file_count++;
+						const std::string file_name{file_stat.m_filename};
+						node.is_apk = node.is_apk || file_name == "AndroidManifest.xml";
+						node.has_dex = node.has_dex || is_dex(file_name);
+						if (node.depth == max_depth || !is_nested_archive(file_name) || file_stat.m_uncomp_size > max_nested_size)
+						{
+							continue;
+						}
+						entries[index].push_back({i, file_name, file_stat.m_uncomp_size});
+					}
+					mz_zip_reader_end(&zip_archive);
+				});
+
+				// the budget in archive order, the same archives are skipped whatever the threads do
+				for (auto& node_entries : entries)
+				{
+					for (auto& entry : node_entries)
+					{
+						entry.is_skipped = nested_total + entry.size > max_nested_total;
+						nested_total += entry.is_skipped ? 0 : entry.size;
+					}
+				}
+
+				std::vector<std::vector<archive_node>> found(level.size());
+				std::vector<uint64_t> released(level.size(), 0); // the images which aren't zips
+				pool.parallel_for(level.size(), 1, [&](const size_t index, size_t)
+				{
+					if (entries[index].empty())
+					{
+						return;
+					}
+					const auto& node = nodes_[level[index]];
+					mz_zip_archive zip_archive;
+					if (!node.source.open(zip_archive))
+					{
+						return;
+					}
+					for (const auto& entry : entries[index])
+					{
+						archive_node child{};
+						child.entry = entry.file_name;
+						child.parent = static_cast<int>(level[index]);
+						child.depth = node.depth + 1;
+						child.size = entry.size;
+						if (entry.is_skipped)
+						{
+							child.is_skipped = true;
+							found[index].emplace_back(std::move(child));
+							continue;
+						}
+
+						size_t size = 0;
+						auto content = extract<const uint8_t>(zip_archive, entry.index, size);
+						if (content == nullptr)
+						{
+							released[index] += entry.size;
+							continue;
+						}
+						child.source = utils::zip_source(node.source.name() + "!/" + entry.file_name, std::move(content), size);
+						child.size = size;
+						// a .jar or .zip which is something else
+						mz_zip_archive nested;
+						if (child.source.open(nested))
+						{
+							mz_zip_reader_end(&nested);
+							found[index].emplace_back(std::move(child));
+						}
+						else
+						{
+							released[index] += entry.size;
+						}
+					}
+					mz_zip_reader_end(&zip_archive);
+				});
+
+				std::vector<size_t> next_level{};
+				for (size_t index = 0; index < found.size(); index++)
+				{
+					nested_total -= released[index];
+					for (auto& child : found[index])
+					{
+						nodes_[child.parent].children.emplace_back(nodes_.size());
+						if (!child.is_skipped)
+						{
+							next_level.emplace_back(nodes_.size());
+						}
+						nodes_.emplace_back(std::move(child));
+					}
+				}
+				level = std::move(next_level);
+			}
+		}
+
+		// "split_config.arm64_v8a.apk" -> "config.arm64_v8a"
+		static std::string split_name(const std::string& entry)
+		{
+			auto name = fs::path(entry).filename().string();
+			if (utils::starts_with(name, "split_"))
+			{
+				name = name.substr(6);
+			}
+			return utils::ends_with(name, ".apk") ? name.substr(0, name.size() - 4) : name;
+		}
+
+		// base.apk, or the APK with code which isn't named like a split
+		int find_base(const std::vector<size_t>& apks) const
+		{
+			for (const auto index : apks)
+			{
+				if (nodes_[index].entry == "base.apk")
+				{
+					return static_cast<int>(index);
+				}
+			}
+			for (const auto index : apks)
+			{
+				const auto name = fs::path(nodes_[index].entry).filename().string();
+				if (nodes_[index].has_dex && !utils::starts_with(name, "split_") && !utils::starts_with(name, "config."))
+				{
+					return static_cast<int>(index);
+				}
+			}
+			for (const auto index : apks)
+			{
+				if (nodes_[index].has_dex)
+				{
+					return static_cast<int>(index);
+				}
+			}
+			return -1;
+		}
+
+		void load_part(app_part& part, const bool is_base) const
+		{
+			const auto& node = nodes_[part.node];
+			mz_zip_archive zip_archive;
+			if (!node.source.open(zip_archive))
+			{
+				return;
+			}
+			// the dex files of a split keep the name of their APK
+			const auto dex_prefix = is_base ? std::string{} : node.entry + "!/";
+			const auto file_count = mz_zip_reader_get_num_files(&zip_archive);
+			for (mz_uint i = 0; i < file_count; i++)
+			{
+				mz_zip_archive_file_stat file_stat;
+				if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat) || mz_zip_reader_is_file_a_directory(&zip_archive, i))
+				{
+					continue;
+				}
+				const std::string file_name{file_stat.m_filename};
+				part.files.emplace_back(file_name);
+
+				size_t size = 0;
+				if (is_dex(file_name))
+				{
+					const auto content = extract<char>(zip_archive, i, size);
+					if (content != nullptr)
+					{
+						part.dexes.emplace_back(dex_prefix + file_name, content, size);
+					}
+				}
+				else if (is_base && file_name == "AndroidManifest.xml")
+				{
+					part.manifest_content = extract<char>(zip_archive, i, part.manifest_size);
+				}
+				else if (is_base && file_name == "resources.arsc")
+				{
+					part.resources_content = extract<const uint8_t>(zip_archive, i, part.resources_size);
+				}
+			}
+			mz_zip_reader_end(&zip_archive);
+			std::sort(part.dexes.begin(), part.dexes.end(), dex_order);
+		}
+
+	public:
+		explicit app_bundle(const utils::zip_source& source)
+		{
+			slicer::Chronometer chrono(elapsed_ms_);
+			walk(source);
+		}
+
+		// No copy/move semantics
+		app_bundle(const app_bundle&) = delete;
+		app_bundle& operator=(const app_bundle&) = delete;
+
+		static bool is_bundle_name(const std::string& path)
+		{
+			return utils::ends_with(path, ".xapk") || utils::ends_with(path, ".apks") ||
+			       utils::ends_with(path, ".apkm") || utils::ends_with(path, ".zip");
+		}
+
+		// reads the base APK and the splits of the opened file (itself the base when it is an APK),
+		// false if there is no base APK
+		bool load_app()
+		{
+			slicer::Chronometer chrono(elapsed_ms_, true);
+			parts_.clear();
+			std::vector<size_t> apks{};
+			if (nodes_[0].is_apk)
+			{
+				apks.emplace_back(0);
+			}
+			else
+			{
+				for (const auto child : nodes_[0].children)
+				{
+					if (nodes_[child].is_apk)
+					{
+						apks.emplace_back(child);
+					}
+				}
+			}
+			const auto base = find_base(apks);
+			if (base < 0)
+			{
+				return false;
+			}
+
+			parts_.resize(apks.size());
+			parts_[0].node = static_cast<size_t>(base);
+			size_t next = 1;
+			for (const auto index : apks)
+			{
+				if (index != static_cast<size_t>(base))
+				{
+					parts_[next].node = index;
+					parts_[next].split = split_name(nodes_[index].entry);
+					next++;
+				}
+			}
+			worker_pool().parallel_for(parts_.size(), 1, [this](const size_t index, size_t)
+			{
+				load_part(parts_[index], index == 0);
+			});
+			return true;
+		}
+
+		const std::vector<archive_node>& get_nodes() const
+		{
+			return nodes_;
+		}
+
+		const std::vector<app_part>& get_parts() const
+		{
+			return parts_;
+		}
+
+		// the archives of the app (base first), ex. for the native libraries of every split
+		std::vector<utils::zip_source> part_sources() const
+		{
+			std::vector<utils::zip_source> sources{};
+			for (const auto& part : parts_)
+			{
+				sources.emplace_back(nodes_[part.node].source);
+			}
+			return sources;
+		}
+
+		// the base / split name of an archive node, nullptr if it isn't a part of the app
+		const app_part* find_part(const size_t node) const
+		{
+			for (const auto& part : parts_)
+			{
+				if (part.node == node)
+				{
+					return &part;
+				}
+			}
+			return nullptr;
+		}
+
+		double get_elapsed_ms() const
+		{
+			return elapsed_ms_;
+		}
+	};
+} // namespace andromeda
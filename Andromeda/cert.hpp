@@ -1,123 +1,314 @@
 #pragma once
 
+#include <array>
+#include <map>
+
 #include "utils.hpp"
 
 // apt install libssl-dev
 #include <openssl/pkcs7.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
 #include <openssl/pem.h>
 #include <openssl/x509.h>
 
 namespace andromeda
 {
-    class certificate
-    {
-        bool is_cert = false;
-
-        std::shared_ptr<char> root_certificate{};
-        std::shared_ptr<char> creation_date{};
-        std::shared_ptr<char> revoke_date{};
-
-    public:
-        
-        bool is_certificate() const
-        {
-            return is_cert;
-        }
-        
-        explicit certificate(const std::string& cert_dir)
-        {
-            if (!fs::exists(cert_dir))
-            {
-                return;
-            }
-
-			for (auto& p : fs::directory_iterator(cert_dir))
-			{
-				const auto& file_path = p.path();
-				if (
-                    file_path.extension() == ".RSA" ||
-                    file_path.extension() == ".EC" ||
-                    file_path.extension() == ".DSA"
-                )
+	// what is needed to identify a signer, the X509 text is rendered only on demand
+	struct certificate_info
+	{
+		std::array<uint8_t, 20> sha1{};
+		std::array<uint8_t, 32> sha256{};
+		std::string subject{};
+		std::string issuer{};
+		std::string serial{}; // hex
+		std::string not_before{};
+		std::string not_after{};
+		std::vector<uint8_t> der{};
+
+		template <size_t Size>
+		static std::string hex(const std::array<uint8_t, Size>& bytes)
+		{
+			static const char digits[] = "0123456789abcdef";
+			std::string result(Size * 2, '0');
+			for (size_t i = 0; i < Size; i++)
+			{
+				result[i * 2] = digits[bytes[i] >> 4];
+				result[i * 2 + 1] = digits[bytes[i] & 0x0f];
+			}
+			return result;
+		}
+
+		std::string sha1_hex() const
+		{
+			return hex(sha1);
+		}
+
+		std::string sha256_hex() const
+		{
+			return hex(sha256);
+		}
+	};
+
+	// v1 (JAR) signature: the PKCS7 block of META-INF/*.RSA|*.EC|*.DSA, decoded straight from the archive
+	class certificate
+	{
+		bool is_cert = false;
+		std::string signature_file{};
+		std::vector<certificate_info> chain{}; // in PKCS7 order, the root is the last one
+
+		mutable std::string root_text{};
+
+		static bool is_signature_file(const std::string& file_name)
+		{
+			return utils::starts_with(file_name, "META-INF/") && file_name.find('/', 9) == std::string::npos &&
+			       (utils::ends_with(file_name, ".RSA") || utils::ends_with(file_name, ".EC") ||
+			        utils::ends_with(file_name, ".DSA"));
+		}
+
+		static std::string bio_string(BIO* bio)
+		{
+			char* data = nullptr;
+			const auto length = BIO_get_mem_data(bio, &data);
+			std::string result(data, length > 0 ? length : 0);
+			BIO_free(bio);
+			return result;
+		}
+
+		static std::string time_string(const ASN1_TIME* time)
+		{
+			const auto bio = BIO_new(BIO_s_mem());
+			ASN1_TIME_print(bio, time);
+			return bio_string(bio);
+		}
+
+		static certificate_info describe(X509* x509)
+		{
+			certificate_info info{};
+
+			const auto der_size = i2d_X509(x509, nullptr);
+			if (der_size > 0)
+			{
+				info.der.resize(der_size);
+				auto p = info.der.data();
+				i2d_X509(x509, &p);
+			}
+			EVP_Digest(info.der.data(), info.der.size(), info.sha1.data(), nullptr, EVP_sha1(), nullptr);
+			EVP_Digest(info.der.data(), info.der.size(), info.sha256.data(), nullptr, EVP_sha256(), nullptr);
+
+			char name[512]{};
+			X509_NAME_oneline(X509_get_subject_name(x509), name, sizeof(name));
+			info.subject = name;
+			X509_NAME_oneline(X509_get_issuer_name(x509), name, sizeof(name));
+			info.issuer = name;
+
+			const auto serial = ASN1_INTEGER_to_BN(X509_get_serialNumber(x509), nullptr);
+			if (serial != nullptr)
+			{
+				const auto serial_hex = BN_bn2hex(serial);
+				info.serial = serial_hex;
+				OPENSSL_free(serial_hex);
+				BN_free(serial);
+			}
+
+			info.not_before = time_string(X509_get0_notBefore(x509));
+			info.not_after = time_string(X509_get0_notAfter(x509));
+			return info;
+		}
+
+		bool parse(const uint8_t* data, const size_t size)
+		{
+			auto p = data;
+			const auto pkcs7 = d2i_PKCS7(nullptr, &p, static_cast<long>(size));
+			if (pkcs7 == nullptr)
+			{
+				return false;
+			}
+
+			STACK_OF(X509)* certs = nullptr;
+			const auto type = OBJ_obj2nid(pkcs7->type);
+			if (type == NID_pkcs7_signed)
+			{
+				certs = pkcs7->d.sign->cert;
+			}
+			else if (type == NID_pkcs7_signedAndEnveloped)
+			{
+				certs = pkcs7->d.signed_and_enveloped->cert;
+			}
+
+			const auto number_of_certs = certs != nullptr ? sk_X509_num(certs) : 0;
+			for (auto i = 0; i < number_of_certs; i++)
+			{
+				chain.emplace_back(describe(sk_X509_value(certs, i)));
+			}
+			PKCS7_free(pkcs7);
+			return !chain.empty();
+		}
+
+	public:
+
+		bool is_certificate() const
+		{
+			return is_cert;
+		}
+
+		explicit certificate(const utils::zip_source& source)
+		{
+			mz_zip_archive zip_archive;
+			if (!source.open(zip_archive))
+			{
+				return;
+			}
+
+			const auto file_count = mz_zip_reader_get_num_files(&zip_archive);
+			for (mz_uint i = 0; i < file_count && !is_cert; i++)
+			{
+				mz_zip_archive_file_stat file_stat;
+				if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat) || !is_signature_file(file_stat.m_filename))
 				{
-                    FILE *fp = nullptr;
-                    if (!(fp = fopen(file_path.string().c_str(), "rb")))
-                    {
-                        continue;
-                    }
-                    const auto pkcs7_certs = d2i_PKCS7_fp(fp, NULL);
-                    fclose(fp);
-
-                    const auto i = OBJ_obj2nid(pkcs7_certs->type);
-                    STACK_OF(X509) *certs;
-                    if(i == NID_pkcs7_signed) {
-                        certs = pkcs7_certs->d.sign->cert;
-                    } else if(i == NID_pkcs7_signedAndEnveloped) {
-                        certs = pkcs7_certs->d.signed_and_enveloped->cert;
-                    }
-
-                    const auto number_of_certs = sk_X509_num(certs);
-                    if (number_of_certs == 0)
-                    {
-                        return;
-                    }
-                    
-                    auto root_cert = sk_X509_value(certs, number_of_certs - 1);
-                    const auto end_date = X509_get_notAfter(root_cert);
-                    const auto start_date = X509_get_notBefore(root_cert);
-
-                    auto x509Bio = BIO_new(BIO_s_mem());
-                    X509_print(x509Bio, root_cert);
-                    auto buf_len = BIO_number_written(x509Bio);
-                    root_certificate = std::shared_ptr<char>{ new char[buf_len + 1]() };
-                    BIO_read(x509Bio, root_certificate.get(), buf_len + 1);
-                    BIO_free(x509Bio);
-
-                    auto start_bio = BIO_new(BIO_s_mem());
-                    ASN1_TIME_print(start_bio, start_date);
-                    buf_len = BIO_number_written(start_bio);
-                    creation_date = std::shared_ptr<char>{ new char[buf_len + 1]() };
-                    BIO_read(start_bio, creation_date.get(), buf_len + 1);
-                    BIO_free(start_bio);
-
-                    auto end_bio = BIO_new(BIO_s_mem());
-                    ASN1_TIME_print(end_bio, end_date);
-                    buf_len = BIO_number_written(end_bio);
-                    revoke_date = std::shared_ptr<char>{ new char[buf_len + 1]() };
-                    BIO_read(end_bio, revoke_date.get(), buf_len + 1);
-                    BIO_free(end_bio);
-
-                    X509_free(root_cert);
-                    PKCS7_free(pkcs7_certs);
-
-                    is_cert = true;
-                    break;
+					continue;
 				}
-			}
 
-        }
+				size_t size = 0;
+				const auto content = static_cast<uint8_t*>(mz_zip_reader_extract_to_heap(&zip_archive, i, &size, 0));
+				if (content == nullptr)
+				{
+					continue;
+				}
+				if (parse(content, size))
+				{
+					signature_file = file_stat.m_filename;
+					is_cert = true;
+				}
+				mz_free(content);
+			}
+			mz_zip_reader_end(&zip_archive);
+		}
 
-        certificate(const certificate&) = default;
+		certificate(const certificate&) = default;
 		certificate& operator=(const certificate&) = default;
-        
-        std::shared_ptr<char> get_certificate() const 
-        {
-            return root_certificate;
-        }
 
-        std::shared_ptr<char> get_creation_date() const
-        {
-            return creation_date;
-        }
+		const std::vector<certificate_info>& get_chain() const
+		{
+			return chain;
+		}
+
+		const certificate_info* get_root() const
+		{
+			return chain.empty() ? nullptr : &chain.back();
+		}
 
-        
-        std::shared_ptr<char> get_revoke_date() const
-        {
-            return revoke_date;
-        }
+		// ex. META-INF/CERT.RSA
+		const std::string& get_signature_file() const
+		{
+			return signature_file;
+		}
 
+		// X509_print of the root certificate
+		const std::string& get_certificate() const
+		{
+			if (root_text.empty() && is_cert)
+			{
+				auto p = chain.back().der.data();
+				const auto x509 = d2i_X509(nullptr, &p, static_cast<long>(chain.back().der.size()));
+				if (x509 != nullptr)
+				{
+					const auto bio = BIO_new(BIO_s_mem());
+					X509_print(bio, x509);
+					root_text = bio_string(bio);
+					X509_free(x509);
+				}
+			}
+			return root_text;
+		}
+
+		const std::string& get_creation_date() const
+		{
+			static const std::string none{};
+			return is_cert ? chain.back().not_before : none;
+		}
 
-    };
+		const std::string& get_revoke_date() const
+		{
+			static const std::string none{};
+			return is_cert ? chain.back().not_after : none;
+		}
+	};
 
-} // namespace: andomeda
\ No newline at end of file
+	// certificate SHA-256 fingerprint -> the APKs signed with it, to cluster samples by signer
+	class signer_index
+	{
+		struct signer_entry
+		{
+			std::string subject{};
+			std::vector<std::string> apks{};
+		};
+
+		std::map<std::string, signer_entry> signers_{};
+		std::vector<std::string> unsigned_{};
+
+	public:
+		// the apks of a signer keep the order they were added in
+		void add(const std::string& apk_path, const certificate& cert)
+		{
+			const auto root = cert.get_root();
+			if (root == nullptr)
+			{
+				unsigned_.emplace_back(apk_path);
+				return;
+			}
+			auto& entry = signers_[root->sha256_hex()];
+			if (entry.subject.empty())
+			{
+				entry.subject = root->subject;
+			}
+			entry.apks.emplace_back(apk_path);
+		}
+
+		// the APKs signed by "sha256_fingerprint", nullptr if there are none
+		const std::vector<std::string>* find(const std::string& sha256_fingerprint) const
+		{
+			std::string fingerprint{sha256_fingerprint};
+			std::transform(fingerprint.begin(), fingerprint.end(), fingerprint.begin(), tolower);
+			const auto found = signers_.find(fingerprint);
+			return found == signers_.end() ? nullptr : &found->second.apks;
+		}
+
+		size_t signer_count() const
+		{
+			return signers_.size();
+		}
+
+		void dump() const
+		{
+			// the biggest clusters first
+			std::vector<const std::pair<const std::string, signer_entry>*> sorted{};
+			for (const auto& signer : signers_)
+			{
+				sorted.emplace_back(&signer);
+			}
+			std::stable_sort(sorted.begin(), sorted.end(), [](const auto* left, const auto* right)
+			{
+				return left->second.apks.size() > right->second.apks.size();
+			});
+
+			for (const auto signer : sorted)
+			{
+				color::color_printf(color::FG_LIGHT_GREEN, "%s", signer->first.c_str());
+				color::color_printf(color::FG_DARK_GRAY, " (%zu) %s\n", signer->second.apks.size(), signer->second.subject.c_str());
+				for (const auto& apk : signer->second.apks)
+				{
+					printf("\t%s\n", apk.c_str());
+				}
+			}
+			if (!unsigned_.empty())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "No v1 certificate (%zu)\n", unsigned_.size());
+				for (const auto& apk : unsigned_)
+				{
+					printf("\t%s\n", apk.c_str());
+				}
+			}
+		}
+	};
+} // namespace: andomeda
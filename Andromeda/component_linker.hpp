@@ -0,0 +1,166 @@
+#pragma once
+
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "dex.hpp"
+#include "manifest.hpp"
+
+namespace andromeda
+{
+	// where a class is defined
+	struct class_location
+	{
+		static constexpr uint32_t not_found = 0xffffffff;
+
+		uint32_t dex = not_found; // index into the parsed dex files
+		uint32_t class_index = 0; // class definition index in that dex
+
+		bool found() const
+		{
+			return dex != not_found;
+		}
+	};
+
+	// a manifest component (or the Application class) matched with its code
+	struct linked_component
+	{
+		const char* kind = "";
+		std::string class_name{};
+		class_location location{};
+		std::string base_class{}; // first superclass which isn't in the APK, ex. Landroid/app/Activity;
+		std::vector<std::pair<std::string, std::string>> lifecycle_methods{}; // name, declaring class descriptor
+	};
+
+	// Maps the manifest components to their classes through one descriptor index over every dex file,
+	// then walks the superclasses defined in the APK to find the lifecycle callbacks they override.
+	class component_linker
+	{
+		static constexpr int max_class_depth = 64;
+
+		std::vector<parsed_dex>& dexes_;
+		std::unordered_map<std::string_view, class_location> classes_{};
+
+		static const std::vector<std::string>& lifecycle_names(const component_type type)
+		{
+			static const std::vector<std::string> activity{
+				"onCreate", "onStart", "onRestart", "onResume", "onPause", "onStop", "onDestroy",
+				"onNewIntent", "onActivityResult", "onSaveInstanceState", "onRestoreInstanceState"
+			};
+			static const std::vector<std::string> service{
+				"onCreate", "onStartCommand", "onStart", "onBind", "onUnbind", "onRebind", "onDestroy", "onHandleIntent"
+			};
+			static const std::vector<std::string> receiver{"onReceive"};
+			static const std::vector<std::string> provider{
+				"onCreate", "query", "insert", "update", "delete", "getType", "call", "openFile"
+			};
+
+			switch (type)
+			{
+			case component_type::service:
+				return service;
+			case component_type::receiver:
+				return receiver;
+			case component_type::provider:
+				return provider;
+			default:
+				return activity;
+			}
+		}
+
+		static const std::vector<std::string>& application_lifecycle_names()
+		{
+			static const std::vector<std::string> application{
+				"onCreate", "attachBaseContext", "onTerminate", "onLowMemory", "onConfigurationChanged"
+			};
+			return application;
+		}
+
+		void link_class(linked_component& linked, const std::vector<std::string>& names)
+		{
+			linked.location = find_class(parsed_dex::name_to_descriptor(linked.class_name));
+
+			std::unordered_set<std::string_view> seen{};
+			auto location = linked.location;
+			for (auto depth = 0; location.found() && depth < max_class_depth; depth++)
+			{
+				const auto ir_class = dexes_[location.dex].get_class_ir(location.class_index);
+				for (const auto methods : {&ir_class->virtual_methods, &ir_class->direct_methods})
+				{
+					for (const auto method : *methods)
+					{
+						const std::string_view name = method->decl->name->c_str();
+						if (std::find(names.begin(), names.end(), name) != names.end() && seen.insert(name).second)
+						{
+							linked.lifecycle_methods.emplace_back(name, ir_class->type->descriptor->c_str());
+						}
+					}
+				}
+
+				if (ir_class->super_class == nullptr)
+				{
+					break;
+				}
+				const auto super_descriptor = ir_class->super_class->descriptor->c_str();
+				location = find_class(super_descriptor);
+				if (!location.found())
+				{
+					linked.base_class = super_descriptor;
+				}
+			}
+		}
+
+	public:
+		explicit component_linker(std::vector<parsed_dex>& dexes) : dexes_(dexes)
+		{
+			// the first definition wins, like in a multidex class loader
+			for (size_t dex = 0; dex < dexes_.size(); dex++)
+			{
+				const auto count = dexes_[dex].class_count();
+				for (size_t index = 0; index < count; index++)
+				{
+					class_location location{};
+					location.dex = static_cast<uint32_t>(dex);
+					location.class_index = static_cast<uint32_t>(index);
+					classes_.emplace(dexes_[dex].get_class_descriptor(index), location);
+				}
+			}
+		}
+
+		// "Lcom/example/Foo;"
+		class_location find_class(const std::string_view& descriptor) const
+		{
+			const auto found = classes_.find(descriptor);
+			return found == classes_.end() ? class_location{} : found->second;
+		}
+
+		// the Application class (when there is one) followed by every component, in manifest order
+		std::vector<linked_component> link(const manifest& app_manifest)
+		{
+			std::vector<linked_component> linked{};
+
+			if (!app_manifest.get_application_class().empty())
+			{
+				linked_component application{};
+				application.kind = "application";
+				application.class_name = app_manifest.get_application_class();
+				link_class(application, application_lifecycle_names());
+				linked.emplace_back(std::move(application));
+			}
+
+			for (const auto& current : app_manifest.get_components())
+			{
+				linked_component component_class{};
+				component_class.kind = manifest::type_name(current.type);
+				// an alias runs the code of its target
+				component_class.class_name = app_manifest.str(
+					current.target != string_table::none ? current.target : current.name);
+				link_class(component_class, lifecycle_names(current.type));
+				linked.emplace_back(std::move(component_class));
+			}
+
+			return linked;
+		}
+	};
+} // namespace andromeda
@@ -1,19 +1,34 @@
 #pragma once
 
+#include <unordered_map>
+
 #include "utils.hpp"
+#include "output.hpp"
+#include "dex_patch.hpp"
+#include "thread_pool.hpp"
 
 // slicer
 #include "slicer/dex_format.h"
 #include "slicer/reader.h"
+#include "slicer/writer.h"
 #include "slicer/common.h"
 #include "slicer/code_ir.h"
 #include "slicer/dex_ir.h"
+#include "slicer/control_flow_graph.h"
+#include "slicer/instrumentation.h"
 
 
 #include "disassambler/dissassembler.h"
 
 namespace andromeda
 {
+	// the code IR of a method with its control flow graph (edges, dominators and loops)
+	struct method_cfg
+	{
+		std::unique_ptr<lir::CodeIr> code_ir;
+		std::unique_ptr<lir::ControlFlowGraph> cfg;
+	};
+
 	class parsed_dex
 	{
 		std::shared_ptr<char> dex_content_ = nullptr;
@@ -22,15 +37,8 @@ namespace andromeda
 		std::vector<std::pair<std::string, std::string>> dex_methods_; // class_path, function_name
 		std::vector<std::string> strings_pool; // thanks to Strings Constant Pool
 		std::string dex_name_;
-
-		static std::string name_to_descriptor(const std::string& name)
-		{
-			auto descriptor = name;
-			std::replace(descriptor.begin(), descriptor.end(), '.', '/');
-			descriptor = "L" + descriptor + ";";
-
-			return descriptor;
-		}
+		bool full_ir_created_ = false;
+		std::unordered_map<const ir::EncodedMethod*, std::shared_ptr<const method_cfg>> cfg_cache_;
 
 		static std::pair<std::string, std::string> split_method_path(const std::string& method_path)
 		{
@@ -48,6 +56,15 @@ namespace andromeda
 		}
 
 	public:
+		// "com.example.Foo" -> "Lcom/example/Foo;"
+		static std::string name_to_descriptor(const std::string& name)
+		{
+			auto descriptor = name;
+			std::replace(descriptor.begin(), descriptor.end(), '.', '/');
+			descriptor = "L" + descriptor + ";";
+
+			return descriptor;
+		}
 
 		explicit parsed_dex(const fs::path& dex_path)
 		{
@@ -61,6 +78,15 @@ namespace andromeda
 			// ctor
 		}
 
+		// a dex image which is already in memory, ex. a payload found inside another file
+		parsed_dex(const std::string& dex_name, const std::shared_ptr<char>& dex_content, const size_t size)
+			: dex_content_(dex_content), dex_name_(dex_name)
+		{
+			dex_reader_ = std::shared_ptr<dex::Reader>{
+				new dex::Reader((dex::u1*)(dex_content_.get()), size)
+			};
+		}
+
 		parsed_dex(const parsed_dex&) = default;
 		parsed_dex& operator=(const parsed_dex&) = default;
 
@@ -69,12 +95,49 @@ namespace andromeda
 			return dex_name_;
 		}
 
-		std::vector<std::string> get_strings()
+		// IR of every class in the dex file, created on first use
+		std::shared_ptr<ir::DexFile> get_full_ir()
+		{
+			if (!full_ir_created_)
+			{
+				dex_reader_->CreateFullIr();
+				full_ir_created_ = true;
+			}
+			return dex_reader_->GetIr();
+		}
+
+		size_t class_count() const
+		{
+			return dex_reader_->ClassDefs().size();
+		}
+
+		// descriptor of a class definition, points into the dex image
+		const char* get_class_descriptor(const size_t class_index) const
+		{
+			const auto& class_def = dex_reader_->ClassDefs()[class_index];
+			return dex_reader_->GetStringMUTF8(dex_reader_->TypeIds()[class_def.class_idx].descriptor_idx);
+		}
+
+		// IR of the classes created so far
+		std::shared_ptr<ir::DexFile> get_ir() const
+		{
+			return dex_reader_->GetIr();
+		}
+
+		// IR of a single class, created on first use
+		ir::Class* get_class_ir(const size_t class_index)
+		{
+			dex_reader_->CreateClassIr(static_cast<dex::u4>(class_index));
+			return dex_reader_->GetIr()->classes_map[static_cast<dex::u4>(class_index)];
+		}
+
+		const std::vector<std::string>& get_strings()
 		{
 			if (strings_pool.empty())
 			{
 				dex_reader_->CreateFullIr();
 				auto ir = dex_reader_->GetIr();
+				strings_pool.reserve(ir->strings.size());
 				for (const auto& s : ir->strings)
 				{
 					auto current_string = std::string { s->c_str() };
@@ -89,7 +152,7 @@ namespace andromeda
 			return strings_pool;
 		}
 
-		std::vector<std::string> get_classes()
+		const std::vector<std::string>& get_classes()
 		{
 			if (dex_classes_.empty())
 			{
@@ -106,17 +169,18 @@ namespace andromeda
 			return dex_classes_;
 		}
 
-		std::vector<std::pair<std::string, std::string>> get_methods()
+		const std::vector<std::pair<std::string, std::string>>& get_methods()
 		{
 			if (dex_methods_.empty())
 			{
 				dex_reader_->CreateFullIr();
 				auto dex_ir = dex_reader_->GetIr();
 
+				dex_methods_.reserve(dex_ir->methods.size());
 				for (auto& current_method : dex_ir->methods)
 				{
 					//printf("%s!%s!%s\n", current_method->parent->Decl().c_str(), current_method->name->c_str(), current_method->prototype->Signature().c_str());
-					dex_methods_.emplace_back(current_method->parent->Decl().c_str(), current_method->name->c_str());
+					dex_methods_.emplace_back(current_method->parent->Decl(), current_method->name->c_str());
 				}
 
 			}
@@ -156,17 +220,18 @@ namespace andromeda
 			// get_class_methods
 		}
 
-		bool dump_method(const std::string& method_path) const
+		// encoded methods matching "class.path.method_name"
+		std::vector<ir::EncodedMethod*> find_methods(const std::string& method_path) const
 		{
 			const auto [class_path, function_name] = split_method_path(method_path);
 
-			auto found = false;
+			std::vector<ir::EncodedMethod*> methods;
 			const auto class_descriptor = name_to_descriptor(class_path);
 			const auto class_index = dex_reader_->FindClassIndex(class_descriptor.c_str());
 			if (class_index == dex::kNoIndex)
 			{
 				// printf("Can not find a class: %s\n\t%s\n", class_descriptor.c_str(), dex_name.c_str());
-				return found;
+				return methods;
 			}
 
 			dex_reader_->CreateClassIr(class_index);
@@ -185,13 +250,272 @@ namespace andromeda
 				if (current_function_name != function_name)
 					continue;
 
-				found = true;
-				const auto type = DexDissasembler::CfgType::None;
-				DexDissasembler disasm(dex_ir, type);
-				disasm.DumpMethod(ir_method.get());
+				methods.emplace_back(ir_method.get());
+			}
+
+			return methods;
+		}
+
+		bool dump_method(const std::string& method_path,
+		                 const DexDissasembler::CfgType type = DexDissasembler::CfgType::None) const
+		{
+			const auto methods = find_methods(method_path);
+			for (auto ir_method : methods)
+			{
+				DexDissasembler disasm(dex_reader_->GetIr(), type, color::is_enabled());
+				disasm.DumpMethod(ir_method);
+			}
+
+			return !methods.empty();
+		}
+
+		// CFG of a method, built on first use and kept for the later queries
+		// (nullptr for the methods without code)
+		std::shared_ptr<const method_cfg> get_method_cfg(ir::EncodedMethod* ir_method)
+		{
+			const auto cached = cfg_cache_.find(ir_method);
+			if (cached != cfg_cache_.end())
+			{
+				return cached->second;
+			}
+
+			std::shared_ptr<method_cfg> result = nullptr;
+			if (ir_method->code != nullptr)
+			{
+				result = std::make_shared<method_cfg>();
+				result->code_ir.reset(new lir::CodeIr(ir_method, dex_reader_->GetIr()));
+				result->cfg.reset(new lir::ControlFlowGraph(result->code_ir.get(), false));
+				result->cfg->ComputeDominators();
+				result->cfg->FindLoops();
 			}
+			cfg_cache_.emplace(ir_method, result);
+			return result;
+		}
+
+		// listing of the method split in basic blocks, followed by the edges, dominators and loops
+		bool dump_cfg(const std::string& method_path)
+		{
+			const auto methods = find_methods(method_path);
+			for (auto ir_method : methods)
+			{
+				output::writer out;
+				out.color_printf(color::FG_LIGHT_GREEN, "%s.%s%s\n", ir_method->decl->parent->Decl().c_str(),
+				                 ir_method->decl->name->c_str(), ir_method->decl->prototype->Signature().c_str());
+
+				const auto method = get_method_cfg(ir_method);
+				if (method == nullptr)
+				{
+					out.color_printf(color::FG_DARK_GRAY, "\tno code\n");
+					continue;
+				}
 
-			return found;
+				const auto& cfg = *method->cfg;
+				std::string listing;
+				DexDissasembler disasm(dex_reader_->GetIr(), DexDissasembler::CfgType::Compact, color::is_enabled());
+				disasm.DumpCode(method->code_ir.get(), method->cfg.get(), listing);
+				out.write(listing);
+
+				size_t edges = 0;
+				for (const auto& block : cfg.basic_blocks)
+				{
+					edges += block.successors.size();
+				}
+				out.color_printf(color::FG_GREEN, "Blocks: %zu, edges: %zu, loops: %zu\n",
+				                 cfg.basic_blocks.size(), edges, cfg.loops.size());
+
+				for (size_t i = 0; i < cfg.basic_blocks.size(); i++)
+				{
+					const auto& block = cfg.basic_blocks[i];
+					out.printf("\tblock %d [0x%04x]", block.id, block.region.first->offset);
+					if (!cfg.IsReachable(static_cast<int>(i)))
+					{
+						out.color_printf(color::FG_LIGHT_RED, " unreachable");
+					}
+					out.printf(" ->");
+					for (const auto successor : block.successors)
+					{
+						out.printf(" %d", cfg.basic_blocks[successor].id);
+					}
+					out.printf(", preds:");
+					for (const auto predecessor : block.predecessors)
+					{
+						out.printf(" %d", cfg.basic_blocks[predecessor].id);
+					}
+					const auto idom = cfg.dominators[i];
+					if (idom >= 0)
+					{
+						out.printf(", idom: %d", cfg.basic_blocks[idom].id);
+					}
+					out.printf("\n");
+				}
+
+				for (const auto& loop : cfg.loops)
+				{
+					out.color_printf(color::FG_YELLOW, "\tloop, header block %d:", cfg.basic_blocks[loop.header].id);
+					for (const auto block : loop.blocks)
+					{
+						out.color_printf(color::FG_YELLOW, " %d", cfg.basic_blocks[block].id);
+					}
+					out.color_printf(color::FG_YELLOW, " (back edges from");
+					for (const auto block : loop.back_edges)
+					{
+						out.color_printf(color::FG_YELLOW, " %d", cfg.basic_blocks[block].id);
+					}
+					out.color_printf(color::FG_YELLOW, ")\n");
+				}
+			}
+
+			return !methods.empty();
+		}
+
+		// a new dex image from the IR, with the changes made to it (slicer's writer)
+		std::shared_ptr<const uint8_t> create_image(size_t& image_size)
+		{
+			struct heap_allocator : dex::Writer::Allocator
+			{
+				void* Allocate(const size_t size) override
+				{
+					return ::malloc(size);
+				}
+
+				void Free(void* ptr) override
+				{
+					::free(ptr);
+				}
+			};
+
+			heap_allocator allocator;
+			dex::Writer writer(get_full_ir());
+			const auto image = writer.CreateImage(&allocator, &image_size);
+			return std::shared_ptr<const uint8_t>(image, [](const uint8_t* p)
+			{
+				::free(const_cast<uint8_t*>(p));
+			});
+		}
+
+		// writes a new dex image from the IR to "file_path": patched from the original image when the
+		// changes allow it (see dex_patcher), else the full writer reserves the file once the layout is known,
+		// maps it and the worker threads copy the sections straight into it; "fallback" says why
+		bool write_image(const std::string& file_path, size_t& image_size, std::string& fallback, std::string& error)
+		{
+			const auto patched = patch_image(image_size, fallback);
+			if (patched != nullptr)
+			{
+				if (!utils::write_file(file_path, reinterpret_cast<const char*>(patched.get()), image_size))
+				{
+					error = "can't write " + file_path;
+					unlink(file_path.c_str());
+					return false;
+				}
+				return true;
+			}
+
+			struct mapped_file_allocator : dex::Writer::Allocator
+			{
+				int fd = -1;
+				size_t size = 0;
+				std::string error;
+
+				void* Allocate(const size_t alloc_size) override
+				{
+					// the blocks are reserved before the mapping (a sparse file running out of disk space
+					// would be a SIGBUS in the workers writing to it), they read as zeros: the writer
+					// doesn't clear them again
+					const auto reserve_error = posix_fallocate(fd, 0, alloc_size);
+					if (reserve_error != 0)
+					{
+						error = std::string("can't reserve the output file: ") + strerror(reserve_error);
+						return nullptr;
+					}
+					const auto mapping = mmap(nullptr, alloc_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+					if (mapping == MAP_FAILED)
+					{
+						error = std::string("can't map the output file: ") + strerror(errno);
+						return nullptr;
+					}
+					size = alloc_size;
+					return mapping;
+				}
+
+				void Free(void* ptr) override
+				{
+					munmap(ptr, size);
+				}
+			};
+
+			mapped_file_allocator allocator;
+			allocator.fd = open(file_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+			if (allocator.fd < 0)
+			{
+				error = "can't create " + file_path + ": " + strerror(errno);
+				return false;
+			}
+
+			dex::Writer writer(get_full_ir());
+			const auto image = writer.CreateImage(&allocator, &image_size, true, pool_for);
+			if (image != nullptr)
+			{
+				allocator.Free(image);
+			}
+			close(allocator.fd);
+			if (image == nullptr)
+			{
+				error = allocator.error.empty() ? "can't write the dex image" : allocator.error;
+				unlink(file_path.c_str());
+				return false;
+			}
+			return true;
+		}
+
+		// adds calls to "hook_class".onEntry/onExit (static, not in this dex) to every method matching
+		// "filter", across the worker threads; returns the number of instrumented methods
+		size_t trace_methods(const slicer::MethodFilter& filter, const std::string& hook_class, size_t& selected)
+		{
+			slicer::BatchInstrumenter instrumenter(get_full_ir(), [&hook_class](slicer::MethodInstrumenter* mi)
+			{
+				mi->AddTransformation<slicer::EntryHook>(ir::MethodId(hook_class.c_str(), "onEntry"));
+				mi->AddTransformation<slicer::ExitHook>(ir::MethodId(hook_class.c_str(), "onExit"));
+			});
+			const auto methods = instrumenter.SelectMethods(filter);
+			selected = methods.size();
+			const auto instrumented = instrumenter.InstrumentMethods(methods, pool_for);
+
+			// the cached code IRs are the code before the hooks
+			cfg_cache_.clear();
+			return instrumented;
+		}
+
+		// the original image with the changed methods of every class created in the IR (see dex_patcher),
+		// the classes which didn't change keep their code; nullptr when the changes need the full writer
+		std::shared_ptr<const uint8_t> patch_image(size_t& image_size, std::string& fallback)
+		{
+			const auto dex_ir = dex_reader_->GetIr();
+			std::vector<ir::Class*> classes{};
+			classes.reserve(dex_ir->classes_map.size());
+			for (const auto& [index, ir_class] : dex_ir->classes_map)
+			{
+				classes.emplace_back(ir_class);
+			}
+			dex_patcher patcher(reinterpret_cast<const dex::u1*>(dex_content_.get()), dex_reader_->Header()->file_size);
+			auto image = patcher.write(*dex_ir, classes, image_size);
+			fallback = image != nullptr ? std::string{} : patcher.get_error();
+			return image;
+		}
+
+		// a new dex image where only the changed methods are encoded again (see patch_image),
+		// or from the full IR when the changes can't be patched in, "fallback" says why
+		std::shared_ptr<const uint8_t> create_patched_image(size_t& image_size, std::string& fallback)
+		{
+			const auto image = patch_image(image_size, fallback);
+			return image != nullptr ? image : create_image(image_size);
+		}
+
+		// disassemble every method of the dex file into "out_file", returns the number of bytes written
+		size_t dump_all_methods(FILE* out_file) const
+		{
+			dex_reader_->CreateFullIr();
+			DexDissasembler disasm(dex_reader_->GetIr(), DexDissasembler::CfgType::None, false);
+			return disasm.DumpAllMethods(out_file);
 		}
 	};
 } // namespace andromeda
@@ -0,0 +1,857 @@
+#pragma once
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "slicer/dex_format.h"
+#include "slicer/dex_ir.h"
+#include "slicer/dex_leb128.h"
+#include "slicer/buffer.h"
+#include "slicer/chronometer.h"
+
+namespace andromeda
+{
+	// Writes a dex image from the original one and a few changed classes, without the full IR:
+	// the new code (and debug info) of the changed methods is appended to the code (and debug info)
+	// section, the class_data section is encoded again with the moved code offsets, and everything
+	// else is copied as it is. The sections after a grown one move, so every offset field of the
+	// image goes through a relocation table (old offset -> new offset, one anchor per move).
+	// The old code items of the changed methods stay in the image, unreferenced.
+	// Only possible when the index sections don't change: the IR must not have new strings, types,
+	// protos, fields, methods or classes, and the changed classes keep their fields and methods.
+	class dex_patcher
+	{
+		// map_item types which the slicer headers don't name
+		static constexpr dex::u2 call_site_id_item = 0x0007;
+		static constexpr dex::u2 method_handle_item = 0x0008;
+		static constexpr dex::u2 hiddenapi_class_data_item = 0xf000;
+
+		struct section
+		{
+			dex::u2 type = 0;
+			dex::u4 count = 0;
+			dex::u4 offset = 0;
+			dex::u4 end = 0; // start of the next section in the original image
+			dex::u4 used_end = 0; // end of the last item, for the sections which get new items
+			dex::u4 new_offset = 0;
+			dex::u4 new_size = 0;
+		};
+
+		// a changed class with what its original class_data says
+		struct class_patch
+		{
+			const ir::Class* ir_class = nullptr;
+			std::vector<dex::u4> code_offsets{}; // direct then virtual methods
+		};
+
+		// an appended code item and its appended debug info
+		struct new_code
+		{
+			dex::u4 code = 0; // in code_
+			dex::u4 debug = 0; // in debug_
+			bool has_debug = false;
+		};
+
+		const dex::u1* image_ = nullptr;
+		size_t size_ = 0;
+		const dex::Header* header_ = nullptr;
+		std::vector<section> sections_{};
+		std::vector<std::pair<dex::u4, dex::u4>> anchors_{};
+		std::unordered_map<dex::u4, class_patch> patches_{}; // by original class_data offset
+		std::unordered_map<const ir::EncodedMethod*, new_code> new_codes_{};
+		slicer::Buffer code_{};
+		slicer::Buffer debug_{};
+		slicer::Buffer class_data_{};
+		std::string error_{};
+		double elapsed_ms_ = 0;
+
+		template <typename T>
+		const T* at(const dex::u4 offset) const
+		{
+			return reinterpret_cast<const T*>(image_ + offset);
+		}
+
+		static const dex::u1* skip_handlers(const dex::u1* ptr)
+		{
+			const auto handlers_count = dex::ReadULeb128(&ptr);
+			for (dex::u4 i = 0; i < handlers_count; i++)
+			{
+				const auto catch_count = dex::ReadSLeb128(&ptr);
+				for (int catch_index = 0; catch_index < std::abs(catch_count); catch_index++)
+				{
+					dex::ReadULeb128(&ptr); // type_idx
+					dex::ReadULeb128(&ptr); // address
+				}
+				if (catch_count < 1)
+				{
+					dex::ReadULeb128(&ptr); // catch_all_addr
+				}
+			}
+			return ptr;
+		}
+
+		// the state machine of a debug_info_item, up to its DBG_END_SEQUENCE included
+		static const dex::u1* skip_debug_opcodes(const dex::u1* ptr)
+		{
+			dex::u1 opcode = 0;
+			while ((opcode = *ptr++) != dex::DBG_END_SEQUENCE)
+			{
+				switch (opcode)
+				{
+				case dex::DBG_ADVANCE_PC:
+				case dex::DBG_END_LOCAL:
+				case dex::DBG_RESTART_LOCAL:
+				case dex::DBG_SET_FILE:
+					dex::ReadULeb128(&ptr);
+					break;
+				case dex::DBG_ADVANCE_LINE:
+					dex::ReadSLeb128(&ptr);
+					break;
+				case dex::DBG_START_LOCAL: // register, name, type
+					for (auto i = 0; i < 3; i++)
+					{
+						dex::ReadULeb128(&ptr);
+					}
+					break;
+				case dex::DBG_START_LOCAL_EXTENDED: // register, name, type, signature
+					for (auto i = 0; i < 4; i++)
+					{
+						dex::ReadULeb128(&ptr);
+					}
+					break;
+				default:
+					break;
+				}
+			}
+			return ptr;
+		}
+
+		static dex::u4 code_item_size(const dex::u1* item)
+		{
+			const auto code = reinterpret_cast<const dex::Code*>(item);
+			auto end = reinterpret_cast<const dex::u1*>(code->insns + code->insns_size);
+			if (code->tries_size != 0)
+			{
+				end += (code->insns_size & 1) * sizeof(dex::u2);
+				end = skip_handlers(end + code->tries_size * sizeof(dex::TryBlock));
+			}
+			return static_cast<dex::u4>(end - item);
+		}
+
+		static dex::u4 debug_item_size(const dex::u1* item)
+		{
+			auto ptr = item;
+			dex::ReadULeb128(&ptr); // line_start
+			const auto parameters_size = dex::ReadULeb128(&ptr);
+			for (dex::u4 i = 0; i < parameters_size; i++)
+			{
+				dex::ReadULeb128(&ptr);
+			}
+			return static_cast<dex::u4>(skip_debug_opcodes(ptr) - item);
+		}
+
+		static dex::u4 align4(const dex::u4 value)
+		{
+			return (value + 3) & ~dex::u4{3};
+		}
+
+		bool fail(const std::string& error)
+		{
+			error_ = error;
+			return false;
+		}
+
+		bool read_map()
+		{
+			if (size_ < sizeof(dex::Header) || header_->file_size > size_ || header_->map_off == 0 ||
+			    header_->map_off % 4 != 0 || header_->map_off + sizeof(dex::u4) > header_->file_size)
+			{
+				return fail("invalid dex header");
+			}
+			const auto map_list = at<dex::MapList>(header_->map_off);
+			if (header_->map_off + sizeof(dex::u4) + uint64_t{map_list->size} * sizeof(dex::MapItem) > header_->file_size)
+			{
+				return fail("invalid map_list");
+			}
+			for (dex::u4 i = 0; i < map_list->size; i++)
+			{
+				const auto& item = map_list->list[i];
+				switch (item.type)
+				{
+				case dex::kHeaderItem: case dex::kStringIdItem: case dex::kTypeIdItem: case dex::kProtoIdItem:
+				case dex::kFieldIdItem: case dex::kMethodIdItem: case dex::kClassDefItem: case call_site_id_item:
+				case method_handle_item: case dex::kMapList: case dex::kTypeList: case dex::kAnnotationSetRefList:
+				case dex::kAnnotationSetItem: case dex::kClassDataItem: case dex::kCodeItem: case dex::kStringDataItem:
+				case dex::kDebugInfoItem: case dex::kAnnotationItem: case dex::kEncodedArrayItem:
+				case dex::kAnnotationsDirectoryItem: case hiddenapi_class_data_item:
+					break;
+				default:
+				{
+					// it may hold offsets which can't be relocated
+					char type[16]{};
+					snprintf(type, sizeof(type), "0x%04x", item.type);
+					return fail(std::string{"unknown map_list section type "} + type);
+				}
+				}
+				if (item.offset >= header_->file_size)
+				{
+					return fail("map_list section out of the image");
+				}
+				section current{};
+				current.type = item.type;
+				current.count = item.size;
+				current.offset = item.offset;
+				sections_.emplace_back(current);
+			}
+			std::sort(sections_.begin(), sections_.end(), [](const section& left, const section& right)
+			{
+				return left.offset < right.offset;
+			});
+			for (size_t i = 0; i < sections_.size(); i++)
+			{
+				sections_[i].end = i + 1 < sections_.size() ? sections_[i + 1].offset : header_->file_size;
+			}
+			return true;
+		}
+
+		section* find_section(const dex::u2 type)
+		{
+			for (auto& current : sections_)
+			{
+				if (current.type == type)
+				{
+					return &current;
+				}
+			}
+			return nullptr;
+		}
+
+		// every id node of the IR is the item with the same index in the image
+		bool check_ids(const ir::DexFile& dex_ir) const
+		{
+			const auto string_ids = at<dex::StringId>(header_->string_ids_off);
+			for (const auto& [index, ir_string] : dex_ir.strings_map)
+			{
+				if (index >= header_->string_ids_size ||
+				    ir_string->data.ptr<dex::u1>() != image_ + string_ids[index].string_data_off)
+				{
+					return false;
+				}
+			}
+			const auto type_ids = at<dex::TypeId>(header_->type_ids_off);
+			for (const auto& [index, ir_type] : dex_ir.types_map)
+			{
+				if (index >= header_->type_ids_size || ir_type->descriptor->orig_index != type_ids[index].descriptor_idx)
+				{
+					return false;
+				}
+			}
+			const auto proto_ids = at<dex::ProtoId>(header_->proto_ids_off);
+			for (const auto& [index, ir_proto] : dex_ir.protos_map)
+			{
+				if (index >= header_->proto_ids_size || ir_proto->shorty->orig_index != proto_ids[index].shorty_idx ||
+				    ir_proto->return_type->orig_index != proto_ids[index].return_type_idx)
+				{
+					return false;
+				}
+				const auto parameters_off = proto_ids[index].parameters_off;
+				const auto parameters = parameters_off != 0 ? at<dex::TypeList>(parameters_off) : nullptr;
+				const auto parameters_size = ir_proto->param_types != nullptr ? ir_proto->param_types->types.size() : 0;
+				if ((parameters != nullptr ? parameters->size : 0) != parameters_size)
+				{
+					return false;
+				}
+				for (size_t i = 0; i < parameters_size; i++)
+				{
+					if (ir_proto->param_types->types[i]->orig_index != parameters->list[i].type_idx)
+					{
+						return false;
+					}
+				}
+			}
+			const auto field_ids = at<dex::FieldId>(header_->field_ids_off);
+			for (const auto& [index, ir_field] : dex_ir.fields_map)
+			{
+				if (index >= header_->field_ids_size || ir_field->parent->orig_index != field_ids[index].class_idx ||
+				    ir_field->type->orig_index != field_ids[index].type_idx || ir_field->name->orig_index != field_ids[index].name_idx)
+				{
+					return false;
+				}
+			}
+			const auto method_ids = at<dex::MethodId>(header_->method_ids_off);
+			for (const auto& [index, ir_method] : dex_ir.methods_map)
+			{
+				if (index >= header_->method_ids_size || ir_method->parent->orig_index != method_ids[index].class_idx ||
+				    ir_method->prototype->orig_index != method_ids[index].proto_idx || ir_method->name->orig_index != method_ids[index].name_idx)
+				{
+					return false;
+				}
+			}
+			for (const auto& [index, ir_class] : dex_ir.classes_map)
+			{
+				if (index >= header_->class_defs_size || ir_class->orig_index != index)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// the methods of a changed class whose code isn't the original one anymore
+		bool add_class(const ir::DexFile& dex_ir, const ir::Class* ir_class)
+		{
+			const auto class_index = ir_class->orig_index;
+			const auto found = dex_ir.classes_map.find(class_index);
+			if (found == dex_ir.classes_map.end() || found->second != ir_class)
+			{
+				return fail("the class isn't from this dex image");
+			}
+			const auto class_data_off = at<dex::ClassDef>(header_->class_defs_off)[class_index].class_data_off;
+			const auto class_name = ir_class->type->descriptor->c_str();
+			if (patches_.count(class_data_off) != 0)
+			{
+				return true;
+			}
+			if (class_data_off == 0)
+			{
+				if (!ir_class->static_fields.empty() || !ir_class->instance_fields.empty() ||
+				    !ir_class->direct_methods.empty() || !ir_class->virtual_methods.empty())
+				{
+					return fail(std::string{"new members in "} + class_name);
+				}
+				return true;
+			}
+
+			auto ptr = image_ + class_data_off;
+			const auto static_fields_size = dex::ReadULeb128(&ptr);
+			const auto instance_fields_size = dex::ReadULeb128(&ptr);
+			const auto direct_methods_size = dex::ReadULeb128(&ptr);
+			const auto virtual_methods_size = dex::ReadULeb128(&ptr);
+			if (static_fields_size != ir_class->static_fields.size() || instance_fields_size != ir_class->instance_fields.size() ||
+			    direct_methods_size != ir_class->direct_methods.size() || virtual_methods_size != ir_class->virtual_methods.size())
+			{
+				return fail(std::string{"fields or methods added to "} + class_name);
+			}
+
+			const auto same_fields = [&ptr](const std::vector<ir::EncodedField*>& fields)
+			{
+				dex::u4 index = 0;
+				for (size_t i = 0; i < fields.size(); i++)
+				{
+					index = i == 0 ? dex::ReadULeb128(&ptr) : index + dex::ReadULeb128(&ptr);
+					dex::ReadULeb128(&ptr); // access_flags
+					if (fields[i]->decl->orig_index != index)
+					{
+						return false;
+					}
+				}
+				return true;
+			};
+			class_patch patch{};
+			patch.ir_class = ir_class;
+			const auto same_methods = [&ptr, &patch](const std::vector<ir::EncodedMethod*>& methods)
+			{
+				dex::u4 index = 0;
+				for (size_t i = 0; i < methods.size(); i++)
+				{
+					index = i == 0 ? dex::ReadULeb128(&ptr) : index + dex::ReadULeb128(&ptr);
+					dex::ReadULeb128(&ptr); // access_flags
+					patch.code_offsets.emplace_back(dex::ReadULeb128(&ptr));
+					if (methods[i]->decl->orig_index != index)
+					{
+						return false;
+					}
+				}
+				return true;
+			};
+			if (!same_fields(ir_class->static_fields) || !same_fields(ir_class->instance_fields) ||
+			    !same_methods(ir_class->direct_methods) || !same_methods(ir_class->virtual_methods))
+			{
+				return fail(std::string{"fields or methods replaced in "} + class_name);
+			}
+
+			size_t method_index = 0;
+			for (const auto methods : {&ir_class->direct_methods, &ir_class->virtual_methods})
+			{
+				for (const auto ir_method : *methods)
+				{
+					const auto code_off = patch.code_offsets[method_index++];
+					const auto ir_code = ir_method->code;
+					if (ir_code == nullptr)
+					{
+						if (code_off != 0)
+						{
+							return fail(std::string{"code removed from a method of "} + class_name);
+						}
+						continue;
+					}
+					// the reader points the instructions into the image, the assembler into a new buffer
+					if (code_off != 0 && ir_code->instructions.begin() == at<dex::Code>(code_off)->insns)
+					{
+						continue;
+					}
+					if (ir_code->instructions.empty())
+					{
+						return fail(std::string{"empty code in "} + class_name);
+					}
+					append_code(ir_method);
+				}
+			}
+			patches_[class_data_off] = std::move(patch);
+			return true;
+		}
+
+		// a code_item (and its debug_info_item) at the end of the new items,
+		// the indexes are the original ones: nothing to map
+		void append_code(const ir::EncodedMethod* ir_method)
+		{
+			const auto ir_code = ir_method->code;
+			new_code appended{};
+			const auto ir_debug_info = ir_code->debug_info;
+			if (ir_debug_info != nullptr)
+			{
+				appended.has_debug = true;
+				appended.debug = static_cast<dex::u4>(debug_.size());
+				debug_.PushULeb128(ir_debug_info->line_start);
+				debug_.PushULeb128(static_cast<dex::u4>(ir_debug_info->param_names.size()));
+				for (const auto ir_string : ir_debug_info->param_names)
+				{
+					debug_.PushULeb128(ir_string != nullptr ? ir_string->orig_index + 1 : 0);
+				}
+				const auto opcodes = ir_debug_info->data.ptr<dex::u1>();
+				debug_.Push(opcodes, skip_debug_opcodes(opcodes) - opcodes);
+			}
+
+			code_.Align(4);
+			appended.code = static_cast<dex::u4>(code_.size());
+			dex::Code dex_code{};
+			dex_code.registers_size = ir_code->registers;
+			dex_code.ins_size = ir_code->ins_count;
+			dex_code.outs_size = ir_code->outs_count;
+			dex_code.tries_size = static_cast<dex::u2>(ir_code->try_blocks.size());
+			dex_code.insns_size = static_cast<dex::u4>(ir_code->instructions.size());
+			code_.Push(&dex_code, offsetof(dex::Code, insns));
+			code_.Push(ir_code->instructions);
+			if (!ir_code->try_blocks.empty())
+			{
+				code_.Align(4);
+				code_.Push(ir_code->try_blocks);
+				const auto handlers = ir_code->catch_handlers.ptr<dex::u1>();
+				code_.Push(handlers, skip_handlers(handlers) - handlers);
+			}
+			new_codes_[ir_method] = appended;
+		}
+
+		void add_anchor(const dex::u4 offset, const dex::u4 new_offset)
+		{
+			if (anchors_.empty() || new_offset - offset != anchors_.back().second - anchors_.back().first)
+			{
+				anchors_.emplace_back(offset, new_offset);
+			}
+		}
+
+		dex::u4 relocate(const dex::u4 offset) const
+		{
+			if (offset == 0)
+			{
+				return 0;
+			}
+			auto anchor = std::upper_bound(anchors_.begin(), anchors_.end(), offset,
+			                               [](const dex::u4 value, const std::pair<dex::u4, dex::u4>& current)
+			                               {
+				                               return value < current.first;
+			                               });
+			--anchor;
+			return anchor->second + (offset - anchor->first);
+		}
+
+		// end of the last item of a section which gets new items at its end
+		bool find_used_end(section& current)
+		{
+			auto offset = current.offset;
+			for (dex::u4 i = 0; i < current.count; i++)
+			{
+				if (current.type == dex::kCodeItem)
+				{
+					offset = align4(offset);
+				}
+				if (offset >= current.end)
+				{
+					return fail("truncated section");
+				}
+				offset += current.type == dex::kCodeItem ? code_item_size(image_ + offset) : debug_item_size(image_ + offset);
+			}
+			if (offset > current.end)
+			{
+				return fail("truncated section");
+			}
+			current.used_end = offset;
+			return true;
+		}
+
+		void encode_index(const dex::u4 index, dex::u4& base_index)
+		{
+			class_data_.PushULeb128(base_index == dex::kNoIndex ? index : index - base_index);
+			base_index = index;
+		}
+
+		// every class_data_item again: the code offsets move with the sections before them,
+		// the changed classes point to their appended code
+		bool encode_class_data(const section& current, const section* code_section)
+		{
+			auto ptr = image_ + current.offset;
+			const auto end = image_ + current.end;
+			for (dex::u4 i = 0; i < current.count; i++)
+			{
+				if (ptr >= end)
+				{
+					return fail("truncated class_data section");
+				}
+				const auto offset = static_cast<dex::u4>(ptr - image_);
+				add_anchor(offset, current.new_offset + static_cast<dex::u4>(class_data_.size()));
+
+				dex::u4 sizes[4]{};
+				for (auto& size : sizes)
+				{
+					size = dex::ReadULeb128(&ptr);
+					class_data_.PushULeb128(size);
+				}
+				const auto patch = patches_.find(offset);
+				size_t method_index = 0;
+				for (size_t list = 0; list < 4; list++)
+				{
+					auto base_index = dex::kNoIndex;
+					for (dex::u4 member = 0; member < sizes[list]; member++)
+					{
+						const auto index_diff = dex::ReadULeb128(&ptr);
+						const auto access_flags = dex::ReadULeb128(&ptr);
+						const auto code_off = list >= 2 ? dex::ReadULeb128(&ptr) : 0;
+						if (patch == patches_.end())
+						{
+							class_data_.PushULeb128(index_diff);
+							class_data_.PushULeb128(access_flags);
+							if (list >= 2)
+							{
+								class_data_.PushULeb128(relocate(code_off));
+							}
+							continue;
+						}
+
+						const auto ir_class = patch->second.ir_class;
+						if (list < 2)
+						{
+							const auto ir_field = (list == 0 ? ir_class->static_fields : ir_class->instance_fields)[member];
+							encode_index(ir_field->decl->orig_index, base_index);
+							class_data_.PushULeb128(ir_field->access_flags);
+							continue;
+						}
+						const auto ir_method = (list == 2 ? ir_class->direct_methods : ir_class->virtual_methods)[member];
+						encode_index(ir_method->decl->orig_index, base_index);
+						class_data_.PushULeb128(ir_method->access_flags);
+						const auto appended = new_codes_.find(ir_method);
+						class_data_.PushULeb128(appended != new_codes_.end()
+							                        ? align4(code_section->new_offset + code_section->used_end - code_section->offset) + appended->second.code
+							                        : relocate(patch->second.code_offsets[method_index]));
+						method_index++;
+					}
+				}
+			}
+			return true;
+		}
+
+		// the new offset of each section, the same as the old one modulo 4 to keep every alignment
+		bool layout()
+		{
+			const auto code_section = find_section(dex::kCodeItem);
+			const auto debug_section = find_section(dex::kDebugInfoItem);
+			if (!new_codes_.empty() && code_section == nullptr)
+			{
+				return fail("no code section");
+			}
+			if (!debug_.empty() && debug_section == nullptr)
+			{
+				return fail("no debug_info section");
+			}
+			if (code_section != nullptr && !code_.empty() && !find_used_end(*code_section))
+			{
+				return false;
+			}
+			if (debug_section != nullptr && !debug_.empty() && !find_used_end(*debug_section))
+			{
+				return false;
+			}
+
+			uint64_t cursor = 0;
+			for (auto& current : sections_)
+			{
+				current.new_offset = static_cast<dex::u4>(cursor + ((current.offset - cursor) & 3));
+				add_anchor(current.offset, current.new_offset);
+				if (current.type == dex::kCodeItem && !code_.empty())
+				{
+					current.new_size = align4(current.used_end - current.offset) + static_cast<dex::u4>(code_.size());
+				}
+				else if (current.type == dex::kDebugInfoItem && !debug_.empty())
+				{
+					current.new_size = current.used_end - current.offset + static_cast<dex::u4>(debug_.size());
+				}
+				else if (current.type == dex::kClassDataItem)
+				{
+					if (code_section != nullptr && code_section->offset > current.offset)
+					{
+						// the code offsets in class_data would depend on the size of class_data
+						return fail("class_data section before the code section");
+					}
+					if (!encode_class_data(current, code_section))
+					{
+						return false;
+					}
+					current.new_size = static_cast<dex::u4>(class_data_.size());
+				}
+				else
+				{
+					current.new_size = current.end - current.offset;
+				}
+				cursor = uint64_t{current.new_offset} + current.new_size;
+				if (cursor > 0xffffffff)
+				{
+					return fail("the image is too big");
+				}
+			}
+			return true;
+		}
+
+		void copy_sections(dex::u1* out) const
+		{
+			dex::u4 cursor = 0;
+			for (const auto& current : sections_)
+			{
+				memset(out + cursor, 0, current.new_offset - cursor);
+				const auto target = out + current.new_offset;
+				if (current.type == dex::kCodeItem && !code_.empty())
+				{
+					const auto used = current.used_end - current.offset;
+					memcpy(target, image_ + current.offset, used);
+					memset(target + used, 0, align4(used) - used);
+					memcpy(target + align4(used), code_.data(), code_.size());
+				}
+				else if (current.type == dex::kDebugInfoItem && !debug_.empty())
+				{
+					const auto used = current.used_end - current.offset;
+					memcpy(target, image_ + current.offset, used);
+					memcpy(target + used, debug_.data(), debug_.size());
+				}
+				else if (current.type == dex::kClassDataItem)
+				{
+					if (!class_data_.empty())
+					{
+						memcpy(target, class_data_.data(), class_data_.size());
+					}
+				}
+				else
+				{
+					memcpy(target, image_ + current.offset, current.new_size);
+				}
+				cursor = current.new_offset + current.new_size;
+			}
+		}
+
+		// the offsets to other items, everywhere in the new image
+		void relocate_offsets(dex::u1* out, const dex::u4 out_size) const
+		{
+			const auto header = reinterpret_cast<dex::Header*>(out);
+			const auto& old_header = *header_;
+			for (const auto& current : sections_)
+			{
+				const auto base = out + current.new_offset;
+				switch (current.type)
+				{
+				case dex::kStringIdItem:
+					for (auto& string_id : slicer::ArrayView<dex::StringId>(reinterpret_cast<dex::StringId*>(base), current.count))
+					{
+						string_id.string_data_off = relocate(string_id.string_data_off);
+					}
+					break;
+				case dex::kProtoIdItem:
+					for (auto& proto_id : slicer::ArrayView<dex::ProtoId>(reinterpret_cast<dex::ProtoId*>(base), current.count))
+					{
+						proto_id.parameters_off = relocate(proto_id.parameters_off);
+					}
+					break;
+				case dex::kClassDefItem:
+					for (auto& class_def : slicer::ArrayView<dex::ClassDef>(reinterpret_cast<dex::ClassDef*>(base), current.count))
+					{
+						class_def.interfaces_off = relocate(class_def.interfaces_off);
+						class_def.annotations_off = relocate(class_def.annotations_off);
+						class_def.class_data_off = relocate(class_def.class_data_off);
+						class_def.static_values_off = relocate(class_def.static_values_off);
+					}
+					break;
+				case call_site_id_item:
+					for (auto& call_site_off : slicer::ArrayView<dex::u4>(reinterpret_cast<dex::u4*>(base), current.count))
+					{
+						call_site_off = relocate(call_site_off);
+					}
+					break;
+				case dex::kCodeItem:
+				{
+					dex::u4 offset = 0;
+					for (dex::u4 i = 0; i < current.count; i++)
+					{
+						offset = align4(offset);
+						const auto code = reinterpret_cast<dex::Code*>(base + offset);
+						code->debug_info_off = relocate(code->debug_info_off);
+						offset += code_item_size(base + offset);
+					}
+					if (code_.empty())
+					{
+						break;
+					}
+					const auto debug_section = std::find_if(sections_.begin(), sections_.end(), [](const section& s)
+					{
+						return s.type == dex::kDebugInfoItem;
+					});
+					const auto new_items = base + align4(current.used_end - current.offset);
+					for (const auto& [ir_method, appended] : new_codes_)
+					{
+						const auto code = reinterpret_cast<dex::Code*>(new_items + appended.code);
+						code->debug_info_off = appended.has_debug
+							                       ? debug_section->new_offset + debug_section->used_end - debug_section->offset + appended.debug
+							                       : 0;
+					}
+					break;
+				}
+				case dex::kAnnotationsDirectoryItem:
+				{
+					auto item = base;
+					for (dex::u4 i = 0; i < current.count; i++)
+					{
+						const auto directory = reinterpret_cast<dex::AnnotationsDirectoryItem*>(item);
+						directory->class_annotations_off = relocate(directory->class_annotations_off);
+						// field, method and parameter annotations are all (index, offset) pairs
+						const auto pairs = directory->fields_size + directory->methods_size + directory->parameters_size;
+						const auto entries = reinterpret_cast<dex::FieldAnnotationsItem*>(directory + 1);
+						for (dex::u4 entry = 0; entry < pairs; entry++)
+						{
+							entries[entry].annotations_off = relocate(entries[entry].annotations_off);
+						}
+						item = reinterpret_cast<dex::u1*>(entries + pairs);
+					}
+					break;
+				}
+				case dex::kAnnotationSetRefList:
+				case dex::kAnnotationSetItem:
+				{
+					// a size followed by offsets, for both
+					auto item = reinterpret_cast<dex::u4*>(base);
+					for (dex::u4 i = 0; i < current.count; i++)
+					{
+						const auto size = *item++;
+						for (dex::u4 entry = 0; entry < size; entry++, item++)
+						{
+							*item = relocate(*item);
+						}
+					}
+					break;
+				}
+				case dex::kMapList:
+				{
+					const auto map_list = reinterpret_cast<dex::MapList*>(base);
+					for (dex::u4 i = 0; i < map_list->size; i++)
+					{
+						auto& item = map_list->list[i];
+						item.offset = relocate(item.offset);
+						if (item.type == dex::kCodeItem || item.type == dex::kDebugInfoItem)
+						{
+							for (const auto& [ir_method, appended] : new_codes_)
+							{
+								item.size += item.type == dex::kCodeItem || appended.has_debug;
+							}
+						}
+					}
+					break;
+				}
+				default:
+					break;
+				}
+			}
+
+			header->file_size = out_size;
+			header->link_off = relocate(old_header.link_off);
+			header->map_off = relocate(old_header.map_off);
+			header->data_off = relocate(old_header.data_off);
+			const auto data_end = old_header.data_off + old_header.data_size;
+			header->data_size = (data_end >= old_header.file_size ? out_size : relocate(data_end)) - header->data_off;
+			// like slicer's writer: no SHA-1 signature, the checksum is enough to load the image
+			memset(header->signature, 0, sizeof(header->signature));
+			header->checksum = dex::ComputeChecksum(header);
+		}
+
+	public:
+		dex_patcher(const dex::u1* image, const size_t size)
+			: image_(image), size_(size), header_(reinterpret_cast<const dex::Header*>(image))
+		{
+		}
+
+		// No copy/move semantics
+		dex_patcher(const dex_patcher&) = delete;
+		dex_patcher& operator=(const dex_patcher&) = delete;
+
+		// the patched image (freed with free), nullptr and get_error() when the changes need the full writer
+		std::shared_ptr<const uint8_t> write(const ir::DexFile& dex_ir, const std::vector<ir::Class*>& classes, size_t& image_size)
+		{
+			slicer::Chronometer chrono(elapsed_ms_);
+			if (!read_map())
+			{
+				return nullptr;
+			}
+			if (!check_ids(dex_ir))
+			{
+				fail("new strings, types, protos, fields, methods or classes in the IR");
+				return nullptr;
+			}
+			for (const auto ir_class : classes)
+			{
+				if (!add_class(dex_ir, ir_class))
+				{
+					return nullptr;
+				}
+			}
+			if (!layout())
+			{
+				return nullptr;
+			}
+
+			const auto& last = sections_.back();
+			const auto out_size = last.new_offset + last.new_size;
+			const auto out = static_cast<dex::u1*>(::malloc(out_size));
+			if (out == nullptr)
+			{
+				fail("out of memory");
+				return nullptr;
+			}
+			copy_sections(out);
+			relocate_offsets(out, out_size);
+			image_size = out_size;
+			return std::shared_ptr<const uint8_t>(out, [](const uint8_t* p)
+			{
+				::free(const_cast<uint8_t*>(p));
+			});
+		}
+
+		const std::string& get_error() const
+		{
+			return error_;
+		}
+
+		// the methods with new code
+		size_t patched_count() const
+		{
+			return new_codes_.size();
+		}
+
+		double get_elapsed_ms() const
+		{
+			return elapsed_ms_;
+		}
+	};
+} // namespace andromeda
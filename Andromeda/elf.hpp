@@ -0,0 +1,466 @@
+#pragma once
+
+#include <cstring>
+#include <elf.h>
+
+#include "utils.hpp"
+
+namespace andromeda
+{
+	struct elf_symbol
+	{
+		std::string name{};
+		uint64_t value = 0;
+		uint64_t size = 0;
+		uint8_t type = STT_NOTYPE;
+		uint8_t binding = STB_LOCAL;
+		bool defined = false;
+	};
+
+	// Dynamic linking view of a shared object (ELF32/ELF64, little-endian): dynamic symbols,
+	// needed libraries and soname. Everything is copied out, the input buffer can go away after the parse.
+	// The symbols come from the .dynsym section, or from the dynamic segment when the section headers are stripped.
+	class elf_file
+	{
+		struct elf32
+		{
+			using ehdr = Elf32_Ehdr;
+			using phdr = Elf32_Phdr;
+			using shdr = Elf32_Shdr;
+			using sym = Elf32_Sym;
+			using dyn = Elf32_Dyn;
+			using addr = Elf32_Addr;
+
+			static uint8_t symbol_type(const sym& symbol)
+			{
+				return ELF32_ST_TYPE(symbol.st_info);
+			}
+
+			static uint8_t symbol_binding(const sym& symbol)
+			{
+				return ELF32_ST_BIND(symbol.st_info);
+			}
+		};
+
+		struct elf64
+		{
+			using ehdr = Elf64_Ehdr;
+			using phdr = Elf64_Phdr;
+			using shdr = Elf64_Shdr;
+			using sym = Elf64_Sym;
+			using dyn = Elf64_Dyn;
+			using addr = Elf64_Addr;
+
+			static uint8_t symbol_type(const sym& symbol)
+			{
+				return ELF64_ST_TYPE(symbol.st_info);
+			}
+
+			static uint8_t symbol_binding(const sym& symbol)
+			{
+				return ELF64_ST_BIND(symbol.st_info);
+			}
+		};
+
+		const uint8_t* data_ = nullptr;
+		size_t size_ = 0;
+
+		bool is_valid_ = false;
+		bool is_64_ = false;
+		uint16_t machine_ = EM_NONE;
+		std::string soname_{};
+		std::vector<std::string> needed_{};
+		std::vector<elf_symbol> symbols_{};
+
+		bool in_bounds(const uint64_t offset, const uint64_t length) const
+		{
+			return offset <= size_ && length <= size_ - offset;
+		}
+
+		// nullptr when out of bounds or misaligned (corrupted offsets)
+		template <typename T>
+		const T* at(const uint64_t offset) const
+		{
+			if (!in_bounds(offset, sizeof(T)) || reinterpret_cast<uintptr_t>(data_ + offset) % alignof(T) != 0)
+			{
+				return nullptr;
+			}
+			return reinterpret_cast<const T*>(data_ + offset);
+		}
+
+		// NUL terminated string inside [table, table + table_size)
+		std::string string_at(const uint64_t table, const uint64_t table_size, const uint64_t offset) const
+		{
+			if (offset >= table_size || !in_bounds(table, table_size))
+			{
+				return "";
+			}
+			const auto begin = reinterpret_cast<const char*>(data_ + table + offset);
+			return std::string(begin, strnlen(begin, table_size - offset));
+		}
+
+		// virtual address -> file offset through the PT_LOAD segments
+		template <typename Elf>
+		static bool to_offset(const std::vector<const typename Elf::phdr*>& loads, const uint64_t address, uint64_t& offset)
+		{
+			for (const auto load : loads)
+			{
+				if (address >= load->p_vaddr && address < load->p_vaddr + load->p_filesz)
+				{
+					offset = address - load->p_vaddr + load->p_offset;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// number of dynamic symbols from a DT_GNU_HASH table: past the highest bucket, follow its chain to the end
+		template <typename Elf>
+		uint64_t gnu_hash_symbol_count(const uint64_t offset) const
+		{
+			const auto header = at<uint32_t[4]>(offset);
+			if (header == nullptr)
+			{
+				return 0;
+			}
+			const auto bucket_count = (*header)[0];
+			const auto symbol_offset = (*header)[1];
+			const auto bloom_size = (*header)[2];
+			const auto buckets = offset + 16 + static_cast<uint64_t>(bloom_size) * sizeof(typename Elf::addr);
+			if (!in_bounds(buckets, static_cast<uint64_t>(bucket_count) * 4))
+			{
+				return 0;
+			}
+
+			uint32_t last_bucket = 0;
+			for (uint32_t i = 0; i < bucket_count; i++)
+			{
+				last_bucket = std::max(last_bucket, *at<uint32_t>(buckets + i * 4ull));
+			}
+			if (last_bucket < symbol_offset)
+			{
+				return symbol_offset;
+			}
+
+			const auto chains = buckets + bucket_count * 4ull;
+			for (uint64_t index = last_bucket;; index++)
+			{
+				const auto chain = at<uint32_t>(chains + (index - symbol_offset) * 4);
+				if (chain == nullptr)
+				{
+					return 0;
+				}
+				if (*chain & 1)
+				{
+					return index + 1;
+				}
+			}
+		}
+
+		template <typename Elf>
+		bool parse()
+		{
+			const auto header = at<typename Elf::ehdr>(0);
+			if (header == nullptr)
+			{
+				return false;
+			}
+			machine_ = header->e_machine;
+
+			std::vector<const typename Elf::phdr*> loads{};
+			const typename Elf::phdr* dynamic_segment = nullptr;
+			for (uint64_t i = 0; i < header->e_phnum; i++)
+			{
+				const auto segment = at<typename Elf::phdr>(header->e_phoff + i * header->e_phentsize);
+				if (segment == nullptr || header->e_phentsize < sizeof(typename Elf::phdr))
+				{
+					break;
+				}
+				if (segment->p_type == PT_LOAD)
+				{
+					loads.emplace_back(segment);
+				}
+				else if (segment->p_type == PT_DYNAMIC)
+				{
+					dynamic_segment = segment;
+				}
+			}
+
+			// dynamic segment: needed libraries, soname and the tables the loader uses
+			uint64_t string_table = 0, string_table_size = 0, symbol_table = 0, symbol_count = 0;
+			std::vector<uint64_t> needed_offsets{};
+			uint64_t soname_offset = UINT64_MAX;
+			if (dynamic_segment != nullptr && in_bounds(dynamic_segment->p_offset, dynamic_segment->p_filesz) &&
+			    at<typename Elf::dyn>(dynamic_segment->p_offset) != nullptr)
+			{
+				const auto count = dynamic_segment->p_filesz / sizeof(typename Elf::dyn);
+				const auto entries = at<typename Elf::dyn>(dynamic_segment->p_offset);
+				uint64_t hash_table = 0, gnu_hash_table = 0;
+				for (uint64_t i = 0; i < count && entries[i].d_tag != DT_NULL; i++)
+				{
+					const uint64_t value = entries[i].d_un.d_val;
+					switch (entries[i].d_tag)
+					{
+					case DT_NEEDED:
+						needed_offsets.emplace_back(value);
+						break;
+					case DT_SONAME:
+						soname_offset = value;
+						break;
+					case DT_STRTAB:
+						to_offset<Elf>(loads, value, string_table);
+						break;
+					case DT_STRSZ:
+						string_table_size = value;
+						break;
+					case DT_SYMTAB:
+						to_offset<Elf>(loads, value, symbol_table);
+						break;
+					case DT_HASH:
+						to_offset<Elf>(loads, value, hash_table);
+						break;
+					case DT_GNU_HASH:
+						to_offset<Elf>(loads, value, gnu_hash_table);
+						break;
+					default:
+						break;
+					}
+				}
+				if (hash_table != 0 && at<uint32_t[2]>(hash_table) != nullptr)
+				{
+					symbol_count = (*at<uint32_t[2]>(hash_table))[1]; // nchain
+				}
+				else if (gnu_hash_table != 0)
+				{
+					symbol_count = gnu_hash_symbol_count<Elf>(gnu_hash_table);
+				}
+			}
+
+			// prefer the section headers when they are there
+			if (header->e_shentsize >= sizeof(typename Elf::shdr))
+			{
+				for (uint64_t i = 0; i < header->e_shnum; i++)
+				{
+					const auto section = at<typename Elf::shdr>(header->e_shoff + i * header->e_shentsize);
+					if (section == nullptr)
+					{
+						break;
+					}
+					if (section->sh_type != SHT_DYNSYM)
+					{
+						continue;
+					}
+					const auto strings = at<typename Elf::shdr>(header->e_shoff + section->sh_link * header->e_shentsize);
+					if (strings != nullptr && section->sh_link < header->e_shnum)
+					{
+						symbol_table = section->sh_offset;
+						symbol_count = section->sh_size / sizeof(typename Elf::sym);
+						string_table = strings->sh_offset;
+						string_table_size = strings->sh_size;
+					}
+					break;
+				}
+			}
+
+			for (const auto offset : needed_offsets)
+			{
+				needed_.emplace_back(string_at(string_table, string_table_size, offset));
+			}
+			if (soname_offset != UINT64_MAX)
+			{
+				soname_ = string_at(string_table, string_table_size, soname_offset);
+			}
+
+			const auto symbols = at<typename Elf::sym>(symbol_table);
+			if (symbols == nullptr || !in_bounds(symbol_table, symbol_count * sizeof(typename Elf::sym)))
+			{
+				symbol_count = 0;
+			}
+			symbols_.reserve(symbol_count);
+			// the first entry is always the undefined symbol
+			for (uint64_t i = 1; i < symbol_count; i++)
+			{
+				elf_symbol symbol{};
+				symbol.name = string_at(string_table, string_table_size, symbols[i].st_name);
+				if (symbol.name.empty())
+				{
+					continue;
+				}
+				symbol.value = symbols[i].st_value;
+				symbol.size = symbols[i].st_size;
+				symbol.type = Elf::symbol_type(symbols[i]);
+				symbol.binding = Elf::symbol_binding(symbols[i]);
+				symbol.defined = symbols[i].st_shndx != SHN_UNDEF;
+				symbols_.emplace_back(std::move(symbol));
+			}
+			return true;
+		}
+
+	public:
+		elf_file(const uint8_t* data, const size_t size) : data_(data), size_(size)
+		{
+			if (size < EI_NIDENT || memcmp(data, ELFMAG, SELFMAG) != 0 || data[EI_DATA] != ELFDATA2LSB)
+			{
+				return;
+			}
+			is_64_ = data[EI_CLASS] == ELFCLASS64;
+			if (is_64_)
+			{
+				is_valid_ = parse<elf64>();
+			}
+			else if (data[EI_CLASS] == ELFCLASS32)
+			{
+				is_valid_ = parse<elf32>();
+			}
+			data_ = nullptr;
+			size_ = 0;
+		}
+
+		bool is_valid() const
+		{
+			return is_valid_;
+		}
+
+		bool is_64() const
+		{
+			return is_64_;
+		}
+
+		const char* machine_name() const
+		{
+			switch (machine_)
+			{
+			case EM_ARM:
+				return "ARM";
+			case EM_AARCH64:
+				return "AArch64";
+			case EM_386:
+				return "x86";
+			case EM_X86_64:
+				return "x86-64";
+			case EM_MIPS:
+				return "MIPS";
+			case EM_RISCV:
+				return "RISC-V";
+			default:
+				return "unknown";
+			}
+		}
+
+		const std::string& get_soname() const
+		{
+			return soname_;
+		}
+
+		const std::vector<std::string>& get_needed() const
+		{
+			return needed_;
+		}
+
+		const std::vector<elf_symbol>& get_symbols() const
+		{
+			return symbols_;
+		}
+
+		const elf_symbol* find_export(const std::string& name) const
+		{
+			for (const auto& symbol : symbols_)
+			{
+				if (symbol.defined && symbol.binding != STB_LOCAL && symbol.name == name)
+				{
+					return &symbol;
+				}
+			}
+			return nullptr;
+		}
+	};
+
+	// a statically bound native method, decoded from its exported symbol
+	struct jni_name
+	{
+		std::string class_descriptor{}; // Lcom/example/Foo;
+		std::string method_name{};
+		std::string parameters{}; // "(I[B)", only for the overloaded form "Java_..__<params>"
+	};
+
+	// Java_com_example_Foo_bar__I_3B -> Lcom/example/Foo; bar (I[B)
+	// _1 is '_', _2 ';', _3 '[' and _0xxxx an UTF-16 unit, a plain '_' is a package separator
+	inline bool decode_jni_name(const std::string& symbol, jni_name& decoded)
+	{
+		if (!utils::starts_with(symbol, "Java_"))
+		{
+			return false;
+		}
+
+		std::string name{};
+		std::string parameters{};
+		auto* current = &name;
+		for (size_t i = 5; i < symbol.size(); i++)
+		{
+			const auto c = symbol[i];
+			if (c != '_')
+			{
+				*current += c;
+				continue;
+			}
+			if (i + 1 >= symbol.size())
+			{
+				return false;
+			}
+			const auto escape = symbol[i + 1];
+			if (escape == '_')
+			{
+				// the overloaded form: mangled parameter descriptors follow
+				if (current == &parameters)
+				{
+					return false;
+				}
+				current = &parameters;
+				i++;
+			}
+			else if (escape == '1' || escape == '2' || escape == '3')
+			{
+				*current += escape == '1' ? '_' : escape == '2' ? ';' : '[';
+				i++;
+			}
+			else if (escape == '0')
+			{
+				if (i + 6 > symbol.size() || !std::all_of(symbol.begin() + i + 2, symbol.begin() + i + 6, isxdigit))
+				{
+					return false;
+				}
+				const auto unit = static_cast<uint32_t>(std::stoul(symbol.substr(i + 2, 4), nullptr, 16));
+				if (unit < 0x80)
+				{
+					*current += static_cast<char>(unit);
+				}
+				else if (unit < 0x800)
+				{
+					*current += static_cast<char>(0xc0 | unit >> 6);
+					*current += static_cast<char>(0x80 | (unit & 0x3f));
+				}
+				else
+				{
+					*current += static_cast<char>(0xe0 | unit >> 12);
+					*current += static_cast<char>(0x80 | (unit >> 6 & 0x3f));
+					*current += static_cast<char>(0x80 | (unit & 0x3f));
+				}
+				i += 5;
+			}
+			else
+			{
+				*current += '/';
+			}
+		}
+
+		const auto method = name.find_last_of('/');
+		if (method == std::string::npos || method == 0 || method + 1 == name.size())
+		{
+			return false;
+		}
+		decoded.class_descriptor = "L" + name.substr(0, method) + ";";
+		decoded.method_name = name.substr(method + 1);
+		decoded.parameters = current == &parameters ? "(" + parameters + ")" : "";
+		return true;
+	}
+} // namespace andromeda
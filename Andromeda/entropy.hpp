@@ -0,0 +1,344 @@
+#pragma once
+
+#include <cmath>
+
+#include "utils.hpp"
+#include "thread_pool.hpp"
+
+#include "slicer/chronometer.h"
+
+namespace andromeda
+{
+	// byte counts of a buffer; four interleaved tables so consecutive bytes don't wait on the same counter
+	struct byte_histogram
+	{
+		uint64_t counts[256]{};
+		uint64_t total = 0;
+
+		void add(const uint8_t* data, const size_t size)
+		{
+			// the 32-bit counters are flushed every 1 GB, before they can overflow
+			constexpr size_t max_run = size_t{1} << 30;
+			uint32_t tables[4][256]{};
+			for (size_t begin = 0; begin < size; begin += max_run)
+			{
+				const auto end = std::min(size, begin + max_run);
+				auto i = begin;
+				for (; i + 8 <= end; i += 8)
+				{
+					uint64_t word;
+					memcpy(&word, data + i, sizeof(word));
+					tables[0][word & 0xff]++;
+					tables[1][word >> 8 & 0xff]++;
+					tables[2][word >> 16 & 0xff]++;
+					tables[3][word >> 24 & 0xff]++;
+					tables[0][word >> 32 & 0xff]++;
+					tables[1][word >> 40 & 0xff]++;
+					tables[2][word >> 48 & 0xff]++;
+					tables[3][word >> 56]++;
+				}
+				for (; i < end; i++)
+				{
+					tables[0][data[i]]++;
+				}
+				for (size_t value = 0; value < 256; value++)
+				{
+					counts[value] += tables[0][value] + tables[1][value] + tables[2][value] + tables[3][value];
+					tables[0][value] = tables[1][value] = tables[2][value] = tables[3][value] = 0;
+				}
+			}
+			total += size;
+		}
+
+		void add(const byte_histogram& other)
+		{
+			for (size_t value = 0; value < 256; value++)
+			{
+				counts[value] += other.counts[value];
+			}
+			total += other.total;
+		}
+
+		// Shannon entropy in bits per byte, 0 - 8
+		double entropy() const
+		{
+			if (total == 0)
+			{
+				return 0;
+			}
+			double sum = 0;
+			for (const auto count : counts)
+			{
+				if (count != 0)
+				{
+					sum += static_cast<double>(count) * std::log2(static_cast<double>(count));
+				}
+			}
+			return std::log2(static_cast<double>(total)) - sum / static_cast<double>(total);
+		}
+	};
+
+	// entropy of one archive entry, and of its 8 KB windows (every 4 KB) when they were asked for
+	struct entry_entropy
+	{
+		std::string name{};
+		uint64_t size = 0;
+		double entropy = 0;
+		std::vector<float> windows{};
+		uint8_t header[8]{};
+	};
+
+	// Entropy of every archive entry, inflated in pieces straight into the histograms (nothing is
+	// extracted), one entry per task on the worker pool. Dex, native libraries and assets also get
+	// sliding window values, which show where the encrypted or compressed parts of a file are.
+	class entropy_scanner
+	{
+	public:
+		static constexpr size_t window_step = 4096;
+		static constexpr size_t window_size = window_step * 2;
+
+	private:
+		// streaming state of one entry
+		struct meter
+		{
+			entry_entropy& result;
+			const bool windowed;
+			byte_histogram whole{};
+			byte_histogram step{};
+			byte_histogram previous_step{};
+			size_t step_fill = 0;
+			uint64_t offset = 0;
+
+			static double window_entropy(const byte_histogram& first, const byte_histogram& second)
+			{
+				// counts of a window are at most window_size, so c * log2(c) comes from a table
+				static const std::vector<double> count_log = []
+				{
+					std::vector<double> table(window_size + 1, 0);
+					for (size_t count = 1; count <= window_size; count++)
+					{
+						table[count] = static_cast<double>(count) * std::log2(static_cast<double>(count));
+					}
+					return table;
+				}();
+				double sum = 0;
+				for (size_t value = 0; value < 256; value++)
+				{
+					sum += count_log[first.counts[value] + second.counts[value]];
+				}
+				const auto total = static_cast<double>(first.total + second.total);
+				return std::log2(total) - sum / total;
+			}
+
+			void add(const uint8_t* data, const size_t size)
+			{
+				for (size_t i = offset; i < sizeof(result.header) && i - offset < size; i++)
+				{
+					result.header[i] = data[i - offset];
+				}
+				offset += size;
+
+				if (!windowed)
+				{
+					whole.add(data, size);
+					return;
+				}
+				size_t i = 0;
+				while (i < size)
+				{
+					const auto take = std::min(size - i, window_step - step_fill);
+					step.add(data + i, take);
+					step_fill += take;
+					i += take;
+					if (step_fill == window_step)
+					{
+						if (previous_step.total != 0)
+						{
+							result.windows.emplace_back(static_cast<float>(window_entropy(previous_step, step)));
+						}
+						whole.add(step);
+						previous_step = step;
+						step = byte_histogram{};
+						step_fill = 0;
+					}
+				}
+			}
+
+			void finish()
+			{
+				whole.add(step);
+				result.size = whole.total;
+				result.entropy = whole.entropy();
+			}
+		};
+
+		utils::zip_source source_;
+		std::vector<entry_entropy> entries_{};
+		double elapsed_ms_ = 0;
+
+		static bool is_windowed(const std::string& file_name)
+		{
+			return utils::ends_with(file_name, ".dex") || utils::ends_with(file_name, ".so") ||
+			       utils::starts_with(file_name, "assets/");
+		}
+
+		static size_t add_chunk(void* opaque, mz_uint64, const void* buffer, const size_t size)
+		{
+			static_cast<meter*>(opaque)->add(static_cast<const uint8_t*>(buffer), size);
+			return size;
+		}
+
+	public:
+		explicit entropy_scanner(const utils::zip_source& source) : source_(source)
+		{
+		}
+
+		const std::vector<entry_entropy>& scan()
+		{
+			entries_.clear();
+			slicer::Chronometer chrono(elapsed_ms_);
+
+			mz_zip_archive zip_archive;
+			if (!source_.open(zip_archive))
+			{
+				return entries_;
+			}
+			std::vector<mz_uint> indexes{};
+			std::vector<uint64_t> sizes{};
+			const auto file_count = mz_zip_reader_get_num_files(&zip_archive);
+			for (mz_uint i = 0; i < file_count; i++)
+			{
+				mz_zip_archive_file_stat file_stat;
+				if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat) || mz_zip_reader_is_file_a_directory(&zip_archive, i))
+				{
+					continue;
+				}
+				indexes.emplace_back(i);
+				sizes.emplace_back(file_stat.m_uncomp_size);
+				entries_.emplace_back();
+				entries_.back().name = file_stat.m_filename;
+			}
+			mz_zip_reader_end(&zip_archive);
+
+			// the biggest entries first, so one of them doesn't end up alone at the end
+			std::vector<size_t> order(indexes.size());
+			for (size_t i = 0; i < order.size(); i++)
+			{
+				order[i] = i;
+			}
+			std::stable_sort(order.begin(), order.end(), [&sizes](const size_t left, const size_t right)
+			{
+				return sizes[left] > sizes[right];
+			});
+
+			auto& pool = worker_pool();
+			std::vector<std::unique_ptr<mz_zip_archive>> readers(pool.size());
+			pool.parallel_for(order.size(), 1, [&](const size_t task, const size_t worker_index)
+			{
+				const auto index = order[task];
+				auto& reader = readers[worker_index];
+				if (reader == nullptr)
+				{
+					reader.reset(new mz_zip_archive);
+					if (!source_.open(*reader))
+					{
+						return;
+					}
+				}
+				if (reader->m_zip_mode != MZ_ZIP_MODE_READING)
+				{
+					return;
+				}
+
+				meter current{entries_[index], is_windowed(entries_[index].name)};
+				mz_zip_reader_extract_to_callback(reader.get(), indexes[index], add_chunk, &current, 0);
+				current.finish();
+			});
+			for (auto& reader : readers)
+			{
+				if (reader != nullptr && reader->m_zip_mode == MZ_ZIP_MODE_READING)
+				{
+					mz_zip_reader_end(reader.get());
+				}
+			}
+			return entries_;
+		}
+
+		double get_elapsed_ms() const
+		{
+			return elapsed_ms_;
+		}
+
+		// formats which are compressed by design, their entropy says nothing
+		static bool is_compressed_format(const entry_entropy& entry)
+		{
+			const auto h = entry.header;
+			return (h[0] == 0x89 && h[1] == 'P' && h[2] == 'N' && h[3] == 'G') || // PNG
+			       (h[0] == 0xff && h[1] == 0xd8 && h[2] == 0xff) || // JPEG
+			       (h[0] == 'R' && h[1] == 'I' && h[2] == 'F' && h[3] == 'F') || // WebP, WAV
+			       (h[0] == 'G' && h[1] == 'I' && h[2] == 'F') ||
+			       (h[0] == 'P' && h[1] == 'K' && h[2] == 0x03 && h[3] == 0x04) ||
+			       (h[0] == 0x1f && h[1] == 0x8b) || // gzip
+			       (h[0] == 'O' && h[1] == 'g' && h[2] == 'g' && h[3] == 'S') ||
+			       (h[0] == 'I' && h[1] == 'D' && h[2] == '3') || // MP3
+			       (h[0] == 'f' && h[1] == 'L' && h[2] == 'a' && h[3] == 'C') ||
+			       (h[4] == 'f' && h[5] == 't' && h[6] == 'y' && h[7] == 'p') || // MP4
+			       (h[0] == 'w' && h[1] == 'O' && h[2] == 'F') || // WOFF
+			       (h[0] == 0x28 && h[1] == 0xb5 && h[2] == 0x2f && h[3] == 0xfd) || // zstd
+			       (h[0] == 0xfd && h[1] == '7' && h[2] == 'z' && h[3] == 'X') || // xz
+			       (h[0] == 'B' && h[1] == 'Z' && h[2] == 'h');
+		}
+
+		// packer / encryption hints from the entropy values
+		static std::vector<std::string> findings(const std::vector<entry_entropy>& entries)
+		{
+			constexpr double high_entropy = 7.5;
+			constexpr uint64_t min_blob_size = 64 * 1024;
+
+			std::vector<std::string> found{};
+			uint64_t dex_size = 0;
+			const entry_entropy* biggest_blob = nullptr;
+			char line[512]{};
+			for (const auto& entry : entries)
+			{
+				const auto is_dex = utils::ends_with(entry.name, ".dex") && entry.name.find('/') == std::string::npos;
+				if (is_dex)
+				{
+					dex_size += entry.size;
+				}
+				if (entry.entropy < high_entropy || entry.size < min_blob_size || is_compressed_format(entry))
+				{
+					continue;
+				}
+
+				if (is_dex)
+				{
+					snprintf(line, sizeof(line), "%s: dex with an entropy of %.2f, encrypted or obfuscated?", entry.name.c_str(), entry.entropy);
+				}
+				else if (utils::ends_with(entry.name, ".so"))
+				{
+					snprintf(line, sizeof(line), "%s: packed native library? (entropy %.2f)", entry.name.c_str(), entry.entropy);
+				}
+				else
+				{
+					snprintf(line, sizeof(line), "%s: high entropy data (%.2f), encrypted payload?", entry.name.c_str(), entry.entropy);
+					if (biggest_blob == nullptr || entry.size > biggest_blob->size)
+					{
+						biggest_blob = &entry;
+					}
+				}
+				found.emplace_back(line);
+			}
+
+			// a small loader dex which decrypts the real code at runtime
+			if (biggest_blob != nullptr && dex_size != 0 && biggest_blob->size >= dex_size * 4)
+			{
+				snprintf(line, sizeof(line), "packer? the dex files are %llu bytes, %s is %llu bytes of encrypted-looking data",
+				         static_cast<unsigned long long>(dex_size), biggest_blob->name.c_str(),
+				         static_cast<unsigned long long>(biggest_blob->size));
+				found.emplace_back(line);
+			}
+			return found;
+		}
+	};
+} // namespace andromeda
@@ -1,189 +1,681 @@
 #pragma once
 
+#include <deque>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <algorithm>
+#include <unordered_map>
 
 #include "color/color.hpp"
 #include "pugixml/pugixml.hpp"
 
 namespace andromeda
 {
+	// every distinct string is stored once and referred to by its id, id 0 is the empty string
+	class string_table
+	{
+		std::deque<std::string> strings_{};
+		std::unordered_map<std::string_view, uint32_t> ids_{};
+
+	public:
+		static constexpr uint32_t none = 0;
+
+		string_table()
+		{
+			intern("");
+		}
+
+		// No copy/move semantics (the index points into the strings)
+		string_table(const string_table&) = delete;
+		string_table& operator=(const string_table&) = delete;
+
+		uint32_t intern(const std::string_view& str)
+		{
+			const auto found = ids_.find(str);
+			if (found != ids_.end())
+			{
+				return found->second;
+			}
+			const auto id = static_cast<uint32_t>(strings_.size());
+			strings_.emplace_back(str);
+			ids_.emplace(strings_.back(), id);
+			return id;
+		}
+
+		// none if the string was never interned
+		uint32_t find(const std::string_view& str) const
+		{
+			const auto found = ids_.find(str);
+			return found == ids_.end() ? none : found->second;
+		}
+
+		const std::string& get(const uint32_t id) const
+		{
+			return strings_[id];
+		}
+
+		size_t size() const
+		{
+			return strings_.size();
+		}
+	};
+
+	enum class component_type
+	{
+		activity,
+		activity_alias,
+		service,
+		receiver,
+		provider
+	};
+
+	// one <intent-filter>, as string ids
+	struct intent_filter
+	{
+		std::vector<uint32_t> actions{};
+		std::vector<uint32_t> categories{};
+		std::vector<uint32_t> schemes{};
+		std::vector<uint32_t> hosts{};
+	};
+
+	struct component
+	{
+		component_type type = component_type::activity;
+		uint32_t name = string_table::none; // fully qualified class name
+		uint32_t target = string_table::none; // android:targetActivity of an alias
+		uint32_t permission = string_table::none;
+		uint32_t authorities = string_table::none; // providers
+		int exported = -1; // android:exported, -1 when not set
+		std::vector<intent_filter> filters{};
+
+		// without android:exported, a component with an intent-filter is exported (until Android 12)
+		bool is_exported() const
+		{
+			return exported < 0 ? !filters.empty() : exported != 0;
+		}
+	};
+
 	class manifest
 	{
+	public:
+		enum class parse_mode
+		{
+			streaming, // one pass over the binary XML events, no DOM
+			dom        // pugixml document built from the events
+		};
+
+	private:
 		std::string application_class_name_{};
 
-		enum class intent_target
+		string_table strings_{};
+		std::vector<component> components_{};
+		// string id -> indexes of the components declaring it in an intent-filter
+		std::unordered_map<uint32_t, std::vector<uint32_t>> by_action_{};
+		std::unordered_map<uint32_t, std::vector<uint32_t>> by_category_{};
+		std::unordered_map<uint32_t, std::vector<uint32_t>> by_scheme_{};
+
+		// Turns start/end tags into the model, shared by the streaming and the DOM paths.
+		// Only the first <manifest> and its first <application> are used, like the platform does.
+		// "attribute(android, name, value)" looks up the first "android:<name>" (or "<name>") attribute.
+		class model_builder
 		{
-			activity,
-			service,
-			receiver
+			manifest& owner_;
+			bool manifest_seen_ = false;
+			bool application_seen_ = false;
+			bool in_manifest_ = false;
+			bool in_application_ = false;
+			bool in_component_ = false;
+			bool in_filter_ = false;
+			component component_{};
+
+			static bool component_tag(const char* tag, component_type& type)
+			{
+				static const std::pair<const char*, component_type> tags[] = {
+					{"activity", component_type::activity},
+					{"activity-alias", component_type::activity_alias},
+					{"service", component_type::service},
+					{"receiver", component_type::receiver},
+					{"provider", component_type::provider},
+				};
+				for (const auto& [name, current] : tags)
+				{
+					if (strcmp(tag, name) == 0)
+					{
+						type = current;
+						return true;
+					}
+				}
+				return false;
+			}
+
+		public:
+			explicit model_builder(manifest& owner) : owner_(owner)
+			{
+			}
+
+			// "tag" is empty for prefixed tags, they never match
+			template <typename Attribute>
+			void start_tag(const int depth, const char* tag, const Attribute& attribute)
+			{
+				std::string value{};
+				const auto android_attribute = [&](const char* name)
+				{
+					value.clear();
+					attribute(true, name, value);
+					return value;
+				};
+
+				if (depth == 0)
+				{
+					if (!manifest_seen_ && strcmp(tag, "manifest") == 0)
+					{
+						manifest_seen_ = in_manifest_ = true;
+						attribute(false, "package", owner_.manifest_package);
+					}
+				}
+				else if (depth == 1 && in_manifest_)
+				{
+					if (strcmp(tag, "uses-permission") == 0)
+					{
+						owner_.permissions.emplace_back(android_attribute("name"));
+					}
+					else if (!application_seen_ && strcmp(tag, "application") == 0)
+					{
+						application_seen_ = in_application_ = true;
+						owner_.debuggable = android_attribute("debuggable") == "true";
+						owner_.application_class_name_ = owner_.class_name(android_attribute("name"));
+					}
+				}
+				else if (depth == 2 && in_application_)
+				{
+					component_ = {};
+					in_component_ = component_tag(tag, component_.type);
+					if (in_component_)
+					{
+						auto& strings = owner_.strings_;
+						component_.name = strings.intern(owner_.class_name(android_attribute("name")));
+						component_.target = strings.intern(owner_.class_name(android_attribute("targetActivity")));
+						component_.permission = strings.intern(android_attribute("permission"));
+						component_.authorities = strings.intern(android_attribute("authorities"));
+						if (attribute(true, "exported", value) && (value == "true" || value == "false"))
+						{
+							component_.exported = value == "true";
+						}
+					}
+				}
+				else if (depth == 3 && in_component_)
+				{
+					if (strcmp(tag, "intent-filter") == 0)
+					{
+						in_filter_ = true;
+						component_.filters.emplace_back();
+					}
+				}
+				else if (depth == 4 && in_filter_)
+				{
+					auto& strings = owner_.strings_;
+					auto& filter = component_.filters.back();
+					if (strcmp(tag, "action") == 0)
+					{
+						filter.actions.emplace_back(strings.intern(android_attribute("name")));
+					}
+					else if (strcmp(tag, "category") == 0)
+					{
+						filter.categories.emplace_back(strings.intern(android_attribute("name")));
+					}
+					else if (strcmp(tag, "data") == 0)
+					{
+						if (attribute(true, "scheme", value))
+						{
+							filter.schemes.emplace_back(strings.intern(value));
+						}
+						if (attribute(true, "host", value))
+						{
+							filter.hosts.emplace_back(strings.intern(value));
+						}
+					}
+				}
+			}
+
+			// "depth" of the closed tag
+			void end_tag(const int depth)
+			{
+				if (depth == 0)
+				{
+					in_manifest_ = false;
+				}
+				else if (depth == 1)
+				{
+					in_application_ = false;
+				}
+				else if (depth == 2 && in_component_)
+				{
+					in_component_ = false;
+					owner_.add_component(std::move(component_));
+				}
+				else if (depth == 3)
+				{
+					in_filter_ = false;
+				}
+			}
 		};
 
-		void dump_intents(const intent_target type)
+		// ".Foo" and "Foo" are relative to the package
+		std::string class_name(const std::string& name) const
 		{
-			auto ptr_target = &activities;
-			switch (type)
+			if (name.empty() || manifest_package.empty())
 			{
-			case intent_target::service:
-				ptr_target = &services;
-				break;
+				return name;
+			}
+			if (name[0] == '.')
+			{
+				return manifest_package + name;
+			}
+			if (name.find('.') == std::string::npos)
+			{
+				return manifest_package + '.' + name;
+			}
+			return name;
+		}
 
-			case intent_target::receiver:
-				ptr_target = &receivers;
+		static void index_component(std::unordered_map<uint32_t, std::vector<uint32_t>>& index,
+		                            const std::vector<uint32_t>& ids, const uint32_t component_index)
+		{
+			for (const auto id : ids)
+			{
+				auto& components = index[id];
+				if (components.empty() || components.back() != component_index)
+				{
+					components.emplace_back(component_index);
+				}
+			}
+		}
+
+		void add_component(component&& current)
+		{
+			const auto index = static_cast<uint32_t>(components_.size());
+			for (const auto& filter : current.filters)
+			{
+				index_component(by_action_, filter.actions, index);
+				index_component(by_category_, filter.categories, index);
+				index_component(by_scheme_, filter.schemes, index);
+			}
+			components_.emplace_back(std::move(current));
+		}
+
+		static const std::vector<uint32_t>& find_in(const std::unordered_map<uint32_t, std::vector<uint32_t>>& index,
+		                                            const uint32_t id)
+		{
+			static const std::vector<uint32_t> empty{};
+			const auto found = index.find(id);
+			return id == string_table::none || found == index.end() ? empty : found->second;
+		}
+
+		static std::string qualified_name(const char* prefix, const char* name)
+		{
+			if (prefix == nullptr || prefix[0] == '\0')
+			{
+				return name;
+			}
+			return std::string{prefix} + ':' + name;
+		}
 
-			default:
-				break;
+		// builds the DOM straight from the binary XML events, no text round-trip
+		bool decode_manifest(pugi::xml_document& xml_doc)
+		{
+			const auto parser = AxmlOpen(binary_content_.get(), binary_size_);
+			if (parser == nullptr)
+			{
+				return false;
 			}
 
-			for (const auto& [name, intents] : *ptr_target)
+			pugi::xml_node current = xml_doc;
+			auto event = AE_UNINITIALIZED;
+			while ((event = AxmlNext(parser)) != AE_ENDDOC)
 			{
-				color_printf(color::FG_GREEN, "\t%s\n", name.c_str());
-				if (!intents.empty())
+				if (event == AE_STARTTAG)
 				{
-					color_printf(color::FG_DARK_GRAY, "\t\tIntents:\n");
-					for (const auto& intent : intents)
+					current = current.append_child(
+						qualified_name(AxmlGetTagPrefix(parser), AxmlGetTagName(parser)).c_str());
+
+					if (AxmlNewNamespace(parser))
+					{
+						const auto ns_count = AxmlGetNsCount(parser);
+						for (uint32_t i = 0; i < ns_count; i++)
+						{
+							current.append_attribute(qualified_name("xmlns", AxmlGetNsPrefixAt(parser, i)).c_str())
+							       .set_value(AxmlGetNsUriAt(parser, i));
+						}
+					}
+
+					const auto attr_count = AxmlGetAttrCount(parser);
+					for (uint32_t i = 0; i < attr_count; i++)
 					{
-						color_printf(color::FG_DEFAULT, "\t\t%s\n", intent.c_str());
+						const auto value = AxmlGetAttrValue(parser, i);
+						current.append_attribute(
+							qualified_name(AxmlGetAttrPrefix(parser, i), AxmlGetAttrName(parser, i)).c_str())
+						       .set_value(value);
+						free(value);
 					}
 				}
+				else if (event == AE_ENDTAG)
+				{
+					if (current != xml_doc)
+					{
+						current = current.parent();
+					}
+				}
+				else if (event == AE_TEXT)
+				{
+					current.append_child(pugi::node_pcdata).set_value(AxmlGetText(parser));
+				}
+				else if (event == AE_ERROR)
+				{
+					AxmlClose(parser);
+					return false;
+				}
 			}
+			AxmlClose(parser);
+
+			return true;
 		}
 
-		void emplace_intents(const pugi::xml_node& node, const intent_target type)
+		std::shared_ptr<char> binary_content_ = nullptr;
+		size_t binary_size_ = 0;
+		std::string manifest_content_{};
+
+		static void walk_dom(const pugi::xml_node& node, const int depth, model_builder& builder)
 		{
-			auto name = std::string{node.attribute("android:name").as_string()};
-			auto alias_target = std::string{node.attribute("android:targetActivity").as_string()};
-			if (!alias_target.empty())
+			for (const auto& child : node.children())
 			{
-				name = alias_target;
+				if (child.type() != pugi::node_element)
+				{
+					continue;
+				}
+				const auto name = child.name();
+				const auto attribute = [&child](const bool android, const char* attribute_name, std::string& value)
+				{
+					const auto found = child.attribute(android ? qualified_name("android", attribute_name).c_str()
+					                                           : attribute_name);
+					if (!found)
+					{
+						return false;
+					}
+					value = found.as_string();
+					return true;
+				};
+				builder.start_tag(depth, strchr(name, ':') == nullptr ? name : "", attribute);
+				walk_dom(child, depth + 1, builder);
+				builder.end_tag(depth);
 			}
+		}
 
-			if (!name.empty() && name[0] == '.' && !manifest_package.empty())
+		bool load_from_dom()
+		{
+			pugi::xml_document xml_doc;
+			if (!decode_manifest(xml_doc))
 			{
-				name = manifest_package + name;
+				return false;
 			}
 
-			std::vector<std::string> intent_filters{};
-			for (const auto& intent_child : node.child("intent-filter").children("action"))
+			model_builder builder(*this);
+			walk_dom(xml_doc, 0, builder);
+			return true;
+		}
+
+		static std::string attribute_value(AxmlParser_t* parser, const uint32_t index)
+		{
+			// strings come straight from the pool, other types have to be formatted
+			const auto string_value = AxmlGetAttrString(parser, index);
+			if (string_value != nullptr)
 			{
-				const auto intent_name = intent_child.attribute("android:name").as_string();
-				intent_filters.emplace_back(intent_name);
+				return string_value;
 			}
+			const auto value = AxmlGetAttrValue(parser, index);
+			std::string result{value};
+			free(value);
+			return result;
+		}
 
-			if (type == intent_target::service)
+		// fills the model in a single pass over the binary XML events
+		bool load_streaming()
+		{
+			const auto parser = AxmlOpen(binary_content_.get(), binary_size_);
+			if (parser == nullptr)
 			{
-				services.emplace_back(name, intent_filters);
+				return false;
 			}
-			else if (type == intent_target::activity)
+
+			model_builder builder(*this);
+			auto depth = 0;
+			auto event = AE_UNINITIALIZED;
+			auto status = true;
+			while ((event = AxmlNext(parser)) != AE_ENDDOC)
 			{
-				activities.emplace_back(name, intent_filters);
+				if (event == AE_ERROR)
+				{
+					status = false;
+					break;
+				}
+				if (event == AE_ENDTAG)
+				{
+					builder.end_tag(--depth);
+					continue;
+				}
+				if (event != AE_STARTTAG)
+				{
+					continue;
+				}
+
+				const auto attr_count = AxmlGetAttrCount(parser);
+				const auto attribute = [&](const bool android, const char* name, std::string& value)
+				{
+					for (uint32_t i = 0; i < attr_count; i++)
+					{
+						const auto prefix = AxmlGetAttrPrefix(parser, i);
+						const auto prefix_match = android ? strcmp(prefix, "android") == 0 : prefix[0] == '\0';
+						if (prefix_match && strcmp(AxmlGetAttrName(parser, i), name) == 0)
+						{
+							value = attribute_value(parser, i);
+							return true;
+						}
+					}
+					return false;
+				};
+				const auto tag = AxmlGetTagPrefix(parser)[0] == '\0' ? AxmlGetTagName(parser) : "";
+				builder.start_tag(depth++, tag, attribute);
 			}
-			else if (type == intent_target::receiver)
+			AxmlClose(parser);
+
+			return status;
+		}
+
+		bool parse(std::shared_ptr<char> content, const size_t size, const parse_mode mode)
+		{
+			binary_content_ = std::move(content);
+			binary_size_ = size;
+			if (binary_content_ == nullptr)
 			{
-				receivers.emplace_back(name, intent_filters);
+				return false;
 			}
+			return mode == parse_mode::dom ? load_from_dom() : load_streaming();
 		}
 
-		bool decode_manifest(const std::string& manifest_path)
+		void dump_filter(const intent_filter& filter) const
 		{
-			size_t file_size = 0;
-			const auto file_content = utils::read_file(manifest_path, file_size);
-			char* xml_content = nullptr;
-			size_t xml_size = 0;
-			AxmlToXml(&xml_content, &xml_size, file_content.get(), file_size);
-			fs::remove(manifest_path);
-
-			const auto status = utils::write_file(manifest_path, xml_content, xml_size);
-			manifest_content = std::string(xml_content, xml_size);
-			free(xml_content);
-			if (status == false)
-			{
-				printf("Failed to write AndroidManifest.xml\n");
-				return false;
+			color_printf(color::FG_DARK_GRAY, "\t\tintent-filter:\n");
+			const std::pair<const char*, const std::vector<uint32_t>*> fields[] = {
+				{"action", &filter.actions},
+				{"category", &filter.categories},
+				{"scheme", &filter.schemes},
+				{"host", &filter.hosts},
+			};
+			for (const auto& [label, ids] : fields)
+			{
+				for (const auto id : *ids)
+				{
+					color_printf(color::FG_DEFAULT, "\t\t\t%s: %s\n", label, str(id).c_str());
+				}
 			}
+		}
 
-			return true;
+		// the component strings, so manifests with different string tables can be compared
+		std::vector<std::string> component_fields(const component& current) const
+		{
+			std::vector<std::string> fields{
+				std::to_string(static_cast<int>(current.type)), str(current.name), str(current.target),
+				str(current.permission), str(current.authorities), std::to_string(current.exported)
+			};
+			for (const auto& filter : current.filters)
+			{
+				for (const auto ids : {&filter.actions, &filter.categories, &filter.schemes, &filter.hosts})
+				{
+					fields.emplace_back("|");
+					for (const auto id : *ids)
+					{
+						fields.emplace_back(str(id));
+					}
+				}
+			}
+			return fields;
 		}
 
 	public:
 		std::vector<std::string> permissions{};
 		std::string manifest_package;
-		std::vector<std::pair<std::string, std::vector<std::string>>> activities{};
-		std::vector<std::pair<std::string, std::vector<std::string>>> services{};
-		std::vector<std::pair<std::string, std::vector<std::string>>> receivers{};
-		std::string manifest_content;
 		bool debuggable = false;
 
-		explicit manifest(const std::string& xml_path)
+		explicit manifest(const std::string& xml_path, const parse_mode mode = parse_mode::streaming)
 		{
-			const auto status = decode_manifest(xml_path);
-			if (status == false)
+			size_t file_size = 0;
+			auto file_content = utils::read_file(xml_path, file_size);
+			if (file_content == nullptr || !parse(std::move(file_content), file_size, mode))
 			{
 				printf("Failed to decode manifest file: %s\n", xml_path.c_str());
-				return;
 			}
+		}
 
-			pugi::xml_document xml_doc;
-			xml_doc.load_file(xml_path.c_str());
+		manifest(std::shared_ptr<char> content, const size_t size, const parse_mode mode = parse_mode::streaming)
+		{
+			if (!parse(std::move(content), size, mode))
+			{
+				printf("Failed to decode manifest\n");
+			}
+		}
 
-			auto is_debug_string = std::string{
-				xml_doc.child("manifest").child("application").attribute("android:debuggable").as_string()
-			};
-			if (!is_debug_string.empty() && is_debug_string == "true")
+		// No copy/move semantics
+		manifest(const manifest&) = delete;
+		manifest& operator=(const manifest&) = delete;
+
+		static const char* type_name(const component_type type)
+		{
+			switch (type)
 			{
-				debuggable = true;
+			case component_type::activity:
+				return "activity";
+			case component_type::activity_alias:
+				return "activity-alias";
+			case component_type::service:
+				return "service";
+			case component_type::receiver:
+				return "receiver";
+			case component_type::provider:
+				return "provider";
 			}
+			return "";
+		}
 
-			// application class
-			application_class_name_ = xml_doc.child("manifest").child("application").attribute("android:name").
-			                                  as_string();
-			manifest_package = std::string{xml_doc.child("manifest").attribute("package").as_string()};
-			if (!application_class_name_.empty() && application_class_name_[0] == '.' && !manifest_package.empty())
+		const std::string& str(const uint32_t id) const
+		{
+			return strings_.get(id);
+		}
+
+		const std::vector<component>& get_components() const
+		{
+			return components_;
+		}
+
+		const std::string& get_application_class() const
+		{
+			return application_class_name_;
+		}
+
+		// indexes of the components with an intent-filter for "action", "category" or "scheme"
+		const std::vector<uint32_t>& find_by_action(const std::string& action) const
+		{
+			return find_in(by_action_, strings_.find(action));
+		}
+
+		const std::vector<uint32_t>& find_by_category(const std::string& category) const
+		{
+			return find_in(by_category_, strings_.find(category));
+		}
+
+		const std::vector<uint32_t>& find_by_scheme(const std::string& scheme) const
+		{
+			return find_in(by_scheme_, strings_.find(scheme));
+		}
+
+		// all the schemes used by intent-filters
+		std::vector<std::string> get_schemes() const
+		{
+			std::vector<std::string> schemes{};
+			for (const auto& [id, _] : by_scheme_)
 			{
-				application_class_name_ = manifest_package + application_class_name_;
+				schemes.emplace_back(str(id));
 			}
+			std::sort(schemes.begin(), schemes.end());
+			return schemes;
+		}
 
-			// permissions
-			for (const auto& child : xml_doc.child("manifest").children("uses-permission"))
+		// class name, flags and intent-filters of a component
+		void dump_component(const component& current, const bool with_filters = true) const
+		{
+			color_printf(color::FG_GREEN, "\t%s", str(current.name).c_str());
+			if (current.target != string_table::none)
 			{
-				const auto permission_name = child.attribute("android:name").as_string();
-				permissions.emplace_back(permission_name);
+				color_printf(color::FG_GREEN, " -> %s", str(current.target).c_str());
 			}
-			// activities
-			for (const auto& child : xml_doc.child("manifest").child("application").children("activity"))
+			if (current.is_exported())
 			{
-				emplace_intents(child, intent_target::activity);
+				color_printf(color::FG_LIGHT_RED, " [exported]");
 			}
-			for (const auto& child : xml_doc.child("manifest").child("application").children("activity-alias"))
+			if (current.permission != string_table::none)
 			{
-				emplace_intents(child, intent_target::activity);
+				color_printf(color::FG_DARK_GRAY, " [permission: %s]", str(current.permission).c_str());
 			}
-
-			// services
-			for (const auto& child : xml_doc.child("manifest").child("application").children("service"))
+			if (current.authorities != string_table::none)
 			{
-				emplace_intents(child, intent_target::service);
+				color_printf(color::FG_DARK_GRAY, " [authorities: %s]", str(current.authorities).c_str());
 			}
+			printf("\n");
 
-			// Broadcast receivers
-			for (const auto& child : xml_doc.child("manifest").child("application").children("receiver"))
+			if (with_filters)
 			{
-				emplace_intents(child, intent_target::receiver);
+				for (const auto& filter : current.filters)
+				{
+					dump_filter(filter);
+				}
 			}
-
-			// ctor
 		}
 
-		// No copy/move semantics
-		manifest(const manifest&) = delete;
-		manifest& operator=(const manifest&) = delete;
+		void dump_components(const component_type type, const bool with_filters = true) const
+		{
+			for (const auto& current : components_)
+			{
+				if (current.type == type)
+				{
+					dump_component(current, with_filters);
+				}
+			}
+		}
 
-		/* 
+		/*
 			dump entry points from manifest file
-	
-			Three of the four component types—activities, services, and broadcast receivers — are activated by an asynchronous message called an intent. 
-			
+
+			Three of the four component types—activities, services, and broadcast receivers — are activated by an asynchronous message called an intent.
+
 			details: https://developer.android.com/guide/components/fundamentals
 		*/
 		void dump_entry_points(bool extended = false)
@@ -196,21 +688,14 @@ namespace andromeda
 			}
 
 			// main activity ("Activity Action: Start as a main entry point, does not expect to receive data.")
-			for (const auto& [name, intents] : activities)
+			for (const auto index : find_by_action("android.intent.action.MAIN"))
 			{
-				if (std::find(intents.begin(), intents.end(), R"(android.intent.action.MAIN)") != intents.end())
+				const auto& current = components_[index];
+				if (current.type == component_type::activity || current.type == component_type::activity_alias)
 				{
 					color_printf(color::FG_LIGHT_GRAY, "Main activity:\n\t");
-					auto full_class_name = name;
-					if (!full_class_name.empty() && full_class_name[0] == '.')
-					{
-						if (!manifest_package.empty())
-						{
-							full_class_name = manifest_package + full_class_name;
-						}
-					}
-
-					color_printf(color::FG_GREEN, "%s\n", full_class_name.c_str());
+					color_printf(color::FG_GREEN, "%s\n",
+					             str(current.target != string_table::none ? current.target : current.name).c_str());
 					break;
 				}
 			}
@@ -220,33 +705,68 @@ namespace andromeda
 				return;
 			}
 
-			// activities
-			if (!activities.empty())
+			static const std::pair<component_type, const char*> groups[] = {
+				{component_type::activity, "Activities:\n"},
+				{component_type::activity_alias, "Activity aliases:\n"},
+				{component_type::service, "Services:\n"},
+				{component_type::receiver, "Receivers:\n"},
+				{component_type::provider, "Providers:\n"},
+			};
+			for (const auto& [type, title] : groups)
 			{
-				color_printf(color::FG_LIGHT_GRAY, "Activities:\n");
-				dump_intents(intent_target::activity);
+				const auto found = std::find_if(components_.begin(), components_.end(),
+				                                [type = type](const component& current) { return current.type == type; });
+				if (found != components_.end())
+				{
+					color_printf(color::FG_LIGHT_GRAY, "%s", title);
+					dump_components(type);
+				}
 			}
 
-			// services
-			if (!services.empty())
+			// dump_entry_points()
+		}
+
+		bool is_debuggable() const
+		{
+			return debuggable;
+		}
+
+		// true if both manifests extracted the same information
+		bool same_fields(const manifest& other) const
+		{
+			if (application_class_name_ != other.application_class_name_ ||
+				manifest_package != other.manifest_package ||
+				permissions != other.permissions ||
+				debuggable != other.debuggable ||
+				components_.size() != other.components_.size())
 			{
-				color_printf(color::FG_LIGHT_GRAY, "Services:\n");
-				dump_intents(intent_target::service);
+				return false;
 			}
-
-			// receivers
-			if (!receivers.empty())
+			for (size_t i = 0; i < components_.size(); i++)
 			{
-				color_printf(color::FG_LIGHT_GRAY, "Services:\n");
-				dump_intents(intent_target::receiver);
+				if (component_fields(components_[i]) != other.component_fields(other.components_[i]))
+				{
+					return false;
+				}
 			}
-
-			// dump_entry_points()
+			return true;
 		}
 
-		bool is_debuggable() const
+		// text form of the manifest, rendered on first use
+		const std::string& get_content()
 		{
-			return debuggable;
+			if (manifest_content_.empty() && binary_content_ != nullptr)
+			{
+				char* xml_content = nullptr;
+				size_t xml_size = 0;
+				if (AxmlToXml(&xml_content, &xml_size, binary_content_.get(), binary_size_) == 0)
+				{
+					manifest_content_ = std::string(xml_content, xml_size);
+					free(xml_content);
+				}
+			}
+
+			return manifest_content_;
 		}
 
 		// class: manifest
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#include "utils.hpp"
+#include "thread_pool.hpp"
+#include "elf.hpp"
+#include "dex.hpp"
+
+#include <openssl/evp.h>
+
+namespace andromeda
+{
+	struct native_library
+	{
+		std::string path{}; // lib/arm64-v8a/libfoo.so
+		std::string abi{};
+		std::string sha256{};
+		std::shared_ptr<const elf_file> elf{};
+	};
+
+	// a dex method with the native flag and where its code is
+	struct jni_binding
+	{
+		std::string class_descriptor{};
+		std::string method_name{};
+		std::string signature{};
+		std::vector<std::pair<const native_library*, std::string>> exports{}; // library, Java_ symbol
+	};
+
+	// The ELF files under lib/, read straight from the archive: stored entries are used in place
+	// from the mapped APK, compressed ones are inflated to the heap. The libraries are hashed
+	// and parsed in parallel, identical libraries (same SHA-256, in any APK) are parsed once.
+	class native_libs
+	{
+		std::vector<utils::zip_source> sources_;
+		bool loaded_ = false;
+		std::vector<native_library> libs_{};
+
+		static std::pair<std::mutex&, std::unordered_map<std::string, std::shared_ptr<const elf_file>>&> elf_cache()
+		{
+			static std::mutex lock{};
+			static std::unordered_map<std::string, std::shared_ptr<const elf_file>> cache{};
+			return {lock, cache};
+		}
+
+		static std::string sha256_hex(const uint8_t* data, const size_t size)
+		{
+			static const char digits[] = "0123456789abcdef";
+			uint8_t digest[EVP_MAX_MD_SIZE]{};
+			unsigned int digest_size = 0;
+			EVP_Digest(data, size, digest, &digest_size, EVP_sha256(), nullptr);
+			std::string result(digest_size * 2, '0');
+			for (unsigned int i = 0; i < digest_size; i++)
+			{
+				result[i * 2] = digits[digest[i] >> 4];
+				result[i * 2 + 1] = digits[digest[i] & 0x0f];
+			}
+			return result;
+		}
+
+		static std::shared_ptr<const elf_file> parse_cached(const std::string& sha256, const uint8_t* data, const size_t size)
+		{
+			auto [lock, cache] = elf_cache();
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				const auto found = cache.find(sha256);
+				if (found != cache.end())
+				{
+					return found->second;
+				}
+			}
+			const auto elf = std::make_shared<const elf_file>(data, size);
+			std::lock_guard<std::mutex> guard(lock);
+			return cache.emplace(sha256, elf).first->second;
+		}
+
+		// data of a stored entry inside the mapped archive, nullptr if it has to be inflated
+		static const uint8_t* stored_data(const uint8_t* data, const size_t size, const mz_zip_archive_file_stat& file_stat)
+		{
+			const auto header = file_stat.m_local_header_ofs;
+			if (data == nullptr || file_stat.m_method != 0 || file_stat.m_comp_size != file_stat.m_uncomp_size ||
+			    header + 30 > size || memcmp(data + header, "PK\x03\x04", 4) != 0)
+			{
+				return nullptr;
+			}
+			const auto offset = header + 30 + (data[header + 26] | data[header + 27] << 8) + (data[header + 28] | data[header + 29] << 8);
+			// the ELF structures are read in place, they need an aligned start (zipalign -p gives 4 KB)
+			if (offset + file_stat.m_comp_size > size || (offset & 7) != 0)
+			{
+				return nullptr;
+			}
+			return data + offset;
+		}
+
+		// "app.xapk!/config.arm64_v8a.apk" -> "config.arm64_v8a.apk"
+		static std::string archive_name(const utils::zip_source& source)
+		{
+			const auto separator = source.name().rfind("!/");
+			return separator == std::string::npos ? fs::path(source.name()).filename().string() : source.name().substr(separator + 2);
+		}
+
+		void load()
+		{
+			loaded_ = true;
+
+			std::vector<std::pair<size_t, mz_zip_archive_file_stat>> entries{}; // source, entry
+			for (size_t source = 0; source < sources_.size(); source++)
+			{
+				mz_zip_archive zip_archive;
+				if (!sources_[source].open(zip_archive))
+				{
+					continue;
+				}
+				const auto file_count = mz_zip_reader_get_num_files(&zip_archive);
+				for (mz_uint i = 0; i < file_count; i++)
+				{
+					mz_zip_archive_file_stat file_stat;
+					if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat) || mz_zip_reader_is_file_a_directory(&zip_archive, i))
+					{
+						continue;
+					}
+					const std::string file_name{file_stat.m_filename};
+					if (utils::starts_with(file_name, "lib/") && utils::ends_with(file_name, ".so"))
+					{
+						native_library library{};
+						// the libraries of the split APKs are named after their archive
+						library.path = source == 0 ? file_name : archive_name(sources_[source]) + "!/" + file_name;
+						const auto abi_end = file_name.find('/', 4);
+						library.abi = abi_end == std::string::npos ? "" : file_name.substr(4, abi_end - 4);
+						libs_.emplace_back(std::move(library));
+						entries.emplace_back(source, file_stat);
+					}
+				}
+				mz_zip_reader_end(&zip_archive);
+			}
+
+			std::vector<std::pair<std::shared_ptr<const uint8_t>, size_t>> images(sources_.size());
+			for (size_t source = 0; source < sources_.size(); source++)
+			{
+				images[source].first = sources_[source].map(images[source].second);
+			}
+			auto& pool = worker_pool();
+			std::vector<std::unique_ptr<mz_zip_archive>> readers(pool.size() * sources_.size()); // per worker and source
+			pool.parallel_for(entries.size(), 1, [&](const size_t index, const size_t worker_index)
+			{
+				auto& library = libs_[index];
+				const auto& [source, file_stat] = entries[index];
+				const auto stored = stored_data(images[source].first.get(), images[source].second, file_stat);
+				if (stored != nullptr)
+				{
+					library.sha256 = sha256_hex(stored, file_stat.m_uncomp_size);
+					library.elf = parse_cached(library.sha256, stored, file_stat.m_uncomp_size);
+					return;
+				}
+
+				auto& reader = readers[worker_index * sources_.size() + source];
+				if (reader == nullptr)
+				{
+					reader.reset(new mz_zip_archive);
+					if (!sources_[source].open(*reader))
+					{
+						return;
+					}
+				}
+				if (reader->m_zip_mode != MZ_ZIP_MODE_READING)
+				{
+					return;
+				}
+				size_t size = 0;
+				const auto content = static_cast<uint8_t*>(mz_zip_reader_extract_to_heap(reader.get(), file_stat.m_file_index, &size, 0));
+				if (content != nullptr)
+				{
+					library.sha256 = sha256_hex(content, size);
+					library.elf = parse_cached(library.sha256, content, size);
+					mz_free(content);
+				}
+			});
+			for (auto& reader : readers)
+			{
+				if (reader != nullptr && reader->m_zip_mode == MZ_ZIP_MODE_READING)
+				{
+					mz_zip_reader_end(reader.get());
+				}
+			}
+		}
+
+	public:
+		explicit native_libs(const utils::zip_source& source) : sources_{source}
+		{
+		}
+
+		// the libraries of several archives seen as one set, ex. the base and split APKs of a bundle
+		explicit native_libs(std::vector<utils::zip_source> sources) : sources_(std::move(sources))
+		{
+		}
+
+		const std::vector<native_library>& get_libraries()
+		{
+			if (!loaded_)
+			{
+				load();
+			}
+			return libs_;
+		}
+
+		// "lib/arm64-v8a/libfoo.so" or "arm64-v8a/libfoo.so", with or without the archive of a split APK
+		const native_library* find(const std::string& path)
+		{
+			for (const auto& library : get_libraries())
+			{
+				if (library.path == path || library.path == "lib/" + path ||
+				    utils::ends_with(library.path, "!/" + path) || utils::ends_with(library.path, "!/lib/" + path))
+				{
+					return &library;
+				}
+			}
+			return nullptr;
+		}
+
+		// every native method of the dex files with the Java_ exports implementing it;
+		// unmatched_exports gets the Java_ symbols without a native method
+		std::vector<jni_binding> link(std::vector<parsed_dex>& dexes, std::vector<std::pair<const native_library*, std::string>>& unmatched_exports)
+		{
+			std::vector<jni_binding> bindings{};
+			std::unordered_map<std::string, std::vector<size_t>> by_name{}; // "Lcom/Foo;->bar" -> bindings
+			for (auto& dex : dexes)
+			{
+				for (const auto& method : dex.get_full_ir()->encoded_methods)
+				{
+					if ((method->access_flags & dex::kAccNative) == 0)
+					{
+						continue;
+					}
+					jni_binding binding{};
+					binding.class_descriptor = method->decl->parent->descriptor->c_str();
+					binding.method_name = method->decl->name->c_str();
+					binding.signature = method->decl->prototype->Signature();
+					by_name[binding.class_descriptor + "->" + binding.method_name].emplace_back(bindings.size());
+					bindings.emplace_back(std::move(binding));
+				}
+			}
+
+			for (const auto& library : get_libraries())
+			{
+				if (library.elf == nullptr)
+				{
+					continue;
+				}
+				for (const auto& symbol : library.elf->get_symbols())
+				{
+					jni_name decoded{};
+					if (!symbol.defined || symbol.binding == STB_LOCAL || !decode_jni_name(symbol.name, decoded))
+					{
+						continue;
+					}
+					auto matched = false;
+					const auto found = by_name.find(decoded.class_descriptor + "->" + decoded.method_name);
+					if (found != by_name.end())
+					{
+						for (const auto index : found->second)
+						{
+							auto& binding = bindings[index];
+							if (decoded.parameters.empty() || utils::starts_with(binding.signature, decoded.parameters))
+							{
+								binding.exports.emplace_back(&library, symbol.name);
+								matched = true;
+							}
+						}
+					}
+					if (!matched)
+					{
+						unmatched_exports.emplace_back(&library, symbol.name);
+					}
+				}
+			}
+			return bindings;
+		}
+	};
+} // namespace andromeda
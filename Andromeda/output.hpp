@@ -0,0 +1,176 @@
+#pragma once
+
+#include <string>
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+
+#include "color/color.hpp"
+
+namespace output
+{
+	// Collects (colored) lines in memory and hands them to the stream in big chunks.
+	// Listing commands produce hundreds of thousands of lines, writing every
+	// fragment separately to the unbuffered stdout costs a syscall each.
+	class writer
+	{
+		static constexpr size_t flush_threshold = 1 << 20;
+
+		std::string buffer_{};
+		FILE* stream_ = nullptr;
+		bool colors_ = false;
+
+		void append_escape(const int code)
+		{
+			char escape[8] = {'\033', '['};
+			auto length = 2;
+			if (code >= 100)
+			{
+				escape[length++] = static_cast<char>('0' + code / 100);
+			}
+			escape[length++] = static_cast<char>('0' + code / 10 % 10);
+			escape[length++] = static_cast<char>('0' + code % 10);
+			escape[length++] = 'm';
+			buffer_.append(escape, length);
+		}
+
+		void append_format(const char* format, va_list args)
+		{
+			va_list args_copy;
+			va_copy(args_copy, args);
+
+			char local[512];
+			const auto written = vsnprintf(local, sizeof(local), format, args);
+			if (written > 0 && static_cast<size_t>(written) < sizeof(local))
+			{
+				buffer_.append(local, written);
+			}
+			else if (written > 0)
+			{
+				// long line, format straight into the buffer
+				const auto used = buffer_.size();
+				buffer_.resize(used + written + 1);
+				vsnprintf(&buffer_[used], written + 1, format, args_copy);
+				buffer_.resize(used + written);
+			}
+			va_end(args_copy);
+		}
+
+		void maybe_flush()
+		{
+			if (buffer_.size() >= flush_threshold)
+			{
+				flush();
+			}
+		}
+
+	public:
+		explicit writer(FILE* stream = stdout) : writer(stream, color::is_enabled(stream))
+		{
+		}
+
+		writer(FILE* stream, const bool colors) : stream_(stream), colors_(colors)
+		{
+			buffer_.reserve(flush_threshold + 4096);
+		}
+
+		~writer()
+		{
+			flush();
+		}
+
+		// No copy/move semantics
+		writer(const writer&) = delete;
+		writer& operator=(const writer&) = delete;
+
+		void write(const char* data, const size_t size)
+		{
+			buffer_.append(data, size);
+			maybe_flush();
+		}
+
+		void write(const std::string& str)
+		{
+			write(str.data(), str.size());
+		}
+
+		void write(const color::code code, const char* data, const size_t size)
+		{
+			if (colors_)
+			{
+				append_escape(code);
+				buffer_.append(data, size);
+				append_escape(color::FG_DEFAULT);
+			}
+			else
+			{
+				buffer_.append(data, size);
+			}
+			maybe_flush();
+		}
+
+		void write(const color::code code, const std::string& str)
+		{
+			write(code, str.data(), str.size());
+		}
+
+		// "prefix" + "str" + "suffix" in a single color, the common shape of listing lines
+		void line(const color::code code, const char* prefix, const std::string& str, const char* suffix = "\n")
+		{
+			if (colors_)
+			{
+				append_escape(code);
+			}
+			buffer_.append(prefix);
+			buffer_.append(str);
+			buffer_.append(suffix);
+			if (colors_)
+			{
+				append_escape(color::FG_DEFAULT);
+			}
+			maybe_flush();
+		}
+
+		void printf(const char* __restrict format, ...)
+		{
+			va_list args;
+			va_start(args, format);
+			append_format(format, args);
+			va_end(args);
+			maybe_flush();
+		}
+
+		void color_printf(const color::code code, const char* __restrict format, ...)
+		{
+			if (colors_)
+			{
+				append_escape(code);
+			}
+			va_list args;
+			va_start(args, format);
+			append_format(format, args);
+			va_end(args);
+			if (colors_)
+			{
+				append_escape(color::FG_DEFAULT);
+			}
+			maybe_flush();
+		}
+
+		void flush()
+		{
+			if (buffer_.empty())
+			{
+				return;
+			}
+			fwrite(buffer_.data(), 1, buffer_.size(), stream_);
+			fflush(stream_);
+			buffer_.clear();
+		}
+
+		size_t pending() const
+		{
+			return buffer_.size();
+		}
+	};
+} // namespace output
@@ -0,0 +1,442 @@
+#pragma once
+
+#include "utils.hpp"
+#include "thread_pool.hpp"
+#include "dex.hpp"
+
+#include "slicer/chronometer.h"
+
+namespace andromeda
+{
+	enum class payload_type : uint8_t { dex, zip, elf, java_class };
+
+	// a file header found inside an archive entry
+	struct payload
+	{
+		uint32_t entry = 0; // index for payload_scanner::get_file
+		uint64_t offset = 0;
+		payload_type type = payload_type::dex;
+		uint8_t key = 0; // single byte XOR key, 0 for plain data
+		uint64_t size = 0; // dex: file_size of the header
+		uint32_t count = 1; // zip: local file headers after this one (same key)
+	};
+
+	// Streams bytes through the header matcher, the input can come in pieces: the last bytes
+	// of a piece are kept until the next one completes their window.
+	// A match with a single byte XOR key keeps the XOR of neighbouring bytes, so one test on
+	// (b[0] ^ b[1]) finds the plain headers and every XOR key at once; the rest of the header
+	// is then checked with the key it gives.
+	class payload_matcher
+	{
+	public:
+		static constexpr size_t window = 44; // the dex header up to endian_tag
+
+	private:
+		struct signature
+		{
+			payload_type type;
+			uint8_t magic[4];
+		};
+
+		static constexpr signature signatures[] = {
+			{payload_type::dex, {'d', 'e', 'x', '\n'}},
+			{payload_type::zip, {'P', 'K', 0x03, 0x04}},
+			{payload_type::elf, {0x7f, 'E', 'L', 'F'}},
+			{payload_type::java_class, {0xca, 0xfe, 0xba, 0xbe}},
+		};
+
+		bool with_xor_;
+		std::vector<payload>& found_;
+		uint32_t entry_;
+		uint8_t first_difference_[256]{}; // b[0] ^ b[1] -> bit per signature
+		std::vector<uint8_t> tail_{};
+		uint64_t base_ = 0; // offset of tail_[0] or of the next piece
+		int64_t last_zip_ = -1; // index in found_ of the first zip header of this entry
+
+		static uint16_t u16(const uint8_t* p, const uint8_t key)
+		{
+			return static_cast<uint16_t>((p[0] ^ key) | (p[1] ^ key) << 8);
+		}
+
+		static uint32_t u32(const uint8_t* p, const uint8_t key)
+		{
+			return u16(p, key) | static_cast<uint32_t>(u16(p + 2, key)) << 16;
+		}
+
+		// the bytes after the magic, so random matches are rejected
+		static bool is_valid_header(const payload_type type, const uint8_t* p, const uint8_t key)
+		{
+			switch (type)
+			{
+			case payload_type::dex: // dex\n0NN\0, header_size and endian_tag
+				return (p[4] ^ key) == '0' && isdigit(p[5] ^ key) && isdigit(p[6] ^ key) && (p[7] ^ key) == 0 &&
+				       u32(p + 36, key) == 0x70 && u32(p + 40, key) == 0x12345678;
+			case payload_type::zip: // version needed to extract and compression method
+				return u16(p + 4, key) <= 63 && (u16(p + 8, key) == 0 || u16(p + 8, key) == 8);
+			case payload_type::elf: // class, data, version and e_type
+				return ((p[4] ^ key) == 1 || (p[4] ^ key) == 2) && ((p[5] ^ key) == 1 || (p[5] ^ key) == 2) &&
+				       (p[6] ^ key) == 1 && u16(p + 16, key) >= 1 && u16(p + 16, key) <= 4;
+			case payload_type::java_class: // big-endian major version, Mach-O fat headers have a small count there
+			{
+				const auto major = (p[6] ^ key) << 8 | (p[7] ^ key);
+				return major >= 45 && major <= 80;
+			}
+			}
+			return false;
+		}
+
+		void check(const uint8_t* p, const uint64_t offset)
+		{
+			const auto candidates = first_difference_[p[0] ^ p[1]];
+			if (candidates == 0)
+			{
+				return;
+			}
+			for (size_t i = 0; i < sizeof(signatures) / sizeof(signatures[0]); i++)
+			{
+				if ((candidates & 1 << i) == 0)
+				{
+					continue;
+				}
+				const auto& current = signatures[i];
+				const uint8_t key = p[0] ^ current.magic[0];
+				if ((key != 0 && !with_xor_) || (p[2] ^ key) != current.magic[2] || (p[3] ^ key) != current.magic[3] ||
+				    !is_valid_header(current.type, p, key))
+				{
+					continue;
+				}
+
+				// an archive has a local header per file, count them under the first one
+				if (current.type == payload_type::zip && last_zip_ >= 0 && found_[last_zip_].key == key)
+				{
+					found_[last_zip_].count++;
+					continue;
+				}
+				payload hit{};
+				hit.entry = entry_;
+				hit.offset = offset;
+				hit.type = current.type;
+				hit.key = key;
+				hit.size = current.type == payload_type::dex ? u32(p + 32, key) : 0;
+				if (current.type == payload_type::zip)
+				{
+					last_zip_ = static_cast<int64_t>(found_.size());
+				}
+				found_.emplace_back(hit);
+			}
+		}
+
+	public:
+		payload_matcher(const bool with_xor, const uint32_t entry, std::vector<payload>& found)
+			: with_xor_(with_xor), found_(found), entry_(entry)
+		{
+			for (size_t i = 0; i < sizeof(signatures) / sizeof(signatures[0]); i++)
+			{
+				first_difference_[signatures[i].magic[0] ^ signatures[i].magic[1]] |= 1 << i;
+			}
+		}
+
+		void scan(const uint8_t* data, const size_t size)
+		{
+			// headers which started in the previous piece
+			if (!tail_.empty())
+			{
+				const auto pending = tail_.size();
+				tail_.insert(tail_.end(), data, data + std::min(size, window - 1));
+				size_t checked = 0;
+				for (; checked < pending && checked + window <= tail_.size(); checked++)
+				{
+					check(tail_.data() + checked, base_ + checked);
+				}
+				base_ += checked;
+				if (checked < pending)
+				{
+					// the whole piece went to the tail
+					tail_.erase(tail_.begin(), tail_.begin() + checked);
+					return;
+				}
+				tail_.clear();
+			}
+
+			const size_t complete = size >= window ? size - window + 1 : 0;
+			for (size_t i = 0; i < complete; i++)
+			{
+				check(data + i, base_ + i);
+			}
+			tail_.assign(data + complete, data + size);
+			base_ += complete;
+		}
+	};
+
+	// Looks for dex, zip, ELF and class headers hidden in the archive entries (assets/, res/raw/,
+	// files with a wrong extension ...), one entry per task on the worker pool. The entries are
+	// inflated in pieces straight into the matcher, the memory used doesn't depend on their size.
+	class payload_scanner
+	{
+		utils::zip_source source_;
+		std::vector<std::string> files_{};
+		std::vector<mz_uint> entries_{}; // archive index of files_
+		std::vector<payload> payloads_{};
+		double elapsed_ms_ = 0;
+
+		// the header an entry is expected to start with, ex. classes.dex or lib/*.so
+		static bool is_expected(const std::string& file_name, const payload& hit)
+		{
+			if (hit.offset != 0 || hit.key != 0)
+			{
+				return false;
+			}
+			switch (hit.type)
+			{
+			case payload_type::dex:
+				return utils::ends_with(file_name, ".dex");
+			case payload_type::elf:
+				return utils::ends_with(file_name, ".so");
+			case payload_type::zip:
+				return utils::ends_with(file_name, ".jar") || utils::ends_with(file_name, ".zip") ||
+				       utils::ends_with(file_name, ".apk");
+			case payload_type::java_class:
+				return utils::ends_with(file_name, ".class");
+			}
+			return false;
+		}
+
+		static size_t scan_chunk(void* opaque, mz_uint64, const void* buffer, const size_t size)
+		{
+			static_cast<payload_matcher*>(opaque)->scan(static_cast<const uint8_t*>(buffer), size);
+			return size;
+		}
+
+		// the same checks slicer does before reading a dex (it aborts when they fail), and the checksum
+		static bool is_loadable_dex(const uint8_t* data, const size_t size)
+		{
+			if (size <= sizeof(dex::Header))
+			{
+				return false;
+			}
+			dex::Header header{};
+			memcpy(&header, data, sizeof(header));
+			if (!(header.file_size == size && header.header_size == sizeof(dex::Header) &&
+			      header.endian_tag == dex::kEndianConstant && header.data_size % 4 == 0 &&
+			      header.string_ids_off % 4 == 0 && header.type_ids_size < 65536 && header.type_ids_off % 4 == 0 &&
+			      header.proto_ids_size < 65536 && header.proto_ids_off % 4 == 0 && header.field_ids_off % 4 == 0 &&
+			      header.method_ids_off % 4 == 0 && header.class_defs_off % 4 == 0 &&
+			      header.map_off >= header.data_off && header.map_off < size && header.link_size == 0 &&
+			      header.link_off == 0 && header.data_off % 4 == 0 && header.map_off % 4 == 0))
+			{
+				return false;
+			}
+
+			// the map_list: its size field first, then a non empty list inside the image
+			if (uint64_t{header.map_off} + sizeof(dex::u4) > size)
+			{
+				return false;
+			}
+			dex::u4 map_size = 0;
+			memcpy(&map_size, data + header.map_off, sizeof(map_size));
+			if (map_size == 0 || uint64_t{header.map_off} + sizeof(dex::u4) + uint64_t{map_size} * sizeof(dex::MapItem) > size)
+			{
+				return false;
+			}
+			return header.checksum == mz_adler32(MZ_ADLER32_INIT, data + 12, size - 12);
+		}
+
+		// the dex payloads of an entry, copied (and decoded) from its bytes as they are inflated
+		struct dex_slices
+		{
+			std::vector<const payload*> hits{};
+			std::vector<std::shared_ptr<char>> contents{};
+			std::vector<uint64_t> copied{};
+		};
+
+		static size_t copy_slices(void* opaque, const mz_uint64 offset, const void* buffer, const size_t size)
+		{
+			auto& slices = *static_cast<dex_slices*>(opaque);
+			const auto data = static_cast<const uint8_t*>(buffer);
+			for (size_t i = 0; i < slices.hits.size(); i++)
+			{
+				const auto& hit = *slices.hits[i];
+				const auto begin = std::max<uint64_t>(offset, hit.offset);
+				const auto end = std::min<uint64_t>(offset + size, hit.offset + hit.size);
+				for (auto position = begin; position < end; position++)
+				{
+					slices.contents[i].get()[position - hit.offset] = static_cast<char>(data[position - offset] ^ hit.key);
+				}
+				slices.copied[i] += end > begin ? end - begin : 0;
+			}
+			return size;
+		}
+
+	public:
+		explicit payload_scanner(const utils::zip_source& source) : source_(source)
+		{
+		}
+
+		const std::vector<payload>& scan(const bool with_xor)
+		{
+			files_.clear();
+			entries_.clear();
+			payloads_.clear();
+			slicer::Chronometer chrono(elapsed_ms_);
+
+			mz_zip_archive zip_archive;
+			if (!source_.open(zip_archive))
+			{
+				return payloads_;
+			}
+			const auto file_count = mz_zip_reader_get_num_files(&zip_archive);
+			for (mz_uint i = 0; i < file_count; i++)
+			{
+				mz_zip_archive_file_stat file_stat;
+				if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat) || mz_zip_reader_is_file_a_directory(&zip_archive, i))
+				{
+					continue;
+				}
+				entries_.emplace_back(i);
+				files_.emplace_back(file_stat.m_filename);
+			}
+			mz_zip_reader_end(&zip_archive);
+
+			auto& pool = worker_pool();
+			std::vector<std::unique_ptr<mz_zip_archive>> readers(pool.size());
+			std::vector<std::vector<payload>> found(entries_.size());
+			pool.parallel_for(entries_.size(), 1, [&](const size_t index, const size_t worker_index)
+			{
+				auto& reader = readers[worker_index];
+				if (reader == nullptr)
+				{
+					reader.reset(new mz_zip_archive);
+					if (!source_.open(*reader))
+					{
+						return;
+					}
+				}
+				if (reader->m_zip_mode != MZ_ZIP_MODE_READING)
+				{
+					return;
+				}
+
+				payload_matcher matcher(with_xor, static_cast<uint32_t>(index), found[index]);
+				mz_zip_reader_extract_to_callback(reader.get(), entries_[index], scan_chunk, &matcher, 0);
+			});
+			for (auto& reader : readers)
+			{
+				if (reader != nullptr && reader->m_zip_mode == MZ_ZIP_MODE_READING)
+				{
+					mz_zip_reader_end(reader.get());
+				}
+			}
+
+			for (auto& entry_payloads : found)
+			{
+				for (const auto& hit : entry_payloads)
+				{
+					if (!is_expected(files_[hit.entry], hit))
+					{
+						payloads_.emplace_back(hit);
+					}
+				}
+			}
+			return payloads_;
+		}
+
+		const std::string& get_file(const uint32_t entry) const
+		{
+			return files_[entry];
+		}
+
+		double get_elapsed_ms() const
+		{
+			return elapsed_ms_;
+		}
+
+		static const char* type_name(const payload_type type)
+		{
+			switch (type)
+			{
+			case payload_type::dex:
+				return "dex";
+			case payload_type::zip:
+				return "zip";
+			case payload_type::elf:
+				return "ELF";
+			case payload_type::java_class:
+				return "class";
+			}
+			return "";
+		}
+
+		// the dex payloads of the last scan which pass the header and checksum checks,
+		// named "<entry>@<offset>"; "rejected" gets the names of the others.
+		// Each entry is inflated once, in pieces: only the bytes of its dex payloads are kept.
+		std::vector<parsed_dex> load_dexes(std::vector<std::string>& rejected) const
+		{
+			std::vector<parsed_dex> dexes{};
+
+			mz_zip_archive zip_archive;
+			if (!source_.open(zip_archive))
+			{
+				return dexes;
+			}
+			const auto hit_name = [this](const payload& hit)
+			{
+				char offset[32]{};
+				snprintf(offset, sizeof(offset), "@0x%llx", static_cast<unsigned long long>(hit.offset));
+				return files_[hit.entry] + offset;
+			};
+
+			// the payloads of an entry follow each other
+			for (size_t first = 0; first < payloads_.size();)
+			{
+				const auto entry = payloads_[first].entry;
+				auto last = first;
+				while (last < payloads_.size() && payloads_[last].entry == entry)
+				{
+					last++;
+				}
+
+				mz_zip_archive_file_stat file_stat;
+				const auto has_stat = mz_zip_reader_file_stat(&zip_archive, entries_[entry], &file_stat);
+				dex_slices slices{};
+				for (auto index = first; index < last; index++)
+				{
+					const auto& hit = payloads_[index];
+					if (hit.type != payload_type::dex)
+					{
+						continue;
+					}
+					if (!has_stat || hit.offset > file_stat.m_uncomp_size || hit.size > file_stat.m_uncomp_size - hit.offset)
+					{
+						rejected.emplace_back(hit_name(hit));
+						continue;
+					}
+					slices.hits.emplace_back(&hit);
+					slices.contents.emplace_back(new char[hit.size], std::default_delete<char[]>());
+					slices.copied.emplace_back(0);
+				}
+				first = last;
+				if (slices.hits.empty())
+				{
+					continue;
+				}
+
+				mz_zip_reader_extract_to_callback(&zip_archive, entries_[entry], copy_slices, &slices, 0);
+				for (size_t i = 0; i < slices.hits.size(); i++)
+				{
+					const auto& hit = *slices.hits[i];
+					if (slices.copied[i] == hit.size &&
+					    is_loadable_dex(reinterpret_cast<const uint8_t*>(slices.contents[i].get()), hit.size))
+					{
+						dexes.emplace_back(hit_name(hit), slices.contents[i], hit.size);
+					}
+					else
+					{
+						rejected.emplace_back(hit_name(hit));
+					}
+				}
+			}
+			mz_zip_reader_end(&zip_archive);
+			return dexes;
+		}
+	};
+} // namespace andromeda
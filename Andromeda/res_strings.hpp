@@ -0,0 +1,187 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "utils.hpp"
+#include "thread_pool.hpp"
+
+#include "slicer/chronometer.h"
+
+namespace andromeda
+{
+	// Attribute and text values of every binary XML under res/ (layouts, xml configs, menus ...).
+	// The entries are inflated straight from the archive and decoded in parallel,
+	// each worker with its own zip reader; the values are merged in archive order
+	// into one deduplicated pool which remembers the files each string came from.
+	class res_strings
+	{
+		utils::zip_source source_;
+		bool collected_ = false;
+
+		std::vector<std::string> files_{};
+		std::vector<std::string> strings_pool{};
+		std::vector<std::vector<uint32_t>> sources_{}; // indexes into files_, per string
+
+		// values of one document, in order and without duplicates
+		static void decode_xml(char* content, const size_t size, std::vector<std::string>& values)
+		{
+			// compiled XML starts with a RES_XML_TYPE chunk, anything else (raw files) is skipped
+			if (size < 8 || content[0] != 0x03 || content[1] != 0x00)
+			{
+				return;
+			}
+			const auto parser = AxmlOpen(content, size);
+			if (parser == nullptr)
+			{
+				return;
+			}
+
+			std::unordered_set<std::string> seen{};
+			const auto add_value = [&](const char* raw)
+			{
+				if (raw == nullptr || raw[0] == '\0')
+				{
+					return;
+				}
+				auto current_string = utils::strip(raw);
+				if (!current_string.empty() && seen.insert(current_string).second)
+				{
+					values.emplace_back(std::move(current_string));
+				}
+			};
+
+			auto event = AE_UNINITIALIZED;
+			while ((event = AxmlNext(parser)) != AE_ENDDOC && event != AE_ERROR)
+			{
+				if (event == AE_STARTTAG)
+				{
+					const auto attr_count = AxmlGetAttrCount(parser);
+					for (uint32_t i = 0; i < attr_count; i++)
+					{
+						add_value(AxmlGetAttrString(parser, i));
+					}
+				}
+				else if (event == AE_TEXT)
+				{
+					add_value(AxmlGetText(parser));
+				}
+			}
+			AxmlClose(parser);
+		}
+
+		void collect()
+		{
+			collected_ = true;
+
+			mz_zip_archive zip_archive;
+			if (!source_.open(zip_archive))
+			{
+				return;
+			}
+
+			std::vector<mz_uint> entries{};
+			const auto file_count = mz_zip_reader_get_num_files(&zip_archive);
+			for (mz_uint i = 0; i < file_count; i++)
+			{
+				mz_zip_archive_file_stat file_stat;
+				if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat) ||
+				    mz_zip_reader_is_file_a_directory(&zip_archive, i))
+				{
+					continue;
+				}
+				const std::string file_name{file_stat.m_filename};
+				if (utils::starts_with(file_name, "res/") && utils::ends_with(file_name, ".xml"))
+				{
+					entries.emplace_back(i);
+					files_.emplace_back(file_name);
+				}
+			}
+			mz_zip_reader_end(&zip_archive);
+
+			// miniz readers can't be shared between threads, every worker opens the archive once
+			auto& pool = worker_pool();
+			std::vector<std::unique_ptr<mz_zip_archive>> readers(pool.size());
+			std::vector<std::vector<std::string>> values(entries.size());
+			pool.parallel_for(entries.size(), 4, [&](const size_t index, const size_t worker_index)
+			{
+				auto& reader = readers[worker_index];
+				if (reader == nullptr)
+				{
+					reader.reset(new mz_zip_archive);
+					if (!source_.open(*reader))
+					{
+						return;
+					}
+				}
+				if (reader->m_zip_mode != MZ_ZIP_MODE_READING)
+				{
+					return;
+				}
+
+				size_t size = 0;
+				const auto content = static_cast<char*>(mz_zip_reader_extract_to_heap(reader.get(), entries[index], &size, 0));
+				if (content != nullptr)
+				{
+					decode_xml(content, size, values[index]);
+					mz_free(content);
+				}
+			});
+			for (auto& reader : readers)
+			{
+				if (reader != nullptr && reader->m_zip_mode == MZ_ZIP_MODE_READING)
+				{
+					mz_zip_reader_end(reader.get());
+				}
+			}
+
+			std::unordered_map<std::string, uint32_t> string_ids{};
+			for (size_t file = 0; file < values.size(); file++)
+			{
+				for (auto& value : values[file])
+				{
+					const auto [found, inserted] = string_ids.emplace(value, static_cast<uint32_t>(strings_pool.size()));
+					if (inserted)
+					{
+						strings_pool.emplace_back(std::move(value));
+						sources_.emplace_back();
+					}
+					sources_[found->second].emplace_back(static_cast<uint32_t>(file));
+				}
+			}
+		}
+
+	public:
+		explicit res_strings(const utils::zip_source& source) : source_(source)
+		{
+		}
+
+		// same interface as the dex strings
+		const std::vector<std::string>& get_strings()
+		{
+			if (!collected_)
+			{
+				collect();
+			}
+			return strings_pool;
+		}
+
+		// the files (indexes for get_file) the string "index" appears in
+		const std::vector<uint32_t>& get_sources(const size_t index)
+		{
+			get_strings();
+			return sources_[index];
+		}
+
+		const std::string& get_file(const uint32_t file_index) const
+		{
+			return files_[file_index];
+		}
+
+		size_t file_count()
+		{
+			get_strings();
+			return files_.size();
+		}
+	};
+} // namespace andromeda
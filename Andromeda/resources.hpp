@@ -0,0 +1,690 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <unordered_map>
+
+#include "utils.hpp"
+
+namespace andromeda
+{
+	// resources.arsc reader.
+	// The file is mapped and only the chunk headers are walked when it is opened: packages, types and
+	// configurations are indexed by id, so resolving 0xPPTTEEEE is a few array accesses.
+	// Entries are read in place on lookup and the string pools decode a string the first time it is used,
+	// which also means a table must not be shared between threads.
+	class resource_table
+	{
+	public:
+		// Res_value
+		struct value
+		{
+			uint8_t type = 0;
+			uint32_t data = 0;
+		};
+
+	private:
+		using string_pool = std::unique_ptr<AxmlStringPool_t, void (*)(AxmlStringPool_t*)>;
+
+		static constexpr uint16_t chunk_string_pool = 0x0001;
+		static constexpr uint16_t chunk_table = 0x0002;
+		static constexpr uint16_t chunk_package = 0x0200;
+		static constexpr uint16_t chunk_type = 0x0201;
+
+		static constexpr uint8_t type_null = 0x00;
+		static constexpr uint8_t type_reference = 0x01;
+		static constexpr uint8_t type_attribute = 0x02;
+		static constexpr uint8_t type_string = 0x03;
+		static constexpr uint8_t type_float = 0x04;
+		static constexpr uint8_t type_dimension = 0x05;
+		static constexpr uint8_t type_fraction = 0x06;
+		static constexpr uint8_t type_dynamic_reference = 0x07;
+		static constexpr uint8_t type_int_dec = 0x10;
+		static constexpr uint8_t type_int_hex = 0x11;
+		static constexpr uint8_t type_boolean = 0x12;
+		static constexpr uint8_t type_first_color = 0x1c;
+		static constexpr uint8_t type_last_color = 0x1f;
+
+		// ResTable_type::flags
+		static constexpr uint8_t type_flag_sparse = 0x01;
+		static constexpr uint8_t type_flag_offset16 = 0x02;
+
+		// ResTable_entry::flags
+		static constexpr uint16_t entry_flag_complex = 0x0001;
+		static constexpr uint16_t entry_flag_compact = 0x0008;
+
+		static constexpr uint32_t no_entry = 0xffffffff;
+		static constexpr size_t max_reference_depth = 8;
+		static constexpr size_t max_resolved_values = 4096;
+
+		// the ids being resolved (to stop on cycles) and the work done so far, a crafted table
+		// with bags of bags would otherwise expand exponentially
+		struct resolve_state
+		{
+			std::vector<uint32_t> path;
+			bool in_bag = false;
+			size_t values = 0;
+		};
+
+		// one ResTable_type chunk (the entries of a type for one configuration)
+		struct type_config
+		{
+			const uint8_t* offsets = nullptr;
+			const uint8_t* entries = nullptr;
+			const uint8_t* end = nullptr;
+			uint32_t entry_count = 0;
+			uint8_t flags = 0;
+		};
+
+		struct package
+		{
+			uint32_t id = 0;
+			std::string name{};
+			string_pool type_strings{nullptr, AxmlStringPoolClose};
+			string_pool key_strings{nullptr, AxmlStringPoolClose};
+			// indexed by type id - 1, the default configuration comes first
+			std::vector<std::vector<type_config>> types{};
+		};
+
+		size_t size_ = 0; // set by the mapping, before data_ is initialized
+		std::shared_ptr<const uint8_t> data_{};
+		string_pool strings_{nullptr, AxmlStringPoolClose};
+		std::vector<package> packages_{};
+		std::array<int, 256> package_slots_{};
+
+		// built on the first name lookup
+		bool names_indexed_ = false;
+		std::unordered_map<std::string, uint32_t> names_{};
+		std::vector<uint32_t> string_owners_{};
+
+		static uint16_t read16(const uint8_t* p)
+		{
+			uint16_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		static uint32_t read32(const uint8_t* p)
+		{
+			uint32_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		static const char* pool_string(const string_pool& pool, const uint32_t index)
+		{
+			if (pool == nullptr)
+			{
+				return "";
+			}
+			return AxmlStringPoolGet(pool.get(), index);
+		}
+
+		void index_type(package& owner, const uint8_t* chunk, const uint32_t chunk_size)
+		{
+			const auto header_size = read16(chunk + 2);
+			if (header_size < 20 || header_size > chunk_size)
+			{
+				return;
+			}
+
+			type_config config{};
+			const auto type_id = chunk[8];
+			config.flags = chunk[9];
+			config.entry_count = read32(chunk + 12);
+			const auto entries_start = read32(chunk + 16);
+
+			const uint64_t offsets_size = uint64_t{config.entry_count} *
+				((config.flags & type_flag_offset16) && !(config.flags & type_flag_sparse) ? 2 : 4);
+			if (type_id == 0 || entries_start > chunk_size || header_size + offsets_size > chunk_size)
+			{
+				return;
+			}
+			config.offsets = chunk + header_size;
+			config.entries = chunk + entries_start;
+			config.end = chunk + chunk_size;
+
+			// ResTable_config: everything after its size field is zero for the default configuration
+			auto is_default = true;
+			if (header_size >= 24)
+			{
+				const auto config_end = std::min<uint64_t>(header_size, 20 + uint64_t{read32(chunk + 20)});
+				for (auto p = chunk + 24; p < chunk + config_end; p++)
+				{
+					if (*p != 0)
+					{
+						is_default = false;
+						break;
+					}
+				}
+			}
+
+			if (owner.types.size() < type_id)
+			{
+				owner.types.resize(type_id);
+			}
+			auto& configs = owner.types[type_id - 1];
+			if (is_default)
+			{
+				configs.insert(configs.begin(), config);
+			}
+			else
+			{
+				configs.emplace_back(config);
+			}
+		}
+
+		void index_package(const uint8_t* chunk, const uint32_t chunk_size)
+		{
+			// ResTable_package: header, id, name[128], typeStrings, lastPublicType, keyStrings, lastPublicKey
+			const auto header_size = read16(chunk + 2);
+			const auto id = read32(chunk + 8);
+			if (header_size < 284 || header_size > chunk_size || id > 0xff || package_slots_[id] >= 0)
+			{
+				return;
+			}
+
+			package current{};
+			current.id = id;
+			for (auto i = 0; i < 128; i++)
+			{
+				const auto c = read16(chunk + 12 + i * 2);
+				if (c == 0)
+				{
+					break;
+				}
+				current.name += c < 0x80 ? static_cast<char>(c) : '?';
+			}
+
+			const auto type_strings = read32(chunk + 268);
+			const auto key_strings = read32(chunk + 276);
+			if (type_strings != 0 && type_strings < chunk_size)
+			{
+				current.type_strings.reset(AxmlStringPoolOpen(reinterpret_cast<const char*>(chunk + type_strings),
+				                                              chunk_size - type_strings));
+			}
+			if (key_strings != 0 && key_strings < chunk_size)
+			{
+				current.key_strings.reset(AxmlStringPoolOpen(reinterpret_cast<const char*>(chunk + key_strings),
+				                                             chunk_size - key_strings));
+			}
+
+			const auto end = chunk + chunk_size;
+			for (auto sub_chunk = chunk + header_size; end - sub_chunk >= 8;)
+			{
+				const auto sub_size = read32(sub_chunk + 4);
+				if (sub_size < 8 || sub_size > static_cast<size_t>(end - sub_chunk))
+				{
+					break;
+				}
+				if (read16(sub_chunk) == chunk_type)
+				{
+					index_type(current, sub_chunk, sub_size);
+				}
+				sub_chunk += sub_size;
+			}
+
+			package_slots_[id] = static_cast<int>(packages_.size());
+			packages_.emplace_back(std::move(current));
+		}
+
+		void parse()
+		{
+			const auto data = data_.get();
+			const auto size = size_;
+			if (size < 12 || read16(data) != chunk_table)
+			{
+				return;
+			}
+			const auto header_size = read16(data + 2);
+			const auto table_size = read32(data + 4);
+			if (header_size < 12 || table_size > size || header_size > table_size)
+			{
+				return;
+			}
+
+			const auto end = data + table_size;
+			for (auto chunk = data + header_size; end - chunk >= 8;)
+			{
+				const auto chunk_size = read32(chunk + 4);
+				if (chunk_size < 8 || chunk_size > static_cast<size_t>(end - chunk))
+				{
+					break;
+				}
+
+				const auto type = read16(chunk);
+				if (type == chunk_string_pool && strings_ == nullptr)
+				{
+					strings_.reset(AxmlStringPoolOpen(reinterpret_cast<const char*>(chunk), chunk_size));
+				}
+				else if (type == chunk_package)
+				{
+					index_package(chunk, chunk_size);
+				}
+				chunk += chunk_size;
+			}
+		}
+
+		// offset of an entry from the start of the entries, or no_entry
+		static uint32_t entry_offset(const type_config& config, const uint32_t index)
+		{
+			if (config.flags & type_flag_sparse)
+			{
+				// sorted (index, offset / 4) pairs
+				uint32_t low = 0;
+				uint32_t high = config.entry_count;
+				while (low < high)
+				{
+					const auto middle = low + (high - low) / 2;
+					const auto current = read16(config.offsets + middle * 4);
+					if (current == index)
+					{
+						return read16(config.offsets + middle * 4 + 2) * 4u;
+					}
+					if (current < index)
+					{
+						low = middle + 1;
+					}
+					else
+					{
+						high = middle;
+					}
+				}
+				return no_entry;
+			}
+
+			if (index >= config.entry_count)
+			{
+				return no_entry;
+			}
+			if (config.flags & type_flag_offset16)
+			{
+				const auto offset = read16(config.offsets + index * 2);
+				return offset == 0xffff ? no_entry : offset * 4u;
+			}
+			return read32(config.offsets + index * 4);
+		}
+
+		// ResTable_entry of "id" in the first configuration that defines it
+		const uint8_t* find_entry(const uint32_t id, const type_config** owner = nullptr) const
+		{
+			const auto slot = package_slots_[id >> 24];
+			if (slot < 0)
+			{
+				return nullptr;
+			}
+			const auto& types = packages_[slot].types;
+			const auto type_id = (id >> 16) & 0xff;
+			if (type_id == 0 || type_id > types.size())
+			{
+				return nullptr;
+			}
+
+			for (const auto& config : types[type_id - 1])
+			{
+				const auto offset = entry_offset(config, id & 0xffff);
+				if (offset == no_entry || offset > static_cast<size_t>(config.end - config.entries) ||
+				    config.end - (config.entries + offset) < 8)
+				{
+					continue;
+				}
+				if (owner != nullptr)
+				{
+					*owner = &config;
+				}
+				return config.entries + offset;
+			}
+			return nullptr;
+		}
+
+		static uint32_t entry_key(const uint8_t* entry)
+		{
+			return read16(entry + 2) & entry_flag_compact ? read16(entry) : read32(entry + 4);
+		}
+
+		// false for bags (styles, arrays, plurals ...)
+		static bool entry_value(const uint8_t* entry, const uint8_t* end, value& out)
+		{
+			const auto flags = read16(entry + 2);
+			if (flags & entry_flag_compact)
+			{
+				out.type = static_cast<uint8_t>(flags >> 8);
+				out.data = read32(entry + 4);
+				return true;
+			}
+			if (flags & entry_flag_complex)
+			{
+				return false;
+			}
+
+			const auto size = read16(entry);
+			if (size < 8 || end - entry < size + 8)
+			{
+				out = value{};
+				return true;
+			}
+			out.type = entry[size + 3];
+			out.data = read32(entry + size + 4);
+			return true;
+		}
+
+		static std::string format_id(const uint32_t id)
+		{
+			char buffer[16]{};
+			snprintf(buffer, sizeof(buffer), "@%08X", id);
+			return buffer;
+		}
+
+		std::string format_value(const value& current, resolve_state& state) const
+		{
+			static const float radix_table[] = {0.00390625f, 3.051758E-005f, 1.192093E-007f, 4.656613E-010f};
+			static const char* dimension_table[] = {"px", "dip", "sp", "pt", "in", "mm", "", ""};
+			static const char* fraction_table[] = {"%", "%p", "", "", "", "", "", ""};
+
+			char buffer[64]{};
+			switch (current.type)
+			{
+			case type_null:
+				return "";
+			case type_reference:
+			case type_dynamic_reference:
+				if (current.data == 0)
+				{
+					return "@null";
+				}
+				if (state.path.size() < max_reference_depth && state.values < max_resolved_values &&
+					std::find(state.path.begin(), state.path.end(), current.data) == state.path.end() &&
+					find_entry(current.data) != nullptr)
+				{
+					return resolve(current.data, state);
+				}
+				return format_id(current.data);
+			case type_attribute:
+				snprintf(buffer, sizeof(buffer), "?%08X", current.data);
+				break;
+			case type_string:
+				return pool_string(strings_, current.data);
+			case type_float:
+			{
+				float number;
+				memcpy(&number, &current.data, sizeof(number));
+				snprintf(buffer, sizeof(buffer), "%g", number);
+				break;
+			}
+			case type_dimension:
+				snprintf(buffer, sizeof(buffer), "%f%s",
+				         static_cast<float>(current.data & 0xffffff00) * radix_table[(current.data >> 4) & 0x03],
+				         dimension_table[current.data & 0x0f]);
+				break;
+			case type_fraction:
+				snprintf(buffer, sizeof(buffer), "%f%s",
+				         static_cast<float>(current.data & 0xffffff00) * radix_table[(current.data >> 4) & 0x03],
+				         fraction_table[current.data & 0x0f]);
+				break;
+			case type_int_dec:
+				snprintf(buffer, sizeof(buffer), "%d", static_cast<int32_t>(current.data));
+				break;
+			case type_int_hex:
+				snprintf(buffer, sizeof(buffer), "0x%08x", current.data);
+				break;
+			case type_boolean:
+				return current.data != 0 ? "true" : "false";
+			default:
+				if (current.type >= type_first_color && current.type <= type_last_color)
+				{
+					snprintf(buffer, sizeof(buffer), "#%08x", current.data);
+				}
+				else
+				{
+					snprintf(buffer, sizeof(buffer), "0x%08x", current.data);
+				}
+				break;
+			}
+			return buffer;
+		}
+
+		// ResTable_map_entry followed by "count" (name, Res_value) pairs
+		std::string format_bag(const uint8_t* entry, const uint8_t* end, resolve_state& state) const
+		{
+			const auto size = read16(entry);
+			if (size < 16 || end - entry < size)
+			{
+				return "[]";
+			}
+			const auto count = read32(entry + 12);
+
+			std::string result = "[";
+			auto map = entry + size;
+			for (uint32_t i = 0; i < count && end - map >= 12; i++, map += 12)
+			{
+				if (i != 0)
+				{
+					result += ", ";
+				}
+				if (++state.values > max_resolved_values)
+				{
+					result += "...";
+					break;
+				}
+				value item{};
+				item.type = map[7];
+				item.data = read32(map + 8);
+				result += format_value(item, state);
+			}
+			result += ']';
+			return result;
+		}
+
+		std::string resolve(const uint32_t id, resolve_state& state) const
+		{
+			const type_config* config = nullptr;
+			const auto entry = find_entry(id, &config);
+			if (entry == nullptr)
+			{
+				return "";
+			}
+			state.values++;
+			value current{};
+			std::string result;
+			state.path.push_back(id);
+			if (entry_value(entry, config->end, current))
+			{
+				result = format_value(current, state);
+			}
+			else if (state.in_bag)
+			{
+				// a bag inside a bag is only named
+				result = format_id(id);
+			}
+			else
+			{
+				state.in_bag = true;
+				result = format_bag(entry, config->end, state);
+				state.in_bag = false;
+			}
+			state.path.pop_back();
+			return result;
+		}
+
+		void index_names()
+		{
+			names_indexed_ = true;
+			if (strings_ != nullptr)
+			{
+				string_owners_.assign(AxmlStringPoolCount(strings_.get()), 0);
+			}
+
+			for (const auto& current : packages_)
+			{
+				for (size_t type = 0; type < current.types.size(); type++)
+				{
+					for (const auto& config : current.types[type])
+					{
+						const auto sparse = (config.flags & type_flag_sparse) != 0;
+						for (uint32_t i = 0; i < config.entry_count && i <= 0xffff; i++)
+						{
+							const auto index = sparse ? read16(config.offsets + i * 4) : i;
+							const auto offset = entry_offset(config, index);
+							if (offset == no_entry || offset > static_cast<size_t>(config.end - config.entries) ||
+							    config.end - (config.entries + offset) < 8)
+							{
+								continue;
+							}
+
+							const auto id = current.id << 24 | static_cast<uint32_t>(type + 1) << 16 | index;
+							names_.emplace(get_name(id), id);
+
+							value item{};
+							if (entry_value(config.entries + offset, config.end, item) && item.type == type_string &&
+							    item.data < string_owners_.size() && string_owners_[item.data] == 0)
+							{
+								string_owners_[item.data] = id;
+							}
+						}
+					}
+				}
+			}
+		}
+
+	public:
+		explicit resource_table(const std::string& arsc_path) : data_(utils::map_file(arsc_path, size_))
+		{
+			package_slots_.fill(-1);
+			if (data_ != nullptr)
+			{
+				parse();
+			}
+		}
+
+		// a table which is already in memory, ex. inflated from a nested APK
+		resource_table(std::shared_ptr<const uint8_t> data, const size_t size) : size_(size), data_(std::move(data))
+		{
+			package_slots_.fill(-1);
+			if (data_ != nullptr)
+			{
+				parse();
+			}
+		}
+
+		// No copy/move semantics
+		resource_table(const resource_table&) = delete;
+		resource_table& operator=(const resource_table&) = delete;
+
+		bool is_valid() const
+		{
+			return !packages_.empty();
+		}
+
+		size_t package_count() const
+		{
+			return packages_.size();
+		}
+
+		size_t string_count() const
+		{
+			return strings_ == nullptr ? 0 : AxmlStringPoolCount(strings_.get());
+		}
+
+		// global string pool, the values of string resources
+		const char* get_string(const size_t index) const
+		{
+			return pool_string(strings_, static_cast<uint32_t>(index));
+		}
+
+		// value of "id" in its default configuration, false if it doesn't exist or is a bag
+		bool get_value(const uint32_t id, value& out) const
+		{
+			const type_config* config = nullptr;
+			const auto entry = find_entry(id, &config);
+			return entry != nullptr && entry_value(entry, config->end, out);
+		}
+
+		// "type/key", prefixed with the package name outside of the application package
+		std::string get_name(const uint32_t id) const
+		{
+			const auto slot = package_slots_[id >> 24];
+			const auto entry = find_entry(id);
+			if (slot < 0 || entry == nullptr)
+			{
+				return "";
+			}
+			const auto& owner = packages_[slot];
+
+			std::string name{};
+			if (owner.id != 0x7f && !owner.name.empty())
+			{
+				name = owner.name + ':';
+			}
+			name += pool_string(owner.type_strings, ((id >> 16) & 0xff) - 1);
+			name += '/';
+			name += pool_string(owner.key_strings, entry_key(entry));
+			return name;
+		}
+
+		// the value as text, references are followed
+		std::string resolve(const uint32_t id) const
+		{
+			resolve_state state;
+			return resolve(id, state);
+		}
+
+		// "@string/app_name", "string/app_name" or "android:string/ok"
+		bool find(std::string name, uint32_t& id)
+		{
+			if (!names_indexed_)
+			{
+				index_names();
+			}
+			if (!name.empty() && name[0] == '@')
+			{
+				name.erase(0, 1);
+			}
+			const auto found = names_.find(name);
+			if (found == names_.end())
+			{
+				return false;
+			}
+			id = found->second;
+			return true;
+		}
+
+		// first string resource whose value is the global string "index", 0 if none
+		uint32_t string_owner(const size_t index)
+		{
+			if (!names_indexed_)
+			{
+				index_names();
+			}
+			return index < string_owners_.size() ? string_owners_[index] : 0;
+		}
+
+		// "@7F0A0001" (as printed for binary XML attributes), "@android:01040000", "0x7f0a0001" or "7f0a0001"
+		static bool parse_id(std::string text, uint32_t& id)
+		{
+			if (!text.empty() && text[0] == '@')
+			{
+				text.erase(0, 1);
+			}
+			if (utils::starts_with(text, "android:"))
+			{
+				text.erase(0, 8);
+			}
+			if (text.empty() || text.size() > 10)
+			{
+				return false;
+			}
+			char* end = nullptr;
+			const auto parsed = strtoul(text.c_str(), &end, 16);
+			if (end == nullptr || *end != '\0' || parsed > 0xffffffff)
+			{
+				return false;
+			}
+			id = static_cast<uint32_t>(parsed);
+			return true;
+		}
+	};
+} // namespace andromeda
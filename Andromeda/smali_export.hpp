@@ -0,0 +1,366 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_set>
+
+#include "utils.hpp"
+#include "dex.hpp"
+#include "thread_pool.hpp"
+
+#include "slicer/chronometer.h"
+
+namespace andromeda
+{
+	// Writes batches of files from a dedicated thread, so the disassembly workers never wait for the disk.
+	// The amount of queued data is bounded, producers block when the writer falls behind.
+	class async_file_writer
+	{
+	public:
+		struct file_entry
+		{
+			std::string path;
+			std::string content;
+		};
+
+		using batch = std::vector<file_entry>;
+
+	private:
+		static constexpr size_t max_queued_bytes = 256 * 1024 * 1024;
+
+		std::mutex lock_;
+		std::condition_variable batch_ready_;
+		std::condition_variable space_ready_;
+		std::deque<batch> batches_;
+		size_t queued_bytes_ = 0;
+		bool finished_ = false;
+
+		std::unordered_set<std::string> created_dirs_;
+		size_t bytes_written_ = 0;
+		size_t files_written_ = 0;
+		size_t failures_ = 0;
+
+		std::thread thread_;
+
+		static size_t batch_size(const batch& files)
+		{
+			size_t size = 0;
+			for (const auto& file : files)
+			{
+				size += file.content.size();
+			}
+			return size;
+		}
+
+		void write_entry(const file_entry& file)
+		{
+			const auto parent = fs::path(file.path).parent_path().string();
+			if (created_dirs_.insert(parent).second)
+			{
+				std::error_code error;
+				fs::create_directories(parent, error);
+			}
+
+			if (utils::write_file(file.path, file.content.data(), file.content.size()))
+			{
+				bytes_written_ += file.content.size();
+				files_written_++;
+			}
+			else
+			{
+				failures_++;
+			}
+		}
+
+		void writer_loop()
+		{
+			while (true)
+			{
+				batch current;
+				{
+					std::unique_lock<std::mutex> guard(lock_);
+					batch_ready_.wait(guard, [this] { return finished_ || !batches_.empty(); });
+					if (batches_.empty())
+					{
+						return;
+					}
+					current = std::move(batches_.front());
+					batches_.pop_front();
+				}
+
+				const auto size = batch_size(current);
+				for (const auto& file : current)
+				{
+					write_entry(file);
+				}
+
+				{
+					std::lock_guard<std::mutex> guard(lock_);
+					queued_bytes_ -= size;
+				}
+				space_ready_.notify_all();
+			}
+		}
+
+	public:
+		async_file_writer() : thread_(&async_file_writer::writer_loop, this)
+		{
+		}
+
+		~async_file_writer()
+		{
+			finish();
+		}
+
+		// No copy/move semantics
+		async_file_writer(const async_file_writer&) = delete;
+		async_file_writer& operator=(const async_file_writer&) = delete;
+
+		void push(batch&& files)
+		{
+			if (files.empty())
+			{
+				return;
+			}
+			const auto size = batch_size(files);
+			{
+				std::unique_lock<std::mutex> guard(lock_);
+				space_ready_.wait(guard, [this, size]
+				{
+					return queued_bytes_ == 0 || queued_bytes_ + size <= max_queued_bytes;
+				});
+				queued_bytes_ += size;
+				batches_.emplace_back(std::move(files));
+			}
+			batch_ready_.notify_one();
+		}
+
+		// waits until every queued batch is on disk
+		void finish()
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock_);
+				finished_ = true;
+			}
+			batch_ready_.notify_one();
+			if (thread_.joinable())
+			{
+				thread_.join();
+			}
+		}
+
+		size_t bytes_written() const
+		{
+			return bytes_written_;
+		}
+
+		size_t files_written() const
+		{
+			return files_written_;
+		}
+
+		size_t failures() const
+		{
+			return failures_;
+		}
+	};
+
+	// lexically normalized "path" ("." and ".." segments resolved) is "base" or a path under it
+	inline bool is_path_under(const std::string& base, const std::string& path)
+	{
+		const auto normalize = [](const std::string& full_path)
+		{
+			std::vector<std::string> segments;
+			std::istringstream stream(full_path);
+			std::string segment;
+			while (std::getline(stream, segment, '/'))
+			{
+				if (segment.empty() || segment == ".")
+				{
+					continue;
+				}
+				if (segment == "..")
+				{
+					if (!segments.empty() && segments.back() != "..")
+					{
+						segments.pop_back();
+					}
+					else
+					{
+						segments.emplace_back(segment);
+					}
+					continue;
+				}
+				segments.emplace_back(segment);
+			}
+			return segments;
+		};
+
+		if (!base.empty() && !path.empty() && (base[0] == '/') != (path[0] == '/'))
+		{
+			return false;
+		}
+		const auto base_segments = normalize(base);
+		const auto path_segments = normalize(path);
+		return path_segments.size() >= base_segments.size() &&
+			std::equal(base_segments.begin(), base_segments.end(), path_segments.begin());
+	}
+
+	// "Lcom/example/Foo$Bar;" -> "out_dir/com/example/Foo$Bar.smali", empty when the descriptor
+	// (from an untrusted dex) can't be a relative path under "out_dir": a leading '/', empty,
+	// "." or ".." segments, '\\', control chars or a NUL (MUTF-8 encodes it as C0 80)
+	inline std::string smali_file_path(const std::string& out_dir, const char* descriptor, const size_t descriptor_size)
+	{
+		std::string relative;
+		if (descriptor_size > 2 && descriptor[0] == 'L' && descriptor[descriptor_size - 1] == ';')
+		{
+			relative.assign(descriptor + 1, descriptor_size - 2);
+		}
+		else
+		{
+			relative.assign(descriptor, descriptor_size);
+		}
+
+		if (relative.empty() || relative.front() == '/' || relative.back() == '/')
+		{
+			return {};
+		}
+		for (size_t i = 0; i < relative.size(); i++)
+		{
+			const auto c = static_cast<unsigned char>(relative[i]);
+			if (c == '\\' || c < 0x20 || (c == 0xc0 && i + 1 < relative.size() &&
+				static_cast<unsigned char>(relative[i + 1]) == 0x80))
+			{
+				return {};
+			}
+		}
+		std::istringstream stream(relative);
+		std::string segment;
+		while (std::getline(stream, segment, '/'))
+		{
+			if (segment.empty() || segment == "." || segment == "..")
+			{
+				return {};
+			}
+		}
+
+		auto path = out_dir + '/' + relative + ".smali";
+		if (!is_path_under(out_dir, path))
+		{
+			return {};
+		}
+		return path;
+	}
+
+	// Disassembles every class of "dexes" into one file per class under "out_dir".
+	// Classes are spread over the worker pool, each worker keeps its own dissasembler
+	// (and code IR) per dex file and hands the finished files to the writer in batches.
+	inline void export_smali(std::vector<parsed_dex>& dexes, const std::string& out_dir)
+	{
+		static constexpr size_t batch_bytes = 4 * 1024 * 1024;
+		static constexpr size_t batch_files = 256;
+
+		std::vector<std::pair<size_t, ir::Class*>> classes{};
+		std::vector<std::shared_ptr<ir::DexFile>> dex_irs{};
+		for (size_t i = 0; i < dexes.size(); i++)
+		{
+			// the IR has to be complete before the workers start reading it
+			auto dex_ir = dexes[i].get_full_ir();
+			dex_irs.emplace_back(dex_ir);
+			for (const auto& ir_class : dex_ir->classes)
+			{
+				classes.emplace_back(i, ir_class.get());
+			}
+		}
+
+		struct worker_state
+		{
+			std::vector<std::unique_ptr<DexDissasembler>> disassemblers;
+			async_file_writer::batch files;
+			size_t bytes = 0;
+			size_t rejected = 0;
+		};
+
+		auto& pool = worker_pool();
+		std::vector<worker_state> workers(pool.size());
+		for (auto& worker : workers)
+		{
+			worker.disassemblers.resize(dexes.size());
+		}
+
+		double elapsed_ms = 0;
+		size_t bytes_written = 0;
+		size_t files_written = 0;
+		size_t failures = 0;
+		{
+			slicer::Chronometer chrono(elapsed_ms);
+			async_file_writer writer;
+
+			pool.parallel_for(classes.size(), 16, [&](const size_t index, const size_t worker_index)
+			{
+				auto& worker = workers[worker_index];
+				const auto [dex_index, ir_class] = classes[index];
+
+				auto& disasm = worker.disassemblers[dex_index];
+				if (disasm == nullptr)
+				{
+					disasm.reset(new DexDissasembler(dex_irs[dex_index], DexDissasembler::CfgType::None, false));
+				}
+
+				const auto descriptor = ir_class->type->descriptor->c_str();
+				async_file_writer::file_entry file{};
+				file.path = smali_file_path(out_dir, descriptor, strlen(descriptor));
+				if (file.path.empty())
+				{
+					worker.rejected++;
+					return;
+				}
+				disasm->DumpClass(ir_class, file.content);
+
+				worker.bytes += file.content.size();
+				worker.files.emplace_back(std::move(file));
+				if (worker.bytes >= batch_bytes || worker.files.size() >= batch_files)
+				{
+					writer.push(std::move(worker.files));
+					worker.files = {};
+					worker.bytes = 0;
+				}
+			});
+
+			for (auto& worker : workers)
+			{
+				writer.push(std::move(worker.files));
+			}
+			writer.finish();
+
+			bytes_written = writer.bytes_written();
+			files_written = writer.files_written();
+			failures = writer.failures();
+		}
+		size_t rejected = 0;
+		for (const auto& worker : workers)
+		{
+			rejected += worker.rejected;
+		}
+		failures += rejected;
+
+		const auto size_mb = bytes_written / (1024.0 * 1024.0);
+		const auto seconds = elapsed_ms / 1000.0;
+		color::color_printf(color::FG_GREEN, "Exported %zu classes (%.2f MB) to %s\n",
+		                    files_written, size_mb, out_dir.c_str());
+		color::color_printf(color::FG_DARK_GRAY, "\t%.2f ms, %.1f MB/s, %.0f classes/s, %zu threads\n",
+		                    elapsed_ms, seconds > 0 ? size_mb / seconds : 0.0,
+		                    seconds > 0 ? files_written / seconds : 0.0, pool.size());
+		if (failures != 0)
+		{
+			color::color_printf(color::FG_LIGHT_RED, "Failed to write %zu files\n", failures);
+		}
+		if (rejected != 0)
+		{
+			color::color_printf(color::FG_LIGHT_RED, "\t%zu of them have a name which isn't a path under %s\n",
+			                    rejected, out_dir.c_str());
+		}
+	}
+} // namespace andromeda
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <condition_variable>
+
+namespace andromeda
+{
+	// A small work-stealing pool: every worker owns a deque, pops work from its back
+	// and steals from the front of the other deques when it runs dry.
+	// Tasks get the index of the worker running them, so callers can keep per-thread state.
+	class thread_pool
+	{
+	public:
+		using task = std::function<void(size_t worker_index)>;
+
+	private:
+		struct work_queue
+		{
+			std::mutex lock;
+			std::deque<task> tasks;
+		};
+
+		std::vector<std::unique_ptr<work_queue>> queues_;
+		std::vector<std::thread> workers_;
+
+		std::mutex state_lock_;
+		std::condition_variable work_available_;
+		std::condition_variable work_done_;
+		size_t queued_ = 0;
+		size_t unfinished_ = 0;
+		bool stop_ = false;
+
+		std::atomic<size_t> next_queue_{0};
+
+		bool pop_task(const size_t worker_index, task& current)
+		{
+			// own queue first (LIFO, cache friendly) ...
+			{
+				auto& own = *queues_[worker_index];
+				std::lock_guard<std::mutex> guard(own.lock);
+				if (!own.tasks.empty())
+				{
+					current = std::move(own.tasks.back());
+					own.tasks.pop_back();
+					return true;
+				}
+			}
+			// ... then steal the oldest task of a victim
+			for (size_t i = 1; i < queues_.size(); i++)
+			{
+				auto& victim = *queues_[(worker_index + i) % queues_.size()];
+				std::lock_guard<std::mutex> guard(victim.lock);
+				if (!victim.tasks.empty())
+				{
+					current = std::move(victim.tasks.front());
+					victim.tasks.pop_front();
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void worker_loop(const size_t worker_index)
+		{
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> guard(state_lock_);
+					work_available_.wait(guard, [this] { return stop_ || queued_ > 0; });
+					if (stop_ && queued_ == 0)
+					{
+						return;
+					}
+				}
+
+				task current;
+				if (!pop_task(worker_index, current))
+				{
+					continue;
+				}
+				{
+					std::lock_guard<std::mutex> guard(state_lock_);
+					--queued_;
+				}
+
+				current(worker_index);
+
+				std::lock_guard<std::mutex> guard(state_lock_);
+				if (--unfinished_ == 0)
+				{
+					work_done_.notify_all();
+				}
+			}
+		}
+
+	public:
+		explicit thread_pool(size_t threads = std::thread::hardware_concurrency())
+		{
+			if (threads == 0)
+			{
+				threads = 1;
+			}
+			for (size_t i = 0; i < threads; i++)
+			{
+				queues_.emplace_back(new work_queue);
+			}
+			for (size_t i = 0; i < threads; i++)
+			{
+				workers_.emplace_back(&thread_pool::worker_loop, this, i);
+			}
+		}
+
+		~thread_pool()
+		{
+			{
+				std::lock_guard<std::mutex> guard(state_lock_);
+				stop_ = true;
+			}
+			work_available_.notify_all();
+			for (auto& worker : workers_)
+			{
+				worker.join();
+			}
+		}
+
+		// No copy/move semantics
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		size_t size() const
+		{
+			return workers_.size();
+		}
+
+		void submit(task new_task)
+		{
+			// account for the task before it becomes visible to the workers
+			{
+				std::lock_guard<std::mutex> guard(state_lock_);
+				++queued_;
+				++unfinished_;
+			}
+			auto& queue = *queues_[next_queue_++ % queues_.size()];
+			{
+				std::lock_guard<std::mutex> guard(queue.lock);
+				queue.tasks.emplace_back(std::move(new_task));
+			}
+			work_available_.notify_one();
+		}
+
+		// blocks until every submitted task has finished
+		// (must not be called from a task running on the pool)
+		void wait()
+		{
+			std::unique_lock<std::mutex> guard(state_lock_);
+			work_done_.wait(guard, [this] { return unfinished_ == 0; });
+		}
+
+		// runs "body(index, worker_index)" for every index in [0, count), in chunks of "grain" indexes
+		template <typename Body>
+		void parallel_for(const size_t count, const size_t grain, Body body)
+		{
+			const auto chunk = grain == 0 ? 1 : grain;
+			for (size_t begin = 0; begin < count; begin += chunk)
+			{
+				const auto end = std::min(count, begin + chunk);
+				submit([begin, end, &body](const size_t worker_index)
+				{
+					for (auto i = begin; i < end; i++)
+					{
+						body(i, worker_index);
+					}
+				});
+			}
+			wait();
+		}
+	};
+
+	// process wide pool, created on first use
+	inline thread_pool& worker_pool()
+	{
+		static thread_pool pool;
+		return pool;
+	}
+
+	// task(0) ... task(count - 1) on the process wide pool, in the shape of slicer's
+	// parallel callbacks (dex::Writer::ParallelFor, slicer::BatchInstrumenter::ParallelFor)
+	inline void pool_for(const size_t count, const std::function<void(size_t)>& task)
+	{
+		worker_pool().parallel_for(count, 1, [&task](const size_t i, size_t)
+		{
+			task(i);
+		});
+	}
+} // namespace andromeda
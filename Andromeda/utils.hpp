@@ -7,6 +7,10 @@
 #include <fstream>
 #include <iterator>
 #include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <experimental/filesystem>
 namespace fs = std::experimental::filesystem;
 
@@ -45,6 +49,126 @@ namespace utils
 		return in_buff;
 	}
 
+	// read-only view of a whole file, pages are loaded on access
+	class mapped_file
+	{
+		char* data_ = nullptr;
+		size_t size_ = 0;
+
+	public:
+		explicit mapped_file(const std::string& file_path)
+		{
+			const auto fd = open(file_path.c_str(), O_RDONLY);
+			if (fd < 0)
+			{
+				return;
+			}
+			struct stat file_stat{};
+			if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+			{
+				const auto mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (mapping != MAP_FAILED)
+				{
+					data_ = static_cast<char*>(mapping);
+					size_ = file_stat.st_size;
+				}
+			}
+			close(fd);
+		}
+
+		~mapped_file()
+		{
+			if (data_ != nullptr)
+			{
+				munmap(data_, size_);
+			}
+		}
+
+		// No copy/move semantics
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		bool is_valid() const
+		{
+			return data_ != nullptr;
+		}
+
+		const char* data() const
+		{
+			return data_;
+		}
+
+		size_t size() const
+		{
+			return size_;
+		}
+	};
+
+	// the whole file mapped, nullptr if it can't be; the mapping lives as long as the returned pointer
+	inline std::shared_ptr<const uint8_t> map_file(const std::string& file_path, size_t& size)
+	{
+		const auto file = std::make_shared<const mapped_file>(file_path);
+		size = file->size();
+		if (!file->is_valid())
+		{
+			return nullptr;
+		}
+		return std::shared_ptr<const uint8_t>(file, reinterpret_cast<const uint8_t*>(file->data()));
+	}
+
+	// a zip archive which is a file on disk or an image in memory (ex. an APK nested in a bundle)
+	class zip_source
+	{
+		std::string name_{};
+		std::shared_ptr<const uint8_t> data_{};
+		size_t size_ = 0;
+
+	public:
+		zip_source() = default;
+
+		zip_source(const std::string& file_path) : name_(file_path)
+		{
+		}
+
+		// "name" is only used to show where the data comes from
+		zip_source(const std::string& name, std::shared_ptr<const uint8_t> data, const size_t size)
+			: name_(name), data_(std::move(data)), size_(size)
+		{
+		}
+
+		const std::string& name() const
+		{
+			return name_;
+		}
+
+		bool in_memory() const
+		{
+			return data_ != nullptr;
+		}
+
+		// a reader on the archive, to be closed with mz_zip_reader_end when this returns true
+		bool open(mz_zip_archive& zip_archive) const
+		{
+			memset(&zip_archive, 0, sizeof(zip_archive));
+			if (in_memory())
+			{
+				return mz_zip_reader_init_mem(&zip_archive, data_.get(), size_, 0);
+			}
+			return mz_zip_reader_init_file(&zip_archive, name_.c_str(), 0);
+		}
+
+		// the bytes of the whole archive, mapped when it's a file
+		std::shared_ptr<const uint8_t> map(size_t& size) const
+		{
+			if (in_memory())
+			{
+				size = size_;
+				return data_;
+			}
+			return map_file(name_, size);
+		}
+	};
+
 	inline bool write_file(const std::string& file_path, const char* content, const size_t content_size)
 	{
 		const auto out_file = fopen(file_path.c_str(), "wb");
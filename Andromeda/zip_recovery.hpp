@@ -0,0 +1,400 @@
+#pragma once
+
+#include <unordered_set>
+
+#include "utils.hpp"
+#include "thread_pool.hpp"
+
+#include "slicer/chronometer.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace andromeda
+{
+	// an entry found from its local header
+	struct recovered_entry
+	{
+		std::string name{};
+		uint64_t header_offset = 0;
+		uint64_t data_offset = 0;
+		uint64_t end = 0; // after the data (and the data descriptor)
+		uint16_t method = 0; // as written in the header
+		uint16_t flags = 0;
+		bool deflated = false; // how the data was read
+		uint32_t crc = 0;
+		uint64_t compressed_size = 0;
+		uint64_t size = 0;
+		std::vector<std::string> notes{}; // what didn't match the header
+	};
+
+	// Reads a zip without its central directory (damaged or removed to break the tools), from the local
+	// file headers found by a linear scan of the mapped file. The header values are handled like the platform
+	// does (libziparchive): the encryption flag is ignored, every method but stored is inflated, and the
+	// sizes come from the data itself, the end of the deflate stream or of the stored bytes.
+	class zip_recovery
+	{
+		static constexpr uint32_t local_header_magic = 0x04034b50;
+		static constexpr uint32_t central_header_magic = 0x02014b50;
+		static constexpr uint32_t data_descriptor_magic = 0x08074b50;
+		static constexpr size_t local_header_size = 30;
+		static constexpr size_t chunk_size = 4 * 1024 * 1024; // of the signature search, per task
+
+		std::string path_;
+		std::vector<recovered_entry> entries_{};
+		size_t candidates_ = 0;
+		double elapsed_ms_ = 0;
+
+		static uint16_t read_u16(const uint8_t* p)
+		{
+			return static_cast<uint16_t>(p[0] | p[1] << 8);
+		}
+
+		static uint32_t read_u32(const uint8_t* p)
+		{
+			uint32_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		static uint64_t read_u64(const uint8_t* p)
+		{
+			uint64_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		// offsets of "PK\3\4" starting in [begin, end), the bytes up to end + 3 can be read
+		static void find_signatures(const uint8_t* data, const size_t size, const size_t begin, const size_t end, std::vector<uint64_t>& found)
+		{
+			auto i = begin;
+#if defined(__SSE2__)
+			// 'P' at i and 'K' at i + 1, both lanes compared at once, 16 positions per step
+			const auto p = _mm_set1_epi8('P');
+			const auto k = _mm_set1_epi8('K');
+			for (; i + 16 <= end && i + 17 <= size; i += 16)
+			{
+				const auto first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+				const auto second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+				auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, p), _mm_cmpeq_epi8(second, k))));
+				while (mask != 0)
+				{
+					const auto offset = i + __builtin_ctz(mask);
+					if (offset + 4 <= size && read_u32(data + offset) == local_header_magic)
+					{
+						found.emplace_back(offset);
+					}
+					mask &= mask - 1;
+				}
+			}
+#elif defined(__ARM_NEON)
+			const auto p = vdupq_n_u8('P');
+			const auto k = vdupq_n_u8('K');
+			for (; i + 16 <= end && i + 17 <= size; i += 16)
+			{
+				const auto matches = vandq_u8(vceqq_u8(vld1q_u8(data + i), p), vceqq_u8(vld1q_u8(data + i + 1), k));
+				// 4 bits per byte
+				auto mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+				while (mask != 0)
+				{
+					const auto lane = __builtin_ctzll(mask) >> 2;
+					const auto offset = i + lane;
+					if (offset + 4 <= size && read_u32(data + offset) == local_header_magic)
+					{
+						found.emplace_back(offset);
+					}
+					mask &= ~(uint64_t{0xf} << (lane * 4));
+				}
+			}
+#endif
+			for (; i < end; i++)
+			{
+				if (data[i] == 'P' && i + 4 <= size && read_u32(data + i) == local_header_magic)
+				{
+					found.emplace_back(i);
+				}
+			}
+		}
+
+		// bytes from begin up to end, or up to the central directory if it starts before
+		static uint64_t gap_size(const uint8_t* data, const uint64_t begin, const uint64_t end)
+		{
+			for (auto i = begin; i + 4 <= end; i++)
+			{
+				if (data[i] == 'P' && read_u32(data + i) == central_header_magic)
+				{
+					return i - begin;
+				}
+			}
+			return end - begin;
+		}
+
+		// raw deflate from "data" until the end of the stream, false if it's not one
+		static bool inflate_raw(const uint8_t* data, const size_t size, uint64_t& consumed, uint64_t& output_size, uint32_t& crc)
+		{
+			tinfl_decompressor inflator;
+			tinfl_init(&inflator);
+			std::vector<uint8_t> dictionary(TINFL_LZ_DICT_SIZE);
+			size_t input = 0;
+			size_t output = 0;
+			output_size = 0;
+			crc = MZ_CRC32_INIT;
+			while (true)
+			{
+				auto input_size = size - input;
+				auto output_chunk = dictionary.size() - output;
+				const auto status = tinfl_decompress(&inflator, data + input, &input_size, dictionary.data(),
+				                                     dictionary.data() + output, &output_chunk, 0);
+				input += input_size;
+				crc = static_cast<uint32_t>(mz_crc32(crc, dictionary.data() + output, output_chunk));
+				output_size += output_chunk;
+				output = (output + output_chunk) & (dictionary.size() - 1);
+				if (status == TINFL_STATUS_DONE)
+				{
+					consumed = input;
+					return true;
+				}
+				if (status != TINFL_STATUS_HAS_MORE_OUTPUT)
+				{
+					return false;
+				}
+			}
+		}
+
+		// the entry at a signature, next is the following signature (or the end of the file)
+		static bool read_entry(const uint8_t* data, const size_t size, const uint64_t offset, const uint64_t next, recovered_entry& entry)
+		{
+			if (offset + local_header_size > size)
+			{
+				return false;
+			}
+			const auto header = data + offset;
+			const auto name_size = read_u16(header + 26);
+			const auto extra_size = read_u16(header + 28);
+			entry.header_offset = offset;
+			entry.data_offset = offset + local_header_size + name_size + extra_size;
+			if (name_size == 0 || entry.data_offset > size)
+			{
+				return false;
+			}
+			entry.name.assign(reinterpret_cast<const char*>(header + local_header_size), name_size);
+			if (entry.name.find('\0') != std::string::npos)
+			{
+				return false;
+			}
+			// "/x" can't be added to a zip, the platform doesn't care
+			while (!entry.name.empty() && entry.name.front() == '/')
+			{
+				entry.name.erase(0, 1);
+				entry.notes.emplace_back("leading slash removed");
+			}
+			if (entry.name.empty())
+			{
+				return false;
+			}
+
+			entry.flags = read_u16(header + 6);
+			entry.method = read_u16(header + 8);
+			const auto header_crc = read_u32(header + 14);
+			uint64_t header_compressed = read_u32(header + 18);
+			uint64_t header_size = read_u32(header + 22);
+			// zip64 sizes
+			const auto extra = header + local_header_size + name_size;
+			for (size_t i = 0; i + 4 <= extra_size;)
+			{
+				const auto id = read_u16(extra + i);
+				const auto field_size = read_u16(extra + i + 2);
+				if (id == 0x0001 && field_size >= 16 && i + 4 + field_size <= extra_size)
+				{
+					header_size = read_u64(extra + i + 4);
+					header_compressed = read_u64(extra + i + 12);
+				}
+				i += 4 + field_size;
+			}
+			if (entry.flags & 1)
+			{
+				entry.notes.emplace_back("encryption flag ignored");
+			}
+
+			const auto available = size - entry.data_offset;
+			const auto content = data + entry.data_offset;
+			auto read = false;
+			if (entry.method != 0)
+			{
+				// anything but stored is inflated
+				read = inflate_raw(content, available, entry.compressed_size, entry.size, entry.crc);
+				entry.deflated = read;
+				if (read && entry.method != 8)
+				{
+					char note[64]{};
+					snprintf(note, sizeof(note), "method %u read as deflate", entry.method);
+					entry.notes.emplace_back(note);
+				}
+			}
+			if (!read)
+			{
+				if (entry.method != 0)
+				{
+					char note[64]{};
+					snprintf(note, sizeof(note), "method %u isn't deflate, read as stored", entry.method);
+					entry.notes.emplace_back(note);
+				}
+				// the header size if it fits, or everything up to the next header (or the central directory)
+				auto gap = gap_size(data, entry.data_offset, std::max(next, entry.data_offset));
+				if ((entry.flags & 8) != 0 && gap >= 16 && read_u32(content + gap - 16) == data_descriptor_magic)
+				{
+					gap -= 16;
+				}
+				else if ((entry.flags & 8) != 0 && gap >= 12 && read_u32(content + gap - 8) == gap - 12)
+				{
+					gap -= 12;
+				}
+				const auto is_known = (entry.flags & 8) == 0 && header_compressed <= available && (header_compressed != 0 || gap == 0);
+				entry.compressed_size = is_known ? header_compressed : gap;
+				entry.size = entry.compressed_size;
+				entry.crc = static_cast<uint32_t>(mz_crc32(MZ_CRC32_INIT, content, entry.compressed_size));
+			}
+			entry.end = entry.data_offset + entry.compressed_size;
+
+			if ((entry.flags & 8) != 0)
+			{
+				// data descriptor, with or without its signature
+				if (entry.end + 4 <= size && read_u32(data + entry.end) == data_descriptor_magic)
+				{
+					entry.end += 4;
+				}
+				const uint64_t descriptor_size = header_size >= 0xffffffff || header_compressed >= 0xffffffff ? 20 : 12;
+				entry.end = std::min<uint64_t>(entry.end + descriptor_size, next > entry.end ? next : size);
+			}
+			else if (header_compressed != entry.compressed_size || header_size != entry.size || header_crc != entry.crc)
+			{
+				entry.notes.emplace_back("size or crc in the header don't match the data");
+			}
+			return true;
+		}
+
+	public:
+		explicit zip_recovery(const std::string& path) : path_(path)
+		{
+		}
+
+		// indexes the entries from the local headers, false if there is none
+		bool scan()
+		{
+			entries_.clear();
+			slicer::Chronometer chrono(elapsed_ms_);
+			size_t size = 0;
+			const auto mapping = utils::map_file(path_, size);
+			if (mapping == nullptr)
+			{
+				return false;
+			}
+			const auto data = mapping.get();
+
+			auto& pool = worker_pool();
+			const auto chunks = (size + chunk_size - 1) / chunk_size;
+			std::vector<std::vector<uint64_t>> found(chunks);
+			pool.parallel_for(chunks, 1, [&](const size_t chunk, size_t)
+			{
+				const auto begin = chunk * chunk_size;
+				find_signatures(data, size, begin, std::min(size, begin + chunk_size), found[chunk]);
+			});
+			std::vector<uint64_t> signatures{};
+			for (const auto& chunk : found)
+			{
+				signatures.insert(signatures.end(), chunk.begin(), chunk.end());
+			}
+			candidates_ = signatures.size();
+
+			// every candidate is read on its own, the ones inside the data of an earlier entry
+			// (ex. a stored APK in the assets) are dropped after
+			std::vector<recovered_entry> candidates(signatures.size());
+			std::vector<char> valid(signatures.size(), 0);
+			pool.parallel_for(signatures.size(), 1, [&](const size_t index, size_t)
+			{
+				const auto next = index + 1 < signatures.size() ? signatures[index + 1] : size;
+				valid[index] = read_entry(data, size, signatures[index], next, candidates[index]);
+			});
+			uint64_t covered = 0;
+			for (size_t i = 0; i < candidates.size(); i++)
+			{
+				if (valid[i] && candidates[i].header_offset >= covered)
+				{
+					covered = candidates[i].end;
+					entries_.emplace_back(std::move(candidates[i]));
+				}
+			}
+			return !entries_.empty();
+		}
+
+		const std::vector<recovered_entry>& get_entries() const
+		{
+			return entries_;
+		}
+
+		// "PK\3\4" signatures found, entries or not
+		size_t candidate_count() const
+		{
+			return candidates_;
+		}
+
+		// a new archive in memory with the entries of the last scan and a valid central directory,
+		// the compressed data is copied as is; invalid source if nothing could be added
+		utils::zip_source rebuild() const
+		{
+			size_t size = 0;
+			const auto mapping = utils::map_file(path_, size);
+			if (mapping == nullptr || entries_.empty())
+			{
+				return {};
+			}
+
+			mz_zip_archive writer;
+			memset(&writer, 0, sizeof(writer));
+			if (!mz_zip_writer_init_heap(&writer, 0, size))
+			{
+				return {};
+			}
+			std::unordered_set<std::string> names{};
+			size_t added = 0;
+			for (const auto& entry : entries_)
+			{
+				// the first one wins, like the platform's lookup
+				if (!names.insert(entry.name).second)
+				{
+					continue;
+				}
+				const auto content = mapping.get() + entry.data_offset;
+				const auto is_added = entry.deflated
+					? mz_zip_writer_add_mem_ex(&writer, entry.name.c_str(), content, entry.compressed_size, nullptr, 0,
+					                           MZ_ZIP_FLAG_COMPRESSED_DATA, entry.size, entry.crc)
+					: mz_zip_writer_add_mem_ex(&writer, entry.name.c_str(), content, entry.compressed_size, nullptr, 0,
+					                           MZ_NO_COMPRESSION, 0, 0);
+				added += is_added;
+			}
+
+			void* archive = nullptr;
+			size_t archive_size = 0;
+			const auto finalized = mz_zip_writer_finalize_heap_archive(&writer, &archive, &archive_size);
+			mz_zip_writer_end(&writer);
+			if (!finalized || added == 0)
+			{
+				mz_free(archive);
+				return {};
+			}
+			const std::shared_ptr<const uint8_t> image(static_cast<const uint8_t*>(archive), [](const uint8_t* p)
+			{
+				mz_free(const_cast<uint8_t*>(p));
+			});
+			return utils::zip_source(path_ + " (recovered)", image, archive_size);
+		}
+
+		double get_elapsed_ms() const
+		{
+			return elapsed_ms_;
+		}
+	};
+} // namespace andromeda
@@ -9,6 +9,10 @@
 #include <string.h>
 #include <stdarg.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #ifdef _WIN32	/* Windows */
 
 #pragma warning(disable:4996)
@@ -61,16 +65,33 @@ enum {
 	ATTR_LASTINT = 31,
 };
 
+/* memory block of the string pool arena, the string bytes follow the header */
+typedef struct StringBlock {
+	struct StringBlock* next;
+	size_t size;
+	size_t used;
+} StringBlock_t;
+
+#define STRING_BLOCK_SIZE (64 * 1024)
+
 /* string table */
-typedef struct {
+/* the offsets and the raw strings are read in place from the input buffer,
+ * strings are decoded into the arena blocks on first access */
+struct AxmlStringPool {
 	uint32_t count;		/* count of all strings */
-	uint32_t* offsets;	/* each string's offset in raw data block */
+	const unsigned char* offsets;	/* each string's offset in raw data block (in the input) */
 
-	unsigned char* data;	/* raw data block, contains all strings encoded by UTF-16LE */
+	const unsigned char* data;	/* raw data block, strings encoded by UTF-16LE or UTF-8 (in the input) */
 	size_t len;		/* length of raw data block */
+	unsigned char isUTF8;	/* string pool encoding */
 
-	unsigned char** strings;/* string table, point to strings encoded by UTF-8 */
-} StringTable_t;
+	char** strings;		/* decoded UTF-8 strings, NULL until first access */
+	StringBlock_t* blocks;	/* arena owning the decoded strings */
+
+	char emptyString[1];	/* returned for out of range string ids */
+};
+
+typedef AxmlStringPool_t StringTable_t;
 
 /* attribute structure within tag */
 typedef struct {
@@ -95,12 +116,17 @@ typedef struct NsRecord {
 } NsRecord_t;
 
 /* a parser, also a axml parser handle for user */
-typedef struct {
+/* all the parsing state lives here (no globals), so any number of
+ * documents can be parsed at the same time, one parser per document */
+struct AxmlParser {
 	unsigned char* buf;	/* origin raw data, to be parsed */
 	size_t size;		/* size of raw data */
 	size_t cur;		/* current parsing position in raw data */
 
+	AxmlEvent_t event;	/* last event returned by AxmlNext() */
+
 	StringTable_t* st;
+	char emptyString[1];	/* returned for out of range string ids */
 
 	NsRecord_t* nsList;
 	int nsNew;		/* if a new namespace coming */
@@ -110,10 +136,11 @@ typedef struct {
 	uint32_t text;		/* when tag is text, its content */
 
 	AttrStack_t* attr;	/* attributes */
-} Parser_t;
+};
+
+typedef AxmlParser_t Parser_t;
 
 #define UTF8_FLAG (1 << 8)
-unsigned char isUTF8 = 0;
 
 /* get a 4-byte integer, and mark as parsed */
 /* uses byte oprations to avoid little or big-endian conflict */
@@ -122,19 +149,11 @@ GetInt32(Parser_t* ap)
 {
 	uint32_t value = 0;
 	unsigned char* p = ap->buf + ap->cur;
-	value = p[0] | p[1] << 8 | p[2] << 16 | p[3] << 24;
+	value = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
 	ap->cur += 4;
 	return value;
 }
 
-static void
-CopyData(Parser_t* ap, unsigned char* to, size_t size)
-{
-	memcpy(to, ap->buf + ap->cur, size);
-	ap->cur += size;
-	return;
-}
-
 /* skip some uknown of useless fields, don't parse them */
 static void
 SkipInt32(Parser_t* ap, size_t num)
@@ -150,11 +169,18 @@ NoMoreData(Parser_t* ap)
 	return ap->cur >= ap->size;
 }
 
+/* if "num" more 4-byte fields fit before "end" (the end of the current chunk) */
+static int
+HasInt32(Parser_t* ap, size_t end, uint64_t num)
+{
+	return ap->cur <= end && (end - ap->cur) / 4 >= num;
+}
+
 static int
 ParseHeadChunk(Parser_t* ap)
 {
 	/* file magic */
-	if (GetInt32(ap) != CHUNK_HEAD)
+	if (!HasInt32(ap, ap->size, 2) || GetInt32(ap) != CHUNK_HEAD)
 	{
 		fprintf(stderr, "Error: not valid AXML file.\n");
 		return -1;
@@ -170,91 +196,108 @@ ParseHeadChunk(Parser_t* ap)
 	return 0;
 }
 
-static int
-ParseStringChunk(Parser_t* ap)
+static uint32_t
+ReadInt32(const unsigned char* p)
 {
-	uint32_t chunkSize;
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+AxmlStringPool_t*
+AxmlStringPoolOpen(const char* chunk, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)chunk;
+	StringTable_t* st;
 
+	uint32_t chunkSize;
+	uint32_t headerSize;
+	uint32_t count;
 	uint32_t styleCount;
+	uint32_t flags;
 	uint32_t stringOffset;
 	uint32_t styleOffset;
 
-	uint32_t flags;
-
-	size_t i;
-
 	/* chunk type */
-	if (GetInt32(ap) != CHUNK_STRING)
+	if (p == NULL || size < 0x1c || ReadInt32(p) != CHUNK_STRING)
 	{
 		fprintf(stderr, "Error: not valid string chunk.\n");
-		return -1;
+		return NULL;
 	}
 
-	/* chunk size */
-	chunkSize = GetInt32(ap);
+	headerSize = ReadInt32(p) >> 16;
+	chunkSize = ReadInt32(p + 4);
+	count = ReadInt32(p + 8);
+	styleCount = ReadInt32(p + 12);
+	flags = ReadInt32(p + 16);
+	stringOffset = ReadInt32(p + 20);
+	styleOffset = ReadInt32(p + 24);
+
+	if (chunkSize > size || headerSize > chunkSize ||
+		(chunkSize - headerSize) / 4 < (uint64_t)count + styleCount ||
+		stringOffset > chunkSize || styleOffset > chunkSize ||
+		(styleOffset != 0 && styleOffset < stringOffset))
+	{
+		fprintf(stderr, "Error: not valid string chunk.\n");
+		return NULL;
+	}
 
-	/* count of strings */
-	ap->st->count = GetInt32(ap);
+	st = (StringTable_t*)malloc(sizeof(StringTable_t));
+	if (st == NULL)
+	{
+		fprintf(stderr, "Error: init string table struct.\n");
+		return NULL;
+	}
 
-	/* count of styles */
-	styleCount = GetInt32(ap);
+	st->count = count;
+	st->isUTF8 = ((flags & UTF8_FLAG) != 0);
+	st->offsets = p + headerSize;
+	st->data = p + stringOffset;
+	st->len = (styleOffset ? styleOffset : chunkSize) - stringOffset;
+	st->strings = NULL;
+	st->blocks = NULL;
+	st->emptyString[0] = '\0';
 
-	/* flags field */
-	flags = GetInt32(ap);
-	isUTF8 = ((flags & UTF8_FLAG) != 0);
+	return st;
+}
 
-	/* offset of string raw data in chunk */
-	stringOffset = GetInt32(ap);
+uint32_t
+AxmlStringPoolCount(AxmlStringPool_t* st)
+{
+	return st->count;
+}
 
-	/* offset of style w=raw data in chunk */
-	styleOffset = GetInt32(ap);
+void
+AxmlStringPoolClose(AxmlStringPool_t* st)
+{
+	if (st == NULL)
+		return;
 
-	/* strings' offsets table */
-	ap->st->offsets = (uint32_t*)malloc(ap->st->count * sizeof(uint32_t));
-	if (ap->st->offsets == NULL)
+	while (st->blocks != NULL)
 	{
-		fprintf(stderr, "Error: init strings' offsets table.\n");
-		return -1;
+		StringBlock_t* block = st->blocks;
+		st->blocks = block->next;
+		free(block);
 	}
+	free(st->strings);
+	free(st);
+}
 
-	for (i = 0; i < ap->st->count; i++)
-		ap->st->offsets[i] = GetInt32(ap);
+static int
+ParseStringChunk(Parser_t* ap)
+{
+	uint32_t chunkSize;
 
-	/* init string table */
-	ap->st->strings = (unsigned char**)malloc(ap->st->count * sizeof(unsigned char*));
-	if (ap->st->strings == NULL)
+	if (ap->size - ap->cur < 8)
 	{
-		fprintf(stderr, "Error: init string table.\n");
-		free(ap->st->offsets);
-		ap->st->offsets = NULL;
+		fprintf(stderr, "Error: not valid string chunk.\n");
 		return -1;
 	}
-	for (i = 0; i < ap->st->count; i++)
-		ap->st->strings[i] = NULL;
+	chunkSize = ReadInt32(ap->buf + ap->cur + 4);
 
-	/* skip style offset table */
-	if (styleCount != 0)
-		SkipInt32(ap, styleCount);
-
-	/* save string raw data */
-	ap->st->len = (styleOffset ? styleOffset : chunkSize) - stringOffset;
-	ap->st->data = (unsigned char*)malloc(ap->st->len);
-	if (ap->st->data == NULL)
-	{
-		fprintf(stderr, "Error: init string raw data.\n");
-		free(ap->st->strings);
-		ap->st->strings = NULL;
-		free(ap->st->offsets);
-		ap->st->offsets = NULL;
+	ap->st = AxmlStringPoolOpen((const char*)(ap->buf + ap->cur), ap->size - ap->cur);
+	if (ap->st == NULL)
 		return -1;
-	}
-
-	CopyData(ap, ap->st->data, ap->st->len);
-
-	/* skip style raw data */
-	if (styleOffset != 0)
-		SkipInt32(ap, (chunkSize - styleOffset) / 4);
 
+	ap->cur += chunkSize;
 	return 0;
 }
 
@@ -264,7 +307,7 @@ ParseResourceChunk(Parser_t* ap)
 	uint32_t chunkSize;
 
 	/* chunk type */
-	if (GetInt32(ap) != CHUNK_RESOURCE)
+	if (!HasInt32(ap, ap->size, 2) || GetInt32(ap) != CHUNK_RESOURCE)
 	{
 		fprintf(stderr, "Error: not valid resource chunk.\n");
 		return -1;
@@ -272,7 +315,7 @@ ParseResourceChunk(Parser_t* ap)
 
 	/* chunk size */
 	chunkSize = GetInt32(ap);
-	if (chunkSize % 4 != 0)
+	if (chunkSize % 4 != 0 || chunkSize < 8 || chunkSize - 8 > ap->size - ap->cur)
 	{
 		fprintf(stderr, "Error: not valid resource chunk.\n");
 		return -1;
@@ -284,7 +327,7 @@ ParseResourceChunk(Parser_t* ap)
 	return 0;
 }
 
-void*
+AxmlParser_t*
 AxmlOpen(char* buffer, size_t size)
 {
 	Parser_t* ap;
@@ -307,6 +350,11 @@ AxmlOpen(char* buffer, size_t size)
 	ap->size = size;
 	ap->cur = 0;
 
+	/* the first AxmlNext() call goes straight to the first tag */
+	ap->event = AE_STARTDOC;
+
+	ap->emptyString[0] = '\0';
+
 	ap->nsList = NULL;
 	ap->nsNew = 0;
 
@@ -316,57 +364,45 @@ AxmlOpen(char* buffer, size_t size)
 	ap->tagUri = (uint32_t)(-1);
 	ap->text = (uint32_t)(-1);
 
-	ap->st = (StringTable_t*)malloc(sizeof(StringTable_t));
-	if (ap->st == NULL)
-	{
-		fprintf(stderr, "Error: init string table struct.\n");
-		free(ap);
-		return NULL;
-	}
+	ap->st = NULL;
 
 	/* parse first three chunks */
 	if (ParseHeadChunk(ap) != 0 ||
 		ParseStringChunk(ap) != 0 ||
 		ParseResourceChunk(ap) != 0)
 	{
-		free(ap->st);
-		free(ap);
+		AxmlClose(ap);
 		return NULL;
 	}
 
-	return (void*)ap;
+	return ap;
 }
 
 int
-AxmlClose(void* axml)
+AxmlClose(AxmlParser_t* ap)
 {
-	Parser_t* ap;
-	uint32_t i;
-
-	if (axml == NULL)
+	if (ap == NULL)
 	{
 		fprintf(stderr, "Error: AxmlClose get an invalid parameter.\n");
 		return -1;
 	}
 
-	ap = (Parser_t*)axml;
-
-	if (ap->st->data)
-		free(ap->st->data);
-
-	if (ap->st->strings)
+	/* tags and namespaces still open when the document is abandoned */
+	while (ap->attr != NULL)
 	{
-		for (i = 0; i < ap->st->count; i++)
-			if (ap->st->strings[i])
-				free(ap->st->strings[i]);
-		free(ap->st->strings);
+		AttrStack_t* attr = ap->attr;
+		ap->attr = attr->next;
+		free(attr->list);
+		free(attr);
+	}
+	while (ap->nsList != NULL)
+	{
+		NsRecord_t* ns = ap->nsList;
+		ap->nsList = ns->next;
+		free(ns);
 	}
 
-	if (ap->st->offsets)
-		free(ap->st->offsets);
-
-	if (ap->st)
-		free(ap->st);
+	AxmlStringPoolClose(ap->st);
 
 	if (ap)
 		free(ap);
@@ -375,169 +411,250 @@ AxmlClose(void* axml)
 }
 
 AxmlEvent_t
-AxmlNext(void* axml)
+AxmlNext(AxmlParser_t* ap)
 {
-	static AxmlEvent_t event;
-
-	Parser_t* ap;
 	uint32_t chunkType;
+	uint32_t chunkSize;
+	size_t chunkEnd;
 
 	/* when init */
-	if (event == AE_UNINITIALIZED)
+	if (ap->event == AE_UNINITIALIZED)
 	{
-		event = AE_STARTDOC;
-		return event;
+		ap->event = AE_STARTDOC;
+		return ap->event;
 	}
 
-	ap = (Parser_t*)axml;
+	/* the namespace chunks don't make events, they are read until the next chunk which does */
+	for (;;)
+	{
+		/* when buffer ends */
+		if (NoMoreData(ap))
+			ap->event = AE_ENDDOC;
 
-	/* when buffer ends */
-	if (NoMoreData(ap))
-		event = AE_ENDDOC;
+		if (ap->event == AE_ENDDOC || ap->event == AE_ERROR)
+			return ap->event;
 
-	if (event == AE_ENDDOC)
-		return event;
+		/* common chunk head, each field of the chunk is read inside it */
+		chunkEnd = ap->cur;
+		if (!HasInt32(ap, ap->size, 4))
+		{
+			fprintf(stderr, "Error: not complete chunk.\n");
+			ap->event = AE_ERROR;
+			return ap->event;
+		}
+		chunkType = GetInt32(ap);
+		chunkSize = GetInt32(ap);
+		if (chunkSize < 16 || chunkSize > ap->size - chunkEnd)
+		{
+			fprintf(stderr, "Error: not valid chunk size.\n");
+			ap->event = AE_ERROR;
+			return ap->event;
+		}
+		chunkEnd += chunkSize;
+		SkipInt32(ap, 1);	/* line number, unused */
+		SkipInt32(ap, 1);	/* unknown field */
 
-	/* common chunk head */
-	chunkType = GetInt32(ap);
-	SkipInt32(ap, 1);	/* chunk size, unused */
-	SkipInt32(ap, 1);	/* line number, unused */
-	SkipInt32(ap, 1);	/* unknown field */
+		if (chunkType == CHUNK_STARTTAG)
+		{
+			uint32_t i;
+			uint32_t count;
+			AttrStack_t* attr;
 
-	if (chunkType == CHUNK_STARTTAG)
-	{
-		uint32_t i;
-		AttrStack_t* attr;
+			if (!HasInt32(ap, chunkEnd, 5))
+			{
+				fprintf(stderr, "Error: not valid start tag.\n");
+				ap->event = AE_ERROR;
+				return ap->event;
+			}
+			ap->tagUri = GetInt32(ap);
+			ap->tagName = GetInt32(ap);
+			SkipInt32(ap, 1);	/* flags, unknown usage */
 
-		attr = (AttrStack_t*)malloc(sizeof(AttrStack_t));
-		if (attr == NULL)
-		{
-			fprintf(stderr, "Error: init attribute.\n");
-			return AE_ERROR;
-		}
+			count = GetInt32(ap) & 0x0000ffff;
+			SkipInt32(ap, 1);	/* classAttribute, unknown usage */
 
-		ap->tagUri = GetInt32(ap);
-		ap->tagName = GetInt32(ap);
-		SkipInt32(ap, 1);	/* flags, unknown usage */
+			/* the attributes are in the chunk */
+			if (!HasInt32(ap, chunkEnd, (uint64_t)count * 5))
+			{
+				fprintf(stderr, "Error: not valid start tag.\n");
+				ap->event = AE_ERROR;
+				return ap->event;
+			}
 
-		attr->count = GetInt32(ap) & 0x0000ffff;
-		SkipInt32(ap, 1);	/* classAttribute, unknown usage */
+			attr = (AttrStack_t*)malloc(sizeof(AttrStack_t));
+			if (attr == NULL)
+			{
+				fprintf(stderr, "Error: init attribute.\n");
+				return AE_ERROR;
+			}
 
-		attr->list = (Attribute_t*)malloc(
-			attr->count * sizeof(Attribute_t));
-		if (attr->list == NULL)
-		{
-			fprintf(stderr, "Error: init attribute list.\n");
-			free(attr);
-			return AE_ERROR;
-		}
+			attr->count = count;
+			attr->list = (Attribute_t*)malloc(
+				attr->count * sizeof(Attribute_t));
+			if (attr->list == NULL && attr->count != 0)
+			{
+				fprintf(stderr, "Error: init attribute list.\n");
+				free(attr);
+				return AE_ERROR;
+			}
 
-		/* attribute list */
-		for (i = 0; i < attr->count; i++)
-		{
-			attr->list[i].uri = GetInt32(ap);
-			attr->list[i].name = GetInt32(ap);
-			attr->list[i].string = GetInt32(ap);
-			/* note: type must >> 24 */
-			attr->list[i].type = GetInt32(ap) >> 24;
-			attr->list[i].data = GetInt32(ap);
+			/* attribute list */
+			for (i = 0; i < attr->count; i++)
+			{
+				attr->list[i].uri = GetInt32(ap);
+				attr->list[i].name = GetInt32(ap);
+				attr->list[i].string = GetInt32(ap);
+				/* note: type must >> 24 */
+				attr->list[i].type = GetInt32(ap) >> 24;
+				attr->list[i].data = GetInt32(ap);
+			}
+
+			attr->next = ap->attr;
+			ap->attr = attr;
+
+			ap->event = AE_STARTTAG;
 		}
+		else if (chunkType == CHUNK_ENDTAG)
+		{
+			AttrStack_t* attr;
 
-		attr->next = ap->attr;
-		ap->attr = attr;
+			if (!HasInt32(ap, chunkEnd, 2))
+			{
+				fprintf(stderr, "Error: not valid end tag.\n");
+				ap->event = AE_ERROR;
+				return ap->event;
+			}
+			ap->tagUri = GetInt32(ap);
+			ap->tagName = GetInt32(ap);
 
-		event = AE_STARTTAG;
-	}
-	else if (chunkType == CHUNK_ENDTAG)
-	{
-		AttrStack_t* attr;
+			if (ap->attr != NULL)
+			{
+				attr = ap->attr;
+				ap->attr = ap->attr->next;
 
-		ap->tagUri = GetInt32(ap);
-		ap->tagName = GetInt32(ap);
+				free(attr->list);
+				free(attr);
+			}
 
-		if (ap->attr != NULL)
+			ap->event = AE_ENDTAG;
+		}
+		else if (chunkType == CHUNK_STARTNS)
 		{
-			attr = ap->attr;
-			ap->attr = ap->attr->next;
+			NsRecord_t* ns;
 
-			free(attr->list);
-			free(attr);
-		}
+			if (!HasInt32(ap, chunkEnd, 2))
+			{
+				fprintf(stderr, "Error: not valid namespace.\n");
+				ap->event = AE_ERROR;
+				return ap->event;
+			}
+			ns = (NsRecord_t*)malloc(sizeof(NsRecord_t));
+			if (ns == NULL)
+			{
+				fprintf(stderr, "Error: init namespace.\n");
+				return AE_ERROR;
+			}
 
-		event = AE_ENDTAG;
-	}
-	else if (chunkType == CHUNK_STARTNS)
-	{
-		NsRecord_t* ns = (NsRecord_t*)malloc(sizeof(NsRecord_t));
-		if (ns == NULL)
-		{
-			fprintf(stderr, "Error: init namespace.\n");
-			return AE_ERROR;
+			ns->prefix = GetInt32(ap);
+			ns->uri = GetInt32(ap);
+
+			ns->next = ap->nsList;
+			ap->nsList = ns;
+			/* get a new namespace */
+			ap->nsNew = 1;
+
+			/* no event, on to the next chunk */
+			ap->cur = chunkEnd;
+			continue;
 		}
+		else if (chunkType == CHUNK_ENDNS)
+		{
+			NsRecord_t* ns = ap->nsList;
+			if (ns == NULL)
+			{
+				fprintf(stderr, "Error: end a namespace.\n");
+				return AE_ERROR;
+			}
 
-		ns->prefix = GetInt32(ap);
-		ns->uri = GetInt32(ap);
+			/* ended prefix and uri, unused */
 
-		ns->next = ap->nsList;
-		ap->nsList = ns;
-		/* get a new namespace */
-		ap->nsNew = 1;
+			ap->nsList = ns->next;
+			free(ns);
 
-		/* note this recursion rather than return a event*/
-		return AxmlNext(ap);
-	}
-	else if (chunkType == CHUNK_ENDNS)
-	{
-		NsRecord_t* ns = ap->nsList;
-		if (ns == NULL)
+			/* no event, on to the next chunk */
+			ap->cur = chunkEnd;
+			continue;
+		}
+		else if (chunkType == CHUNK_TEXT)
 		{
-			fprintf(stderr, "Error: end a namespace.\n");
-			return AE_ERROR;
+			if (!HasInt32(ap, chunkEnd, 1))
+			{
+				fprintf(stderr, "Error: not valid text.\n");
+				ap->event = AE_ERROR;
+				return ap->event;
+			}
+			ap->text = GetInt32(ap);
+			ap->event = AE_TEXT;	/* two unknown fields after it */
+		}
+		else
+		{
+			ap->event = AE_ERROR;
 		}
 
-		SkipInt32(ap, 1);	/* ended prefix */
-		SkipInt32(ap, 1);	/* ended uri */
-
-		ap->nsList = ns->next;
-		free(ns);
-
-		/* note this recursion rather than return a event*/
-		return AxmlNext(ap);
-	}
-	else if (chunkType == CHUNK_TEXT)
-	{
-		ap->text = GetInt32(ap);
-		SkipInt32(ap, 2);	/* unknown fields */
-		event = AE_TEXT;
-	}
-	else
-	{
-		event = AE_ERROR;
+		/* the next chunk starts where this one ends, whatever its fields were */
+		ap->cur = chunkEnd;
+		return ap->event;
 	}
-
-	return event;
 }
 
-/** \brief Convert UTF-16LE string into UTF-8 string
+/** \brief Convert UTF-16LE string into UTF-8 string, in a single pass
  *
- *  You must call this function with to=NULL firstly to get UTF-8 size;
- *  then you should alloc enough memory to the string;
- *  at last call this function again to convert actually.
- *  \param to Pointer to target UTF-8 string
+ *  Runs of ASCII characters are converted 8 (SSE2) or 4 characters at a time.
+ *  \param to Pointer to target UTF-8 string, at least 3 * nch + 1 bytes
  *  \param from Pointer to source UTF-16LE string
- *  \param nch Count of UTF-16LE characters, including terminal zero
+ *  \param nch Count of UTF-16LE characters, without terminal zero
  *  \retval -1 Converting error.
- *  \retval positive Bytes of UTF-8 string, including terminal zero.
+ *  \retval positive Bytes of UTF-8 string, without terminal zero.
  */
 static size_t
-UTF16LEtoUTF8(unsigned char* to, unsigned char* from, size_t nch)
+UTF16LEtoUTF8(unsigned char* to, const unsigned char* from, size_t nch)
 {
-	size_t total = 0;
+	unsigned char* start = to;
 	while (nch > 0)
 	{
 		uint32_t ucs4;
 		size_t count;
 
+#if defined(__SSE2__)
+		/* 8 ASCII characters: every 16bit unit < 0x80 */
+		while (nch >= 8)
+		{
+			__m128i units = _mm_loadu_si128((const __m128i*)from);
+			__m128i high = _mm_and_si128(units, _mm_set1_epi16((short)0xff80));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xffff)
+				break;
+			_mm_storel_epi64((__m128i*)to, _mm_packus_epi16(units, units));
+			to += 8;
+			from += 16;
+			nch -= 8;
+		}
+#endif
+		/* 4 ASCII characters */
+		while (nch >= 4 &&
+			(from[1] | from[3] | from[5] | from[7]) == 0 &&
+			((from[0] | from[2] | from[4] | from[6]) & 0x80) == 0)
+		{
+			to[0] = from[0];
+			to[1] = from[2];
+			to[2] = from[4];
+			to[3] = from[6];
+			to += 4;
+			from += 8;
+			nch -= 4;
+		}
+		if (nch == 0)
+			break;
+
 		/* utf-16le -> ucs-4, defined in RFC 2781 */
 		ucs4 = from[0] + (from[1] << 8);
 		from += 2;
@@ -563,23 +680,14 @@ UTF16LEtoUTF8(unsigned char* to, unsigned char* from, size_t nch)
 			return -1;
 		}
 
-		/* ucs-4 -> utf-8, defined in RFC 2279 */
+		/* ucs-4 -> utf-8, defined in RFC 2279 (at most 0x10ffff here) */
 		if (ucs4 < 0x80) count = 1;
 		else if (ucs4 < 0x800) count = 2;
 		else if (ucs4 < 0x10000) count = 3;
-		else if (ucs4 < 0x200000) count = 4;
-		else if (ucs4 < 0x4000000) count = 5;
-		else if (ucs4 < 0x80000000) count = 6;
-		else return 0;
-
-		total += count;
-		if (to == NULL)
-			continue;
+		else count = 4;
 
 		switch (count)
 		{
-		case 6: to[5] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0x4000000;
-		case 5:	to[4] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0x200000;
 		case 4: to[3] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0x10000;
 		case 3: to[2] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0x800;
 		case 2: to[1] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0xc0;
@@ -587,72 +695,153 @@ UTF16LEtoUTF8(unsigned char* to, unsigned char* from, size_t nch)
 		}
 		to += count;
 	}
-	if (to != NULL)
-		to[0] = '\0';
-	return total + 1;
+	to[0] = '\0';
+	return to - start;
 }
 
-static char*
-GetString(Parser_t* ap, uint32_t id)
+/* string pool lengths take one unit, or two when the high bit is set
+ * (returns 0 when the length field runs past "end") */
+static int
+GetUTF8Length(const unsigned char** p, const unsigned char* end, size_t* len)
+{
+	if (*p >= end)
+		return 0;
+	*len = (*p)[0];
+	if (*len & 0x80)
+	{
+		if (end - *p < 2)
+			return 0;
+		*len = ((*len & 0x7f) << 8) | (*p)[1];
+		(*p) += 2;
+	}
+	else
+		(*p) += 1;
+	return 1;
+}
+
+static int
+GetUTF16Length(const unsigned char** p, const unsigned char* end, size_t* len)
+{
+	if (end - *p < 2)
+		return 0;
+	*len = (*p)[0] | (*p)[1] << 8;
+	if (*len & 0x8000)
+	{
+		if (end - *p < 4)
+			return 0;
+		*len = ((*len & 0x7fff) << 16) | (*p)[2] | (*p)[3] << 8;
+		(*p) += 4;
+	}
+	else
+		(*p) += 2;
+	return 1;
+}
+
+/* room for "size" bytes at the end of the arena, the string is committed with CommitString() */
+static unsigned char*
+ReserveString(StringTable_t* st, size_t size)
 {
-	static char* emptyString = "";
+	StringBlock_t* block = st->blocks;
+	if (block == NULL || block->size - block->used < size)
+	{
+		size_t blockSize = size > STRING_BLOCK_SIZE ? size : STRING_BLOCK_SIZE;
+		block = (StringBlock_t*)malloc(sizeof(StringBlock_t) + blockSize);
+		if (block == NULL)
+			return NULL;
+		block->size = blockSize;
+		block->used = 0;
+		block->next = st->blocks;
+		st->blocks = block;
+	}
+	return (unsigned char*)(block + 1) + block->used;
+}
 
-	unsigned char* offset;
-	uint16_t chNum;
+static void
+CommitString(StringTable_t* st, size_t size)
+{
+	st->blocks->used += size;
+}
+
+char*
+AxmlStringPoolGet(AxmlStringPool_t* st, uint32_t id)
+{
+	const unsigned char* offset;
+	const unsigned char* end;
+	unsigned char* str;
+	size_t chNum;
 	size_t size;
 
 	/* out of index range */
-	if (id >= ap->st->count)
-		return emptyString;
+	if (id >= st->count)
+		return st->emptyString;
 
 	/* already parsed, directly use previous result */
-	if (ap->st->strings[id] != NULL)
-		return (char*)(ap->st->strings[id]);
+	if (st->strings != NULL && st->strings[id] != NULL)
+		return st->strings[id];
 
-	/* point to string's raw data */
-	offset = ap->st->data + ap->st->offsets[id];
+	if (st->strings == NULL)
+	{
+		st->strings = (char**)calloc(st->count, sizeof(char*));
+		if (st->strings == NULL)
+			return st->emptyString;
+	}
 
-	/* its first 2 bytes is string's characters count */
-	if (isUTF8) {
-		size = *(uint8_t*)offset;
-		chNum = *(uint8_t*)(offset + 1);
-		ap->st->strings[id] = (unsigned char*)malloc(chNum);
-		memcpy(ap->st->strings[id], offset + 2, chNum);
-		//		ap->st->strings[id][chNum] = 0;
+	/* point to string's raw data */
+	size = ReadInt32(st->offsets + 4 * (size_t)id);
+	if (size >= st->len)
+		return st->emptyString;
+	offset = st->data + size;
+	end = st->data + st->len;
+
+	/* the string's length comes first, every length field is checked against the pool end */
+	if (st->isUTF8) {
+		/* count of UTF-16 characters (unused), then the count of UTF-8 bytes */
+		if (!GetUTF8Length(&offset, end, &chNum) || !GetUTF8Length(&offset, end, &size))
+			return st->emptyString;
+		if (offset > end || size > (size_t)(end - offset))
+			return st->emptyString;
+		str = ReserveString(st, size + 1);
+		if (str == NULL)
+			return st->emptyString;
+		memcpy(str, offset, size);
+		str[size] = 0;
 	}
 	else {
-		chNum = *(uint16_t*)offset;
-		size = UTF16LEtoUTF8(NULL, offset + 2, (size_t)chNum);
+		if (!GetUTF16Length(&offset, end, &chNum))
+			return st->emptyString;
+		if (offset > end || chNum > (size_t)(end - offset) / 2)
+			return st->emptyString;
+		str = ReserveString(st, chNum * 3 + 1);
+		if (str == NULL)
+			return st->emptyString;
+		size = UTF16LEtoUTF8(str, offset, chNum);
 		if (size == (size_t)-1)
-			return emptyString;
-		ap->st->strings[id] = (unsigned char*)malloc(size);
-		if (ap->st->strings[id] == NULL)
-			return emptyString;
-
-		UTF16LEtoUTF8(ap->st->strings[id], offset + 2, (size_t)chNum);
+			return st->emptyString;
 	}
 
+	CommitString(st, size + 1);
+	st->strings[id] = (char*)str;
+	return st->strings[id];
+}
 
-	return (char*)(ap->st->strings[id]);
+static char*
+GetString(Parser_t* ap, uint32_t id)
+{
+	return AxmlStringPoolGet(ap->st, id);
 }
 
 char*
-AxmlGetTagName(void* axml)
+AxmlGetTagName(AxmlParser_t* ap)
 {
-	Parser_t* ap;
-	ap = (Parser_t*)axml;
 	return GetString(ap, ap->tagName);
 }
 
 char*
-AxmlGetTagPrefix(void* axml)
+AxmlGetTagPrefix(AxmlParser_t* ap)
 {
-	Parser_t* ap;
 	NsRecord_t* ns;
 	uint32_t nodePrefix = 0xffffffff;
 
-	ap = (Parser_t*)axml;
-
 	for (ns = ap->nsList; ns != NULL; ns = ns->next)
 	{
 		if (ns->uri == ap->tagUri)
@@ -664,30 +853,24 @@ AxmlGetTagPrefix(void* axml)
 }
 
 char*
-AxmlGetText(void* axml)
+AxmlGetText(AxmlParser_t* ap)
 {
-	Parser_t* ap;
-	ap = (Parser_t*)axml;
 	return GetString(ap, ap->text);
 }
 
 uint32_t
-AxmlGetAttrCount(void* axml)
+AxmlGetAttrCount(AxmlParser_t* ap)
 {
-	Parser_t* ap;
-	ap = (Parser_t*)axml;
 	return ap->attr->count;
 }
 
 char*
-AxmlGetAttrPrefix(void* axml, uint32_t i)
+AxmlGetAttrPrefix(AxmlParser_t* ap, uint32_t i)
 {
-	Parser_t* ap;
 	NsRecord_t* ns;
 	uint32_t prefix = 0xffffffff;
 	uint32_t uri;
 
-	ap = (Parser_t*)axml;
 	uri = ap->attr->list[i].uri;
 
 	for (ns = ap->nsList; ns != NULL; ns = ns->next)
@@ -700,26 +883,31 @@ AxmlGetAttrPrefix(void* axml, uint32_t i)
 }
 
 char*
-AxmlGetAttrName(void* axml, uint32_t i)
+AxmlGetAttrName(AxmlParser_t* ap, uint32_t i)
 {
-	Parser_t* ap;
-	ap = (Parser_t*)axml;
 	return GetString(ap, ap->attr->list[i].name);
 }
 
 char*
-AxmlGetAttrValue(void* axml, uint32_t i)
+AxmlGetAttrString(AxmlParser_t* ap, uint32_t i)
 {
-	static float RadixTable[] = { 0.00390625f, 3.051758E-005f, 1.192093E-007f, 4.656613E-010f };
+	if (ap->attr->list[i].type != ATTR_STRING)
+		return NULL;
+
+	return GetString(ap, ap->attr->list[i].string);
+}
+
+char*
+AxmlGetAttrValue(AxmlParser_t* ap, uint32_t i)
+{
+	static const float RadixTable[] = { 0.00390625f, 3.051758E-005f, 1.192093E-007f, 4.656613E-010f };
 	static const char* DimemsionTable[] = { "px", "dip", "sp", "pt", "in", "mm", "", "" };
 	static const char* FractionTable[] = { "%", "%p", "", "", "", "", "", "" };
 
-	Parser_t* ap;
 	uint32_t type;
 	uint32_t data;
 	char* buf;
 
-	ap = (Parser_t*)axml;
 	type = ap->attr->list[i].type;
 
 	if (type == ATTR_STRING)
@@ -804,10 +992,8 @@ AxmlGetAttrValue(void* axml, uint32_t i)
 }
 
 int
-AxmlNewNamespace(void* axml)
+AxmlNewNamespace(AxmlParser_t* ap)
 {
-	Parser_t* ap;
-	ap = (Parser_t*)axml;
 	if (ap->nsNew == 0)
 		return 0;
 	else
@@ -818,21 +1004,50 @@ AxmlNewNamespace(void* axml)
 }
 
 char*
-AxmlGetNsPrefix(void* axml)
+AxmlGetNsPrefix(AxmlParser_t* ap)
 {
-	Parser_t* ap;
-	ap = (Parser_t*)axml;
 	return GetString(ap, ap->nsList->prefix);
 }
 
 char*
-AxmlGetNsUri(void* axml)
+AxmlGetNsUri(AxmlParser_t* ap)
 {
-	Parser_t* ap;
-	ap = (Parser_t*)axml;
 	return GetString(ap, ap->nsList->uri);
 }
 
+uint32_t
+AxmlGetNsCount(AxmlParser_t* ap)
+{
+	uint32_t count = 0;
+	NsRecord_t* ns;
+	for (ns = ap->nsList; ns != NULL; ns = ns->next)
+		count++;
+	return count;
+}
+
+static NsRecord_t*
+GetNsRecord(AxmlParser_t* ap, uint32_t i)
+{
+	NsRecord_t* ns = ap->nsList;
+	while (ns != NULL && i-- > 0)
+		ns = ns->next;
+	return ns;
+}
+
+char*
+AxmlGetNsPrefixAt(AxmlParser_t* ap, uint32_t i)
+{
+	NsRecord_t* ns = GetNsRecord(ap, i);
+	return ns != NULL ? GetString(ap, ns->prefix) : ap->emptyString;
+}
+
+char*
+AxmlGetNsUriAt(AxmlParser_t* ap, uint32_t i)
+{
+	NsRecord_t* ns = GetNsRecord(ap, i);
+	return ns != NULL ? GetString(ap, ns->uri) : ap->emptyString;
+}
+
 typedef struct {
 	char* data;
 	size_t size;
@@ -889,7 +1104,7 @@ PrintToBuff(Buff_t* buf, size_t maxlen, const char* format, ...)
 int
 AxmlToXml(char** outbuf, size_t* outsize, char* inbuf, size_t insize)
 {
-	void* axml;
+	AxmlParser_t* axml;
 	AxmlEvent_t event;
 	Buff_t buf;
 
@@ -900,7 +1115,10 @@ AxmlToXml(char** outbuf, size_t* outsize, char* inbuf, size_t insize)
 
 	axml = AxmlOpen(inbuf, insize);
 	if (axml == NULL)
+	{
+		free(buf.data);
 		return -1;
+	}
 
 	while ((event = AxmlNext(axml)) != AE_ENDDOC)
 	{
@@ -927,8 +1145,7 @@ AxmlToXml(char** outbuf, size_t* outsize, char* inbuf, size_t insize)
 
 			if (AxmlNewNamespace(axml))
 			{
-				Parser_t* ap;
-				ap = (Parser_t*)axml;
+				Parser_t* ap = axml;
 				for (NsRecord_t* ns = ap->nsList; ns != NULL; ns = ns->next)
 				{
 					prefix = GetString(ap, ns->prefix);
@@ -977,6 +1194,7 @@ AxmlToXml(char** outbuf, size_t* outsize, char* inbuf, size_t insize)
 		case AE_ERROR:
 			fprintf(stderr, "Error: AxmlNext() returns a AE_ERROR event.\n");
 			AxmlClose(axml);
+			free(buf.data);
 			return -1;
 			break;
 
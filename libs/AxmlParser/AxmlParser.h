@@ -5,6 +5,7 @@
 #ifndef AXMLPARSER_H
 #define AXMLPARSER_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef enum {
@@ -23,26 +24,54 @@ extern "C" {
 #endif
 #endif
 
-	void* AxmlOpen(char* buffer, size_t size);
+	/* Parser context, holds all the state of one document.
+	 * The parser has no globals: different documents can be parsed
+	 * concurrently as long as each thread uses its own context.
+	 * Returned strings are owned by the context (valid until AxmlClose),
+	 * except for AxmlGetAttrValue() results which must be freed by the caller.
+	 */
+	typedef struct AxmlParser AxmlParser_t;
 
-	AxmlEvent_t AxmlNext(void* axml);
+	AxmlParser_t* AxmlOpen(char* buffer, size_t size);
 
-	char* AxmlGetTagPrefix(void* axml);
-	char* AxmlGetTagName(void* axml);
+	AxmlEvent_t AxmlNext(AxmlParser_t* axml);
 
-	int AxmlNewNamespace(void* axml);
-	char* AxmlGetNsPrefix(void* axml);
-	char* AxmlGetNsUri(void* axml);
+	char* AxmlGetTagPrefix(AxmlParser_t* axml);
+	char* AxmlGetTagName(AxmlParser_t* axml);
 
-	uint32_t AxmlGetAttrCount(void* axml);
-	char* AxmlGetAttrPrefix(void* axml, uint32_t i);
-	char* AxmlGetAttrName(void* axml, uint32_t i);
-	char* AxmlGetAttrValue(void* axml, uint32_t i);
+	int AxmlNewNamespace(AxmlParser_t* axml);
+	char* AxmlGetNsPrefix(AxmlParser_t* axml);
+	char* AxmlGetNsUri(AxmlParser_t* axml);
 
-	char* AxmlGetText(void* axml);
+	/* namespaces in scope, the most recent first */
+	uint32_t AxmlGetNsCount(AxmlParser_t* axml);
+	char* AxmlGetNsPrefixAt(AxmlParser_t* axml, uint32_t i);
+	char* AxmlGetNsUriAt(AxmlParser_t* axml, uint32_t i);
 
-	int AxmlClose(void* axml);
+	uint32_t AxmlGetAttrCount(AxmlParser_t* axml);
+	char* AxmlGetAttrPrefix(AxmlParser_t* axml, uint32_t i);
+	char* AxmlGetAttrName(AxmlParser_t* axml, uint32_t i);
+	char* AxmlGetAttrValue(AxmlParser_t* axml, uint32_t i);
+	/* the value of a string attribute (owned by the context), NULL for other types */
+	char* AxmlGetAttrString(AxmlParser_t* axml, uint32_t i);
 
+	char* AxmlGetText(AxmlParser_t* axml);
+
+	int AxmlClose(AxmlParser_t* axml);
+
+	/* String pool (ResStringPool chunk, as found in binary XML and resources.arsc).
+	 * The pool reads the chunk in place, so "chunk" must outlive it.
+	 * Strings are decoded to UTF-8 on first access and owned by the pool,
+	 * out of range ids give an empty string.
+	 */
+	typedef struct AxmlStringPool AxmlStringPool_t;
+
+	AxmlStringPool_t* AxmlStringPoolOpen(const char* chunk, size_t size);
+	uint32_t AxmlStringPoolCount(AxmlStringPool_t* pool);
+	char* AxmlStringPoolGet(AxmlStringPool_t* pool, uint32_t id);
+	void AxmlStringPoolClose(AxmlStringPool_t* pool);
+
+	/* thread safe, the output buffer must be freed by the caller */
 	int AxmlToXml(char** outbuf, size_t* outsize, char* inbuf, size_t insize);
 
 #ifdef __cplusplus
@@ -4,6 +4,8 @@
 #include <cstdio>
 #include <cstdarg>
 
+#include <unistd.h>
+
 namespace color
 {
 	enum code
@@ -27,15 +29,33 @@ namespace color
 		FG_WHITE = 97
 	};
 
+	// ANSI escape codes only make sense on a terminal, not in a pipe or a file
+	inline bool is_enabled(FILE* stream = stdout)
+	{
+		if (stream == stdout)
+		{
+			static const auto stdout_tty = isatty(fileno(stdout)) != 0;
+			return stdout_tty;
+		}
+		return isatty(fileno(stream)) != 0;
+	}
+
 	inline void color_printf(const code code, const char* __restrict __fmt, ...)
 	{
 		va_list args;
 		va_start(args, __fmt);
 
-		printf("\033[%dm", static_cast<int>(code));
+		const auto enabled = is_enabled();
+		if (enabled)
+		{
+			printf("\033[%dm", static_cast<int>(code));
+		}
 		vprintf(__fmt, args);
 		va_end(args);
-		printf("\033[%dm", static_cast<int>(FG_DEFAULT));
+		if (enabled)
+		{
+			printf("\033[%dm", static_cast<int>(FG_DEFAULT));
+		}
 		// fflush(stdout);
 	}
 } // namespace color
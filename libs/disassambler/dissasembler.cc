@@ -24,28 +24,112 @@
 #include <stdio.h>
 #include <cinttypes>
 #include <cmath>
-#include <sstream>
+#include <cstdarg>
 
 #include "color/color.hpp"
 
 // Builds a human readable method declaration, not including the name, ex:
 // "(android.content.Context, android.content.pm.ActivityInfo) : java.lang.String"
-static std::string MethodDeclaration(const ir::Proto *proto)
+static void AppendMethodDeclaration(std::string &out, const ir::Proto *proto)
 {
-    std::stringstream ss;
-    ss << "(";
+    out += "(";
     if (proto->param_types != nullptr)
     {
         bool first = true;
         for (auto type : proto->param_types->types)
         {
-            ss << (first ? "" : ", ") << type->Decl();
+            if (!first)
+            {
+                out += ", ";
+            }
+            out += type->Decl();
             first = false;
         }
     }
-    ss << "):";
-    ss << proto->return_type->Decl();
-    return ss.str();
+    out += "):";
+    out += proto->return_type->Decl();
+}
+
+// Appends the access flags keywords (ex. "public static final ")
+static void AppendAccessFlags(std::string &out, dex::u4 access_flags, bool is_method)
+{
+    struct Keyword
+    {
+        dex::u4 flag;
+        const char *name;
+    };
+    static const Keyword keywords[] = {
+        {dex::kAccPublic, "public "},
+        {dex::kAccPrivate, "private "},
+        {dex::kAccProtected, "protected "},
+        {dex::kAccStatic, "static "},
+        {dex::kAccFinal, "final "},
+        {dex::kAccAbstract, "abstract "},
+        {dex::kAccInterface, "interface "},
+        {dex::kAccSynthetic, "synthetic "},
+        {dex::kAccAnnotation, "annotation "},
+        {dex::kAccEnum, "enum "},
+    };
+    for (const auto &keyword : keywords)
+    {
+        if ((access_flags & keyword.flag) != 0)
+        {
+            out += keyword.name;
+        }
+    }
+    if (is_method)
+    {
+        if ((access_flags & (dex::kAccSynchronized | dex::kAccDeclaredSynchronized)) != 0)
+        {
+            out += "synchronized ";
+        }
+        if ((access_flags & dex::kAccNative) != 0)
+        {
+            out += "native ";
+        }
+        if ((access_flags & dex::kAccConstructor) != 0)
+        {
+            out += "constructor ";
+        }
+    }
+}
+
+// The output buffer is flushed to the file once it grows past this size
+static constexpr size_t kFlushThreshold = 4 * 1024 * 1024;
+
+void PrintCodeIrVisitor::Print(const char *format, ...)
+{
+    char local[256];
+    va_list args;
+    va_start(args, format);
+    const int written = vsnprintf(local, sizeof(local), format, args);
+    va_end(args);
+    if (written <= 0)
+    {
+        return;
+    }
+    if (static_cast<size_t>(written) < sizeof(local))
+    {
+        out_->append(local, written);
+        return;
+    }
+    const size_t used = out_->size();
+    out_->resize(used + written + 1);
+    va_start(args, format);
+    vsnprintf(&(*out_)[used], written + 1, format, args);
+    va_end(args);
+    out_->resize(used + written);
+}
+
+void PrintCodeIrVisitor::SetColor(int code)
+{
+    if (!colors_)
+    {
+        return;
+    }
+    char escape[8];
+    const int length = snprintf(escape, sizeof(escape), "\033[%dm", code);
+    out_->append(escape, length);
 }
 
 void PrintCodeIrVisitor::StartInstruction(const lir::Instruction *instr)
@@ -57,7 +141,7 @@ void PrintCodeIrVisitor::StartInstruction(const lir::Instruction *instr)
     const lir::BasicBlock &current_block = cfg_->basic_blocks[current_block_index_];
     if (instr == current_block.region.first)
     {
-        printf("............................. begin block %d .............................\n", current_block.id);
+        Print("............................. begin block %d .............................\n", current_block.id);
     }
 }
 
@@ -70,7 +154,7 @@ void PrintCodeIrVisitor::EndInstruction(const lir::Instruction *instr)
     const lir::BasicBlock &current_block = cfg_->basic_blocks[current_block_index_];
     if (instr == current_block.region.last)
     {
-        printf(".............................. end block %d ..............................\n", current_block.id);
+        Print(".............................. end block %d ..............................\n", current_block.id);
         ++current_block_index_;
     }
 }
@@ -78,16 +162,18 @@ void PrintCodeIrVisitor::EndInstruction(const lir::Instruction *instr)
 bool PrintCodeIrVisitor::Visit(lir::Bytecode *bytecode)
 {
     StartInstruction(bytecode);
-    printf("\t%5u| ", bytecode->offset);
-    color::color_printf(color::FG_LIGHT_CYAN, "%s", dex::GetOpcodeName(bytecode->opcode));
+    Print("\t%5u| ", bytecode->offset);
+    SetColor(color::FG_LIGHT_CYAN);
+    Append(dex::GetOpcodeName(bytecode->opcode));
+    SetColor(color::FG_DEFAULT);
     bool first = true;
     for (auto op : bytecode->operands)
     {
-        printf(first ? " " : ", ");
+        Append(first ? " " : ", ");
         op->Accept(this);
         first = false;
     }
-    printf("\n");
+    Append("\n");
     EndInstruction(bytecode);
     return true;
 }
@@ -95,13 +181,11 @@ bool PrintCodeIrVisitor::Visit(lir::Bytecode *bytecode)
 bool PrintCodeIrVisitor::Visit(lir::PackedSwitchPayload *packed_switch)
 {
     StartInstruction(packed_switch);
-    printf("\t%5u| packed-switch-payload\n", packed_switch->offset);
+    Print("\t%5u| packed-switch-payload\n", packed_switch->offset);
     int key = packed_switch->first_key;
     for (auto target : packed_switch->targets)
     {
-        printf("\t\t%5d: ", key++);
-        printf("Label_%d", target->id);
-        printf("\n");
+        Print("\t\t%5d: Label_%d\n", key++, target->id);
     }
     EndInstruction(packed_switch);
     return true;
@@ -110,12 +194,10 @@ bool PrintCodeIrVisitor::Visit(lir::PackedSwitchPayload *packed_switch)
 bool PrintCodeIrVisitor::Visit(lir::SparseSwitchPayload *sparse_switch)
 {
     StartInstruction(sparse_switch);
-    printf("\t%5u| sparse-switch-payload\n", sparse_switch->offset);
+    Print("\t%5u| sparse-switch-payload\n", sparse_switch->offset);
     for (auto &switchCase : sparse_switch->switch_cases)
     {
-        printf("\t\t%5d: ", switchCase.key);
-        printf("Label_%d", switchCase.target->id);
-        printf("\n");
+        Print("\t\t%5d: Label_%d\n", switchCase.key, switchCase.target->id);
     }
     EndInstruction(sparse_switch);
     return true;
@@ -124,67 +206,73 @@ bool PrintCodeIrVisitor::Visit(lir::SparseSwitchPayload *sparse_switch)
 bool PrintCodeIrVisitor::Visit(lir::ArrayData *array_data)
 {
     StartInstruction(array_data);
-    printf("\t%5u| fill-array-data-payload\n", array_data->offset);
+    Print("\t%5u| fill-array-data-payload\n", array_data->offset);
     EndInstruction(array_data);
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::CodeLocation *target)
 {
-    printf("Label_%d", target->label->id);
+    Print("Label_%d", target->label->id);
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::Const32 *const32)
 {
-    printf("#%+d (0x%08x | ", const32->u.s4_value, const32->u.u4_value);
+    Print("#%+d (0x%08x | ", const32->u.s4_value, const32->u.u4_value);
     if (std::isnan(const32->u.float_value))
     {
-        printf("NaN)");
+        Append("NaN)");
     }
     else
     {
-        printf("%#.6g)", const32->u.float_value);
+        Print("%#.6g)", const32->u.float_value);
     }
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::Const64 *const64)
 {
-    printf("#%+" PRId64 " (0x%016" PRIx64 " | ", const64->u.s8_value, const64->u.u8_value);
+    Print("#%+" PRId64 " (0x%016" PRIx64 " | ", const64->u.s8_value, const64->u.u8_value);
     if (std::isnan(const64->u.double_value))
     {
-        printf("NaN)");
+        Append("NaN)");
     }
     else
     {
-        printf("%#.6g)", const64->u.double_value);
+        Print("%#.6g)", const64->u.double_value);
     }
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::VReg *vreg)
 {
-    color::color_printf(color::FG_LIGHT_BLUE, "v%d", vreg->reg);
+    SetColor(color::FG_LIGHT_BLUE);
+    Print("v%d", vreg->reg);
+    SetColor(color::FG_DEFAULT);
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::VRegPair *vreg_pair)
 {
-    color::color_printf(color::FG_LIGHT_BLUE, "v%d:v%d", vreg_pair->base_reg, vreg_pair->base_reg + 1);
+    SetColor(color::FG_LIGHT_BLUE);
+    Print("v%d:v%d", vreg_pair->base_reg, vreg_pair->base_reg + 1);
+    SetColor(color::FG_DEFAULT);
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::VRegList *vreg_list)
 {
     bool first = true;
-    printf("{");
+    Append("{");
+    SetColor(color::FG_LIGHT_BLUE);
     for (auto reg : vreg_list->registers)
     {
-        color::color_printf(color::FG_LIGHT_BLUE, "%sv%d", (first ? "" : ","), reg);
+        Print("%sv%d", (first ? "" : ","), reg);
         first = false;
     }
-    printf("}");
+    SetColor(color::FG_DEFAULT);
+    Append("}");
     return true;
 }
 
@@ -192,12 +280,12 @@ bool PrintCodeIrVisitor::Visit(lir::VRegRange *vreg_range)
 {
     if (vreg_range->count == 0)
     {
-        printf("{}");
+        Append("{}");
     }
     else
     {
-        printf("{v%d..v%d}", vreg_range->base_reg,
-               vreg_range->base_reg + vreg_range->count - 1);
+        Print("{v%d..v%d}", vreg_range->base_reg,
+              vreg_range->base_reg + vreg_range->count - 1);
     }
     return true;
 }
@@ -206,61 +294,61 @@ bool PrintCodeIrVisitor::Visit(lir::String *string)
 {
     if (string->ir_string == nullptr)
     {
-        printf("<null>");
+        Append("<null>");
         return true;
     }
     auto ir_string = string->ir_string;
-    printf("\"");
+    Append("\"");
     for (const char *p = ir_string->c_str(); *p != '\0'; ++p)
     {
         if (::isprint(*p))
         {
-            printf("%c", *p);
+            out_->push_back(*p);
         }
         else
         {
             switch (*p)
             {
             case '\'':
-                printf("\\'");
+                Append("\\'");
                 break;
             case '\"':
-                printf("\\\"");
+                Append("\\\"");
                 break;
             case '\?':
-                printf("\\?");
+                Append("\\?");
                 break;
             case '\\':
-                printf("\\\\");
+                Append("\\\\");
                 break;
             case '\a':
-                printf("\\a");
+                Append("\\a");
                 break;
             case '\b':
-                printf("\\b");
+                Append("\\b");
                 break;
             case '\f':
-                printf("\\f");
+                Append("\\f");
                 break;
             case '\n':
-                printf("\\n");
+                Append("\\n");
                 break;
             case '\r':
-                printf("\\r");
+                Append("\\r");
                 break;
             case '\t':
-                printf("\\t");
+                Append("\\t");
                 break;
             case '\v':
-                printf("\\v");
+                Append("\\v");
                 break;
             default:
-                printf("\\x%02x", *p);
+                Print("\\x%02x", *p);
                 break;
             }
         }
     }
-    printf("\"");
+    Append("\"");
     return true;
 }
 
@@ -268,7 +356,7 @@ bool PrintCodeIrVisitor::Visit(lir::Type *type)
 {
     SLICER_CHECK(type->index != dex::kNoIndex);
     auto ir_type = type->ir_type;
-    printf("%s", ir_type->Decl().c_str());
+    Append(ir_type->Decl());
     return true;
 }
 
@@ -276,7 +364,11 @@ bool PrintCodeIrVisitor::Visit(lir::Field *field)
 {
     SLICER_CHECK(field->index != dex::kNoIndex);
     auto ir_field = field->ir_field;
-    color::color_printf(color::FG_LIGHT_GRAY, "%s.%s", ir_field->parent->Decl().c_str(), ir_field->name->c_str());
+    SetColor(color::FG_LIGHT_GRAY);
+    Append(ir_field->parent->Decl());
+    Append(".");
+    Append(ir_field->name->c_str());
+    SetColor(color::FG_DEFAULT);
     return true;
 }
 
@@ -284,28 +376,27 @@ bool PrintCodeIrVisitor::Visit(lir::Method *method)
 {
     SLICER_CHECK(method->index != dex::kNoIndex);
     auto ir_method = method->ir_method;
-    color::color_printf(color::FG_GREEN, "%s", ir_method->parent->Decl().c_str());
-    printf(".");
-    color::color_printf(color::FG_LIGHT_YELLOW, "%s%s",
-            ir_method->name->c_str(),
-            MethodDeclaration(ir_method->prototype).c_str());
-    // printf("%s.%s%s",
-    //        ir_method->parent->Decl().c_str(),
-    //        ir_method->name->c_str(),
-    //        MethodDeclaration(ir_method->prototype).c_str());
+    SetColor(color::FG_GREEN);
+    Append(ir_method->parent->Decl());
+    SetColor(color::FG_DEFAULT);
+    Append(".");
+    SetColor(color::FG_LIGHT_YELLOW);
+    Append(ir_method->name->c_str());
+    AppendMethodDeclaration(*out_, ir_method->prototype);
+    SetColor(color::FG_DEFAULT);
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::LineNumber *line_number)
 {
-    printf("%d", line_number->line);
+    Print("%d", line_number->line);
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::Label *label)
 {
     StartInstruction(label);
-    printf("Label_%d:%s\n", label->id, (label->aligned ? " <aligned>" : ""));
+    Print("Label_%d:%s\n", label->id, (label->aligned ? " <aligned>" : ""));
     EndInstruction(label);
     return true;
 }
@@ -313,7 +404,7 @@ bool PrintCodeIrVisitor::Visit(lir::Label *label)
 bool PrintCodeIrVisitor::Visit(lir::TryBlockBegin *try_begin)
 {
     StartInstruction(try_begin);
-    printf("\t.try_begin_%d\n", try_begin->id);
+    Print("\t.try_begin_%d\n", try_begin->id);
     EndInstruction(try_begin);
     return true;
 }
@@ -321,15 +412,15 @@ bool PrintCodeIrVisitor::Visit(lir::TryBlockBegin *try_begin)
 bool PrintCodeIrVisitor::Visit(lir::TryBlockEnd *try_end)
 {
     StartInstruction(try_end);
-    printf("\t.try_end_%d\n", try_end->try_begin->id);
+    Print("\t.try_end_%d\n", try_end->try_begin->id);
     for (const auto &handler : try_end->handlers)
     {
-        printf("\t  catch(%s) : Label_%d\n", handler.ir_type->Decl().c_str(),
-               handler.label->id);
+        Print("\t  catch(%s) : Label_%d\n", handler.ir_type->Decl().c_str(),
+              handler.label->id);
     }
     if (try_end->catch_all != nullptr)
     {
-        printf("\t  catch(...) : Label_%d\n", try_end->catch_all->id);
+        Print("\t  catch(...) : Label_%d\n", try_end->catch_all->id);
     }
     EndInstruction(try_end);
     return true;
@@ -338,15 +429,15 @@ bool PrintCodeIrVisitor::Visit(lir::TryBlockEnd *try_end)
 bool PrintCodeIrVisitor::Visit(lir::DbgInfoHeader *dbg_header)
 {
     StartInstruction(dbg_header);
-    printf("\t.params");
+    Append("\t.params");
     bool first = true;
     for (auto paramName : dbg_header->param_names)
     {
-        printf(first ? " " : ", ");
-        printf("\"%s\"", paramName ? paramName->c_str() : "?");
+        Append(first ? " " : ", ");
+        Print("\"%s\"", paramName ? paramName->c_str() : "?");
         first = false;
     }
-    printf("\n");
+    Append("\n");
     EndInstruction(dbg_header);
     return true;
 }
@@ -387,17 +478,18 @@ bool PrintCodeIrVisitor::Visit(lir::DbgInfoAnnotation *annotation)
     }
     if (!skip)
     {
-        printf("\t%s", name);
+        Append("\t");
+        Append(name);
 
         bool first = true;
         for (auto op : annotation->operands)
         {
-            printf(first ? " " : ", ");
+            Append(first ? " " : ", ");
             op->Accept(this);
             first = false;
         }
 
-        printf("\n");
+        Append("\n");
     }
     EndInstruction(annotation);
     return true;
@@ -405,25 +497,119 @@ bool PrintCodeIrVisitor::Visit(lir::DbgInfoAnnotation *annotation)
 
 void DexDissasembler::DumpAllMethods() const
 {
+    DumpAllMethods(stdout);
+}
+
+size_t DexDissasembler::DumpAllMethods(FILE *file) const
+{
+    size_t total = 0;
+    std::string out;
+    out.reserve(kFlushThreshold + 64 * 1024);
     for (auto &ir_method : dex_ir_->encoded_methods)
     {
-        DumpMethod(ir_method.get());
+        DumpMethod(ir_method.get(), out);
+        if (out.size() >= kFlushThreshold)
+        {
+            total += fwrite(out.data(), 1, out.size(), file);
+            out.clear();
+        }
     }
+    total += fwrite(out.data(), 1, out.size(), file);
+    fflush(file);
+    return total;
 }
 
 void DexDissasembler::DumpMethod(ir::EncodedMethod *ir_method) const
 {
-    printf("\nmethod %s.%s%s\n{\n",
-           ir_method->decl->parent->Decl().c_str(),
-           ir_method->decl->name->c_str(),
-           MethodDeclaration(ir_method->decl->prototype).c_str());
-    Dissasemble(ir_method);
-    printf("}\n");
+    std::string out;
+    DumpMethod(ir_method, out);
+    fwrite(out.data(), 1, out.size(), stdout);
+}
+
+void DexDissasembler::DumpMethod(ir::EncodedMethod *ir_method, std::string &out) const
+{
+    out += "\nmethod ";
+    out += ir_method->decl->parent->Decl();
+    out += ".";
+    out += ir_method->decl->name->c_str();
+    AppendMethodDeclaration(out, ir_method->decl->prototype);
+    out += "\n{\n";
+    Dissasemble(ir_method, out);
+    out += "}\n";
+}
+
+void DexDissasembler::DumpClass(const ir::Class *ir_class, std::string &out) const
+{
+    out += ".class ";
+    AppendAccessFlags(out, ir_class->access_flags, false);
+    out += ir_class->type->Decl();
+    out += "\n";
+    if (ir_class->super_class != nullptr)
+    {
+        out += ".super ";
+        out += ir_class->super_class->Decl();
+        out += "\n";
+    }
+    if (ir_class->source_file != nullptr)
+    {
+        out += ".source \"";
+        out += ir_class->source_file->c_str();
+        out += "\"\n";
+    }
+    if (ir_class->interfaces != nullptr)
+    {
+        for (auto type : ir_class->interfaces->types)
+        {
+            out += ".implements ";
+            out += type->Decl();
+            out += "\n";
+        }
+    }
+
+    for (auto fields : {&ir_class->static_fields, &ir_class->instance_fields})
+    {
+        if (fields->empty())
+        {
+            continue;
+        }
+        out += "\n";
+        for (auto ir_field : *fields)
+        {
+            out += ".field ";
+            AppendAccessFlags(out, ir_field->access_flags, false);
+            out += ir_field->decl->name->c_str();
+            out += ":";
+            out += ir_field->decl->type->Decl();
+            out += "\n";
+        }
+    }
+
+    for (auto methods : {&ir_class->direct_methods, &ir_class->virtual_methods})
+    {
+        for (auto ir_method : *methods)
+        {
+            out += "\n.method ";
+            AppendAccessFlags(out, ir_method->access_flags, true);
+            out += ir_method->decl->name->c_str();
+            AppendMethodDeclaration(out, ir_method->decl->prototype);
+            out += "\n{\n";
+            Dissasemble(ir_method, out);
+            out += "}\n";
+        }
+    }
 }
 
-void DexDissasembler::Dissasemble(ir::EncodedMethod *ir_method) const
+void DexDissasembler::Dissasemble(ir::EncodedMethod *ir_method, std::string &out) const
 {
-    lir::CodeIr code_ir(ir_method, dex_ir_);
+    if (code_ir_ == nullptr)
+    {
+        code_ir_.reset(new lir::CodeIr(ir_method, dex_ir_));
+    }
+    else
+    {
+        code_ir_->Reset(ir_method);
+    }
+    lir::CodeIr &code_ir = *code_ir_;
     std::unique_ptr<lir::ControlFlowGraph> cfg;
     switch (cfg_type_)
     {
@@ -436,6 +622,11 @@ void DexDissasembler::Dissasemble(ir::EncodedMethod *ir_method) const
     default:
         break;
     }
-    PrintCodeIrVisitor visitor(dex_ir_, cfg.get());
-    code_ir.Accept(&visitor);
+    DumpCode(&code_ir, cfg.get(), out);
+}
+
+void DexDissasembler::DumpCode(lir::CodeIr *code_ir, lir::ControlFlowGraph *cfg, std::string &out) const
+{
+    PrintCodeIrVisitor visitor(dex_ir_, cfg, &out, colors_);
+    code_ir->Accept(&visitor);
 }
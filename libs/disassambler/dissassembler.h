@@ -22,13 +22,16 @@
 #include "slicer/control_flow_graph.h"
 
 #include <memory>
+#include <string>
+#include <cstdio>
 
-// Code IR formatting visitor
+// Code IR formatting visitor, renders the listing into a caller owned string
 class PrintCodeIrVisitor : public lir::Visitor
 {
 public:
-    PrintCodeIrVisitor(std::shared_ptr<ir::DexFile> dex_ir, lir::ControlFlowGraph *cfg)
-        : dex_ir_(dex_ir), cfg_(cfg) {}
+    PrintCodeIrVisitor(std::shared_ptr<ir::DexFile> dex_ir, lir::ControlFlowGraph *cfg,
+                       std::string *out, bool colors)
+        : dex_ir_(dex_ir), cfg_(cfg), out_(out), colors_(colors) {}
 
 private:
     virtual bool Visit(lir::Bytecode *bytecode) override;
@@ -56,10 +59,17 @@ private:
     void StartInstruction(const lir::Instruction *instr);
     void EndInstruction(const lir::Instruction *instr);
 
+    void Print(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void Append(const char *str) { out_->append(str); }
+    void Append(const std::string &str) { out_->append(str); }
+    void SetColor(int code);
+
 private:
     std::shared_ptr<ir::DexFile> dex_ir_;
     lir::ControlFlowGraph *cfg_ = nullptr;
     size_t current_block_index_ = 0;
+    std::string *out_ = nullptr;
+    bool colors_ = false;
 };
 
 // A .dex bytecode dissasembler using lir::CodeIr
@@ -78,19 +88,39 @@ public:
     };
 
 public:
-    explicit DexDissasembler(std::shared_ptr<ir::DexFile> dex_ir, CfgType cfg_type = CfgType::None)
-        : dex_ir_(dex_ir), cfg_type_(cfg_type) {}
+    explicit DexDissasembler(std::shared_ptr<ir::DexFile> dex_ir, CfgType cfg_type = CfgType::None,
+                             bool colors = true)
+        : dex_ir_(dex_ir), cfg_type_(cfg_type), colors_(colors) {}
 
     DexDissasembler(const DexDissasembler &) = delete;
     DexDissasembler &operator=(const DexDissasembler &) = delete;
 
+    // Print to stdout, each method is written with a single call
     void DumpAllMethods() const;
     void DumpMethod(ir::EncodedMethod *ir_method) const;
 
+    // Append the listing of a method to "out" (the buffer can be reused between calls)
+    void DumpMethod(ir::EncodedMethod *ir_method, std::string &out) const;
+
+    // Disassemble every method into "file", the output is written in large chunks.
+    // Returns the number of bytes written
+    size_t DumpAllMethods(FILE *file) const;
+
+    // Append the listing of an already raised code IR, "cfg" (optional) marks the basic blocks
+    void DumpCode(lir::CodeIr *code_ir, lir::ControlFlowGraph *cfg, std::string &out) const;
+
+    // Append a smali-like listing of a class (header, fields and all the methods) to "out"
+    void DumpClass(const ir::Class *ir_class, std::string &out) const;
+
 private:
-    void Dissasemble(ir::EncodedMethod *ir_method) const;
+    void Dissasemble(ir::EncodedMethod *ir_method, std::string &out) const;
 
 private:
     std::shared_ptr<ir::DexFile> dex_ir_;
     CfgType cfg_type_ = CfgType::None;
+    bool colors_ = true;
+
+    // the code IR is recycled between methods, so one dissasembler per thread
+    // decodes method after method without rebuilding the containers
+    mutable std::unique_ptr<lir::CodeIr> code_ir_;
 };
@@ -56,6 +56,12 @@ void CodeIr::Assemble() {
   try_blocks_encoder.Encode(ir_code, dex_ir);
 }
 
+void CodeIr::Reset(ir::EncodedMethod* ir_method) {
+  instructions.clear();
+  this->ir_method = ir_method;
+  Dissasemble();
+}
+
 void CodeIr::DissasembleTryBlocks(const ir::Code* ir_code) {
   int nextTryBlockId = 1;
   for (const auto& tryBlock : ir_code->try_blocks) {
@@ -273,22 +279,40 @@ void CodeIr::DissasembleBytecode(const ir::Code* ir_code) {
   SLICER_CHECK(ptr == end);
 }
 
+template <class T>
+T& CodeIr::GetFixup(std::vector<T>& fixups, dex::u4 offset) {
+  for (auto& fixup : fixups) {
+    if (fixup.offset == offset) {
+      return fixup;
+    }
+  }
+  fixups.emplace_back();
+  fixups.back().offset = offset;
+  return fixups.back();
+}
+
 void CodeIr::FixupSwitches() {
   const dex::u2* begin = ir_method->code->instructions.begin();
 
   // packed switches
   for (auto& fixup : packed_switches_) {
-    FixupPackedSwitch(fixup.second.instr, fixup.second.base_offset,
-                      begin + fixup.first);
+    FixupPackedSwitch(fixup.instr, fixup.base_offset, begin + fixup.offset);
   }
 
   // sparse switches
   for (auto& fixup : sparse_switches_) {
-    FixupSparseSwitch(fixup.second.instr, fixup.second.base_offset,
-                      begin + fixup.first);
+    FixupSparseSwitch(fixup.instr, fixup.base_offset, begin + fixup.offset);
   }
 }
 
+void CodeIr::FreeNodes() {
+  for (auto node : nodes_) {
+    node->~Node();
+  }
+  nodes_.clear();
+  arena_.Reset();
+}
+
 // merge a set of extra instructions into the instruction list
 template <class I_LIST, class E_LIST>
 static void MergeInstructions(I_LIST& instructions, const E_LIST& extra) {
@@ -314,8 +338,12 @@ static void MergeInstructions(I_LIST& instructions, const E_LIST& extra) {
 }
 
 void CodeIr::Dissasemble() {
-  nodes_.clear();
-  labels_.clear();
+  FreeNodes();
+  for (auto offset : label_offsets_) {
+    LabelSlot(offset) = nullptr;
+  }
+  label_offsets_.clear();
+  far_labels_.clear();
 
   try_begins_.clear();
   try_ends_.clear();
@@ -328,6 +356,14 @@ void CodeIr::Dissasemble() {
     return;
   }
 
+  // the index maps may be updated by an ir::Builder on another thread
+  std::shared_lock<std::shared_mutex> guard(dex_ir->builder_lock);
+
+  // one label slot per code unit (plus the end of the code)
+  if (labels_.size() < ir_code->instructions.size() + 1) {
+    labels_.resize(ir_code->instructions.size() + 1, nullptr);
+  }
+
   // decode the .dex bytecodes
   DissasembleBytecode(ir_code);
 
@@ -340,12 +376,15 @@ void CodeIr::Dissasemble() {
   // fixup switches
   FixupSwitches();
 
-  // assign label ids
+  // assign label ids (in offset order)
+  std::sort(label_offsets_.begin(), label_offsets_.end());
   std::vector<Label*> tmp_labels;
+  tmp_labels.reserve(label_offsets_.size());
   int nextLabelId = 1;
-  for (auto& label : labels_) {
-    label.second->id = nextLabelId++;
-    tmp_labels.push_back(label.second);
+  for (auto offset : label_offsets_) {
+    auto label = LabelSlot(offset);
+    label->id = nextLabelId++;
+    tmp_labels.push_back(label);
   }
 
   // merge the labels into the instructions stream
@@ -361,7 +400,7 @@ PackedSwitchPayload* CodeIr::DecodePackedSwitch(const dex::u2* /*ptr*/,
   // (since the label offsets are relative to the referring
   //  instruction, not the switch data)
   SLICER_CHECK(offset % 2 == 0);
-  auto& instr = packed_switches_[offset].instr;
+  auto& instr = GetFixup(packed_switches_, offset).instr;
   SLICER_CHECK(instr == nullptr);
   instr = Alloc<PackedSwitchPayload>();
   return instr;
@@ -387,7 +426,7 @@ SparseSwitchPayload* CodeIr::DecodeSparseSwitch(const dex::u2* /*ptr*/,
   // (since the label offsets are relative to the referring
   //  instruction, not the switch data)
   SLICER_CHECK(offset % 2 == 0);
-  auto& instr = sparse_switches_[offset].instr;
+  auto& instr = GetFixup(sparse_switches_, offset).instr;
   SLICER_CHECK(instr == nullptr);
   instr = Alloc<SparseSwitchPayload>();
   return instr;
@@ -496,12 +535,12 @@ Bytecode* CodeIr::DecodeBytecode(const dex::u2* ptr, dex::u4 offset) {
 
       if (dex_instr.opcode == dex::OP_PACKED_SWITCH) {
         label->aligned = true;
-        dex::u4& base_offset = packed_switches_[targetOffset].base_offset;
+        dex::u4& base_offset = GetFixup(packed_switches_, targetOffset).base_offset;
         SLICER_CHECK(base_offset == kInvalidOffset);
         base_offset = offset;
       } else if (dex_instr.opcode == dex::OP_SPARSE_SWITCH) {
         label->aligned = true;
-        dex::u4& base_offset = sparse_switches_[targetOffset].base_offset;
+        dex::u4& base_offset = GetFixup(sparse_switches_, targetOffset).base_offset;
         SLICER_CHECK(base_offset == kInvalidOffset);
         base_offset = offset;
       } else if (dex_instr.opcode == dex::OP_FILL_ARRAY_DATA) {
@@ -624,11 +663,26 @@ String* CodeIr::GetString(dex::u4 index) {
   return Alloc<String>(ir_string, index);
 }
 
+Label*& CodeIr::LabelSlot(dex::u4 offset) {
+  if (offset < labels_.size()) {
+    return labels_[offset];
+  }
+  // malformed code, a target outside of the method
+  for (auto& far_label : far_labels_) {
+    if (far_label.first == offset) {
+      return far_label.second;
+    }
+  }
+  far_labels_.emplace_back(offset, nullptr);
+  return far_labels_.back().second;
+}
+
 // Get en existing, or new label for a particular offset
 Label* CodeIr::GetLabel(dex::u4 offset) {
-  auto& p = labels_[offset];
+  auto& p = LabelSlot(offset);
   if (p == nullptr) {
     p = Alloc<Label>(offset);
+    label_offsets_.push_back(offset);
   }
   ++p->refCount;
   return p;
@@ -17,6 +17,9 @@
 #include "slicer/control_flow_graph.h"
 #include "slicer/chronometer.h"
 
+#include <algorithm>
+#include <unordered_map>
+
 namespace lir {
 
 std::vector<BasicBlock> BasicBlocksVisitor::Finish() {
@@ -136,4 +139,299 @@ void ControlFlowGraph::CreateBasicBlocks(bool model_exceptions) {
   basic_blocks = visitor.Finish();
 }
 
+namespace {
+
+// like detail::CastOperand(), but returns nullptr if the node is not a T
+template <class T>
+T* TryCast(Node* node) {
+  struct CastVisitor : public Visitor {
+    T* result = nullptr;
+
+    bool Visit(T* val) override {
+      result = val;
+      return true;
+    }
+  };
+
+  CastVisitor cv;
+  node->Accept(&cv);
+  return cv.result;
+}
+
+// the branch target operand of a bytecode, if any
+CodeLocation* FindCodeLocation(const Bytecode* bytecode) {
+  for (auto op : bytecode->operands) {
+    auto location = TryCast<CodeLocation>(op);
+    if (location != nullptr) {
+      return location;
+    }
+  }
+  return nullptr;
+}
+
+// the switch targets, from the payload following the payload label
+std::vector<Label*> SwitchTargets(Label* payload_label) {
+  std::vector<Label*> targets;
+  for (auto instr = payload_label->next; instr != nullptr; instr = instr->next) {
+    auto packed_switch = TryCast<PackedSwitchPayload>(instr);
+    if (packed_switch != nullptr) {
+      targets = packed_switch->targets;
+      break;
+    }
+    auto sparse_switch = TryCast<SparseSwitchPayload>(instr);
+    if (sparse_switch != nullptr) {
+      for (const auto& switch_case : sparse_switch->switch_cases) {
+        targets.push_back(switch_case.target);
+      }
+      break;
+    }
+  }
+  return targets;
+}
+
+}  // namespace
+
+void ControlFlowGraph::AddEdge(int from, int to) {
+  if (from < 0 || to < 0) {
+    return;
+  }
+  auto& successors = basic_blocks[from].successors;
+  if (std::find(successors.begin(), successors.end(), to) == successors.end()) {
+    successors.push_back(to);
+    basic_blocks[to].predecessors.push_back(from);
+  }
+}
+
+void ControlFlowGraph::CreateEdges() {
+  // instruction -> index of the basic block containing it
+  std::unordered_map<const Instruction*, int> block_index;
+  for (int i = 0; i < static_cast<int>(basic_blocks.size()); ++i) {
+    const auto& region = basic_blocks[i].region;
+    for (auto instr = region.first; instr != nullptr; instr = instr->next) {
+      block_index[instr] = i;
+      if (instr == region.last) {
+        break;
+      }
+    }
+  }
+
+  // the block of the first instruction at (or after) "instr" which is part of a block
+  // (branch targets may point to labels preceding the actual block start)
+  auto find_block = [&](Instruction* instr) {
+    for (; instr != nullptr; instr = instr->next) {
+      auto it = block_index.find(instr);
+      if (it != block_index.end()) {
+        return it->second;
+      }
+    }
+    return -1;
+  };
+
+  // try blocks, as [begin, end) offset ranges with their handlers
+  std::vector<const TryBlockEnd*> try_blocks;
+  for (auto instr : code_ir->instructions) {
+    auto try_end = TryCast<TryBlockEnd>(instr);
+    if (try_end != nullptr) {
+      try_blocks.push_back(try_end);
+    }
+  }
+
+  for (int i = 0; i < static_cast<int>(basic_blocks.size()); ++i) {
+    const auto& region = basic_blocks[i].region;
+
+    // the last bytecode decides where the flow goes
+    Bytecode* last_bytecode = nullptr;
+    bool can_throw = false;
+    for (auto instr = region.first; instr != nullptr; instr = instr->next) {
+      auto bytecode = TryCast<Bytecode>(instr);
+      if (bytecode != nullptr) {
+        last_bytecode = bytecode;
+        can_throw = can_throw || (dex::GetFlagsFromOpcode(bytecode->opcode) & dex::kThrow) != 0;
+      }
+      if (instr == region.last) {
+        break;
+      }
+    }
+
+    bool fallthrough = true;
+    if (last_bytecode != nullptr) {
+      const auto flags = dex::GetFlagsFromOpcode(last_bytecode->opcode);
+      fallthrough = (flags & dex::kContinue) != 0;
+      if ((flags & (dex::kBranch | dex::kSwitch)) != 0) {
+        auto location = FindCodeLocation(last_bytecode);
+        SLICER_CHECK(location != nullptr);
+        if ((flags & dex::kSwitch) != 0) {
+          for (auto target : SwitchTargets(location->label)) {
+            AddEdge(i, find_block(target));
+          }
+        } else {
+          AddEdge(i, find_block(location->label));
+        }
+      }
+    }
+    if (fallthrough) {
+      AddEdge(i, find_block(region.last->next));
+    }
+
+    // exceptional edges, from the blocks which may throw inside a try block
+    if (can_throw && !try_blocks.empty()) {
+      const auto offset = region.first->offset;
+      for (auto try_end : try_blocks) {
+        if (offset < try_end->try_begin->offset || offset >= try_end->offset) {
+          continue;
+        }
+        for (const auto& handler : try_end->handlers) {
+          AddEdge(i, find_block(handler.label));
+        }
+        if (try_end->catch_all != nullptr) {
+          AddEdge(i, find_block(try_end->catch_all));
+        }
+      }
+    }
+  }
+}
+
+int ControlFlowGraph::Intersect(int a, int b) const {
+  while (a != b) {
+    while (rpo_index_[a] > rpo_index_[b]) {
+      a = dominators[a];
+    }
+    while (rpo_index_[b] > rpo_index_[a]) {
+      b = dominators[b];
+    }
+  }
+  return a;
+}
+
+void ControlFlowGraph::ComputeDominators() {
+  const int count = static_cast<int>(basic_blocks.size());
+  dominators.assign(count, -1);
+  rpo_index_.assign(count, -1);
+  if (count == 0) {
+    return;
+  }
+
+  // iterative DFS from the entry block, recording the postorder
+  std::vector<int> postorder;
+  postorder.reserve(count);
+  std::vector<bool> visited(count, false);
+  std::vector<std::pair<int, size_t>> stack;
+  stack.emplace_back(0, 0);
+  visited[0] = true;
+  while (!stack.empty()) {
+    auto& [block, next_successor] = stack.back();
+    const auto& successors = basic_blocks[block].successors;
+    if (next_successor < successors.size()) {
+      const int successor = successors[next_successor++];
+      if (!visited[successor]) {
+        visited[successor] = true;
+        stack.emplace_back(successor, 0);
+      }
+    } else {
+      postorder.push_back(block);
+      stack.pop_back();
+    }
+  }
+
+  std::vector<int> rpo(postorder.rbegin(), postorder.rend());
+  for (int i = 0; i < static_cast<int>(rpo.size()); ++i) {
+    rpo_index_[rpo[i]] = i;
+  }
+
+  // the entry block is its own dominator while iterating
+  dominators[0] = 0;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = 1; i < rpo.size(); ++i) {
+      const int block = rpo[i];
+      int new_idom = -1;
+      for (int pred : basic_blocks[block].predecessors) {
+        if (dominators[pred] == -1) {
+          continue;
+        }
+        new_idom = (new_idom == -1) ? pred : Intersect(pred, new_idom);
+      }
+      if (dominators[block] != new_idom) {
+        dominators[block] = new_idom;
+        changed = true;
+      }
+    }
+  }
+  dominators[0] = -1;
+}
+
+bool ControlFlowGraph::Dominates(int a, int b) const {
+  if (!IsReachable(a) || !IsReachable(b)) {
+    return false;
+  }
+  for (int block = b; block != -1; block = dominators[block]) {
+    if (block == a) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ControlFlowGraph::FindLoops() {
+  if (rpo_index_.size() != basic_blocks.size()) {
+    ComputeDominators();
+  }
+  loops.clear();
+
+  // header block -> index in "loops"
+  std::unordered_map<int, size_t> loop_index;
+  std::vector<bool> in_loop(basic_blocks.size());
+  for (int block = 0; block < static_cast<int>(basic_blocks.size()); ++block) {
+    if (!IsReachable(block)) {
+      continue;
+    }
+    for (int header : basic_blocks[block].successors) {
+      if (!Dominates(header, block)) {
+        continue;
+      }
+
+      // back edge block -> header
+      auto it = loop_index.find(header);
+      if (it == loop_index.end()) {
+        it = loop_index.emplace(header, loops.size()).first;
+        loops.emplace_back();
+        loops.back().header = header;
+        loops.back().blocks.push_back(header);
+      }
+      auto& loop = loops[it->second];
+      loop.back_edges.push_back(block);
+
+      // the loop body: every block reaching the back edge without going through the header
+      std::fill(in_loop.begin(), in_loop.end(), false);
+      for (int member : loop.blocks) {
+        in_loop[member] = true;
+      }
+      std::vector<int> worklist;
+      if (!in_loop[block]) {
+        in_loop[block] = true;
+        loop.blocks.push_back(block);
+        worklist.push_back(block);
+      }
+      while (!worklist.empty()) {
+        const int current = worklist.back();
+        worklist.pop_back();
+        for (int pred : basic_blocks[current].predecessors) {
+          if (!in_loop[pred] && IsReachable(pred)) {
+            in_loop[pred] = true;
+            loop.blocks.push_back(pred);
+            worklist.push_back(pred);
+          }
+        }
+      }
+    }
+  }
+
+  for (auto& loop : loops) {
+    std::sort(loop.blocks.begin(), loop.blocks.end());
+  }
+  std::sort(loops.begin(), loops.end(),
+            [](const Loop& a, const Loop& b) { return a.header < b.header; });
+}
+
 }  // namespace lir
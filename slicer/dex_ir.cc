@@ -74,6 +74,66 @@ bool MethodsHasher::Compare(const MethodKey& method_key, const EncodedMethod* me
          method_key.prototype == method->decl->prototype;
 }
 
+uint32_t TypesHasher::Hash(String* descriptor) const {
+  return static_cast<uint32_t>(std::hash<void*>{}(descriptor));
+}
+
+bool TypesHasher::Compare(String* descriptor, const Type* type) const {
+  return descriptor == type->descriptor;
+}
+
+uint32_t TypeListsHasher::Hash(const std::vector<Type*>& types) const {
+  size_t hash = types.size();
+  for (auto type : types) {
+    hash = hash * 31 + std::hash<void*>{}(type);
+  }
+  return static_cast<uint32_t>(hash);
+}
+
+bool TypeListsHasher::Compare(const std::vector<Type*>& types, const TypeList* type_list) const {
+  return types == type_list->types;
+}
+
+FieldDeclKey FieldDeclsHasher::GetKey(const FieldDecl* field) const {
+  FieldDeclKey field_key;
+  field_key.name = field->name;
+  field_key.type = field->type;
+  field_key.parent = field->parent;
+  return field_key;
+}
+
+uint32_t FieldDeclsHasher::Hash(const FieldDeclKey& field_key) const {
+  return static_cast<uint32_t>(std::hash<void*>{}(field_key.name) ^
+                               std::hash<void*>{}(field_key.type) ^
+                               std::hash<void*>{}(field_key.parent));
+}
+
+bool FieldDeclsHasher::Compare(const FieldDeclKey& field_key, const FieldDecl* field) const {
+  return field_key.name == field->name &&
+         field_key.type == field->type &&
+         field_key.parent == field->parent;
+}
+
+MethodDeclKey MethodDeclsHasher::GetKey(const MethodDecl* method) const {
+  MethodDeclKey method_key;
+  method_key.name = method->name;
+  method_key.prototype = method->prototype;
+  method_key.parent = method->parent;
+  return method_key;
+}
+
+uint32_t MethodDeclsHasher::Hash(const MethodDeclKey& method_key) const {
+  return static_cast<uint32_t>(std::hash<void*>{}(method_key.name) ^
+                               std::hash<void*>{}(method_key.prototype) ^
+                               std::hash<void*>{}(method_key.parent));
+}
+
+bool MethodDeclsHasher::Compare(const MethodDeclKey& method_key, const MethodDecl* method) const {
+  return method_key.name == method->name &&
+         method_key.prototype == method->prototype &&
+         method_key.parent == method->parent;
+}
+
 // Human-readable type declaration
 std::string Type::Decl() const {
   return dex::DescriptorToDecl(descriptor->c_str());
@@ -28,6 +28,8 @@ bool MethodId::Match(MethodDecl* method_decl) const {
 }
 
 EncodedMethod* Builder::FindMethod(const MethodId& method_id) const {
+  std::shared_lock<std::shared_mutex> guard(dex_ir_->builder_lock);
+
   // first, lookup the strings
   auto ir_descriptor = FindAsciiString(method_id.class_descriptor);
   auto ir_method_name = FindAsciiString(method_id.method_name);
@@ -58,6 +60,8 @@ String* Builder::FindAsciiString(const char* cstr) const {
 }
 
 String* Builder::GetAsciiString(const char* cstr) {
+  std::unique_lock<std::shared_mutex> guard(dex_ir_->builder_lock);
+
   // look for the string first...
   auto ir_string = FindAsciiString(cstr);
   if(ir_string != nullptr) {
@@ -92,15 +96,16 @@ String* Builder::GetAsciiString(const char* cstr) {
 }
 
 Type* Builder::GetType(String* descriptor) {
+  std::unique_lock<std::shared_mutex> guard(dex_ir_->builder_lock);
+
   // look for an existing type
-  for (const auto& ir_type : dex_ir_->types) {
-    if (ir_type->descriptor == descriptor) {
-      return ir_type.get();
-    }
+  auto ir_type = dex_ir_->types_lookup.Lookup(descriptor);
+  if (ir_type != nullptr) {
+    return ir_type;
   }
 
   // create a new type
-  auto ir_type = dex_ir_->Alloc<Type>();
+  ir_type = dex_ir_->Alloc<Type>();
   ir_type->descriptor = descriptor;
 
   // update the index -> ir node map
@@ -110,24 +115,32 @@ Type* Builder::GetType(String* descriptor) {
   ir_node = ir_type;
   ir_type->orig_index = new_index;
 
+  // update the types lookup table
+  dex_ir_->types_lookup.Insert(ir_type);
+
   return ir_type;
 }
 
 TypeList* Builder::GetTypeList(const std::vector<Type*>& types) {
+  std::unique_lock<std::shared_mutex> guard(dex_ir_->builder_lock);
+
   if (types.empty()) {
     return nullptr;
   }
 
   // look for an existing TypeList
-  for (const auto& ir_type_list : dex_ir_->type_lists) {
-    if (ir_type_list->types == types) {
-      return ir_type_list.get();
-    }
+  auto ir_type_list = dex_ir_->type_lists_lookup.Lookup(types);
+  if (ir_type_list != nullptr) {
+    return ir_type_list;
   }
 
   // create a new TypeList
-  auto ir_type_list = dex_ir_->Alloc<TypeList>();
+  ir_type_list = dex_ir_->Alloc<TypeList>();
   ir_type_list->types = types;
+
+  // update the type lists lookup table
+  dex_ir_->type_lists_lookup.Insert(ir_type_list);
+
   return ir_type_list;
 }
 
@@ -147,17 +160,25 @@ Proto* Builder::GetProto(Type* return_type, TypeList* param_types) {
   // create "shorty" descriptor automatically
   auto shorty = GetAsciiString(CreateShorty(return_type, param_types).c_str());
 
+  std::unique_lock<std::shared_mutex> guard(dex_ir_->builder_lock);
+
   // look for an existing proto
-  for (const auto& ir_proto : dex_ir_->protos) {
-    if (ir_proto->shorty == shorty &&
-        ir_proto->return_type == return_type &&
-        ir_proto->param_types == param_types) {
-      return ir_proto.get();
+  // (the signature is made of the same types, so the shorty matches too)
+  std::stringstream signature;
+  signature << "(";
+  if (param_types != nullptr) {
+    for (auto param_type : param_types->types) {
+      signature << param_type->descriptor->c_str();
     }
   }
+  signature << ")" << return_type->descriptor->c_str();
+  auto ir_proto = FindPrototype(signature.str().c_str());
+  if (ir_proto != nullptr) {
+    return ir_proto;
+  }
 
   // create a new proto
-  auto ir_proto = dex_ir_->Alloc<Proto>();
+  ir_proto = dex_ir_->Alloc<Proto>();
   ir_proto->shorty = shorty;
   ir_proto->return_type = return_type;
   ir_proto->param_types = param_types;
@@ -176,17 +197,20 @@ Proto* Builder::GetProto(Type* return_type, TypeList* param_types) {
 }
 
 FieldDecl* Builder::GetFieldDecl(String* name, Type* type, Type* parent) {
+  std::unique_lock<std::shared_mutex> guard(dex_ir_->builder_lock);
+
   // look for an existing field
-  for (const auto& ir_field : dex_ir_->fields) {
-    if (ir_field->name == name &&
-        ir_field->type == type &&
-        ir_field->parent == parent) {
-      return ir_field.get();
-    }
+  FieldDeclKey field_key;
+  field_key.name = name;
+  field_key.type = type;
+  field_key.parent = parent;
+  auto ir_field = dex_ir_->field_decls_lookup.Lookup(field_key);
+  if (ir_field != nullptr) {
+    return ir_field;
   }
 
   // create a new field declaration
-  auto ir_field = dex_ir_->Alloc<FieldDecl>();
+  ir_field = dex_ir_->Alloc<FieldDecl>();
   ir_field->name = name;
   ir_field->type = type;
   ir_field->parent = parent;
@@ -198,21 +222,27 @@ FieldDecl* Builder::GetFieldDecl(String* name, Type* type, Type* parent) {
   ir_node = ir_field;
   ir_field->orig_index = new_index;
 
+  // update the field declarations lookup table
+  dex_ir_->field_decls_lookup.Insert(ir_field);
+
   return ir_field;
 }
 
 MethodDecl* Builder::GetMethodDecl(String* name, Proto* proto, Type* parent) {
+  std::unique_lock<std::shared_mutex> guard(dex_ir_->builder_lock);
+
   // look for an existing method
-  for (const auto& ir_method : dex_ir_->methods) {
-    if (ir_method->name == name &&
-        ir_method->prototype == proto &&
-        ir_method->parent == parent) {
-      return ir_method.get();
-    }
+  MethodDeclKey method_key;
+  method_key.name = name;
+  method_key.prototype = proto;
+  method_key.parent = parent;
+  auto ir_method = dex_ir_->method_decls_lookup.Lookup(method_key);
+  if (ir_method != nullptr) {
+    return ir_method;
   }
 
   // create a new method declaration
-  auto ir_method = dex_ir_->Alloc<MethodDecl>();
+  ir_method = dex_ir_->Alloc<MethodDecl>();
   ir_method->name = name;
   ir_method->prototype = proto;
   ir_method->parent = parent;
@@ -224,6 +254,9 @@ MethodDecl* Builder::GetMethodDecl(String* name, Proto* proto, Type* parent) {
   ir_node = ir_method;
   ir_method->orig_index = new_index;
 
+  // update the method declarations lookup table
+  dex_ir_->method_decls_lookup.Insert(ir_method);
+
   return ir_method;
 }
 
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "common.h"
+
+#include <stdlib.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace slicer {
+
+// A bump allocator: memory is carved out of large blocks and
+// released all at once.
+//
+// NOTE: Reset() keeps the blocks around, so an arena which is reused
+//   (ex. for decoding method after method) stops hitting malloc once
+//   it has grown to the size of the largest working set.
+//   The arena doesn't run destructors, that's up to the owner.
+//
+class Arena {
+  struct Block {
+    uint8_t* memory = nullptr;
+    size_t size = 0;
+  };
+
+ public:
+  explicit Arena(size_t block_size = 64 * 1024) : block_size_(block_size) {}
+
+  ~Arena() {
+    for (auto& block : blocks_) {
+      ::free(block.memory);
+    }
+  }
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+    auto p = Align(ptr_, alignment);
+    if (p == nullptr || p + size > end_) {
+      p = NextBlock(size + alignment, alignment);
+    }
+    ptr_ = p + size;
+    return p;
+  }
+
+  // Makes all the memory available again (without releasing it)
+  void Reset() {
+    current_ = 0;
+    if (blocks_.empty()) {
+      ptr_ = end_ = nullptr;
+    } else {
+      ptr_ = blocks_[0].memory;
+      end_ = ptr_ + blocks_[0].size;
+    }
+  }
+
+  // Total size of the memory blocks owned by the arena
+  size_t capacity() const {
+    size_t capacity = 0;
+    for (const auto& block : blocks_) {
+      capacity += block.size;
+    }
+    return capacity;
+  }
+
+ private:
+  static uint8_t* Align(uint8_t* p, size_t alignment) {
+    auto value = reinterpret_cast<uintptr_t>(p);
+    return reinterpret_cast<uint8_t*>((value + alignment - 1) & ~(uintptr_t(alignment) - 1));
+  }
+
+  // Moves to the next block large enough for "size" bytes,
+  // allocating a new one if none of the existing blocks fits
+  uint8_t* NextBlock(size_t size, size_t alignment) {
+    size_t next = blocks_.empty() ? 0 : current_ + 1;
+    while (next < blocks_.size() && blocks_[next].size < size) {
+      ++next;
+    }
+    if (next == blocks_.size()) {
+      Block block;
+      block.size = size > block_size_ ? size : block_size_;
+      block.memory = static_cast<uint8_t*>(::malloc(block.size));
+      SLICER_CHECK(block.memory != nullptr);
+      blocks_.push_back(block);
+    }
+    current_ = next;
+    end_ = blocks_[next].memory + blocks_[next].size;
+    return Align(blocks_[next].memory, alignment);
+  }
+
+ private:
+  const size_t block_size_;
+  std::vector<Block> blocks_;
+  size_t current_ = 0;
+  uint8_t* ptr_ = nullptr;
+  uint8_t* end_ = nullptr;
+};
+
+}  // namespace slicer
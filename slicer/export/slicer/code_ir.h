@@ -22,6 +22,7 @@
   #endif
 #endif
 
+#include "arena.h"
 #include "common.h"
 #include "memview.h"
 #include "dex_bytecode.h"
@@ -406,10 +407,21 @@ struct CodeIr {
     Dissasemble();
   }
 
+  ~CodeIr() { FreeNodes(); }
+
   // No copy/move semantics
   CodeIr(const CodeIr&) = delete;
   CodeIr& operator=(const CodeIr&) = delete;
 
+  // Discards the current code IR and raises the IR for a different method
+  // (the node arena and the decoding tables are recycled, so a single
+  //  CodeIr instance can be used as a workspace to walk many methods
+  //  without going back to the heap for every node)
+  void Reset(ir::EncodedMethod* ir_method);
+
+  // Memory reserved by the node arena
+  size_t ArenaCapacity() const { return arena_.capacity(); }
+
   void Assemble();
 
   void Accept(Visitor* visitor) {
@@ -418,10 +430,11 @@ struct CodeIr {
     }
   }
 
+  // The nodes live in the CodeIr arena, until the next Reset()
   template <class T, class... Args>
   T* Alloc(Args&&... args) {
-    auto p = new T(std::forward<Args>(args)...);
-    nodes_.push_back(own<T>(p));
+    auto p = new (arena_.Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    nodes_.push_back(p);
     return p;
   }
 
@@ -431,6 +444,8 @@ struct CodeIr {
   void DissasembleTryBlocks(const ir::Code* ir_code);
   void DissasembleDebugInfo(const ir::DebugInfo* ir_debug_info);
 
+  void FreeNodes();
+
   void FixupSwitches();
   void FixupPackedSwitch(PackedSwitchPayload* instr, dex::u4 base_offset, const dex::u2* ptr);
   void FixupSparseSwitch(SparseSwitchPayload* instr, dex::u4 base_offset, const dex::u2* ptr);
@@ -445,30 +460,48 @@ struct CodeIr {
   Type* GetType(dex::u4 index);
   String* GetString(dex::u4 index);
   Label* GetLabel(dex::u4 offset);
+  Label*& LabelSlot(dex::u4 offset);
 
   Operand* GetRegA(const dex::Instruction& dex_instr);
   Operand* GetRegB(const dex::Instruction& dex_instr);
   Operand* GetRegC(const dex::Instruction& dex_instr);
 
  private:
+  // backing memory for all the LIR owned nodes
+  slicer::Arena arena_;
+
   // the "master index" of all the LIR owned nodes
-  std::vector<own<Node>> nodes_;
+  // (the arena doesn't run the node destructors)
+  std::vector<Node*> nodes_;
 
   // data structures for fixing up switch payloads
   struct PackedSwitchFixup {
+    dex::u4 offset = kInvalidOffset;
     PackedSwitchPayload* instr = nullptr;
     dex::u4 base_offset = kInvalidOffset;
   };
 
   struct SparseSwitchFixup {
+    dex::u4 offset = kInvalidOffset;
     SparseSwitchPayload* instr = nullptr;
     dex::u4 base_offset = kInvalidOffset;
   };
 
+  template <class T>
+  static T& GetFixup(std::vector<T>& fixups, dex::u4 offset);
+
   // used during bytecode raising
-  std::map<dex::u4, Label*> labels_;
-  std::map<dex::u4, PackedSwitchFixup> packed_switches_;
-  std::map<dex::u4, SparseSwitchFixup> sparse_switches_;
+  //
+  // labels_ is indexed by the code offset (in 16bit code units),
+  // label_offsets_ tracks the used slots so clearing doesn't touch
+  // the whole table (targets outside the method go to far_labels_). A method has only a handful of switches,
+  // so the switch fixups are small, linearly searched arrays.
+  //
+  std::vector<Label*> labels_;
+  std::vector<dex::u4> label_offsets_;
+  std::vector<std::pair<dex::u4, Label*>> far_labels_;
+  std::vector<PackedSwitchFixup> packed_switches_;
+  std::vector<SparseSwitchFixup> sparse_switches_;
 
   // extra instructions/annotations created during raising
   // (intended to be merged in with the main instruction
@@ -32,6 +32,17 @@ struct Region {
 struct BasicBlock {
   int id = 0;       // real basic blocks have id > 0
   Region region;
+
+  // control flow edges, as indexes into ControlFlowGraph::basic_blocks
+  std::vector<int> successors;
+  std::vector<int> predecessors;
+};
+
+// A natural loop: the header dominates every block in the loop body
+struct Loop {
+  int header = -1;
+  std::vector<int> blocks;       // sorted block indexes, including the header
+  std::vector<int> back_edges;   // the blocks branching back to the header
 };
 
 // LIR visitor used to build the list of basic blocks
@@ -90,15 +101,45 @@ struct ControlFlowGraph {
   // sorted by the byte offset of the region start
   std::vector<BasicBlock> basic_blocks;
 
+  // The immediate dominator of each basic block (-1 for the entry block
+  // and for the blocks which are not reachable from it)
+  // (only available after ComputeDominators())
+  std::vector<int> dominators;
+
+  // Natural loops, sorted by header (only available after FindLoops())
+  std::vector<Loop> loops;
+
   const CodeIr* code_ir;
 
  public:
   ControlFlowGraph(const CodeIr* code_ir, bool model_exceptions) : code_ir(code_ir) {
     CreateBasicBlocks(model_exceptions);
+    CreateEdges();
+  }
+
+  // Iterative dominators computation ("A Simple, Fast Dominance Algorithm",
+  // Cooper, Harvey & Kennedy), a few passes over the blocks in reverse postorder
+  void ComputeDominators();
+
+  // Finds the natural loops from the back edges (computes the dominators if needed)
+  void FindLoops();
+
+  // Returns true if block "a" dominates block "b" (both are block indexes)
+  bool Dominates(int a, int b) const;
+
+  bool IsReachable(int block) const {
+    return !rpo_index_.empty() && rpo_index_[block] >= 0;
   }
 
  private:
   void CreateBasicBlocks(bool model_exceptions);
+  void CreateEdges();
+  void AddEdge(int from, int to);
+  int Intersect(int a, int b) const;
+
+ private:
+  // position of each block in the reverse postorder, -1 if unreachable
+  std::vector<int> rpo_index_;
 };
 
 }  // namespace lir
@@ -28,6 +28,8 @@
 #include <stdlib.h>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <vector>
 #include <string>
 
@@ -352,9 +354,54 @@ struct MethodsHasher {
   bool Compare(const MethodKey& method_key, const EncodedMethod* method) const;
 };
 
+// ir::Type hashing
+// (by the descriptor node, the strings are unique)
+struct TypesHasher {
+  String* GetKey(const Type* type) const { return type->descriptor; }
+  uint32_t Hash(String* descriptor) const;
+  bool Compare(String* descriptor, const Type* type) const;
+};
+
+// ir::TypeList hashing
+struct TypeListsHasher {
+  const std::vector<Type*>& GetKey(const TypeList* type_list) const { return type_list->types; }
+  uint32_t Hash(const std::vector<Type*>& types) const;
+  bool Compare(const std::vector<Type*>& types, const TypeList* type_list) const;
+};
+
+// ir::FieldDecl hashing
+struct FieldDeclKey {
+  String* name = nullptr;
+  Type* type = nullptr;
+  Type* parent = nullptr;
+};
+
+struct FieldDeclsHasher {
+  FieldDeclKey GetKey(const FieldDecl* field) const;
+  uint32_t Hash(const FieldDeclKey& field_key) const;
+  bool Compare(const FieldDeclKey& field_key, const FieldDecl* field) const;
+};
+
+// ir::MethodDecl hashing
+struct MethodDeclKey {
+  String* name = nullptr;
+  Proto* prototype = nullptr;
+  Type* parent = nullptr;
+};
+
+struct MethodDeclsHasher {
+  MethodDeclKey GetKey(const MethodDecl* method) const;
+  uint32_t Hash(const MethodDeclKey& method_key) const;
+  bool Compare(const MethodDeclKey& method_key, const MethodDecl* method) const;
+};
+
 using StringsLookup = slicer::HashTable<const char*, String, StringsHasher>;
 using PrototypesLookup = slicer::HashTable<const std::string&, Proto, ProtosHasher>;
 using MethodsLookup = slicer::HashTable<const MethodKey&, EncodedMethod, MethodsHasher>;
+using TypesLookup = slicer::HashTable<String*, Type, TypesHasher>;
+using TypeListsLookup = slicer::HashTable<const std::vector<Type*>&, TypeList, TypeListsHasher>;
+using FieldDeclsLookup = slicer::HashTable<const FieldDeclKey&, FieldDecl, FieldDeclsHasher>;
+using MethodDeclsLookup = slicer::HashTable<const MethodDeclKey&, MethodDecl, MethodDeclsHasher>;
 
 // The main container/root for a .dex IR
 struct DexFile {
@@ -411,6 +458,15 @@ struct DexFile {
   StringsLookup strings_lookup;
   MethodsLookup methods_lookup;
   PrototypesLookup prototypes_lookup;
+  TypesLookup types_lookup;
+  TypeListsLookup type_lists_lookup;
+  FieldDeclsLookup field_decls_lookup;
+  MethodDeclsLookup method_decls_lookup;
+
+  // guards the index maps, the lookup tables and the node vectors when
+  // methods are instrumented in parallel: ir::Builder takes it exclusively
+  // to create new nodes, raising a code IR takes it shared
+  mutable std::shared_mutex builder_lock;
 
  public:
   DexFile() = default;
@@ -427,6 +483,7 @@ struct DexFile {
   }
 
   void AttachBuffer(slicer::Buffer&& buffer) {
+    std::lock_guard<std::mutex> guard(buffers_lock_);
     buffers_.push_back(std::move(buffer));
   }
 
@@ -466,7 +523,9 @@ struct DexFile {
 
 private:
   // additional memory buffers owned by this .dex IR
+  // (the code encoders attach them concurrently)
   std::vector<slicer::Buffer> buffers_;
+  std::mutex buffers_lock_;
 };
 
 }  // namespace ir
@@ -21,7 +21,9 @@
 #include "dex_ir.h"
 #include "dex_ir_builder.h"
 
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 #include <utility>
 #include <set>
@@ -186,9 +188,80 @@ class MethodInstrumenter {
   bool InstrumentMethod(ir::EncodedMethod* ir_method);
   bool InstrumentMethod(const ir::MethodId& method_id);
 
+  // Apply all the queued transformations to an already raised code IR
+  // (ex. a CodeIr recycled with Reset() across methods) and assemble it
+  bool InstrumentCode(lir::CodeIr* code_ir);
+
  private:
   std::shared_ptr<ir::DexFile> dex_ir_;
   std::vector<std::unique_ptr<Transformation>> transformations_;
 };
 
+// Selects the methods of a batch instrumentation, every non-empty
+// criteria must match:
+//
+//  class_prefix - prefix of the class descriptor (ex. "Lcom/example/")
+//  annotation   - descriptor of an annotation on the method or on its
+//                 class (ex. "Lcom/example/Trace;")
+//  signature    - pattern for the method name and signature, '*' matches
+//                 any sequence and '?' a single char (ex. "on*(Landroid/*)V")
+//
+// Abstract and native methods are never selected.
+struct MethodFilter {
+  std::string class_prefix;
+  std::string annotation;
+  std::string signature;
+
+  bool Match(const ir::Class* ir_class, const ir::EncodedMethod* ir_method) const;
+};
+
+// Instruments many (distinct) methods across worker threads: the methods
+// are split in chunks and every chunk is a task with its own
+// MethodInstrumenter (the transformations keep per method state) and its
+// own CodeIr workspace. Raising, transforming and assembling run in
+// parallel, only the ir::Builder calls which look up or create strings,
+// types, protos and methods are serialized (DexFile::builder_lock).
+//
+// For example, tracing every method of a package:
+//
+//    ...
+//    slicer::MethodFilter filter;
+//    filter.class_prefix = "Lcom/example/";
+//    slicer::BatchInstrumenter bi(dex_ir, [](slicer::MethodInstrumenter* mi) {
+//      mi->AddTransformation<slicer::EntryHook>(ir::MethodId("LTracer;", "OnEntry"));
+//      mi->AddTransformation<slicer::ExitHook>(ir::MethodId("LTracer;", "OnExit"));
+//    });
+//    auto methods = bi.SelectMethods(filter);
+//    bi.InstrumentMethods(methods, parallel_for);
+//    ...
+//
+class BatchInstrumenter {
+ public:
+  // queues the transformations of a task's MethodInstrumenter
+  // (called once per task, possibly from several threads at once)
+  using Setup = std::function<void(MethodInstrumenter* mi)>;
+
+  // runs task(0) ... task(count - 1), possibly in parallel
+  using ParallelFor = std::function<void(size_t count, const std::function<void(size_t)>& task)>;
+
+  BatchInstrumenter(std::shared_ptr<ir::DexFile> dex_ir, Setup setup)
+      : dex_ir_(dex_ir), setup_(std::move(setup)) {}
+
+  // No copy/move semantics
+  BatchInstrumenter(const BatchInstrumenter&) = delete;
+  BatchInstrumenter& operator=(const BatchInstrumenter&) = delete;
+
+  // The methods matching the filter, in class order
+  std::vector<ir::EncodedMethod*> SelectMethods(const MethodFilter& filter) const;
+
+  // Apply the transformations to all the methods
+  // (returns how many were instrumented)
+  size_t InstrumentMethods(const std::vector<ir::EncodedMethod*>& methods,
+                           const ParallelFor& parallel_for);
+
+ private:
+  std::shared_ptr<ir::DexFile> dex_ir_;
+  Setup setup_;
+};
+
 }  // namespace slicer
@@ -128,6 +128,12 @@ class IntrusiveList {
     pos->next = nullptr;
   }
 
+  // Unlinks all the elements (the list doesn't own them)
+  void clear() {
+    begin_ = end_;
+    end_sentinel_.prev = nullptr;
+  }
+
   bool empty() const { return begin_ == end_; }
 
   Iterator begin() const { return Iterator(begin_); }
@@ -22,6 +22,7 @@
 #include "dex_format.h"
 #include "dex_ir.h"
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <vector>
@@ -175,6 +176,10 @@ class Writer {
     virtual ~Allocator() = default;
   };
 
+  // runs task(0) ... task(count - 1), possibly in parallel
+  // (the tasks write disjoint parts of the image)
+  using ParallelFor = std::function<void(size_t count, const std::function<void(size_t)>& task)>;
+
  public:
   explicit Writer(std::shared_ptr<ir::DexFile> dex_ir) : dex_ir_(dex_ir) {}
   ~Writer() = default;
@@ -185,6 +190,13 @@ class Writer {
   // .dex image creation
   dex::u1* CreateImage(Allocator* allocator, size_t* new_image_size);
 
+  // .dex image creation, where the final copy of the sections and the
+  // checksum are split in tasks for "parallel_for". If "zero_filled" the
+  // allocator returns zeroed memory (ex. a new file mapping), so it's not
+  // cleared again.
+  dex::u1* CreateImage(Allocator* allocator, size_t* new_image_size,
+                       bool zero_filled, const ParallelFor& parallel_for);
+
  private:
   // helpers for creating various .dex sections
   dex::u4 CreateStringDataSection(dex::u4 section_offset);
@@ -17,6 +17,10 @@
 #include "slicer/instrumentation.h"
 #include "slicer/dex_ir_builder.h"
 
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+
 namespace slicer {
 
 namespace {
@@ -443,15 +447,19 @@ bool MethodInstrumenter::InstrumentMethod(ir::EncodedMethod* ir_method) {
     return false;
   }
 
-  // apply all the queued transformations
   lir::CodeIr code_ir(ir_method, dex_ir_);
+  return InstrumentCode(&code_ir);
+}
+
+bool MethodInstrumenter::InstrumentCode(lir::CodeIr* code_ir) {
+  // apply all the queued transformations
   for (const auto& transformation : transformations_) {
-    if (!transformation->Apply(&code_ir)) {
+    if (!transformation->Apply(code_ir)) {
       // the transformation failed, bail out...
       return false;
     }
   }
-  code_ir.Assemble();
+  code_ir->Assemble();
   return true;
 }
 
@@ -466,4 +474,148 @@ bool MethodInstrumenter::InstrumentMethod(const ir::MethodId& method_id) {
   return InstrumentMethod(ir_method);
 }
 
+// Glob style matching, '*' matches any sequence and '?' a single char
+static bool MatchPattern(const char* pattern, const char* text) {
+  const char* star = nullptr;
+  const char* star_text = nullptr;
+  while (*text != 0) {
+    if (*pattern == '*') {
+      star = pattern++;
+      star_text = text;
+    } else if (*pattern == '?' || *pattern == *text) {
+      ++pattern;
+      ++text;
+    } else if (star != nullptr) {
+      // backtrack: the last '*' swallows one more char
+      pattern = star + 1;
+      text = ++star_text;
+    } else {
+      return false;
+    }
+  }
+  while (*pattern == '*') {
+    ++pattern;
+  }
+  return *pattern == 0;
+}
+
+static bool HasAnnotation(const ir::AnnotationSet* ir_annotations, const char* descriptor) {
+  if (ir_annotations == nullptr) {
+    return false;
+  }
+  for (auto ir_annotation : ir_annotations->annotations) {
+    if (::strcmp(ir_annotation->type->descriptor->c_str(), descriptor) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool MethodFilter::Match(const ir::Class* ir_class, const ir::EncodedMethod* ir_method) const {
+  if (ir_method->code == nullptr) {
+    // abstract or native method
+    return false;
+  }
+
+  const auto ir_decl = ir_method->decl;
+  if (!class_prefix.empty() &&
+      ::strncmp(ir_decl->parent->descriptor->c_str(), class_prefix.c_str(), class_prefix.size()) != 0) {
+    return false;
+  }
+
+  if (!signature.empty()) {
+    const auto name = std::string(ir_decl->name->c_str()) + ir_decl->prototype->Signature();
+    if (!MatchPattern(signature.c_str(), name.c_str())) {
+      return false;
+    }
+  }
+
+  if (!annotation.empty()) {
+    const auto ir_directory = ir_class->annotations;
+    if (ir_directory == nullptr) {
+      return false;
+    }
+    bool annotated = HasAnnotation(ir_directory->class_annotation, annotation.c_str());
+    for (auto ir_method_annotation : ir_directory->method_annotations) {
+      if (annotated) {
+        break;
+      }
+      annotated = ir_method_annotation->method_decl == ir_decl &&
+                  HasAnnotation(ir_method_annotation->annotations, annotation.c_str());
+    }
+    if (!annotated) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::vector<ir::EncodedMethod*> BatchInstrumenter::SelectMethods(const MethodFilter& filter) const {
+  std::vector<ir::EncodedMethod*> methods;
+  for (const auto& ir_class : dex_ir_->classes) {
+    for (auto ir_method : ir_class->direct_methods) {
+      if (filter.Match(ir_class.get(), ir_method)) {
+        methods.push_back(ir_method);
+      }
+    }
+    for (auto ir_method : ir_class->virtual_methods) {
+      if (filter.Match(ir_class.get(), ir_method)) {
+        methods.push_back(ir_method);
+      }
+    }
+  }
+  return methods;
+}
+
+// methods per batch task: large enough to amortize the task setup
+// and the CodeIr workspace, small enough to balance the workers
+static constexpr size_t kBatchChunkSize = 64;
+
+size_t BatchInstrumenter::InstrumentMethods(const std::vector<ir::EncodedMethod*>& methods,
+                                            const ParallelFor& parallel_for) {
+  const size_t type_lists_before = dex_ir_->type_lists.size();
+  std::atomic<size_t> instrumented(0);
+  const size_t chunks = (methods.size() + kBatchChunkSize - 1) / kBatchChunkSize;
+  parallel_for(chunks, [&](size_t chunk) {
+    MethodInstrumenter mi(dex_ir_);
+    setup_(&mi);
+
+    const size_t begin = chunk * kBatchChunkSize;
+    const size_t end = std::min(methods.size(), begin + kBatchChunkSize);
+    std::unique_ptr<lir::CodeIr> code_ir;
+    size_t count = 0;
+    for (size_t i = begin; i < end; ++i) {
+      auto ir_method = methods[i];
+      if (ir_method->code == nullptr) {
+        // can't instrument abstract methods
+        continue;
+      }
+      if (code_ir == nullptr) {
+        code_ir.reset(new lir::CodeIr(ir_method, dex_ir_));
+      } else {
+        code_ir->Reset(ir_method);
+      }
+      if (mi.InstrumentCode(code_ir.get())) {
+        ++count;
+      }
+    }
+    instrumented += count;
+  });
+
+  // the new type lists are in the order the tasks happened to create them,
+  // sort them so the .dex image doesn't depend on the thread scheduling
+  // (the other new nodes are sorted by DexFile::Normalize())
+  auto descriptor_less = [](const ir::Type* a, const ir::Type* b) {
+    return ::strcmp(a->descriptor->c_str(), b->descriptor->c_str()) < 0;
+  };
+  std::sort(dex_ir_->type_lists.begin() + type_lists_before, dex_ir_->type_lists.end(),
+            [&](const ir::own<ir::TypeList>& a, const ir::own<ir::TypeList>& b) {
+              return std::lexicographical_compare(a->types.begin(), a->types.end(),
+                                                  b->types.begin(), b->types.end(),
+                                                  descriptor_less);
+            });
+  return instrumented;
+}
+
 }  // namespace slicer
@@ -795,6 +795,12 @@ ir::Type* Reader::ParseType(dex::u4 index) {
   ir_type->descriptor = GetString(dex_type.descriptor_idx);
   ir_type->orig_index = index;
 
+  // update the types lookup table
+  // (the first one wins if the .dex has duplicate type ids)
+  if (dex_ir_->types_lookup.Lookup(ir_type->descriptor) == nullptr) {
+    dex_ir_->types_lookup.Insert(ir_type);
+  }
+
   return ir_type;
 }
 
@@ -807,6 +813,12 @@ ir::FieldDecl* Reader::ParseFieldDecl(dex::u4 index) {
   ir_field->parent = GetType(dex_field.class_idx);
   ir_field->orig_index = index;
 
+  // update the field declarations lookup table
+  ir::FieldDeclsHasher hasher;
+  if (dex_ir_->field_decls_lookup.Lookup(hasher.GetKey(ir_field)) == nullptr) {
+    dex_ir_->field_decls_lookup.Insert(ir_field);
+  }
+
   return ir_field;
 }
 
@@ -819,6 +831,12 @@ ir::MethodDecl* Reader::ParseMethodDecl(dex::u4 index) {
   ir_method->parent = GetType(dex_method.class_idx);
   ir_method->orig_index = index;
 
+  // update the method declarations lookup table
+  ir::MethodDeclsHasher hasher;
+  if (dex_ir_->method_decls_lookup.Lookup(hasher.GetKey(ir_method)) == nullptr) {
+    dex_ir_->method_decls_lookup.Insert(ir_method);
+  }
+
   return ir_method;
 }
 
@@ -838,6 +856,11 @@ ir::TypeList* Reader::ExtractTypeList(dex::u4 offset) {
     for (dex::u4 i = 0; i < dex_type_list->size; ++i) {
       ir_type_list->types.push_back(GetType(dex_type_list->list[i].type_idx));
     }
+
+    // update the type lists lookup table
+    if (dex_ir_->type_lists_lookup.Lookup(ir_type_list->types) == nullptr) {
+      dex_ir_->type_lists_lookup.Insert(ir_type_list);
+    }
   }
 
   return ir_type_list;
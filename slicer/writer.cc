@@ -28,6 +28,7 @@
 #include <cstdlib>
 #include <string.h>
 #include <algorithm>
+#include <zlib.h>
 
 namespace dex {
 
@@ -215,12 +216,24 @@ static void WriteEncodedArray(const ir::EncodedArray* ir_array, Section& data) {
   }
 }
 
+// a part of a .dex section, copied to the final image by one task
+struct ImageChunk {
+  const dex::u1* data;
+  dex::u4 offset;
+  dex::u4 size;
+};
+
+// the big sections are split so the copy tasks are balanced
+static constexpr dex::u4 kImageChunkSize = 1024 * 1024;
+
 // helper for concatenating .dex sections into the final image
+// (returns the section size)
 template <class T>
-static void CopySection(const T& section, dex::u1* image, dex::u4 image_size) {
+static dex::u4 AddSectionChunks(const T& section, dex::u4 image_size,
+                                std::vector<ImageChunk>& chunks) {
   if (section.size() == 0) {
     SLICER_CHECK(section.ItemsCount() == 0);
-    return;
+    return 0;
   }
 
   SLICER_CHECK(section.ItemsCount() > 0);
@@ -229,7 +242,32 @@ static void CopySection(const T& section, dex::u1* image, dex::u4 image_size) {
   SLICER_CHECK(offset >= sizeof(dex::Header));
   SLICER_CHECK(offset + size <= image_size);
 
-  ::memcpy(image + offset, section.data(), size);
+  const auto data = reinterpret_cast<const dex::u1*>(section.data());
+  for (dex::u4 pos = 0; pos < size; pos += kImageChunkSize) {
+    chunks.push_back({data + pos, offset + pos, std::min(kImageChunkSize, size - pos)});
+  }
+  return size;
+}
+
+// same as dex::ComputeChecksum(), the adler32 of the chunks
+// are computed in parallel then combined
+static dex::u4 ComputeChunkedChecksum(const dex::u1* image, dex::u4 image_size,
+                                      const Writer::ParallelFor& parallel_for) {
+  const dex::u4 start = sizeof(dex::Header::magic) + sizeof(dex::Header::checksum);
+  const dex::u4 count = (image_size - start + kImageChunkSize - 1) / kImageChunkSize;
+  std::vector<uLong> sums(count);
+  parallel_for(count, [&](size_t i) {
+    const dex::u4 offset = start + i * kImageChunkSize;
+    const dex::u4 size = std::min(kImageChunkSize, image_size - offset);
+    sums[i] = adler32(adler32(0L, Z_NULL, 0), image + offset, size);
+  });
+
+  uLong adler = adler32(0L, Z_NULL, 0);
+  for (dex::u4 i = 0; i < count; ++i) {
+    const dex::u4 offset = start + i * kImageChunkSize;
+    adler = adler32_combine(adler, sums[i], std::min(kImageChunkSize, image_size - offset));
+  }
+  return static_cast<dex::u4>(adler);
 }
 
 static u4 ReadU4(const u2* ptr) { return ptr[0] | (u4(ptr[1]) << 16); }
@@ -242,6 +280,16 @@ static void WriteU4(u2* ptr, u4 val) {
 // This is the main interface for the .dex writer
 // (returns nullptr on failure)
 dex::u1* Writer::CreateImage(Allocator* allocator, size_t* new_image_size) {
+  auto serial_for = [](size_t count, const std::function<void(size_t)>& task) {
+    for (size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+  };
+  return CreateImage(allocator, new_image_size, false, serial_for);
+}
+
+dex::u1* Writer::CreateImage(Allocator* allocator, size_t* new_image_size,
+                             bool zero_filled, const ParallelFor& parallel_for) {
   // create a new DexImage
   dex_.reset(new DexImage);
 
@@ -284,12 +332,16 @@ dex::u1* Writer::CreateImage(Allocator* allocator, size_t* new_image_size) {
   offset += CreateAnnDirectoriesSection(offset);
   offset += CreateMapSection(offset);
 
-  // back-fill the indexes
-  FillTypes();
-  FillFields();
-  FillProtos();
-  FillMethods();
-  FillClassDefs();
+  // back-fill the indexes (each one only reads the IR)
+  parallel_for(5, [this](size_t i) {
+    switch (i) {
+      case 0: FillTypes(); break;
+      case 1: FillFields(); break;
+      case 2: FillProtos(); break;
+      case 3: FillMethods(); break;
+      case 4: FillClassDefs(); break;
+    }
+  });
 
   // allocate the final buffer for the .dex image
   SLICER_CHECK(offset % 4 == 0);
@@ -299,7 +351,11 @@ dex::u1* Writer::CreateImage(Allocator* allocator, size_t* new_image_size) {
     // memory allocation failed, bailing out...
     return nullptr;
   }
-  memset(image, 0, image_size);
+
+  // the sections cover the whole image after the header
+  if (!zero_filled) {
+    memset(image, 0, sizeof(dex::Header));
+  }
 
   // finally, back-fill the header
   SLICER_CHECK(image_size > sizeof(dex::Header));
@@ -333,26 +389,33 @@ dex::u1* Writer::CreateImage(Allocator* allocator, size_t* new_image_size) {
   header->data_off = data_offset;
 
   // copy the individual sections to the final image
-  CopySection(dex_->string_ids, image, image_size);
-  CopySection(dex_->type_ids, image, image_size);
-  CopySection(dex_->proto_ids, image, image_size);
-  CopySection(dex_->field_ids, image, image_size);
-  CopySection(dex_->method_ids, image, image_size);
-  CopySection(dex_->class_defs, image, image_size);
-  CopySection(dex_->string_data, image, image_size);
-  CopySection(dex_->type_lists, image, image_size);
-  CopySection(dex_->debug_info, image, image_size);
-  CopySection(dex_->encoded_arrays, image, image_size);
-  CopySection(dex_->code, image, image_size);
-  CopySection(dex_->class_data, image, image_size);
-  CopySection(dex_->ann_directories, image, image_size);
-  CopySection(dex_->ann_set_ref_lists, image, image_size);
-  CopySection(dex_->ann_sets, image, image_size);
-  CopySection(dex_->ann_items, image, image_size);
-  CopySection(dex_->map_list, image, image_size);
+  std::vector<ImageChunk> chunks;
+  dex::u4 copy_size = sizeof(dex::Header);
+  copy_size += AddSectionChunks(dex_->string_ids, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->type_ids, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->proto_ids, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->field_ids, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->method_ids, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->class_defs, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->string_data, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->type_lists, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->debug_info, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->encoded_arrays, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->code, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->class_data, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->ann_directories, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->ann_set_ref_lists, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->ann_sets, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->ann_items, image_size, chunks);
+  copy_size += AddSectionChunks(dex_->map_list, image_size, chunks);
+  SLICER_CHECK(copy_size == image_size);
+
+  parallel_for(chunks.size(), [&](size_t i) {
+    ::memcpy(image + chunks[i].offset, chunks[i].data, chunks[i].size);
+  });
 
   // checksum
-  header->checksum = dex::ComputeChecksum(header);
+  header->checksum = ComputeChunkedChecksum(image, image_size, parallel_for);
 
   *new_image_size = image_size;
   return image;